@@ -0,0 +1,1503 @@
+// generated by embed_cl.sh from the .cl files, do not edit
+
+#include <cstring>
+#include "cl_source.h"
+
+static const struct { const char* name; const char* code; } sources[] = {
+	{ "crypt.cl",
+		"/*Iterated crypt formats ($1$ md5crypt, $6$ sha512crypt), built after\n"
+		"smash.cl for load_word() but independent of the hash file. Every\n"
+		"work-item runs all rounds of one word against one salt group; the\n"
+		"whole state stays in private memory, the group's sorted digests are\n"
+		"only read at the end.*/\n"
+		"\n"
+		"#define CRYPT_MAX_SALT 16\n"
+		"\n"
+		"__constant uint md5c_k[64] = {\n"
+		"	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,\n"
+		"	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,\n"
+		"	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,\n"
+		"	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,\n"
+		"	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,\n"
+		"	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,\n"
+		"	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,\n"
+		"	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391\n"
+		"};\n"
+		"\n"
+		"__constant uint md5c_r[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };\n"
+		"\n"
+		"__constant ulong sha512c_k[80] = {\n"
+		"	0x428a2f98d728ae22UL, 0x7137449123ef65cdUL, 0xb5c0fbcfec4d3b2fUL, 0xe9b5dba58189dbbcUL,\n"
+		"	0x3956c25bf348b538UL, 0x59f111f1b605d019UL, 0x923f82a4af194f9bUL, 0xab1c5ed5da6d8118UL,\n"
+		"	0xd807aa98a3030242UL, 0x12835b0145706fbeUL, 0x243185be4ee4b28cUL, 0x550c7dc3d5ffb4e2UL,\n"
+		"	0x72be5d74f27b896fUL, 0x80deb1fe3b1696b1UL, 0x9bdc06a725c71235UL, 0xc19bf174cf692694UL,\n"
+		"	0xe49b69c19ef14ad2UL, 0xefbe4786384f25e3UL, 0x0fc19dc68b8cd5b5UL, 0x240ca1cc77ac9c65UL,\n"
+		"	0x2de92c6f592b0275UL, 0x4a7484aa6ea6e483UL, 0x5cb0a9dcbd41fbd4UL, 0x76f988da831153b5UL,\n"
+		"	0x983e5152ee66dfabUL, 0xa831c66d2db43210UL, 0xb00327c898fb213fUL, 0xbf597fc7beef0ee4UL,\n"
+		"	0xc6e00bf33da88fc2UL, 0xd5a79147930aa725UL, 0x06ca6351e003826fUL, 0x142929670a0e6e70UL,\n"
+		"	0x27b70a8546d22ffcUL, 0x2e1b21385c26c926UL, 0x4d2c6dfc5ac42aedUL, 0x53380d139d95b3dfUL,\n"
+		"	0x650a73548baf63deUL, 0x766a0abb3c77b2a8UL, 0x81c2c92e47edaee6UL, 0x92722c851482353bUL,\n"
+		"	0xa2bfe8a14cf10364UL, 0xa81a664bbc423001UL, 0xc24b8b70d0f89791UL, 0xc76c51a30654be30UL,\n"
+		"	0xd192e819d6ef5218UL, 0xd69906245565a910UL, 0xf40e35855771202aUL, 0x106aa07032bbd1b8UL,\n"
+		"	0x19a4c116b8d2d0c8UL, 0x1e376c085141ab53UL, 0x2748774cdf8eeb99UL, 0x34b0bcb5e19b48a8UL,\n"
+		"	0x391c0cb3c5c95a63UL, 0x4ed8aa4ae3418acbUL, 0x5b9cca4f7763e373UL, 0x682e6ff3d6b2b8a3UL,\n"
+		"	0x748f82ee5defb2fcUL, 0x78a5636f43172f60UL, 0x84c87814a1f0ab72UL, 0x8cc702081a6439ecUL,\n"
+		"	0x90befffa23631e28UL, 0xa4506cebde82bde9UL, 0xbef9a3f7b2c67915UL, 0xc67178f2e372532bUL,\n"
+		"	0xca273eceea26619cUL, 0xd186b8c721c0c207UL, 0xeada7dd6cde0eb1eUL, 0xf57d4f7fee6ed178UL,\n"
+		"	0x06f067aa72176fbaUL, 0x0a637dc5a2c898a6UL, 0x113f9804bef90daeUL, 0x1b710b35131c471bUL,\n"
+		"	0x28db77f523047d84UL, 0x32caab7b40c72493UL, 0x3c9ebe0a15c9bebcUL, 0x431d67c49c100d4cUL,\n"
+		"	0x4cc5d4becb3e42b6UL, 0x597f299cfc657e2aUL, 0x5fcb6fab3ad6faecUL, 0x6c44198c4a475817UL\n"
+		"};\n"
+		"\n"
+		"__constant ulong sha512c_iv[8] = {\n"
+		"	0x6a09e667f3bcc908UL, 0xbb67ae8584caa73bUL, 0x3c6ef372fe94f82bUL, 0xa54ff53a5f1d36f1UL,\n"
+		"	0x510e527fade682d1UL, 0x9b05688c2b3e6c1fUL, 0x1f83d9abfb41bd6bUL, 0x5be0cd19137e2179UL\n"
+		"};\n"
+		"\n"
+		"/*Streaming MD5, fed a few bytes at a time.*/\n"
+		"typedef struct {\n"
+		"	uint s[4];\n"
+		"	uchar buf[64];\n"
+		"	uint fill;\n"
+		"	uint total;\n"
+		"} md5c_ctx;\n"
+		"\n"
+		"void md5c_block(md5c_ctx* c) {\n"
+		"	uint m[16];\n"
+		"	for (uint w = 0; w < 16; ++w)\n"
+		"		m[w] = c->buf[w * 4] | (c->buf[w * 4 + 1] << 8) | (c->buf[w * 4 + 2] << 16) | ((uint)c->buf[w * 4 + 3] << 24);\n"
+		"\n"
+		"	uint a = c->s[0], b = c->s[1], d = c->s[3], cc = c->s[2];\n"
+		"	for (uint i = 0; i < 64; ++i) {\n"
+		"		uint f, g;\n"
+		"		if (i < 16) { f = d ^ (b & (cc ^ d)); g = i; }\n"
+		"		else if (i < 32) { f = cc ^ (d & (b ^ cc)); g = (5 * i + 1) & 15; }\n"
+		"		else if (i < 48) { f = b ^ cc ^ d; g = (3 * i + 5) & 15; }\n"
+		"		else { f = cc ^ (b | ~d); g = (7 * i) & 15; }\n"
+		"\n"
+		"		const uint t = d;\n"
+		"		d = cc;\n"
+		"		cc = b;\n"
+		"		b += rotate(a + f + md5c_k[i] + m[g], md5c_r[(i >> 4) * 4 + (i & 3)]);\n"
+		"		a = t;\n"
+		"	}\n"
+		"\n"
+		"	c->s[0] += a;\n"
+		"	c->s[1] += b;\n"
+		"	c->s[2] += cc;\n"
+		"	c->s[3] += d;\n"
+		"}\n"
+		"\n"
+		"inline void md5c_init(md5c_ctx* c) {\n"
+		"	c->s[0] = 0x67452301;\n"
+		"	c->s[1] = 0xefcdab89;\n"
+		"	c->s[2] = 0x98badcfe;\n"
+		"	c->s[3] = 0x10325476;\n"
+		"	c->fill = 0;\n"
+		"	c->total = 0;\n"
+		"}\n"
+		"\n"
+		"void md5c_add(md5c_ctx* c, const uchar* p, uint n) {\n"
+		"	c->total += n;\n"
+		"	for (uint k = 0; k < n; ++k) {\n"
+		"		c->buf[c->fill++] = p[k];\n"
+		"		if (c->fill == 64) {\n"
+		"			md5c_block(c);\n"
+		"			c->fill = 0;\n"
+		"		}\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"void md5c_add_global(md5c_ctx* c, __global const uchar* p, uint n) {\n"
+		"	uchar b[CRYPT_MAX_SALT];\n"
+		"	for (uint k = 0; k < n; ++k)\n"
+		"		b[k] = p[k];\n"
+		"	md5c_add(c, b, n);\n"
+		"}\n"
+		"\n"
+		"void md5c_finish(md5c_ctx* c, uchar* out) {\n"
+		"	const uint bits = c->total * 8;\n"
+		"	c->buf[c->fill++] = 0x80;\n"
+		"	if (c->fill > 56) {\n"
+		"		while (c->fill < 64)\n"
+		"			c->buf[c->fill++] = 0;\n"
+		"		md5c_block(c);\n"
+		"		c->fill = 0;\n"
+		"	}\n"
+		"	while (c->fill < 56)\n"
+		"		c->buf[c->fill++] = 0;\n"
+		"	for (uint k = 0; k < 8; ++k)\n"
+		"		c->buf[56 + k] = (k < 4) ? (uchar)(bits >> (k * 8)) : 0;\n"
+		"	md5c_block(c);\n"
+		"\n"
+		"	for (uint k = 0; k < 16; ++k)\n"
+		"		out[k] = (uchar)(c->s[k / 4] >> ((k % 4) * 8));\n"
+		"}\n"
+		"\n"
+		"/*Streaming SHA-512, same shape.*/\n"
+		"typedef struct {\n"
+		"	ulong s[8];\n"
+		"	uchar buf[128];\n"
+		"	uint fill;\n"
+		"	uint total;\n"
+		"} sha512c_ctx;\n"
+		"\n"
+		"#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))\n"
+		"\n"
+		"void sha512c_block(sha512c_ctx* c) {\n"
+		"	ulong w[16], x[8];\n"
+		"	for (uint k = 0; k < 16; ++k) {\n"
+		"		ulong v = 0;\n"
+		"		for (uint b = 0; b < 8; ++b)\n"
+		"			v = v << 8 | c->buf[k * 8 + b];\n"
+		"		w[k] = v;\n"
+		"	}\n"
+		"	for (uint k = 0; k < 8; ++k)\n"
+		"		x[k] = c->s[k];\n"
+		"\n"
+		"	for (uint t = 0; t < 80; ++t) {\n"
+		"		if (t >= 16) {\n"
+		"			const ulong a = w[(t + 1) & 15], b = w[(t + 14) & 15];\n"
+		"			w[t & 15] += (ROTR64(a, 1) ^ ROTR64(a, 8) ^ (a >> 7)) + w[(t + 9) & 15] + (ROTR64(b, 19) ^ ROTR64(b, 61) ^ (b >> 6));\n"
+		"		}\n"
+		"\n"
+		"		const ulong t1 = x[7] + (ROTR64(x[4], 14) ^ ROTR64(x[4], 18) ^ ROTR64(x[4], 41)) +\n"
+		"			(x[6] ^ (x[4] & (x[5] ^ x[6]))) + sha512c_k[t] + w[t & 15];\n"
+		"		const ulong t2 = (ROTR64(x[0], 28) ^ ROTR64(x[0], 34) ^ ROTR64(x[0], 39)) +\n"
+		"			((x[0] & x[1]) | (x[2] & (x[0] | x[1])));\n"
+		"\n"
+		"		for (uint k = 7; k > 0; --k)\n"
+		"			x[k] = x[k - 1];\n"
+		"		x[4] += t1;\n"
+		"		x[0] = t1 + t2;\n"
+		"	}\n"
+		"\n"
+		"	for (uint k = 0; k < 8; ++k)\n"
+		"		c->s[k] += x[k];\n"
+		"}\n"
+		"\n"
+		"inline void sha512c_init(sha512c_ctx* c) {\n"
+		"	for (uint k = 0; k < 8; ++k)\n"
+		"		c->s[k] = sha512c_iv[k];\n"
+		"	c->fill = 0;\n"
+		"	c->total = 0;\n"
+		"}\n"
+		"\n"
+		"void sha512c_add(sha512c_ctx* c, const uchar* p, uint n) {\n"
+		"	c->total += n;\n"
+		"	for (uint k = 0; k < n; ++k) {\n"
+		"		c->buf[c->fill++] = p[k];\n"
+		"		if (c->fill == 128) {\n"
+		"			sha512c_block(c);\n"
+		"			c->fill = 0;\n"
+		"		}\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"void sha512c_finish(sha512c_ctx* c, uchar* out) {\n"
+		"	const uint bits = c->total * 8;\n"
+		"	c->buf[c->fill++] = 0x80;\n"
+		"	if (c->fill > 112) {\n"
+		"		while (c->fill < 128)\n"
+		"			c->buf[c->fill++] = 0;\n"
+		"		sha512c_block(c);\n"
+		"		c->fill = 0;\n"
+		"	}\n"
+		"	while (c->fill < 128)\n"
+		"		c->buf[c->fill++] = 0;\n"
+		"	for (uint k = 0; k < 4; ++k)\n"
+		"		c->buf[127 - k] = (uchar)(bits >> (k * 8));\n"
+		"	sha512c_block(c);\n"
+		"\n"
+		"	for (uint k = 0; k < 64; ++k)\n"
+		"		out[k] = (uchar)(c->s[k / 8] >> ((7 - k % 8) * 8));\n"
+		"}\n"
+		"\n"
+		"inline int crypt_compare(__global const uchar* t, const uchar* digest, const uint size) {\n"
+		"	int c = 0;\n"
+		"	for (uint k = 0; k < size && !c; ++k)\n"
+		"		c = (int)t[k] - (int)digest[k];\n"
+		"	return c;\n"
+		"}\n"
+		"\n"
+		"/*Appends every match against the group's sorted digests to 'hits', in\n"
+		"the layout of check_targets(). Users who share a salt and a password\n"
+		"share the digest, each of them gets a hit.*/\n"
+		"void crypt_check(__global volatile uint* hits, const uchar* digest, const uint size, const uint index,\n"
+		"	__global const uchar* digests, const uint targets, const uint capacity) {\n"
+		"	uint lo = 0, hi = targets;\n"
+		"	while (lo < hi) {\n"
+		"		const uint mid = (lo + hi) / 2;\n"
+		"		if (crypt_compare(digests + mid * size, digest, size) < 0)\n"
+		"			lo = mid + 1;\n"
+		"		else\n"
+		"			hi = mid;\n"
+		"	}\n"
+		"\n"
+		"	for (; lo < targets && !crypt_compare(digests + lo * size, digest, size); ++lo) {\n"
+		"		const uint slot = atomic_inc(&hits[0]);\n"
+		"		if (slot < capacity) {\n"
+		"			hits[1 + slot * 2] = index;\n"
+		"			hits[2 + slot * 2] = lo;\n"
+		"		}\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"__kernel void smash_md5crypt(__global volatile uint* hits, __global const uchar* data, __global const uint* words, uint count,\n"
+		"	__global const uchar* salt_data, uint salt_length, uint rounds, __global const uchar* digests, uint targets, uint capacity) {\n"
+		"	const uint id = get_global_id(0);\n"
+		"	if (id >= count)\n"
+		"		return;\n"
+		"\n"
+		"	uchar key[MAX_KEY_LEN], salt[CRYPT_MAX_SALT], alt[16];\n"
+		"	const uint length = load_word((char*)key, data, words[id]);\n"
+		"	for (uint k = 0; k < salt_length; ++k)\n"
+		"		salt[k] = salt_data[k];\n"
+		"\n"
+		"	md5c_ctx c;\n"
+		"	md5c_init(&c);\n"
+		"	md5c_add(&c, key, length);\n"
+		"	md5c_add(&c, salt, salt_length);\n"
+		"	md5c_add(&c, key, length);\n"
+		"	md5c_finish(&c, alt);\n"
+		"\n"
+		"	const uchar prefix[3] = { '$', '1', '$' };\n"
+		"	md5c_init(&c);\n"
+		"	md5c_add(&c, key, length);\n"
+		"	md5c_add(&c, prefix, 3);\n"
+		"	md5c_add(&c, salt, salt_length);\n"
+		"	for (uint n = length; n; n -= (n > 16) ? 16 : n)\n"
+		"		md5c_add(&c, alt, (n > 16) ? 16 : n);\n"
+		"\n"
+		"	const uchar zero = 0;\n"
+		"	for (uint n = length; n; n >>= 1)\n"
+		"		md5c_add(&c, (n & 1) ? &zero : key, 1);\n"
+		"	md5c_finish(&c, alt);\n"
+		"\n"
+		"	for (uint i = 0; i < rounds; ++i) {\n"
+		"		md5c_init(&c);\n"
+		"		if (i & 1) md5c_add(&c, key, length);\n"
+		"		else md5c_add(&c, alt, 16);\n"
+		"		if (i % 3) md5c_add(&c, salt, salt_length);\n"
+		"		if (i % 7) md5c_add(&c, key, length);\n"
+		"		if (i & 1) md5c_add(&c, alt, 16);\n"
+		"		else md5c_add(&c, key, length);\n"
+		"		md5c_finish(&c, alt);\n"
+		"	}\n"
+		"\n"
+		"	crypt_check(hits, alt, 16, id, digests, targets, capacity);\n"
+		"}\n"
+		"\n"
+		"__kernel void smash_sha512crypt(__global volatile uint* hits, __global const uchar* data, __global const uint* words, uint count,\n"
+		"	__global const uchar* salt_data, uint salt_length, uint rounds, __global const uchar* digests, uint targets, uint capacity) {\n"
+		"	const uint id = get_global_id(0);\n"
+		"	if (id >= count)\n"
+		"		return;\n"
+		"\n"
+		"	uchar key[MAX_KEY_LEN], salt[CRYPT_MAX_SALT], alt[64], p[MAX_KEY_LEN], s[CRYPT_MAX_SALT];\n"
+		"	const uint length = load_word((char*)key, data, words[id]);\n"
+		"	for (uint k = 0; k < salt_length; ++k)\n"
+		"		salt[k] = salt_data[k];\n"
+		"\n"
+		"	sha512c_ctx c;\n"
+		"	sha512c_init(&c);\n"
+		"	sha512c_add(&c, key, length);\n"
+		"	sha512c_add(&c, salt, salt_length);\n"
+		"	sha512c_add(&c, key, length);\n"
+		"	sha512c_finish(&c, alt);\n"
+		"\n"
+		"	sha512c_init(&c);\n"
+		"	sha512c_add(&c, key, length);\n"
+		"	sha512c_add(&c, salt, salt_length);\n"
+		"	sha512c_add(&c, alt, length); // keys are shorter than a digest\n"
+		"	for (uint n = length; n; n >>= 1) {\n"
+		"		if (n & 1) sha512c_add(&c, alt, 64);\n"
+		"		else sha512c_add(&c, key, length);\n"
+		"	}\n"
+		"	sha512c_finish(&c, alt);\n"
+		"\n"
+		"	// P and S sequences, as long as key and salt\n"
+		"	uchar d[64];\n"
+		"	sha512c_init(&c);\n"
+		"	for (uint n = 0; n < length; ++n)\n"
+		"		sha512c_add(&c, key, length);\n"
+		"	sha512c_finish(&c, d);\n"
+		"	for (uint n = 0; n < length; ++n)\n"
+		"		p[n] = d[n];\n"
+		"\n"
+		"	sha512c_init(&c);\n"
+		"	for (uint n = 0; n < 16u + alt[0]; ++n)\n"
+		"		sha512c_add(&c, salt, salt_length);\n"
+		"	sha512c_finish(&c, d);\n"
+		"	for (uint n = 0; n < salt_length; ++n)\n"
+		"		s[n] = d[n];\n"
+		"\n"
+		"	for (uint i = 0; i < rounds; ++i) {\n"
+		"		sha512c_init(&c);\n"
+		"		if (i & 1) sha512c_add(&c, p, length);\n"
+		"		else sha512c_add(&c, alt, 64);\n"
+		"		if (i % 3) sha512c_add(&c, s, salt_length);\n"
+		"		if (i % 7) sha512c_add(&c, p, length);\n"
+		"		if (i & 1) sha512c_add(&c, alt, 64);\n"
+		"		else sha512c_add(&c, p, length);\n"
+		"		sha512c_finish(&c, alt);\n"
+		"	}\n"
+		"\n"
+		"	crypt_check(hits, alt, 64, id, digests, targets, capacity);\n"
+		"}\n"
+	},
+	{ "hash.cl",
+		"/*Definitions shared by every hash file and smash.cl, built first.\n"
+		"KEY_SIZE, MAX_KEY_LEN and KEYS_PER_ITEM come from the host\n"
+		"as -D options (smasher::build_options()), so types.h is the only\n"
+		"place they are set.*/\n"
+		"\n"
+		"#pragma OPENCL EXTENSION cl_khr_byte_addressable_store : enable\n"
+		"\n"
+		"// byte swap, for the big-endian hashes\n"
+		"#define swap_bytes(x) ((rotate((uint)(x), 8u) & 0x00ff00ffu) | (rotate((uint)(x), 24u) & 0xff00ff00u))\n"
+		"\n"
+		"/*Counter keys are hashed as uintv, VECTOR_WIDTH lanes of one key\n"
+		"each. The host builds a vector program with -D VECTOR_WIDTH=n on\n"
+		"devices that prefer uintn (CPU runtimes mostly), where explicit vectors\n"
+		"beat the implicit vectorizer; everywhere else a uintv is a uint.*/\n"
+		"#ifndef VECTOR_WIDTH\n"
+		"#define VECTOR_WIDTH 1\n"
+		"#endif\n"
+		"\n"
+		"#if VECTOR_WIDTH > 1\n"
+		"#define VECTOR_(name, n) name##n\n"
+		"#define VECTOR__(name, n) VECTOR_(name, n)\n"
+		"#define VECTOR(name) VECTOR__(name, VECTOR_WIDTH)\n"
+		"typedef VECTOR(uint) uintv;\n"
+		"typedef VECTOR(int) intv; // comparisons of uintv, -1 in matching lanes\n"
+		"#define any_lane(m) any(m)\n"
+		"#define store_lanes(v, p) VECTOR(vstore)((v), 0, (p))\n"
+		"#define load_lanes(p) VECTOR(vload)(0, (p))\n"
+		"#else\n"
+		"typedef uint uintv;\n"
+		"typedef int intv;\n"
+		"#define any_lane(m) (m)\n"
+		"#define store_lanes(v, p) (*(p) = (v))\n"
+		"#define load_lanes(p) (*(p))\n"
+		"#endif\n"
+		"\n"
+		"// swap_bytes() for uintv, rotate() takes no scalar count with vectors\n"
+		"#define swap_bytesv(x) ((rotate((x), (uintv)8) & 0x00ff00ffu) | (rotate((x), (uintv)24) & 0xff00ff00u))\n"
+		"\n"
+		"/*Packs a message of at most MAX_KEY_LEN bytes into one block of\n"
+		"little-endian words: the message, 0x80, then zeros. The caller adds\n"
+		"the bit length where its hash expects it.*/\n"
+		"inline void pack_block(uint* m, const char* msg, const uint len) {\n"
+		"	for (uint w = 0; w < 16; ++w)\n"
+		"		m[w] = 0;\n"
+		"\n"
+		"	for (uint k = 0; k < len; ++k)\n"
+		"		m[k >> 2] |= (uint)(uchar)msg[k] << ((k & 3) * 8);\n"
+		"	m[len >> 2] |= 0x80u << ((len & 3) * 8);\n"
+		"}\n"
+	},
+	{ "md4.cl",
+		"/*MD4, single block. With -D UTF16 smash.cl widens keys first, which\n"
+		"makes it NTLM.*/\n"
+		"\n"
+		"#define DIGEST_WORDS 4\n"
+		"\n"
+		"#define MD4_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))\n"
+		"#define MD4_G(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))\n"
+		"#define MD4_H(x, y, z) ((x) ^ (y) ^ (z))\n"
+		"\n"
+		"#define MD4_STEP(f, a, b, c, d, x, s) \\\n"
+		"	(a) += f((b), (c), (d)) + (x); \\\n"
+		"	(a) = rotate((a), (uintv)(s));\n"
+		"\n"
+		"/*'m' is the message packed like pack_block() does, the bit length is\n"
+		"added here. Hashes VECTOR_WIDTH messages at once.*/\n"
+		"inline void hash_words(uintv* m, const uint len, uintv* out) {\n"
+		"	m[14] = len * 8;\n"
+		"\n"
+		"	uintv a = 0x67452301, b = 0xefcdab89, c = 0x98badcfe, d = 0x10325476;\n"
+		"\n"
+		"	/* Round 1 */\n"
+		"	for (uint k = 0; k < 16; k += 4) {\n"
+		"		MD4_STEP(MD4_F, a, b, c, d, m[k], 3)\n"
+		"		MD4_STEP(MD4_F, d, a, b, c, m[k + 1], 7)\n"
+		"		MD4_STEP(MD4_F, c, d, a, b, m[k + 2], 11)\n"
+		"		MD4_STEP(MD4_F, b, c, d, a, m[k + 3], 19)\n"
+		"	}\n"
+		"\n"
+		"	/* Round 2 */\n"
+		"	for (uint k = 0; k < 4; ++k) {\n"
+		"		MD4_STEP(MD4_G, a, b, c, d, m[k] + 0x5a827999, 3)\n"
+		"		MD4_STEP(MD4_G, d, a, b, c, m[k + 4] + 0x5a827999, 5)\n"
+		"		MD4_STEP(MD4_G, c, d, a, b, m[k + 8] + 0x5a827999, 9)\n"
+		"		MD4_STEP(MD4_G, b, c, d, a, m[k + 12] + 0x5a827999, 13)\n"
+		"	}\n"
+		"\n"
+		"	/* Round 3, words in bit-reversed order */\n"
+		"	const uint order[4] = { 0, 2, 1, 3 };\n"
+		"	for (uint k = 0; k < 4; ++k) {\n"
+		"		const uint o = order[k];\n"
+		"		MD4_STEP(MD4_H, a, b, c, d, m[o] + 0x6ed9eba1, 3)\n"
+		"		MD4_STEP(MD4_H, d, a, b, c, m[o + 8] + 0x6ed9eba1, 9)\n"
+		"		MD4_STEP(MD4_H, c, d, a, b, m[o + 4] + 0x6ed9eba1, 11)\n"
+		"		MD4_STEP(MD4_H, b, c, d, a, m[o + 12] + 0x6ed9eba1, 15)\n"
+		"	}\n"
+		"\n"
+		"	out[0] = a + 0x67452301;\n"
+		"	out[1] = b + 0xefcdab89;\n"
+		"	out[2] = c + 0x98badcfe;\n"
+		"	out[3] = d + 0x10325476;\n"
+		"}\n"
+		"\n"
+		"#if VECTOR_WIDTH == 1\n"
+		"inline void hash(char* msg, const uint len, uint* out) {\n"
+		"	uint m[16];\n"
+		"	pack_block(m, msg, len);\n"
+		"	hash_words(m, len, out);\n"
+		"}\n"
+		"#endif\n"
+	},
+	{ "md5.cl",
+		"// MD5 function taken from: https://github.com/awreece/pdfcrack-opencl/blob/master/md5.cl\n"
+		"\n"
+		"#define DIGEST_WORDS 4\n"
+		"\n"
+		"/* The basic MD5 functions */\n"
+		"#define F(x, y, z)			((z) ^ ((x) & ((y) ^ (z))))\n"
+		"#define G(x, y, z)			((y) ^ ((z) & ((x) ^ (y))))\n"
+		"#define H(x, y, z)			((x) ^ (y) ^ (z))\n"
+		"#define I(x, y, z)			((y) ^ ((x) | ~(z)))\n"
+		"\n"
+		"/* The MD5 transformation for all four rounds. */\n"
+		"#define STEP(f, a, b, c, d, x, t, s) \\\n"
+		"    (a) += f((b), (c), (d)) + (x) + (t); \\\n"
+		"    (a) = (((a) << (s)) | (((a) & 0xffffffff) >> (32 - (s)))); \\\n"
+		"    (a) += (b);\n"
+		"\n"
+		"#define GET(i) (key[(i)])\n"
+		"\n"
+		"static void md5_round(uintv* internal_state, const uintv* key) {\n"
+		"  uintv a, b, c, d;\n"
+		"  a = internal_state[0];\n"
+		"  b = internal_state[1];\n"
+		"  c = internal_state[2];\n"
+		"  d = internal_state[3];\n"
+		"\n"
+		"  /* Round 1 */\n"
+		"  STEP(F, a, b, c, d, GET(0), 0xd76aa478, 7)\n"
+		"  STEP(F, d, a, b, c, GET(1), 0xe8c7b756, 12)\n"
+		"  STEP(F, c, d, a, b, GET(2), 0x242070db, 17)\n"
+		"  STEP(F, b, c, d, a, GET(3), 0xc1bdceee, 22)\n"
+		"  STEP(F, a, b, c, d, GET(4), 0xf57c0faf, 7)\n"
+		"  STEP(F, d, a, b, c, GET(5), 0x4787c62a, 12)\n"
+		"  STEP(F, c, d, a, b, GET(6), 0xa8304613, 17)\n"
+		"  STEP(F, b, c, d, a, GET(7), 0xfd469501, 22)\n"
+		"  STEP(F, a, b, c, d, GET(8), 0x698098d8, 7)\n"
+		"  STEP(F, d, a, b, c, GET(9), 0x8b44f7af, 12)\n"
+		"  STEP(F, c, d, a, b, GET(10), 0xffff5bb1, 17)\n"
+		"  STEP(F, b, c, d, a, GET(11), 0x895cd7be, 22)\n"
+		"  STEP(F, a, b, c, d, GET(12), 0x6b901122, 7)\n"
+		"  STEP(F, d, a, b, c, GET(13), 0xfd987193, 12)\n"
+		"  STEP(F, c, d, a, b, GET(14), 0xa679438e, 17)\n"
+		"  STEP(F, b, c, d, a, GET(15), 0x49b40821, 22)\n"
+		"\n"
+		"  /* Round 2 */\n"
+		"  STEP(G, a, b, c, d, GET(1), 0xf61e2562, 5)\n"
+		"  STEP(G, d, a, b, c, GET(6), 0xc040b340, 9)\n"
+		"  STEP(G, c, d, a, b, GET(11), 0x265e5a51, 14)\n"
+		"  STEP(G, b, c, d, a, GET(0), 0xe9b6c7aa, 20)\n"
+		"  STEP(G, a, b, c, d, GET(5), 0xd62f105d, 5)\n"
+		"  STEP(G, d, a, b, c, GET(10), 0x02441453, 9)\n"
+		"  STEP(G, c, d, a, b, GET(15), 0xd8a1e681, 14)\n"
+		"  STEP(G, b, c, d, a, GET(4), 0xe7d3fbc8, 20)\n"
+		"  STEP(G, a, b, c, d, GET(9), 0x21e1cde6, 5)\n"
+		"  STEP(G, d, a, b, c, GET(14), 0xc33707d6, 9)\n"
+		"  STEP(G, c, d, a, b, GET(3), 0xf4d50d87, 14)\n"
+		"  STEP(G, b, c, d, a, GET(8), 0x455a14ed, 20)\n"
+		"  STEP(G, a, b, c, d, GET(13), 0xa9e3e905, 5)\n"
+		"  STEP(G, d, a, b, c, GET(2), 0xfcefa3f8, 9)\n"
+		"  STEP(G, c, d, a, b, GET(7), 0x676f02d9, 14)\n"
+		"  STEP(G, b, c, d, a, GET(12), 0x8d2a4c8a, 20)\n"
+		"\n"
+		"  /* Round 3 */\n"
+		"  STEP(H, a, b, c, d, GET(5), 0xfffa3942, 4)\n"
+		"  STEP(H, d, a, b, c, GET(8), 0x8771f681, 11)\n"
+		"  STEP(H, c, d, a, b, GET(11), 0x6d9d6122, 16)\n"
+		"  STEP(H, b, c, d, a, GET(14), 0xfde5380c, 23)\n"
+		"  STEP(H, a, b, c, d, GET(1), 0xa4beea44, 4)\n"
+		"  STEP(H, d, a, b, c, GET(4), 0x4bdecfa9, 11)\n"
+		"  STEP(H, c, d, a, b, GET(7), 0xf6bb4b60, 16)\n"
+		"  STEP(H, b, c, d, a, GET(10), 0xbebfbc70, 23)\n"
+		"  STEP(H, a, b, c, d, GET(13), 0x289b7ec6, 4)\n"
+		"  STEP(H, d, a, b, c, GET(0), 0xeaa127fa, 11)\n"
+		"  STEP(H, c, d, a, b, GET(3), 0xd4ef3085, 16)\n"
+		"  STEP(H, b, c, d, a, GET(6), 0x04881d05, 23)\n"
+		"  STEP(H, a, b, c, d, GET(9), 0xd9d4d039, 4)\n"
+		"  STEP(H, d, a, b, c, GET(12), 0xe6db99e5, 11)\n"
+		"  STEP(H, c, d, a, b, GET(15), 0x1fa27cf8, 16)\n"
+		"  STEP(H, b, c, d, a, GET(2), 0xc4ac5665, 23)\n"
+		"\n"
+		"  /* Round 4 */\n"
+		"  STEP(I, a, b, c, d, GET(0), 0xf4292244, 6)\n"
+		"  STEP(I, d, a, b, c, GET(7), 0x432aff97, 10)\n"
+		"  STEP(I, c, d, a, b, GET(14), 0xab9423a7, 15)\n"
+		"  STEP(I, b, c, d, a, GET(5), 0xfc93a039, 21)\n"
+		"  STEP(I, a, b, c, d, GET(12), 0x655b59c3, 6)\n"
+		"  STEP(I, d, a, b, c, GET(3), 0x8f0ccc92, 10)\n"
+		"  STEP(I, c, d, a, b, GET(10), 0xffeff47d, 15)\n"
+		"  STEP(I, b, c, d, a, GET(1), 0x85845dd1, 21)\n"
+		"  STEP(I, a, b, c, d, GET(8), 0x6fa87e4f, 6)\n"
+		"  STEP(I, d, a, b, c, GET(15), 0xfe2ce6e0, 10)\n"
+		"  STEP(I, c, d, a, b, GET(6), 0xa3014314, 15)\n"
+		"  STEP(I, b, c, d, a, GET(13), 0x4e0811a1, 21)\n"
+		"  STEP(I, a, b, c, d, GET(4), 0xf7537e82, 6)\n"
+		"  STEP(I, d, a, b, c, GET(11), 0xbd3af235, 10)\n"
+		"  STEP(I, c, d, a, b, GET(2), 0x2ad7d2bb, 15)\n"
+		"  STEP(I, b, c, d, a, GET(9), 0xeb86d391, 21)\n"
+		"\n"
+		"  internal_state[0] = a + internal_state[0];\n"
+		"  internal_state[1] = b + internal_state[1];\n"
+		"  internal_state[2] = c + internal_state[2];\n"
+		"  internal_state[3] = d + internal_state[3];\n"
+		"}\n"
+		"\n"
+		"/*'m' is the message packed like pack_block() does, the bit length is\n"
+		"added here. Hashes VECTOR_WIDTH messages at once.*/\n"
+		"inline void hash_words(uintv* m, const uint len, uintv* out) {\n"
+		"  out[0] = 0x67452301;\n"
+		"  out[1] = 0xefcdab89;\n"
+		"  out[2] = 0x98badcfe;\n"
+		"  out[3] = 0x10325476;\n"
+		"\n"
+		"  m[14] = len * 8;\n"
+		"  md5_round(out, m);\n"
+		"}\n"
+		"\n"
+		"#if VECTOR_WIDTH == 1\n"
+		"void md5(char* msg, const uint len, uint* out) {\n"
+		"  uint i;\n"
+		"  uint bytes_left;\n"
+		"  char key[64];\n"
+		"\n"
+		"  out[0] = 0x67452301;\n"
+		"  out[1] = 0xefcdab89;\n"
+		"  out[2] = 0x98badcfe;\n"
+		"  out[3] = 0x10325476;\n"
+		"\n"
+		"  for (bytes_left = len;  bytes_left >= 64;\n"
+		"       bytes_left -= 64, msg = &msg[64]) {\n"
+		"    md5_round(out, (const uint*) msg);\n"
+		"  }\n"
+		"\n"
+		"  for (i = 0; i < bytes_left; i++) {\n"
+		"    key[i] = msg[i];\n"
+		"  }\n"
+		"  key[bytes_left++] = 0x80;\n"
+		"\n"
+		"  if (bytes_left <= 56) {\n"
+		"    for (i = bytes_left; i < 56; key[i++] = 0);\n"
+		"  } else {\n"
+		"    // If we have to pad enough to roll past this round.\n"
+		"    for (i = bytes_left; i < 64; key[i++] = 0);\n"
+		"    md5_round(out, (const uint*)key);\n"
+		"    for (i = 0; i < 56; key[i++] = 0);\n"
+		"  }\n"
+		"\n"
+		"  ulong* len_ptr = (ulong*) &key[56];\n"
+		"  *len_ptr = len * 8;\n"
+		"  md5_round(out, (const uint*) key);\n"
+		"}\n"
+		"\n"
+		"inline void hash(char* msg, const uint len, uint* out) {\n"
+		"  md5(msg, len, out);\n"
+		"}\n"
+		"#endif\n"
+		"\n"
+		"/*Single-target fast path for the counter keyspace. Its keys are 16\n"
+		"bytes with the high half zero, so only words 2 and 3 of the padded\n"
+		"block vary; the others are folded into the step constants below.\n"
+		"'target' is the digest with steps 62 and 63 undone on the host\n"
+		"(hash_algo::reverse): (a60, b59, c58 + m[2], d61). Step 58 yields c, so\n"
+		"nearly every key is rejected there, and a survivor is a match exactly\n"
+		"when steps 59 to 61 land on the rest; steps 62 and 63 and the final\n"
+		"additions are never computed. Word 2 is the same in every lane, word 3\n"
+		"differs; the result is non-zero in the lanes that match.*/\n"
+		"#define COUNTER_SINGLE\n"
+		"\n"
+		"#define STEP0(f, a, b, c, d, t, s) \\\n"
+		"    (a) += f((b), (c), (d)) + (t); \\\n"
+		"    (a) = rotate((a), (uintv)(s)); \\\n"
+		"    (a) += (b);\n"
+		"\n"
+		"inline intv hash_counter(const uint x2, const uintv x3, const uint4 target) {\n"
+		"  uintv a = 0x67452301, b = 0xefcdab89, c = 0x98badcfe, d = 0x10325476;\n"
+		"\n"
+		"  /* Round 1 */\n"
+		"  STEP0(F, a, b, c, d, 0xd76aa478, 7)\n"
+		"  STEP0(F, d, a, b, c, 0xe8c7b756, 12)\n"
+		"  STEP(F, c, d, a, b, x2, 0x242070db, 17)\n"
+		"  STEP(F, b, c, d, a, x3, 0xc1bdceee, 22)\n"
+		"  STEP0(F, a, b, c, d, 0xf57c102f, 7) // + 0x80 pad\n"
+		"  STEP0(F, d, a, b, c, 0x4787c62a, 12)\n"
+		"  STEP0(F, c, d, a, b, 0xa8304613, 17)\n"
+		"  STEP0(F, b, c, d, a, 0xfd469501, 22)\n"
+		"  STEP0(F, a, b, c, d, 0x698098d8, 7)\n"
+		"  STEP0(F, d, a, b, c, 0x8b44f7af, 12)\n"
+		"  STEP0(F, c, d, a, b, 0xffff5bb1, 17)\n"
+		"  STEP0(F, b, c, d, a, 0x895cd7be, 22)\n"
+		"  STEP0(F, a, b, c, d, 0x6b901122, 7)\n"
+		"  STEP0(F, d, a, b, c, 0xfd987193, 12)\n"
+		"  STEP0(F, c, d, a, b, 0xa679440e, 17) // + 128 bit length\n"
+		"  STEP0(F, b, c, d, a, 0x49b40821, 22)\n"
+		"\n"
+		"  /* Round 2 */\n"
+		"  STEP0(G, a, b, c, d, 0xf61e2562, 5)\n"
+		"  STEP0(G, d, a, b, c, 0xc040b340, 9)\n"
+		"  STEP0(G, c, d, a, b, 0x265e5a51, 14)\n"
+		"  STEP0(G, b, c, d, a, 0xe9b6c7aa, 20)\n"
+		"  STEP0(G, a, b, c, d, 0xd62f105d, 5)\n"
+		"  STEP0(G, d, a, b, c, 0x02441453, 9)\n"
+		"  STEP0(G, c, d, a, b, 0xd8a1e681, 14)\n"
+		"  STEP0(G, b, c, d, a, 0xe7d3fc48, 20) // + 0x80 pad\n"
+		"  STEP0(G, a, b, c, d, 0x21e1cde6, 5)\n"
+		"  STEP0(G, d, a, b, c, 0xc3370856, 9) // + 128 bit length\n"
+		"  STEP(G, c, d, a, b, x3, 0xf4d50d87, 14)\n"
+		"  STEP0(G, b, c, d, a, 0x455a14ed, 20)\n"
+		"  STEP0(G, a, b, c, d, 0xa9e3e905, 5)\n"
+		"  STEP(G, d, a, b, c, x2, 0xfcefa3f8, 9)\n"
+		"  STEP0(G, c, d, a, b, 0x676f02d9, 14)\n"
+		"  STEP0(G, b, c, d, a, 0x8d2a4c8a, 20)\n"
+		"\n"
+		"  /* Round 3 */\n"
+		"  STEP0(H, a, b, c, d, 0xfffa3942, 4)\n"
+		"  STEP0(H, d, a, b, c, 0x8771f681, 11)\n"
+		"  STEP0(H, c, d, a, b, 0x6d9d6122, 16)\n"
+		"  STEP0(H, b, c, d, a, 0xfde5388c, 23) // + 128 bit length\n"
+		"  STEP0(H, a, b, c, d, 0xa4beea44, 4)\n"
+		"  STEP0(H, d, a, b, c, 0x4bded029, 11) // + 0x80 pad\n"
+		"  STEP0(H, c, d, a, b, 0xf6bb4b60, 16)\n"
+		"  STEP0(H, b, c, d, a, 0xbebfbc70, 23)\n"
+		"  STEP0(H, a, b, c, d, 0x289b7ec6, 4)\n"
+		"  STEP0(H, d, a, b, c, 0xeaa127fa, 11)\n"
+		"  STEP(H, c, d, a, b, x3, 0xd4ef3085, 16)\n"
+		"  STEP0(H, b, c, d, a, 0x04881d05, 23)\n"
+		"  STEP0(H, a, b, c, d, 0xd9d4d039, 4)\n"
+		"  STEP0(H, d, a, b, c, 0xe6db99e5, 11)\n"
+		"  STEP0(H, c, d, a, b, 0x1fa27cf8, 16)\n"
+		"  STEP(H, b, c, d, a, x2, 0xc4ac5665, 23)\n"
+		"\n"
+		"  /* Round 4, up to step 58 */\n"
+		"  STEP0(I, a, b, c, d, 0xf4292244, 6)\n"
+		"  STEP0(I, d, a, b, c, 0x432aff97, 10)\n"
+		"  STEP0(I, c, d, a, b, 0xab942427, 15) // + 128 bit length\n"
+		"  STEP0(I, b, c, d, a, 0xfc93a039, 21)\n"
+		"  STEP0(I, a, b, c, d, 0x655b59c3, 6)\n"
+		"  STEP(I, d, a, b, c, x3, 0x8f0ccc92, 10)\n"
+		"  STEP0(I, c, d, a, b, 0xffeff47d, 15)\n"
+		"  STEP0(I, b, c, d, a, 0x85845dd1, 21)\n"
+		"  STEP0(I, a, b, c, d, 0x6fa87e4f, 6)\n"
+		"  STEP0(I, d, a, b, c, 0xfe2ce6e0, 10)\n"
+		"  STEP0(I, c, d, a, b, 0xa3014314, 15)\n"
+		"\n"
+		"  // early reject, one word in\n"
+		"  const intv early = (c + x2 == target.z);\n"
+		"  if (!any_lane(early))\n"
+		"    return 0;\n"
+		"\n"
+		"  STEP0(I, b, c, d, a, 0x4e0811a1, 21)\n"
+		"  STEP0(I, a, b, c, d, 0xf7537f02, 6) // + 0x80 pad\n"
+		"  STEP0(I, d, a, b, c, 0xbd3af235, 10)\n"
+		"\n"
+		"  return early & (a == target.x) & (b == target.y) & (d == target.w);\n"
+		"}\n"
+	},
+	{ "sha1.cl",
+		"/*SHA-1, single block. The schedule lives in a 16-word ring.*/\n"
+		"\n"
+		"#define DIGEST_WORDS 5\n"
+		"\n"
+		"#define SHA1_CH(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))\n"
+		"#define SHA1_PARITY(x, y, z) ((x) ^ (y) ^ (z))\n"
+		"#define SHA1_MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))\n"
+		"\n"
+		"/*'w' is the message packed like pack_block() does, the bit length is\n"
+		"added here. Hashes VECTOR_WIDTH messages at once.*/\n"
+		"inline void hash_words(uintv* w, const uint len, uintv* out) {\n"
+		"	for (uint k = 0; k < 14; ++k)\n"
+		"		w[k] = swap_bytesv(w[k]);\n"
+		"	w[15] = len * 8;\n"
+		"\n"
+		"	uintv a = 0x67452301, b = 0xefcdab89, c = 0x98badcfe, d = 0x10325476, e = 0xc3d2e1f0;\n"
+		"\n"
+		"	for (uint t = 0; t < 80; ++t) {\n"
+		"		if (t >= 16)\n"
+		"			w[t & 15] = rotate(w[(t + 13) & 15] ^ w[(t + 8) & 15] ^ w[(t + 2) & 15] ^ w[t & 15], (uintv)1);\n"
+		"\n"
+		"		uintv f;\n"
+		"		uint k;\n"
+		"		if (t < 20) { f = SHA1_CH(b, c, d); k = 0x5a827999; }\n"
+		"		else if (t < 40) { f = SHA1_PARITY(b, c, d); k = 0x6ed9eba1; }\n"
+		"		else if (t < 60) { f = SHA1_MAJ(b, c, d); k = 0x8f1bbcdc; }\n"
+		"		else { f = SHA1_PARITY(b, c, d); k = 0xca62c1d6; }\n"
+		"\n"
+		"		const uintv temp = rotate(a, (uintv)5) + f + e + k + w[t & 15];\n"
+		"		e = d;\n"
+		"		d = c;\n"
+		"		c = rotate(b, (uintv)30);\n"
+		"		b = a;\n"
+		"		a = temp;\n"
+		"	}\n"
+		"\n"
+		"	// digest byte order, as little-endian words like md5\n"
+		"	out[0] = swap_bytesv(a + 0x67452301);\n"
+		"	out[1] = swap_bytesv(b + 0xefcdab89);\n"
+		"	out[2] = swap_bytesv(c + 0x98badcfe);\n"
+		"	out[3] = swap_bytesv(d + 0x10325476);\n"
+		"	out[4] = swap_bytesv(e + 0xc3d2e1f0);\n"
+		"}\n"
+		"\n"
+		"#if VECTOR_WIDTH == 1\n"
+		"inline void hash(char* msg, const uint len, uint* out) {\n"
+		"	uint w[16];\n"
+		"	pack_block(w, msg, len);\n"
+		"	hash_words(w, len, out);\n"
+		"}\n"
+		"#endif\n"
+	},
+	{ "sha256.cl",
+		"/*SHA-256, single block. The schedule lives in a 16-word ring.*/\n"
+		"\n"
+		"#define DIGEST_WORDS 8\n"
+		"\n"
+		"__constant uint sha256_k[64] = {\n"
+		"	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,\n"
+		"	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,\n"
+		"	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,\n"
+		"	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,\n"
+		"	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,\n"
+		"	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,\n"
+		"	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,\n"
+		"	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2\n"
+		"};\n"
+		"\n"
+		"#define SHA256_CH(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))\n"
+		"#define SHA256_MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))\n"
+		"\n"
+		"// rotate() turns left, these are the right rotations of the spec\n"
+		"#define SHA256_S0(x) (rotate((x), (uintv)30) ^ rotate((x), (uintv)19) ^ rotate((x), (uintv)10))\n"
+		"#define SHA256_S1(x) (rotate((x), (uintv)26) ^ rotate((x), (uintv)21) ^ rotate((x), (uintv)7))\n"
+		"#define SHA256_s0(x) (rotate((x), (uintv)25) ^ rotate((x), (uintv)14) ^ ((x) >> 3))\n"
+		"#define SHA256_s1(x) (rotate((x), (uintv)15) ^ rotate((x), (uintv)13) ^ ((x) >> 10))\n"
+		"\n"
+		"/*'w' is the message packed like pack_block() does, the bit length is\n"
+		"added here. Hashes VECTOR_WIDTH messages at once.*/\n"
+		"inline void hash_words(uintv* w, const uint len, uintv* out) {\n"
+		"	const uint iv[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };\n"
+		"	uintv s[8];\n"
+		"\n"
+		"	for (uint k = 0; k < 14; ++k)\n"
+		"		w[k] = swap_bytesv(w[k]);\n"
+		"	w[15] = len * 8;\n"
+		"\n"
+		"	for (uint k = 0; k < 8; ++k)\n"
+		"		s[k] = iv[k];\n"
+		"\n"
+		"	for (uint t = 0; t < 64; ++t) {\n"
+		"		if (t >= 16)\n"
+		"			w[t & 15] += SHA256_s1(w[(t + 14) & 15]) + w[(t + 9) & 15] + SHA256_s0(w[(t + 1) & 15]);\n"
+		"\n"
+		"		const uintv t1 = s[7] + SHA256_S1(s[4]) + SHA256_CH(s[4], s[5], s[6]) + sha256_k[t] + w[t & 15];\n"
+		"		const uintv t2 = SHA256_S0(s[0]) + SHA256_MAJ(s[0], s[1], s[2]);\n"
+		"		s[7] = s[6];\n"
+		"		s[6] = s[5];\n"
+		"		s[5] = s[4];\n"
+		"		s[4] = s[3] + t1;\n"
+		"		s[3] = s[2];\n"
+		"		s[2] = s[1];\n"
+		"		s[1] = s[0];\n"
+		"		s[0] = t1 + t2;\n"
+		"	}\n"
+		"\n"
+		"	// digest byte order, as little-endian words like md5\n"
+		"	for (uint k = 0; k < 8; ++k)\n"
+		"		out[k] = swap_bytesv(s[k] + iv[k]);\n"
+		"}\n"
+		"\n"
+		"#if VECTOR_WIDTH == 1\n"
+		"inline void hash(char* msg, const uint len, uint* out) {\n"
+		"	uint w[16];\n"
+		"	pack_block(w, msg, len);\n"
+		"	hash_words(w, len, out);\n"
+		"}\n"
+		"#endif\n"
+	},
+	{ "smash.cl",
+		"/*Key generation, comparison and the search kernels. Built after hash.cl\n"
+		"and one hash file (md5.cl, md4.cl, sha1.cl, sha256.cl), which defines\n"
+		"DIGEST_WORDS, hash_words(m, len, out) and, outside vector builds,\n"
+		"hash(msg, len, out), with 'out' in digest byte order.*/\n"
+		"\n"
+		"/*128-bit index of key 'offset' of a launch that starts at key 'base'.\n"
+		"Counter keys are 16 bytes, so their indices need both halves (x low,\n"
+		"y high); the carry costs one compare per work-item.*/\n"
+		"inline ulong2 key_at(const ulong2 base, const uint offset) {\n"
+		"	ulong2 index;\n"
+		"	index.x = base.x + offset;\n"
+		"	index.y = base.y + (index.x < base.x);\n"
+		"	return index;\n"
+		"}\n"
+		"\n"
+		"/*Counter keys are built as words: the 16 key bytes are the big-endian\n"
+		"128-bit index, so little-endian word 3 holds its lowest 32 bits. A\n"
+		"work-item hashes KEYS_PER_ITEM words of VECTOR_WIDTH consecutive keys.\n"
+		"Launches start on a block and ITEM_KEYS divides BLOCK_SIZE, so no item\n"
+		"crosses a multiple of 2 ** 32 and only word 3 differs within one.*/\n"
+		"#define ITEM_KEYS (KEYS_PER_ITEM * VECTOR_WIDTH)\n"
+		"\n"
+		"__constant uint lane_offsets[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };\n"
+		"\n"
+		"// step 'k' of the item at 'index', lane l holds key k * VECTOR_WIDTH + l\n"
+		"inline void counter_key(uintv* key, const ulong2 index, const uint k) {\n"
+		"	key[0] = swap_bytes(index.y >> 32);\n"
+		"	key[1] = swap_bytes(index.y);\n"
+		"	key[2] = swap_bytes(index.x >> 32);\n"
+		"	key[3] = swap_bytesv((uint)index.x + k * VECTOR_WIDTH + load_lanes(lane_offsets));\n"
+		"}\n"
+		"\n"
+		"/*Hashes counter key words as the build selected: as is, or widened to\n"
+		"UTF-16LE with -D UTF16 (NTLM).*/\n"
+		"inline void hash_counter_key(const uintv* key, uintv* out) {\n"
+		"	uintv m[16];\n"
+		"	for (uint w = 0; w < 16; ++w)\n"
+		"		m[w] = 0;\n"
+		"\n"
+		"#ifdef UTF16\n"
+		"	for (uint w = 0; w < KEY_SIZE / 4; ++w) {\n"
+		"		m[w * 2] = (key[w] & 0xff) | ((key[w] & 0xff00) << 8);\n"
+		"		m[w * 2 + 1] = ((key[w] >> 16) & 0xff) | ((key[w] >> 8) & 0xff0000);\n"
+		"	}\n"
+		"	m[KEY_SIZE / 2] = 0x80;\n"
+		"	hash_words(m, KEY_SIZE * 2, out);\n"
+		"#else\n"
+		"	for (uint w = 0; w < KEY_SIZE / 4; ++w)\n"
+		"		m[w] = key[w];\n"
+		"	m[KEY_SIZE / 4] = 0x80;\n"
+		"	hash_words(m, KEY_SIZE, out);\n"
+		"#endif\n"
+		"}\n"
+		"\n"
+		"/*Mask keys: 'chars' holds 256 chars per position and 'radix' the\n"
+		"charset sizes. A key is the mixed-radix decoding of its index, with\n"
+		"the first position changing fastest.*/\n"
+		"void decode_mask(char* key, uchar* digit, ulong index, const uint length,\n"
+		"	__constant uchar* chars, __constant uint* radix) {\n"
+		"	for (uint p = 0; p < length; ++p) {\n"
+		"		digit[p] = index % radix[p];\n"
+		"		index /= radix[p];\n"
+		"		key[p] = chars[p * 256 + digit[p]];\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"/*decode_mask() of a 128-bit index: long division in 32-bit steps while\n"
+		"the high half is set, the plain one after that.*/\n"
+		"void decode_wide_mask(char* key, uchar* digit, ulong2 index, const uint length,\n"
+		"	__constant uchar* chars, __constant uint* radix) {\n"
+		"	uint p = 0;\n"
+		"	for (; p < length && index.y; ++p) {\n"
+		"		const ulong mid = (index.y % radix[p]) << 32 | (index.x >> 32);\n"
+		"		const ulong low = (mid % radix[p]) << 32 | (index.x & 0xffffffff);\n"
+		"		index.y /= radix[p];\n"
+		"		index.x = (mid / radix[p]) << 32 | (low / radix[p]);\n"
+		"		digit[p] = low % radix[p];\n"
+		"		key[p] = chars[p * 256 + digit[p]];\n"
+		"	}\n"
+		"\n"
+		"	decode_mask(key + p, digit + p, index.x, length - p, chars + p * 256, radix + p);\n"
+		"}\n"
+		"\n"
+		"// keys from 'index' to the end of a 128-bit 'space', capped at 'most'\n"
+		"inline uint keys_left(const ulong2 index, const ulong2 space, const uint most) {\n"
+		"	if (index.y > space.y || (index.y == space.y && index.x >= space.x))\n"
+		"		return 0;\n"
+		"	if (space.y - index.y - (space.x < index.x))\n"
+		"		return most;\n"
+		"	return (space.x - index.x < most) ? (uint)(space.x - index.x) : most;\n"
+		"}\n"
+		"\n"
+		"inline void next_mask(char* key, uchar* digit, const uint length,\n"
+		"	__constant uchar* chars, __constant uint* radix) {\n"
+		"	for (uint p = 0; p < length; ++p) {\n"
+		"		const uint d = digit[p] + 1;\n"
+		"\n"
+		"		// no carry, done\n"
+		"		if (d < radix[p]) {\n"
+		"			digit[p] = d;\n"
+		"			key[p] = chars[p * 256 + d];\n"
+		"			return;\n"
+		"		}\n"
+		"\n"
+		"		digit[p] = 0;\n"
+		"		key[p] = chars[p * 256];\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"inline bool probe(__global const uint* bitmap, const uint mask, const uint word) {\n"
+		"	return (bitmap[(word & mask) >> 5] >> (word & 31)) & 1;\n"
+		"}\n"
+		"\n"
+		"int find_target(__global const uint4* table, const uint count, const uint* h) {\n"
+		"	// lower bound on the first word, then check the full digests\n"
+		"	uint lo = 0, hi = count;\n"
+		"	while (lo < hi) {\n"
+		"		const uint mid = (lo + hi) / 2;\n"
+		"		if (table[mid].x < h[0])\n"
+		"			lo = mid + 1;\n"
+		"		else\n"
+		"			hi = mid;\n"
+		"	}\n"
+		"\n"
+		"	for (; lo < count && table[lo].x == h[0]; ++lo)\n"
+		"		if (table[lo].y == h[1] && table[lo].z == h[2] && table[lo].w == h[3])\n"
+		"			return lo;\n"
+		"\n"
+		"	return -1;\n"
+		"}\n"
+		"\n"
+		"inline void check_target(__global volatile uint* result, const uint* h, const uint4 target, const uint index) {\n"
+		"	// only a hit touches global memory, keep the lowest index\n"
+		"	if (h[0] == target.x && h[1] == target.y && h[2] == target.z && h[3] == target.w)\n"
+		"		atomic_min(result, index);\n"
+		"}\n"
+		"\n"
+		"/*'hits' holds a counter followed by (key index in launch, target index)\n"
+		"pairs; pairs past 'capacity' are counted but not stored.*/\n"
+		"inline void check_targets(__global volatile uint* hits, const uint* h, const uint index,\n"
+		"	__global const uint* bitmap_a, __global const uint* bitmap_b, const uint mask,\n"
+		"	__global const uint4* table, const uint count, const uint capacity) {\n"
+		"	// nearly every key stops at the bitmaps\n"
+		"	if (!probe(bitmap_a, mask, h[0]) || !probe(bitmap_b, mask, h[1]))\n"
+		"		return;\n"
+		"\n"
+		"	const int t = find_target(table, count, h);\n"
+		"	if (t >= 0) {\n"
+		"		const uint slot = atomic_inc(&hits[0]);\n"
+		"		if (slot < capacity) {\n"
+		"			hits[1 + slot * 2] = index;\n"
+		"			hits[2 + slot * 2] = t;\n"
+		"		}\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"// keeps the lowest of the keys set in 'hit', key 'first' in lane 0\n"
+		"inline void report_lanes(__global volatile uint* result, const intv hit, const uint first) {\n"
+		"	if (!any_lane(hit))\n"
+		"		return;\n"
+		"\n"
+		"	int lanes[VECTOR_WIDTH];\n"
+		"	store_lanes(hit, lanes);\n"
+		"	for (uint l = 0; l < VECTOR_WIDTH; ++l)\n"
+		"		if (lanes[l]) {\n"
+		"			atomic_min(result, first + l);\n"
+		"			return;\n"
+		"		}\n"
+		"}\n"
+		"\n"
+		"// check_target() for a uintv of keys, 'first' in lane 0\n"
+		"inline void check_target_lanes(__global volatile uint* result, const uintv* h, const uint4 target, const uint first) {\n"
+		"	report_lanes(result, (h[0] == target.x) & (h[1] == target.y) & (h[2] == target.z) & (h[3] == target.w), first);\n"
+		"}\n"
+		"\n"
+		"// check_targets() for a uintv of keys, 'first' in lane 0\n"
+		"inline void check_targets_lanes(__global volatile uint* hits, const uintv* h, const uint first,\n"
+		"	__global const uint* bitmap_a, __global const uint* bitmap_b, const uint mask,\n"
+		"	__global const uint4* table, const uint count, const uint capacity) {\n"
+		"	uint lanes[DIGEST_WORDS][VECTOR_WIDTH];\n"
+		"	for (uint w = 0; w < DIGEST_WORDS; ++w)\n"
+		"		store_lanes(h[w], lanes[w]);\n"
+		"\n"
+		"	for (uint l = 0; l < VECTOR_WIDTH; ++l) {\n"
+		"		uint out[DIGEST_WORDS];\n"
+		"		for (uint w = 0; w < DIGEST_WORDS; ++w)\n"
+		"			out[w] = lanes[w][l];\n"
+		"		check_targets(hits, out, first + l, bitmap_a, bitmap_b, mask, table, count, capacity);\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"#ifdef COUNTER_SINGLE\n"
+		"/*The hash file has a fast path for counter keys, and the host hands\n"
+		"over 'target' in the form it expects. The fast path takes the first 8\n"
+		"key bytes as zero; keys from 2 ** 64 on are hashed in full and compared\n"
+		"to the plain 'digest'.*/\n"
+		"__kernel void smash(__global volatile uint* result, ulong2 base, uint4 target, uint4 digest) {\n"
+		"	const uint first = get_global_id(0) * ITEM_KEYS; // my sub-range of the launch\n"
+		"	const ulong2 index = key_at(base, first);\n"
+		"	uintv key[KEY_SIZE / 4], out[DIGEST_WORDS];\n"
+		"\n"
+		"	// the same branch for the whole launch, except one crossing 2 ** 64\n"
+		"	if (!index.y) {\n"
+		"		const uint x2 = swap_bytes(index.x >> 32);\n"
+		"		for (uint k = 0; k < KEYS_PER_ITEM; ++k) {\n"
+		"			counter_key(key, index, k);\n"
+		"			report_lanes(result, hash_counter(x2, key[3], target), first + k * VECTOR_WIDTH);\n"
+		"		}\n"
+		"		return;\n"
+		"	}\n"
+		"\n"
+		"	for (uint k = 0; k < KEYS_PER_ITEM; ++k) {\n"
+		"		counter_key(key, index, k);\n"
+		"		hash_counter_key(key, out);\n"
+		"		check_target_lanes(result, out, digest, first + k * VECTOR_WIDTH);\n"
+		"	}\n"
+		"}\n"
+		"#else\n"
+		"__kernel void smash(__global volatile uint* result, ulong2 base, uint4 target) {\n"
+		"	uintv key[KEY_SIZE / 4], out[DIGEST_WORDS];\n"
+		"	const uint first = get_global_id(0) * ITEM_KEYS; // my sub-range of the launch\n"
+		"\n"
+		"	// key = base + first, built directly\n"
+		"	// instead of counting up to it from zero\n"
+		"	const ulong2 index = key_at(base, first);\n"
+		"\n"
+		"	for (uint k = 0; k < KEYS_PER_ITEM; ++k) {\n"
+		"		counter_key(key, index, k);\n"
+		"		hash_counter_key(key, out); // compute the hashes\n"
+		"		check_target_lanes(result, out, target, first + k * VECTOR_WIDTH);\n"
+		"	}\n"
+		"}\n"
+		"#endif\n"
+		"\n"
+		"/*Checks every key against a whole target set.*/\n"
+		"__kernel void smash_multi(__global volatile uint* hits, ulong2 base,\n"
+		"	__global const uint* bitmap_a, __global const uint* bitmap_b, uint mask,\n"
+		"	__global const uint4* table, uint count, uint capacity) {\n"
+		"	uintv key[KEY_SIZE / 4], out[DIGEST_WORDS];\n"
+		"	const uint first = get_global_id(0) * ITEM_KEYS; // my sub-range of the launch\n"
+		"	const ulong2 index = key_at(base, first);\n"
+		"\n"
+		"	for (uint k = 0; k < KEYS_PER_ITEM; ++k) {\n"
+		"		counter_key(key, index, k);\n"
+		"		hash_counter_key(key, out); // compute the hashes\n"
+		"		check_targets_lanes(hits, out, first + k * VECTOR_WIDTH, bitmap_a, bitmap_b, mask, table, count, capacity);\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"/*Everything below hashes byte keys one at a time and is left out of\n"
+		"vector builds, which only run the counter kernels above.*/\n"
+		"#if VECTOR_WIDTH == 1\n"
+		"/*Hashes a key as the build selected it: as is, or widened to UTF-16LE\n"
+		"with -D UTF16 (NTLM). Returns false if the message does not fit.*/\n"
+		"inline bool hash_key(char* key, const uint length, uint* out) {\n"
+		"#ifdef UTF16\n"
+		"	char wide[MAX_KEY_LEN];\n"
+		"	if (length * 2 > MAX_KEY_LEN)\n"
+		"		return false;\n"
+		"\n"
+		"	for (uint p = 0; p < length; ++p) {\n"
+		"		wide[p * 2] = key[p];\n"
+		"		wide[p * 2 + 1] = 0;\n"
+		"	}\n"
+		"	hash(wide, length * 2, out);\n"
+		"#else\n"
+		"	hash(key, length, out);\n"
+		"#endif\n"
+		"	return true;\n"
+		"}\n"
+		"\n"
+		"\n"
+		"/*Mask mode: generates, hashes and compares 'length' byte keys of a\n"
+		"mask keyspace with 'space' keys in one pass. Indices and the space are\n"
+		"128-bit like counter ones; a launch with keys past the end of the space\n"
+		"finds nothing there.*/\n"
+		"__kernel void smash_mask(__global volatile uint* result, ulong2 base, uint4 target,\n"
+		"	__constant uchar* chars, __constant uint* radix, uint length, ulong2 space) {\n"
+		"	char key[MAX_KEY_LEN];\n"
+		"	uchar digit[MAX_KEY_LEN];\n"
+		"	uint out[DIGEST_WORDS];\n"
+		"	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch\n"
+		"\n"
+		"#ifdef MASK_LENGTH\n"
+		"	length = MASK_LENGTH; // variant built for one length, the key loops unroll\n"
+		"#endif\n"
+		"\n"
+		"	const ulong2 index = key_at(base, first);\n"
+		"	const uint keys = keys_left(index, space, KEYS_PER_ITEM);\n"
+		"	if (!keys)\n"
+		"		return;\n"
+		"\n"
+		"	decode_wide_mask(key, digit, index, length, chars, radix);\n"
+		"\n"
+		"	for (uint k = 0; k < keys; ++k) {\n"
+		"		if (hash_key(key, length, out))\n"
+		"			check_target(result, out, target, first + k);\n"
+		"		next_mask(key, digit, length, chars, radix);\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"__kernel void smash_mask_multi(__global volatile uint* hits, ulong2 base,\n"
+		"	__global const uint* bitmap_a, __global const uint* bitmap_b, uint mask,\n"
+		"	__global const uint4* table, uint count, uint capacity,\n"
+		"	__constant uchar* chars, __constant uint* radix, uint length, ulong2 space) {\n"
+		"	char key[MAX_KEY_LEN];\n"
+		"	uchar digit[MAX_KEY_LEN];\n"
+		"	uint out[DIGEST_WORDS];\n"
+		"	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch\n"
+		"\n"
+		"#ifdef MASK_LENGTH\n"
+		"	length = MASK_LENGTH; // variant built for one length, the key loops unroll\n"
+		"#endif\n"
+		"\n"
+		"	const ulong2 index = key_at(base, first);\n"
+		"	const uint keys = keys_left(index, space, KEYS_PER_ITEM);\n"
+		"	if (!keys)\n"
+		"		return;\n"
+		"\n"
+		"	decode_wide_mask(key, digit, index, length, chars, radix);\n"
+		"\n"
+		"	for (uint k = 0; k < keys; ++k) {\n"
+		"		if (hash_key(key, length, out))\n"
+		"			check_targets(hits, out, first + k, bitmap_a, bitmap_b, mask, table, count, capacity);\n"
+		"		next_mask(key, digit, length, chars, radix);\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"/*Wordlist mode: 'words' holds offset << 8 | length of each of the\n"
+		"'count' words packed into 'data'. Words are hashed straight from the\n"
+		"uploaded chunk, nothing is decoded.*/\n"
+		"inline uint load_word(char* key, __global const uchar* data, const uint word) {\n"
+		"	const uint length = word & 0xff;\n"
+		"	__global const uchar* src = data + (word >> 8);\n"
+		"\n"
+		"	for (uint p = 0; p < length; ++p)\n"
+		"		key[p] = src[p];\n"
+		"\n"
+		"	return length;\n"
+		"}\n"
+		"\n"
+		"__kernel void smash_words(__global volatile uint* result, ulong base, uint4 target,\n"
+		"	__global const uchar* data, __global const uint* words, uint count) {\n"
+		"	char key[MAX_KEY_LEN];\n"
+		"	uint out[DIGEST_WORDS];\n"
+		"	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch\n"
+		"\n"
+		"	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < count; ++k) {\n"
+		"		if (hash_key(key, load_word(key, data, words[base + first + k]), out))\n"
+		"			check_target(result, out, target, first + k);\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"__kernel void smash_words_multi(__global volatile uint* hits, ulong base,\n"
+		"	__global const uint* bitmap_a, __global const uint* bitmap_b, uint mask,\n"
+		"	__global const uint4* table, uint count, uint capacity,\n"
+		"	__global const uchar* data, __global const uint* words, uint words_count) {\n"
+		"	char key[MAX_KEY_LEN];\n"
+		"	uint out[DIGEST_WORDS];\n"
+		"	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch\n"
+		"\n"
+		"	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < words_count; ++k) {\n"
+		"		if (hash_key(key, load_word(key, data, words[base + first + k]), out))\n"
+		"			check_targets(hits, out, first + k, bitmap_a, bitmap_b, mask, table, count, capacity);\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"/*Hybrid mode: every word gets each of the 'space' keys of 'length' of a\n"
+		"mask appended, or prepended with 'prefix'. candidate = word * space +\n"
+		"mask index, so neighbours share a word and only step the mask part.\n"
+		"Returns the key's length, 0 if the word is too long for it.*/\n"
+		"inline uint load_hybrid(char* key, uchar* digit, __global const uchar* data, const uint word, const ulong index,\n"
+		"	const uint length, __constant uchar* chars, __constant uint* radix, const uint prefix) {\n"
+		"	const uint size = word & 0xff;\n"
+		"	if (size + length > MAX_KEY_LEN)\n"
+		"		return 0;\n"
+		"\n"
+		"	load_word(key + (prefix ? length : 0), data, word);\n"
+		"	decode_mask(key + (prefix ? 0 : size), digit, index, length, chars, radix);\n"
+		"	return size + length;\n"
+		"}\n"
+		"\n"
+		"__kernel void smash_hybrid(__global volatile uint* result, ulong base, uint4 target,\n"
+		"	__global const uchar* data, __global const uint* words, uint count,\n"
+		"	__constant uchar* chars, __constant uint* radix, uint length, ulong space, uint prefix) {\n"
+		"	char key[MAX_KEY_LEN];\n"
+		"	uchar digit[MAX_KEY_LEN];\n"
+		"	uint out[DIGEST_WORDS];\n"
+		"	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch\n"
+		"	const ulong candidates = (ulong)count * space;\n"
+		"\n"
+		"	if (base + first >= candidates)\n"
+		"		return;\n"
+		"\n"
+		"	uint word = (uint)((base + first) / space);\n"
+		"	ulong index = (base + first) % space;\n"
+		"	uint size = load_hybrid(key, digit, data, words[word], index, length, chars, radix, prefix);\n"
+		"\n"
+		"	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < candidates; ++k) {\n"
+		"		// past the word's last mask key, on to the next word\n"
+		"		if (index == space) {\n"
+		"			index = 0;\n"
+		"			size = load_hybrid(key, digit, data, words[++word], 0, length, chars, radix, prefix);\n"
+		"		}\n"
+		"\n"
+		"		if (size && hash_key(key, size, out))\n"
+		"			check_target(result, out, target, first + k);\n"
+		"		if (size)\n"
+		"			next_mask(key + (prefix ? 0 : size - length), digit, length, chars, radix);\n"
+		"		++index;\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"__kernel void smash_hybrid_multi(__global volatile uint* hits, ulong base,\n"
+		"	__global const uint* bitmap_a, __global const uint* bitmap_b, uint mask,\n"
+		"	__global const uint4* table, uint count, uint capacity,\n"
+		"	__global const uchar* data, __global const uint* words, uint words_count,\n"
+		"	__constant uchar* chars, __constant uint* radix, uint length, ulong space, uint prefix) {\n"
+		"	char key[MAX_KEY_LEN];\n"
+		"	uchar digit[MAX_KEY_LEN];\n"
+		"	uint out[DIGEST_WORDS];\n"
+		"	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch\n"
+		"	const ulong candidates = (ulong)words_count * space;\n"
+		"\n"
+		"	if (base + first >= candidates)\n"
+		"		return;\n"
+		"\n"
+		"	uint word = (uint)((base + first) / space);\n"
+		"	ulong index = (base + first) % space;\n"
+		"	uint size = load_hybrid(key, digit, data, words[word], index, length, chars, radix, prefix);\n"
+		"\n"
+		"	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < candidates; ++k) {\n"
+		"		if (index == space) {\n"
+		"			index = 0;\n"
+		"			size = load_hybrid(key, digit, data, words[++word], 0, length, chars, radix, prefix);\n"
+		"		}\n"
+		"\n"
+		"		if (size && hash_key(key, size, out))\n"
+		"			check_targets(hits, out, first + k, bitmap_a, bitmap_b, mask, table, count, capacity);\n"
+		"		if (size)\n"
+		"			next_mask(key + (prefix ? 0 : size - length), digit, length, chars, radix);\n"
+		"		++index;\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"/*Rule mode: every word of a chunk is run through every rule. Rules are\n"
+		"(op, a, b) instructions as compiled by rule_set on the host, 'rule_at'\n"
+		"holds the first instruction of each rule. Both are global memory, rule\n"
+		"files outgrow the constant buffer of most devices.*/\n"
+		"#define RULE_END 0\n"
+		"#define RULE_LOWER 1\n"
+		"#define RULE_UPPER 2\n"
+		"#define RULE_CAPITALIZE 3\n"
+		"#define RULE_INVERT 4\n"
+		"#define RULE_TOGGLE_ALL 5\n"
+		"#define RULE_TOGGLE 6\n"
+		"#define RULE_REVERSE 7\n"
+		"#define RULE_DUPLICATE 8\n"
+		"#define RULE_REFLECT 9\n"
+		"#define RULE_APPEND 10\n"
+		"#define RULE_PREPEND 11\n"
+		"#define RULE_DELETE_FIRST 12\n"
+		"#define RULE_DELETE_LAST 13\n"
+		"#define RULE_DELETE 14\n"
+		"#define RULE_TRUNCATE 15\n"
+		"#define RULE_REPLACE 16\n"
+		"#define RULE_PURGE 17\n"
+		"#define RULE_REPEAT 18\n"
+		"#define RULE_ROTATE_LEFT 19\n"
+		"#define RULE_ROTATE_RIGHT 20\n"
+		"\n"
+		"inline uchar flip_case(const uchar c) {\n"
+		"	return (c >= 'a' && c <= 'z') ? c - 32 : ((c >= 'A' && c <= 'Z') ? c + 32 : c);\n"
+		"}\n"
+		"\n"
+		"inline uchar to_lower(const uchar c) { return (c >= 'A' && c <= 'Z') ? c + 32 : c; }\n"
+		"inline uchar to_upper(const uchar c) { return (c >= 'a' && c <= 'z') ? c - 32 : c; }\n"
+		"\n"
+		"// returns the new length, 0 if the rule rejects the word\n"
+		"uint apply_rule(uchar* key, uint length, __global const uchar* ins) {\n"
+		"	for (;; ins += 3) {\n"
+		"		const uchar a = ins[1], b = ins[2];\n"
+		"		uint p, n;\n"
+		"		uchar c;\n"
+		"\n"
+		"		switch (ins[0]) {\n"
+		"		case RULE_END:\n"
+		"			return length;\n"
+		"		case RULE_LOWER:\n"
+		"			for (p = 0; p < length; ++p) key[p] = to_lower(key[p]);\n"
+		"			break;\n"
+		"		case RULE_UPPER:\n"
+		"			for (p = 0; p < length; ++p) key[p] = to_upper(key[p]);\n"
+		"			break;\n"
+		"		case RULE_CAPITALIZE:\n"
+		"		case RULE_INVERT:\n"
+		"			for (p = 0; p < length; ++p)\n"
+		"				key[p] = ((p == 0) == (ins[0] == RULE_CAPITALIZE)) ? to_upper(key[p]) : to_lower(key[p]);\n"
+		"			break;\n"
+		"		case RULE_TOGGLE_ALL:\n"
+		"			for (p = 0; p < length; ++p) key[p] = flip_case(key[p]);\n"
+		"			break;\n"
+		"		case RULE_TOGGLE:\n"
+		"			if (a < length) key[a] = flip_case(key[a]);\n"
+		"			break;\n"
+		"		case RULE_REVERSE:\n"
+		"			for (p = 0; p < length / 2; ++p) {\n"
+		"				c = key[p];\n"
+		"				key[p] = key[length - p - 1];\n"
+		"				key[length - p - 1] = c;\n"
+		"			}\n"
+		"			break;\n"
+		"		case RULE_DUPLICATE:\n"
+		"			if (length * 2 > MAX_KEY_LEN) return 0;\n"
+		"			for (p = 0; p < length; ++p) key[length + p] = key[p];\n"
+		"			length *= 2;\n"
+		"			break;\n"
+		"		case RULE_REFLECT:\n"
+		"			if (length * 2 > MAX_KEY_LEN) return 0;\n"
+		"			for (p = 0; p < length; ++p) key[length + p] = key[length - p - 1];\n"
+		"			length *= 2;\n"
+		"			break;\n"
+		"		case RULE_APPEND:\n"
+		"			if (length == MAX_KEY_LEN) return 0;\n"
+		"			key[length++] = a;\n"
+		"			break;\n"
+		"		case RULE_PREPEND:\n"
+		"			if (length == MAX_KEY_LEN) return 0;\n"
+		"			for (p = length; p > 0; --p) key[p] = key[p - 1];\n"
+		"			key[0] = a;\n"
+		"			++length;\n"
+		"			break;\n"
+		"		case RULE_DELETE_FIRST:\n"
+		"			if (!length) break;\n"
+		"			for (p = 1; p < length; ++p) key[p - 1] = key[p];\n"
+		"			--length;\n"
+		"			break;\n"
+		"		case RULE_DELETE_LAST:\n"
+		"			if (length) --length;\n"
+		"			break;\n"
+		"		case RULE_DELETE:\n"
+		"			if (a >= length) break;\n"
+		"			for (p = a + 1; p < length; ++p) key[p - 1] = key[p];\n"
+		"			--length;\n"
+		"			break;\n"
+		"		case RULE_TRUNCATE:\n"
+		"			if (a < length) length = a;\n"
+		"			break;\n"
+		"		case RULE_REPLACE:\n"
+		"			for (p = 0; p < length; ++p) if (key[p] == a) key[p] = b;\n"
+		"			break;\n"
+		"		case RULE_PURGE:\n"
+		"			for (p = 0, n = 0; p < length; ++p) if (key[p] != a) key[n++] = key[p];\n"
+		"			length = n;\n"
+		"			break;\n"
+		"		case RULE_REPEAT:\n"
+		"			if (length * (a + 1) > MAX_KEY_LEN) return 0;\n"
+		"			for (p = length; p < length * (a + 1); ++p) key[p] = key[p - length];\n"
+		"			length *= a + 1;\n"
+		"			break;\n"
+		"		case RULE_ROTATE_LEFT:\n"
+		"			if (!length) break;\n"
+		"			c = key[0];\n"
+		"			for (p = 1; p < length; ++p) key[p - 1] = key[p];\n"
+		"			key[length - 1] = c;\n"
+		"			break;\n"
+		"		case RULE_ROTATE_RIGHT:\n"
+		"			if (!length) break;\n"
+		"			c = key[length - 1];\n"
+		"			for (p = length - 1; p > 0; --p) key[p] = key[p - 1];\n"
+		"			key[0] = c;\n"
+		"			break;\n"
+		"		}\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"__kernel void smash_rules(__global volatile uint* result, ulong base, uint4 target,\n"
+		"	__global const uchar* data, __global const uint* words, uint count,\n"
+		"	__global const uchar* code, __global const uint* rule_at, uint rules) {\n"
+		"	uchar key[MAX_KEY_LEN];\n"
+		"	uint out[DIGEST_WORDS];\n"
+		"	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch\n"
+		"\n"
+		"	// candidate = word * rules + rule, neighbours share a word\n"
+		"	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < (ulong)count * rules; ++k) {\n"
+		"		const ulong candidate = base + first + k;\n"
+		"		uint length = load_word((char*)key, data, words[candidate / rules]);\n"
+		"\n"
+		"		length = apply_rule(key, length, code + rule_at[candidate % rules] * 3);\n"
+		"		if (!length || !hash_key((char*)key, length, out))\n"
+		"			continue;\n"
+		"\n"
+		"		check_target(result, out, target, first + k);\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"__kernel void smash_rules_multi(__global volatile uint* hits, ulong base,\n"
+		"	__global const uint* bitmap_a, __global const uint* bitmap_b, uint mask,\n"
+		"	__global const uint4* table, uint count, uint capacity,\n"
+		"	__global const uchar* data, __global const uint* words, uint words_count,\n"
+		"	__global const uchar* code, __global const uint* rule_at, uint rules) {\n"
+		"	uchar key[MAX_KEY_LEN];\n"
+		"	uint out[DIGEST_WORDS];\n"
+		"	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch\n"
+		"\n"
+		"	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < (ulong)words_count * rules; ++k) {\n"
+		"		const ulong candidate = base + first + k;\n"
+		"		uint length = load_word((char*)key, data, words[candidate / rules]);\n"
+		"\n"
+		"		length = apply_rule(key, length, code + rule_at[candidate % rules] * 3);\n"
+		"		if (!length || !hash_key((char*)key, length, out))\n"
+		"			continue;\n"
+		"\n"
+		"		check_targets(hits, out, first + k, bitmap_a, bitmap_b, mask, table, count, capacity);\n"
+		"	}\n"
+		"}\n"
+		"\n"
+		"/*Rainbow chains over 'space' keys: the keys of 'length' of the mask in\n"
+		"'chars' and 'radix', or counter keys below 2 ** 64 with length 0. Column\n"
+		"c hashes the key at the chain's index and reduces the digest to the\n"
+		"index of column c + 1: its first 8 bytes, little-endian, plus c modulo\n"
+		"'space', as rainbow_reduce() does on the host. Each work-item walks one\n"
+		"entry of 'chains' through columns [from, to) in place. With 'lookup',\n"
+		"entry k holds a digest reduced in column (first + k) % columns and\n"
+		"starts in the column after it.*/\n"
+		"__kernel void smash_chains(__global ulong* chains, uint count, ulong first,\n"
+		"	uint columns, uint from, const uint to, uint lookup, ulong space,\n"
+		"	__constant uchar* chars, __constant uint* radix, uint length) {\n"
+		"	char key[MAX_KEY_LEN];\n"
+		"	uchar digit[MAX_KEY_LEN];\n"
+		"	uint out[DIGEST_WORDS];\n"
+		"	const uint id = get_global_id(0);\n"
+		"	if (id >= count)\n"
+		"		return;\n"
+		"\n"
+		"	if (lookup && (first + id) % columns + 1 > from)\n"
+		"		from = (first + id) % columns + 1;\n"
+		"\n"
+		"	ulong index = chains[id];\n"
+		"	for (uint c = from; c < to; ++c) {\n"
+		"		uint size = length;\n"
+		"		if (length)\n"
+		"			decode_mask(key, digit, index, length, chars, radix);\n"
+		"		else {\n"
+		"			// big-endian counter, like counter_key()\n"
+		"			size = KEY_SIZE;\n"
+		"			for (uint k = 0; k < 8; ++k) {\n"
+		"				key[k] = 0;\n"
+		"				key[KEY_SIZE - 1 - k] = (char)(index >> (k * 8));\n"
+		"			}\n"
+		"		}\n"
+		"\n"
+		"		if (!hash_key(key, size, out))\n"
+		"			return;\n"
+		"		index = ((((ulong)out[1] << 32) | out[0]) + c) % space;\n"
+		"	}\n"
+		"	chains[id] = index;\n"
+		"}\n"
+		"#endif\n"
+	},
+};
+
+const char* cl_source(const char* name) {
+	for (unsigned k = 0; k < sizeof(sources) / sizeof(sources[0]); ++k)
+		if (!strcmp(name, sources[k].name))
+			return sources[k].code;
+	return NULL;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+/*Text of a CL file embedded at build time (embed_cl.sh writes
+cl_source.cpp), NULL if there is no such file.*/
+const char* cl_source(const char* name);
@@ -0,0 +1,524 @@
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include "cluster.h"
+#include "log.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#define close_socket closesocket
+#define BAD_SOCKET INVALID_SOCKET
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define close_socket close
+#define BAD_SOCKET (-1)
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // a closed peer must not raise SIGPIPE where this exists
+#endif
+
+static void net_init() {
+#ifdef _WIN32
+	static bool started = false;
+	if (!started) {
+		WSADATA data;
+		WSAStartup(MAKEWORD(2, 2), &data);
+		started = true;
+	}
+#endif
+}
+
+static void set_nonblocking(cluster_socket s) {
+#ifdef _WIN32
+	u_long yes = 1;
+	ioctlsocket(s, FIONBIO, &yes);
+#else
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+// the last call failed only because the socket buffer is full
+static bool would_block() {
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+// whole lines only, a short write would split a message
+static bool send_all(cluster_socket s, const string& text) {
+	size_t sent = 0;
+	while (sent < text.size()) {
+		int n = ::send(s, text.data() + sent, (int)(text.size() - sent), MSG_NOSIGNAL);
+		if (n <= 0)
+			return false;
+		sent += n;
+	}
+	return true;
+}
+
+// moves the first complete line of 'input' into 'line'
+static bool take_line(string& input, string& line) {
+	size_t end = input.find('\n');
+	if (end == string::npos)
+		return false;
+
+	line = input.substr(0, end);
+	input.erase(0, end + 1);
+	if (!line.empty() && line[line.size() - 1] == '\r')
+		line.erase(line.size() - 1);
+	return true;
+}
+
+bool coordinator::listen(uint16_t port) {
+	net_init();
+
+	server = ::socket(AF_INET, SOCK_STREAM, 0);
+	if (server == BAD_SOCKET)
+		return false;
+
+	int yes = 1;
+	setsockopt(server, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+
+	if (::bind(server, (sockaddr*)&address, sizeof(address)) != 0 || ::listen(server, 64) != 0) {
+		close_socket(server);
+		server = BAD_SOCKET;
+		return false;
+	}
+
+	LOG_LINE("Coordinator listening. PORT = " << port);
+
+	return true;
+}
+
+bool coordinator::flush(peer& p) {
+	while (!p.output.empty()) {
+		int n = ::send(p.socket, p.output.data(), (int)p.output.size(), MSG_NOSIGNAL);
+		if (n <= 0)
+			return n < 0 && would_block();
+		p.output.erase(0, n);
+	}
+	return true;
+}
+
+void coordinator::send(cluster_socket socket, const string& line) {
+	map<cluster_socket, peer>::iterator p = peers.find(socket);
+	if (p == peers.end())
+		return;
+
+	// the rest goes out when the socket is writable; a worker that never reads is dropped
+	p->second.output += line + "\n";
+	if (!flush(p->second) || p->second.output.size() > CLUSTER_MAX_OUTPUT)
+		p->second.failed = true;
+}
+
+void coordinator::accept_peer() {
+	cluster_socket socket = ::accept(server, NULL, NULL);
+	if (socket == BAD_SOCKET)
+		return;
+
+	// select() can only watch FD_SETSIZE sockets (descriptors below it outside Windows)
+#ifdef _WIN32
+	const bool fits = peers.size() + 1 < FD_SETSIZE;
+#else
+	const bool fits = socket < FD_SETSIZE;
+#endif
+	if (!fits) {
+		LOG_LINE("Worker refused, too many connections");
+		close_socket(socket);
+		return;
+	}
+
+	int yes = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&yes, sizeof(yes));
+	set_nonblocking(socket);
+
+	peer p;
+	p.socket = socket;
+	p.greeted = false;
+	p.failed = false;
+	p.lease = 0;
+	p.rate = 0;
+	peers[socket] = p;
+}
+
+void coordinator::drop_peer(cluster_socket socket) {
+	map<cluster_socket, peer>::iterator p = peers.find(socket);
+	if (p == peers.end())
+		return;
+
+	// its range is the first to be handed out again
+	if (p->second.lease && leases.count(p->second.lease)) {
+		free_ranges.push_front(leases[p->second.lease].range);
+		leases.erase(p->second.lease);
+
+		LOG_LINE("Worker " << p->second.name << " gone, lease " << p->second.lease << " returned");
+	}
+
+	close_socket(socket);
+	peers.erase(p);
+}
+
+void coordinator::give_lease(peer& p) {
+	if (free_ranges.empty() || (stop_on_hit && !found->empty())) {
+		// others may still fail and give their ranges back
+		if (!leases.empty() && !(stop_on_hit && !found->empty())) {
+			stringstream s;
+			s << "WAIT " << CLUSTER_WAIT_MS;
+			send(p.socket, s.str());
+		}
+		else
+			send(p.socket, "DONE");
+		return;
+	}
+
+	// enough blocks for LEASE_TARGET_MS at the worker's last rate
+	uint64 size = p.rate > 0 ? (uint64)(p.rate * LEASE_TARGET_MS) : LEASE_FIRST_BLOCKS;
+	if (!size)
+		size = 1;
+
+	block_range& front = free_ranges.front();
+	lease l;
+	l.range.first = front.first;
+	l.range.count = size < front.count ? size : front.count;
+	l.holder = p.socket;
+	l.issued = chrono::steady_clock::now();
+
+	front.first += l.range.count;
+	front.count -= l.range.count;
+	if (!front.count)
+		free_ranges.pop_front();
+
+	p.lease = next_lease++;
+	leases[p.lease] = l;
+
+	stringstream s;
+	s << "RANGE " << p.lease << ' ' << l.range.first << ' ' << l.range.count;
+	send(p.socket, s.str());
+}
+
+void coordinator::handle(peer& p, const string& line) {
+	stringstream fields(line);
+	string command;
+	fields >> command;
+
+	if (!p.greeted) {
+		string theirs;
+		getline(fields >> ws, theirs);
+		if (command != "HELLO" || theirs != job) {
+			send(p.socket, "ERR job does not match");
+			drop_peer(p.socket);
+			return;
+		}
+
+		stringstream s;
+		s << "worker " << p.socket;
+		p.name = s.str();
+		p.greeted = true;
+		send(p.socket, "OK");
+		LOG_LINE("Worker joined: " << p.name);
+		return;
+	}
+
+	if (command == "LEASE")
+		give_lease(p);
+	else if (command == "HIT") {
+		uint id;
+		target_hit hit;
+		if (!(fields >> id >> hit.index >> hit.target >> hit.rule))
+			return;
+		if (!(fields >> hit.index_hi))
+			hit.index_hi = 0;
+
+		// only from the holder of the lease, a timed out lease belongs to someone else
+		map<uint, lease>::iterator l = leases.find(id);
+		if (l == leases.end() || l->second.holder != p.socket)
+			return;
+
+		// a re-issued range can report the same hit twice
+		if (!seen.insert(make_tuple(hit.index_hi, hit.index, hit.target)).second)
+			return;
+		found->push_back(hit);
+		if (journal)
+			journal->hit(hit);
+	}
+	else if (command == "RESULT") {
+		uint id;
+		double ms;
+		if (!(fields >> id >> ms))
+			return;
+
+		// a lease that timed out belongs to someone else now
+		map<uint, lease>::iterator l = leases.find(id);
+		if (l != leases.end() && l->second.holder == p.socket) {
+			p.rate = (double)l->second.range.count / (ms > 1 ? ms : 1);
+			if (journal)
+				journal->done(l->second.range.first, l->second.range.count);
+			leases.erase(l);
+		}
+		if (p.lease == id)
+			p.lease = 0;
+		send(p.socket, "OK");
+	}
+}
+
+void coordinator::expire_leases() {
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	for (map<uint, lease>::iterator l = leases.begin(); l != leases.end();) {
+		if (now - l->second.issued < chrono::milliseconds(lease_timeout)) {
+			++l;
+			continue;
+		}
+
+		LOG_LINE("Lease " << l->first << " timed out, range " << l->second.range.first << " + " << l->second.range.count << " returned");
+
+		free_ranges.push_front(l->second.range);
+		if (peers.count(l->second.holder))
+			peers[l->second.holder].lease = 0;
+		leases.erase(l++);
+	}
+}
+
+double coordinator::get_rate() {
+	double rate = 0;
+	for (map<cluster_socket, peer>::iterator p = peers.begin(); p != peers.end(); ++p)
+		rate += p->second.rate;
+	return rate * 1000 * BLOCK_SIZE;
+}
+
+int coordinator::run(const uint64 first, const uint64 count, vector<target_hit>& hits, bool stop_on_hit) {
+	if (server == BAD_SOCKET)
+		return 0;
+
+	size_t before = hits.size();
+	found = &hits;
+	this->stop_on_hit = stop_on_hit;
+
+	free_ranges.clear();
+	if (journal) {
+		vector<block_range> pending = journal->pending(first, count);
+		free_ranges.assign(pending.begin(), pending.end());
+	}
+	else if (count) {
+		block_range all = { first, count };
+		free_ranges.push_back(all);
+	}
+
+	chrono::steady_clock::time_point reported = chrono::steady_clock::now();
+	while (!free_ranges.empty() || !leases.empty()) {
+		if (stop_on_hit && hits.size() > before)
+			break;
+
+		fd_set readable, writable;
+		FD_ZERO(&readable);
+		FD_ZERO(&writable);
+		FD_SET(server, &readable);
+		cluster_socket top = server;
+		for (map<cluster_socket, peer>::iterator p = peers.begin(); p != peers.end(); ++p) {
+			FD_SET(p->first, &readable);
+			if (!p->second.output.empty())
+				FD_SET(p->first, &writable);
+			if (p->first > top)
+				top = p->first;
+		}
+
+		timeval wait = { 1, 0 };
+		if (select((int)top + 1, &readable, &writable, NULL, &wait) < 0)
+			break;
+
+		if (FD_ISSET(server, &readable))
+			accept_peer();
+
+		// collect the ready ones first, handling a line can drop a peer
+		vector<cluster_socket> ready;
+		for (map<cluster_socket, peer>::iterator p = peers.begin(); p != peers.end(); ++p)
+			if (FD_ISSET(p->first, &readable))
+				ready.push_back(p->first);
+
+		for (size_t k = 0; k < ready.size(); ++k) {
+			char buffer[4096];
+			int n = ::recv(ready[k], buffer, sizeof(buffer), 0);
+			if (n < 0 && would_block())
+				continue;
+			if (n <= 0) {
+				drop_peer(ready[k]);
+				continue;
+			}
+
+			peers[ready[k]].input.append(buffer, n);
+			string line;
+			while (peers.count(ready[k]) && take_line(peers[ready[k]].input, line))
+				handle(peers[ready[k]], line);
+
+			if (peers.count(ready[k]) && peers[ready[k]].input.size() > CLUSTER_MAX_LINE)
+				drop_peer(ready[k]);
+		}
+
+		// pending replies, then the workers that broke or stopped reading
+		vector<cluster_socket> failed;
+		for (map<cluster_socket, peer>::iterator p = peers.begin(); p != peers.end(); ++p) {
+			if (FD_ISSET(p->first, &writable) && !flush(p->second))
+				p->second.failed = true;
+			if (p->second.failed)
+				failed.push_back(p->first);
+		}
+		for (size_t k = 0; k < failed.size(); ++k)
+			drop_peer(failed[k]);
+
+		expire_leases();
+
+		if (chrono::steady_clock::now() - reported >= chrono::milliseconds(CLUSTER_REPORT_MS)) {
+			reported = chrono::steady_clock::now();
+
+			LOG_LINE("Cluster: WORKERS = " << peers.size() << ". LEASES = " << leases.size() << ". RATE = " << get_rate() / 1e6 << " MH/s. HITS = " << hits.size() - before);
+		}
+	}
+
+	// everyone still connected is told to stop
+	for (map<cluster_socket, peer>::iterator p = peers.begin(); p != peers.end(); ++p)
+		send(p->first, "DONE");
+
+	if (journal)
+		journal->sync();
+
+	return (int)(hits.size() - before);
+}
+
+coordinator::coordinator() {
+	server = BAD_SOCKET;
+	journal = NULL;
+	lease_timeout = LEASE_TIMEOUT_MS;
+	next_lease = 1;
+	found = NULL;
+	stop_on_hit = false;
+}
+coordinator::~coordinator() {
+	for (map<cluster_socket, peer>::iterator p = peers.begin(); p != peers.end(); ++p)
+		close_socket(p->first);
+	if (server != BAD_SOCKET)
+		close_socket(server);
+}
+
+bool cluster_worker::send(const string& line) {
+	return send_all(socket, line + "\n");
+}
+
+bool cluster_worker::receive(string& line) {
+	while (!take_line(input, line)) {
+		char buffer[512];
+		int n = ::recv(socket, buffer, sizeof(buffer), 0);
+		if (n <= 0 || input.size() > CLUSTER_MAX_LINE)
+			return false;
+		input.append(buffer, n);
+	}
+	return true;
+}
+
+bool cluster_worker::connect(const string& host, uint16_t port, const string& job) {
+	net_init();
+
+	addrinfo hints, *result = NULL;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+
+	stringstream service;
+	service << port;
+	if (getaddrinfo(host.c_str(), service.str().c_str(), &hints, &result) != 0)
+		return false;
+
+	socket = ::socket(AF_INET, SOCK_STREAM, 0);
+	bool connected = socket != BAD_SOCKET && ::connect(socket, result->ai_addr, (int)result->ai_addrlen) == 0;
+	freeaddrinfo(result);
+
+	string reply;
+	if (!connected || !send("HELLO " + job) || !receive(reply) || reply != "OK") {
+		LOG_LINE("Coordinator refused: " << reply);
+		if (socket != BAD_SOCKET)
+			close_socket(socket);
+		socket = BAD_SOCKET;
+		return false;
+	}
+
+	int yes = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&yes, sizeof(yes));
+
+	LOG_LINE("Connected to coordinator " << host << ":" << port);
+
+	return true;
+}
+
+int cluster_worker::run(const search& fn) {
+	int total = 0;
+	string line;
+
+	while (send("LEASE") && receive(line)) {
+		stringstream fields(line);
+		string command;
+		fields >> command;
+
+		if (command == "DONE")
+			return total;
+
+		if (command == "WAIT") {
+			uint ms = CLUSTER_WAIT_MS;
+			fields >> ms;
+			this_thread::sleep_for(chrono::milliseconds(ms));
+			continue;
+		}
+
+		uint id;
+		uint64 first, count;
+		if (command != "RANGE" || !(fields >> id >> first >> count))
+			break;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		vector<target_hit> hits;
+		fn(first, count, hits);
+		chrono::duration<double, milli> took = chrono::steady_clock::now() - start;
+
+		// hits before the result, the range only counts as done once they are in
+		for (size_t k = 0; k < hits.size(); ++k) {
+			stringstream s;
+			s << "HIT " << id << ' ' << hits[k].index << ' ' << hits[k].target << ' ' << hits[k].rule;
+			if (hits[k].index_hi)
+				s << ' ' << hits[k].index_hi;
+			send(s.str());
+		}
+		total += (int)hits.size();
+
+		stringstream s;
+		s << "RESULT " << id << ' ' << took.count();
+		if (!send(s.str()) || !receive(line) || line != "OK")
+			break;
+	}
+
+	return -1;
+}
+
+cluster_worker::cluster_worker() {
+	socket = BAD_SOCKET;
+}
+cluster_worker::~cluster_worker() {
+	if (socket != BAD_SOCKET)
+		close_socket(socket);
+}
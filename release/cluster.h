@@ -0,0 +1,139 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "progress.h"
+#include "targets.h"
+#include "types.h"
+
+using namespace std;
+
+#define CLUSTER_PORT 7788
+#define LEASE_TIMEOUT_MS 60000 // a lease not finished in this time goes to another worker
+#define LEASE_TARGET_MS 5000 // leases are sized to keep a worker busy this long
+#define LEASE_FIRST_BLOCKS 64 // first lease of a worker, before its rate is known
+#define CLUSTER_REPORT_MS 5000 // cluster hash rate is logged this often
+#define CLUSTER_WAIT_MS 1000 // idle workers ask again after this long
+#define CLUSTER_MAX_LINE 256
+#define CLUSTER_MAX_OUTPUT (64 * 1024) // unsent bytes to a worker before it counts as gone
+
+#ifdef _WIN32
+typedef uintptr_t cluster_socket;
+#else
+typedef int cluster_socket;
+#endif
+
+/*Line protocol between coordinator and workers, one TCP connection
+per worker:
+
+	worker                       coordinator
+	HELLO <job>              ->  OK | ERR <reason>
+	LEASE                    ->  RANGE <id> <first> <count> | WAIT <ms> | DONE
+	HIT <id> <index> <target> <rule> [<index_hi>]
+	RESULT <id> <ms>         ->  OK
+
+Ranges are in blocks. A worker holds one lease at a time; a lease of a
+worker that disconnects or does not report within LEASE_TIMEOUT_MS is
+handed out again. Hits count only for a lease the sender still holds,
+duplicates dropped.*/
+
+/*Hands out a block range to the workers that connect and collects
+their hits. Lease sizes follow each worker's measured rate. With a
+journal, finished leases and their hits are recorded and a restarted
+coordinator only leases what is left. Sockets do not block: a worker
+that stops reading is dropped once CLUSTER_MAX_OUTPUT bytes to it are
+pending, instead of stalling everyone else.*/
+class coordinator {
+public:
+	// false if the port can not be bound
+	bool listen(uint16_t port = CLUSTER_PORT);
+
+	/*Serves [first, first + count) until every block is done, or
+	until the first hit with 'stop_on_hit'. Returns the number of hits
+	appended to 'hits'.*/
+	int run(const uint64 first, const uint64 count, vector<target_hit>& hits, bool stop_on_hit = false);
+
+	void set_job(const string& job) { this->job = job; }
+	void set_journal(progress_journal* journal) { this->journal = journal; }
+
+	// leases not finished in 'ms' go to another worker, LEASE_TIMEOUT_MS by default
+	void set_lease_timeout(uint ms) { lease_timeout = ms; }
+
+	// keys per second over all workers, from their last leases
+	double get_rate();
+	uint get_workers() { return (uint)peers.size(); }
+
+	coordinator();
+	~coordinator();
+private:
+	struct peer {
+		cluster_socket socket;
+		string name;
+		string input; // bytes received but not yet a full line
+		string output; // bytes not sent yet
+		bool greeted;
+		bool failed; // dropped after the current round
+		uint lease; // 0 if idle
+		double rate; // blocks per ms, 0 until the first result
+	};
+
+	struct lease {
+		block_range range;
+		cluster_socket holder;
+		chrono::steady_clock::time_point issued;
+	};
+
+	cluster_socket server;
+	string job;
+	progress_journal* journal;
+	uint lease_timeout;
+
+	map<cluster_socket, peer> peers;
+	map<uint, lease> leases;
+	deque<block_range> free_ranges;
+	uint next_lease;
+
+	vector<target_hit>* found;
+	set<tuple<uint64, uint64, uint> > seen; // (index_hi, index, target) of every hit
+	bool stop_on_hit;
+
+	void accept_peer();
+	void drop_peer(cluster_socket socket);
+	void handle(peer& p, const string& line);
+	void give_lease(peer& p);
+	void expire_leases();
+	void send(cluster_socket socket, const string& line);
+
+	// sends what the socket takes without blocking, false if the connection broke
+	bool flush(peer& p);
+};
+
+/*Runs leases from a coordinator through 'search', which hashes blocks
+[first, first + count) and appends its hits, until the coordinator
+has no work left.*/
+class cluster_worker {
+public:
+	typedef function<int(uint64 first, uint64 count, vector<target_hit>& hits)> search;
+
+	// false if the coordinator is unreachable or runs another job
+	bool connect(const string& host, uint16_t port, const string& job);
+
+	// returns the hits this worker found, -1 if the connection broke
+	int run(const search& fn);
+
+	cluster_worker();
+	~cluster_worker();
+private:
+	cluster_socket socket;
+	string input;
+
+	bool send(const string& line);
+	bool receive(string& line);
+};
@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include "cpu_smasher.h"
+#include "log.h"
+#include "rainbow.h"
+
+static inline uint bswap(uint x) {
+	return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+}
+
+// key 'offset' after 'origin'
+static inline uint128 key_after(const uint128& origin, uint64 offset) {
+	uint128 index = { origin.lo + offset, origin.hi };
+	index.hi += (index.lo < offset);
+	return index;
+}
+
+/*Writes the key at 'index' into lane 'lane' of a block. Same key as
+counter_key() in the kernel: a big-endian 128-bit counter.*/
+static inline void make_key(const uint128& index, uint* m, uint width, uint lane) {
+	m[0 * width + lane] = bswap((uint)(index.hi >> 32));
+	m[1 * width + lane] = bswap((uint)index.hi);
+	m[2 * width + lane] = bswap((uint)(index.lo >> 32));
+	m[3 * width + lane] = bswap((uint)index.lo);
+}
+
+/*Writes a key of 'length' bytes and its 0x80 pad into lane 'lane'.
+Words past the pad stay zero.*/
+static inline void put_key(const uchar* key, uint length, uint* m, uint width, uint lane) {
+	for (uint w = 0; w <= length / 4; ++w) {
+		uint word = 0;
+		for (uint b = 0; b < 4; ++b) {
+			uint p = w * 4 + b;
+			uint c = (p < length) ? key[p] : (p == length ? 0x80 : 0);
+			word |= c << (b * 8);
+		}
+		m[w * width + lane] = word;
+	}
+}
+
+// UTF-16LE of an ASCII key, 0 if it no longer fits a block
+static inline uint widen(const uchar* key, uint length, uchar* wide) {
+	if (length * 2 > MAX_KEY_LEN)
+		return 0;
+
+	for (uint p = 0; p < length; ++p) {
+		wide[p * 2] = key[p];
+		wide[p * 2 + 1] = 0;
+	}
+	return length * 2;
+}
+
+template<uint L, class F>
+bool cpu_smasher::search_fixed(const uint128& origin, uint64 first, uint64 last, F match) {
+	uint m[CPU_BATCH * 16];
+	uint h[CPU_BATCH * MAX_DIGEST_SIZE / 4];
+	const uint width = core.width;
+	const uint words = algo.digest_size / 4;
+	const uint length = L ? L : (mask ? mask_length : KEY_SIZE);
+	const uint bytes = algo.utf16 ? length * 2 : length;
+
+	// widened mask keys that overflow the block are skipped like in the kernel
+	if (bytes > MAX_KEY_LEN && mask)
+		return false;
+
+	// padding for a fixed length message never changes, only the key words do
+	memset(m, 0, sizeof(m));
+	for (uint b = 0; b < CPU_BATCH / width; ++b)
+		for (uint l = 0; l < width; ++l) {
+			if (!mask && !algo.utf16)
+				m[(b * 16 + 4) * width + l] = 0x80;
+			hash_length(algo, bytes, &m[b * 16 * width], width, l);
+		}
+
+	// mask keys are decoded once, then counted up like next_mask() in the kernel
+	uchar key[MAX_KEY_LEN], wide[MAX_KEY_LEN];
+	uint digit[MAX_KEY_LEN] = { 0 };
+	const uchar* chars = mask ? mask->get_chars() : NULL;
+	const uint* radix = mask ? mask->get_radix() : NULL;
+	if (mask) {
+		mask->digits(key_after(origin, first), length, digit);
+		for (uint p = 0; p < length; ++p)
+			key[p] = chars[p * 256 + digit[p]];
+	}
+
+	for (uint64 base = first; base < last; base += CPU_BATCH) {
+		uint count = (last - base < CPU_BATCH) ? (uint)(last - base) : CPU_BATCH;
+		uint batches = (count + width - 1) / width;
+
+		// lanes past 'count' hash a repeated or wrapped key and are never compared
+		for (uint k = 0; k < batches * width; ++k) {
+			uint* block = &m[(k / width) * 16 * width];
+			if (!mask && !algo.utf16) {
+				make_key(key_after(origin, base + (k < count ? k : 0)), block, width, k % width);
+				continue;
+			}
+
+			// counter keys to widen are the big-endian bytes of the index
+			if (!mask) {
+				uint128 index = key_after(origin, base + (k < count ? k : 0));
+				for (uint p = 0; p < 8; ++p) {
+					key[KEY_SIZE - p - 1] = (uchar)(index.lo >> (p * 8));
+					key[KEY_SIZE - p - 9] = (uchar)(index.hi >> (p * 8));
+				}
+			}
+
+			if (algo.utf16)
+				put_key(wide, widen(key, length, wide), block, width, k % width);
+			else
+				put_key(key, length, block, width, k % width);
+
+			if (!mask)
+				continue;
+			for (uint p = 0; p < length; ++p) {
+				if (++digit[p] < radix[p]) {
+					key[p] = chars[p * 256 + digit[p]];
+					break;
+				}
+				digit[p] = 0;
+				key[p] = chars[p * 256];
+			}
+		}
+
+		core.run(m, h, batches);
+
+		for (uint k = 0; k < count; ++k)
+			if (match(base + k, &h[(k / width) * words * width + k % width], width))
+				return true;
+	}
+
+	return false;
+}
+
+#define SEARCH_FIXED(n) case n: return search_fixed<n>(origin, first, last, match);
+
+template<class F>
+bool cpu_smasher::search(const uint128& origin, uint64 first, uint64 last, F match) {
+	if (!mask)
+		return search_fixed<KEY_SIZE>(origin, first, last, match);
+
+	// the usual mask lengths get their own instantiation
+	switch (mask_length) {
+	SEARCH_FIXED(1) SEARCH_FIXED(2) SEARCH_FIXED(3) SEARCH_FIXED(4)
+	SEARCH_FIXED(5) SEARCH_FIXED(6) SEARCH_FIXED(7) SEARCH_FIXED(8)
+	SEARCH_FIXED(9) SEARCH_FIXED(10) SEARCH_FIXED(11) SEARCH_FIXED(12)
+	SEARCH_FIXED(13) SEARCH_FIXED(14) SEARCH_FIXED(15) SEARCH_FIXED(16)
+	default: return search_fixed<0>(origin, first, last, match);
+	}
+}
+
+uint128 cpu_smasher::get_keys(uint64 first, uint64 count, uint64& keys) {
+	uint128 origin = key_index(first);
+	keys = count * BLOCK_SIZE;
+	if (!mask)
+		return origin;
+
+	// mask key indices are 128-bit like the origin
+	keys = mask->keys_after(origin, mask_length, keys);
+	return origin;
+}
+
+template<class F>
+bool cpu_smasher::search_words(const word_batch& batch, uint64 first, uint64 last, F match) {
+	uint m[CPU_BATCH * 16];
+	uint h[CPU_BATCH * MAX_DIGEST_SIZE / 4];
+	const uint width = core.width;
+	const uint words = algo.digest_size / 4;
+
+	uint lengths[CPU_BATCH];
+	uchar key[MAX_KEY_LEN], wide[MAX_KEY_LEN];
+	const uint per_word = word_candidates();
+
+	for (uint64 base = first; base < last; base += CPU_BATCH) {
+		uint count = (last - base < CPU_BATCH) ? (uint)(last - base) : CPU_BATCH;
+		uint batches = (count + width - 1) / width;
+
+		// lengths differ from key to key, so every block starts out clean
+		memset(m, 0, batches * 16 * width * sizeof(uint));
+		for (uint k = 0; k < batches * width; ++k) {
+			uint64 candidate = base + (k < count ? k : 0);
+			uint word = batch.words[(size_t)(candidate / per_word)];
+			uint length = word & 0xff;
+
+			if (hybrid)
+				length = hybrid->combine((const uchar*)batch.data + (word >> 8), length, candidate % per_word, hybrid_length, hybrid_prefix, key);
+			else {
+				memcpy(key, batch.data + (word >> 8), length);
+				if (rules)
+					length = rules->apply((uint)(candidate % per_word), key, length);
+			}
+
+			uint* block = &m[(k / width) * 16 * width];
+			if (algo.utf16) {
+				length = widen(key, length, wide);
+				put_key(wide, length, block, width, k % width);
+			}
+			else
+				put_key(key, length, block, width, k % width);
+			hash_length(algo, length, block, width, k % width);
+			lengths[k] = length;
+		}
+
+		core.run(m, h, batches);
+
+		// rejected keys were hashed empty, skip them
+		for (uint k = 0; k < count; ++k)
+			if (lengths[k] && match(base + k, &h[(k / width) * words * width + k % width], width))
+				return true;
+	}
+
+	return false;
+}
+
+int cpu_smasher::smash_range(const uint64 first, const uint64 count, char* cmpto, uint64& found) {
+	// key offsets from the first key stay within 64 bits
+	if (count > CPU_MAX_BLOCKS) {
+		int k = smash_range(first, CPU_MAX_BLOCKS, cmpto, found);
+		return (k >= 0) ? k : smash_range(first + CPU_MAX_BLOCKS, count - CPU_MAX_BLOCKS, cmpto, found);
+	}
+
+	uint target[4];
+	memcpy(target, cmpto, MATCH_SIZE); // digest bytes are the little-endian state words
+
+	uint64 keys;
+	uint128 origin = get_keys(first, count, keys);
+
+	atomic<uint64> hit(~0ULL);
+	pool.run(0, keys, CPU_GRAIN,
+		[&](uint, uint64 a, uint64 b) {
+			return search(origin, a, b, [&](uint64 index, const uint* out, uint stride) {
+				if (out[0] != target[0] || out[stride] != target[1] ||
+					out[2 * stride] != target[2] || out[3 * stride] != target[3])
+					return false;
+
+				// keep the lowest index if two workers hit at once
+				uint64 prev = hit.load();
+				while (index < prev && !hit.compare_exchange_weak(prev, index));
+				return true;
+			});
+		});
+
+	if (hit == ~0ULL)
+		return -1;
+
+	found = first + hit / BLOCK_SIZE;
+	return (int)(hit % BLOCK_SIZE);
+}
+
+int cpu_smasher::smash(const uint64 block, char* cmpto) {
+	uint64 found;
+	return smash_range(block, 1, cmpto, found);
+}
+
+int cpu_smasher::smash(const uint64 block, const target_set& targets, vector<target_hit>& hits) {
+	return smash_range(block, 1, targets, hits);
+}
+
+int cpu_smasher::smash_range(const uint64 first, const uint64 count, const target_set& targets, vector<target_hit>& hits) {
+	if (count > CPU_MAX_BLOCKS)
+		return smash_range(first, CPU_MAX_BLOCKS, targets, hits) + smash_range(first + CPU_MAX_BLOCKS, count - CPU_MAX_BLOCKS, targets, hits);
+
+	mutex lock;
+	size_t before = hits.size();
+
+	uint64 keys;
+	uint128 origin = get_keys(first, count, keys);
+
+	pool.run(0, keys, CPU_GRAIN,
+		[&](uint, uint64 a, uint64 b) {
+			return search(origin, a, b, [&](uint64 index, const uint* out, uint stride) {
+				if (!targets.probe(out, stride))
+					return false;
+
+				int t = targets.find(out, stride);
+				if (t >= 0) {
+					uint128 key = key_after(origin, index);
+					target_hit hit = { key.lo, (uint)t, 0, key.hi };
+					lock_guard<mutex> guard(lock);
+					hits.push_back(hit);
+				}
+				return false;
+			});
+		});
+
+	return (int)(hits.size() - before);
+}
+
+bool cpu_smasher::smash_words(word_feed& feed, char* cmpto, uint64& found, uint& rule) {
+	uint target[4];
+	memcpy(target, cmpto, MATCH_SIZE);
+
+	// the feed packs the next batches while the pool hashes this one
+	const uint per_word = word_candidates();
+	word_batch batch;
+	while (feed.next(batch)) {
+		atomic<uint64> hit(~0ULL);
+		pool.run(0, batch.words.size() * per_word, CPU_GRAIN,
+			[&](uint, uint64 a, uint64 b) {
+				return search_words(batch, a, b, [&](uint64 index, const uint* out, uint stride) {
+					if (out[0] != target[0] || out[stride] != target[1] ||
+						out[2 * stride] != target[2] || out[3 * stride] != target[3])
+						return false;
+
+					uint64 prev = hit.load();
+					while (index < prev && !hit.compare_exchange_weak(prev, index));
+					return true;
+				});
+			});
+
+		if (hit != ~0ULL) {
+			found = batch.begin + (batch.words[(size_t)(hit / per_word)] >> 8);
+			rule = (uint)(hit % per_word);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int cpu_smasher::smash_words(word_feed& feed, const target_set& targets, vector<target_hit>& hits) {
+	mutex lock;
+	size_t before = hits.size();
+
+	const uint per_word = word_candidates();
+	word_batch batch;
+	while (feed.next(batch)) {
+		pool.run(0, batch.words.size() * per_word, CPU_GRAIN,
+			[&](uint, uint64 a, uint64 b) {
+				return search_words(batch, a, b, [&](uint64 index, const uint* out, uint stride) {
+					if (!targets.probe(out, stride))
+						return false;
+
+					int t = targets.find(out, stride);
+					if (t >= 0) {
+						target_hit hit = { batch.begin + (batch.words[(size_t)(index / per_word)] >> 8), (uint)t, (uint)(index % per_word), 0 };
+						lock_guard<mutex> guard(lock);
+						hits.push_back(hit);
+					}
+					return false;
+				});
+			});
+	}
+
+	return (int)(hits.size() - before);
+}
+
+int cpu_smasher::smash_crypt(word_feed& feed, const crypt_set& targets, vector<target_hit>& hits) {
+	mutex lock;
+	size_t before = hits.size();
+
+	word_batch batch;
+	while (feed.next(batch)) {
+		// equal lengths next to each other, so a chunk fills whole lanes
+		vector<uint> order(batch.words.size());
+		for (uint k = 0; k < order.size(); ++k)
+			order[k] = batch.words[k];
+		stable_sort(order.begin(), order.end(), [](uint a, uint b) { return (a & 0xff) < (b & 0xff); });
+
+		for (uint g = 0; g < targets.size(); ++g) {
+			const crypt_group& group = targets.group(g);
+			pool.run(0, order.size(), CRYPT_GRAIN,
+				[&](uint, uint64 a, uint64 b) {
+					const uint n = (uint)(b - a);
+					const uchar* keys[CRYPT_GRAIN] = { NULL };
+					uint lengths[CRYPT_GRAIN] = { 0 };
+					uchar digests[CRYPT_GRAIN * CRYPT_MAX_DIGEST];
+
+					for (uint k = 0; k < n; ++k) {
+						keys[k] = (const uchar*)batch.data + (order[a + k] >> 8);
+						lengths[k] = order[a + k] & 0xff;
+					}
+					crypt_hash(group, keys, lengths, n, digests);
+
+					for (uint k = 0; k < n; ++k) {
+						uint first, count = group.find(&digests[k * group.digest_size], first);
+						for (uint e = first; e < first + count; ++e) {
+							target_hit hit = { batch.begin + (order[a + k] >> 8), group.entries[e], 0, 0 };
+							lock_guard<mutex> guard(lock);
+							hits.push_back(hit);
+						}
+					}
+					return false;
+				});
+		}
+	}
+
+	return (int)(hits.size() - before);
+}
+
+bool cpu_smasher::walk_chains(uint64* chains, uint count, uint64 first, uint columns, uint64 space, bool lookup) {
+	pool.run(0, count, CPU_CHAINS,
+		[&](uint, uint64 a, uint64 b) {
+			for (uint64 k = a; k < b; ++k) {
+				uint from = lookup ? (uint)((first + k) % columns) + 1 : 0;
+				chains[k] = rainbow_walk(algo, mask, mask_length, chains[k], from, columns, space);
+			}
+			return false;
+		});
+	return true;
+}
+
+bool cpu_smasher::set_hybrid(const key_mask* mask, uint length, bool prefix) {
+	uint64 space = mask ? mask->keyspace(length) : 0;
+	bool fits = space && space <= HYBRID_MAX_SPACE;
+
+	hybrid = fits ? mask : NULL;
+	hybrid_length = length;
+	hybrid_prefix = prefix;
+	hybrid_space = (uint)space;
+	return fits || !mask;
+}
+
+bool cpu_smasher::set_mask(const key_mask* mask, uint length) {
+	bool fits = !mask || mask->fits(length);
+	this->mask = fits ? mask : NULL;
+	mask_length = fits ? length : 0;
+	return fits;
+}
+
+cpu_smasher::cpu_smasher(const hash_algo& algo, uint threads) : algo(algo), core(hash_select(algo)), pool(threads) {
+	mask = NULL;
+	mask_length = 0;
+	rules = NULL;
+	hybrid = NULL;
+	hybrid_length = 0;
+	hybrid_prefix = false;
+	hybrid_space = 0;
+
+	LOG_LINE("Using native CPU engine. HASH = " << algo.name << ". ISA = " << core.name << ". THREADS = " << pool.size());
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "crypt.h"
+#include "mask.h"
+#include "hash_cpu.h"
+#include "pool.h"
+#include "rules.h"
+#include "targets.h"
+#include "wordlist.h"
+#include "types.h"
+
+using namespace std;
+
+#define CPU_GRAIN 256 // keys per stolen chunk
+#define CPU_BATCH 256 // keys hashed per call into the hash core
+#define CPU_CHUNK 64 // blocks handed to the native engine at once
+#define CPU_MAX_BLOCKS (~0ULL >> BLOCK_BITS) // longest range searched in one pass
+#define CPU_CHAINS 16 // rainbow chains per stolen chunk, each is a whole chain of hashes
+
+
+/*Native fallback for smasher, used when no OpenCL device is
+available. Searches the same keyspace with the widest SIMD core of
+the hash the CPU has, spread over a work-stealing thread pool.*/
+class cpu_smasher {
+public:
+	int smash(const uint64 block, char* cmpto);
+
+	/*Searches blocks [first, first + count). On a hit the block is
+	stored in 'found' and the key's index in it is returned.*/
+	int smash_range(const uint64 first, const uint64 count, char* cmpto, uint64& found);
+
+	/*Checks a block against every target at once, appends the
+	hits and returns how many there were.*/
+	int smash(const uint64 block, const target_set& targets, vector<target_hit>& hits);
+
+	int smash_range(const uint64 first, const uint64 count, const target_set& targets, vector<target_hit>& hits);
+
+	/*Searches the 'length' keys of a mask instead of the
+	counter keyspace, until cleared with NULL. False, and back
+	on the counter keyspace, if the mask does not fit(length).*/
+	bool set_mask(const key_mask* mask, uint length);
+
+	/*Hashes every word of the feed, batch by batch. Hits are
+	reported by the word's file offset and the rule applied.*/
+	bool smash_words(word_feed& feed, char* cmpto, uint64& found, uint& rule);
+
+	int smash_words(word_feed& feed, const target_set& targets, vector<target_hit>& hits);
+
+	/*Runs every word of the feed through each salt group of
+	'targets'. Hits carry the crypt_set entry as target; rules are
+	not applied.*/
+	int smash_crypt(word_feed& feed, const crypt_set& targets, vector<target_hit>& hits);
+
+	// runs every word through every rule, NULL for plain words
+	bool set_rules(const rule_set* rules) { this->rules = (rules && rules->size()) ? rules : NULL; return true; }
+
+	/*Appends (prepends with 'prefix') the 'length' keys of a mask to
+	every word instead, until cleared with NULL; rules are not applied
+	then. False if a word has more than HYBRID_MAX_SPACE such keys.*/
+	bool set_hybrid(const key_mask* mask, uint length, bool prefix);
+
+	// smasher::walk_chains() one chain per thread at a time, with the scalar hash
+	bool walk_chains(uint64* chains, uint count, uint64 first, uint columns, uint64 space, bool lookup);
+
+	cpu_smasher(const hash_algo& algo = hash_get(HASH_MD5), uint threads = 0);
+
+	const char* get_isa() { return core.name; }
+	uint get_threads() { return pool.size(); }
+private:
+	const hash_algo& algo;
+	const hash_core& core;
+	work_pool pool;
+
+	const key_mask* mask;
+	uint mask_length;
+
+	const rule_set* rules;
+
+	// hybrid mask, NULL for plain or rule words
+	const key_mask* hybrid;
+	uint hybrid_length;
+	bool hybrid_prefix;
+	uint hybrid_space;
+
+	// candidates of every word of a batch
+	uint word_candidates() const { return hybrid ? hybrid_space : (rules ? rules->size() : 1); }
+
+	/*Index of the first key of block 'first'; 'keys' is the number of
+	keys of blocks [first, first + count), cut at the end of the mask.*/
+	uint128 get_keys(uint64 first, uint64 count, uint64& keys);
+
+	/*Hashes the keys [first, last) after 'origin' and hands each one
+	to 'match' as (offset from origin, digest words 'stride' apart,
+	stride). Stops early and returns true once 'match' does.*/
+	template<class F>
+	bool search(const uint128& origin, uint64 first, uint64 last, F match);
+
+	/*search() for keys of length L, so the key loops unroll like in
+	the device's MASK_LENGTH variants; 0 takes the length at run time.*/
+	template<uint L, class F>
+	bool search_fixed(const uint128& origin, uint64 first, uint64 last, F match);
+
+	// same for the candidates [first, last) of a batch, word * word_candidates() + rule or mask index
+	template<class F>
+	bool search_words(const word_batch& batch, uint64 first, uint64 last, F match);
+};
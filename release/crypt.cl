@@ -0,0 +1,340 @@
+/*Iterated crypt formats ($1$ md5crypt, $6$ sha512crypt), built after
+smash.cl for load_word() but independent of the hash file. Every
+work-item runs all rounds of one word against one salt group; the
+whole state stays in private memory, the group's sorted digests are
+only read at the end.*/
+
+#define CRYPT_MAX_SALT 16
+
+__constant uint md5c_k[64] = {
+	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+	0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+	0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+	0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+	0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+	0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+	0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+	0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+__constant uint md5c_r[16] = { 7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21 };
+
+__constant ulong sha512c_k[80] = {
+	0x428a2f98d728ae22UL, 0x7137449123ef65cdUL, 0xb5c0fbcfec4d3b2fUL, 0xe9b5dba58189dbbcUL,
+	0x3956c25bf348b538UL, 0x59f111f1b605d019UL, 0x923f82a4af194f9bUL, 0xab1c5ed5da6d8118UL,
+	0xd807aa98a3030242UL, 0x12835b0145706fbeUL, 0x243185be4ee4b28cUL, 0x550c7dc3d5ffb4e2UL,
+	0x72be5d74f27b896fUL, 0x80deb1fe3b1696b1UL, 0x9bdc06a725c71235UL, 0xc19bf174cf692694UL,
+	0xe49b69c19ef14ad2UL, 0xefbe4786384f25e3UL, 0x0fc19dc68b8cd5b5UL, 0x240ca1cc77ac9c65UL,
+	0x2de92c6f592b0275UL, 0x4a7484aa6ea6e483UL, 0x5cb0a9dcbd41fbd4UL, 0x76f988da831153b5UL,
+	0x983e5152ee66dfabUL, 0xa831c66d2db43210UL, 0xb00327c898fb213fUL, 0xbf597fc7beef0ee4UL,
+	0xc6e00bf33da88fc2UL, 0xd5a79147930aa725UL, 0x06ca6351e003826fUL, 0x142929670a0e6e70UL,
+	0x27b70a8546d22ffcUL, 0x2e1b21385c26c926UL, 0x4d2c6dfc5ac42aedUL, 0x53380d139d95b3dfUL,
+	0x650a73548baf63deUL, 0x766a0abb3c77b2a8UL, 0x81c2c92e47edaee6UL, 0x92722c851482353bUL,
+	0xa2bfe8a14cf10364UL, 0xa81a664bbc423001UL, 0xc24b8b70d0f89791UL, 0xc76c51a30654be30UL,
+	0xd192e819d6ef5218UL, 0xd69906245565a910UL, 0xf40e35855771202aUL, 0x106aa07032bbd1b8UL,
+	0x19a4c116b8d2d0c8UL, 0x1e376c085141ab53UL, 0x2748774cdf8eeb99UL, 0x34b0bcb5e19b48a8UL,
+	0x391c0cb3c5c95a63UL, 0x4ed8aa4ae3418acbUL, 0x5b9cca4f7763e373UL, 0x682e6ff3d6b2b8a3UL,
+	0x748f82ee5defb2fcUL, 0x78a5636f43172f60UL, 0x84c87814a1f0ab72UL, 0x8cc702081a6439ecUL,
+	0x90befffa23631e28UL, 0xa4506cebde82bde9UL, 0xbef9a3f7b2c67915UL, 0xc67178f2e372532bUL,
+	0xca273eceea26619cUL, 0xd186b8c721c0c207UL, 0xeada7dd6cde0eb1eUL, 0xf57d4f7fee6ed178UL,
+	0x06f067aa72176fbaUL, 0x0a637dc5a2c898a6UL, 0x113f9804bef90daeUL, 0x1b710b35131c471bUL,
+	0x28db77f523047d84UL, 0x32caab7b40c72493UL, 0x3c9ebe0a15c9bebcUL, 0x431d67c49c100d4cUL,
+	0x4cc5d4becb3e42b6UL, 0x597f299cfc657e2aUL, 0x5fcb6fab3ad6faecUL, 0x6c44198c4a475817UL
+};
+
+__constant ulong sha512c_iv[8] = {
+	0x6a09e667f3bcc908UL, 0xbb67ae8584caa73bUL, 0x3c6ef372fe94f82bUL, 0xa54ff53a5f1d36f1UL,
+	0x510e527fade682d1UL, 0x9b05688c2b3e6c1fUL, 0x1f83d9abfb41bd6bUL, 0x5be0cd19137e2179UL
+};
+
+/*Streaming MD5, fed a few bytes at a time.*/
+typedef struct {
+	uint s[4];
+	uchar buf[64];
+	uint fill;
+	uint total;
+} md5c_ctx;
+
+void md5c_block(md5c_ctx* c) {
+	uint m[16];
+	for (uint w = 0; w < 16; ++w)
+		m[w] = c->buf[w * 4] | (c->buf[w * 4 + 1] << 8) | (c->buf[w * 4 + 2] << 16) | ((uint)c->buf[w * 4 + 3] << 24);
+
+	uint a = c->s[0], b = c->s[1], d = c->s[3], cc = c->s[2];
+	for (uint i = 0; i < 64; ++i) {
+		uint f, g;
+		if (i < 16) { f = d ^ (b & (cc ^ d)); g = i; }
+		else if (i < 32) { f = cc ^ (d & (b ^ cc)); g = (5 * i + 1) & 15; }
+		else if (i < 48) { f = b ^ cc ^ d; g = (3 * i + 5) & 15; }
+		else { f = cc ^ (b | ~d); g = (7 * i) & 15; }
+
+		const uint t = d;
+		d = cc;
+		cc = b;
+		b += rotate(a + f + md5c_k[i] + m[g], md5c_r[(i >> 4) * 4 + (i & 3)]);
+		a = t;
+	}
+
+	c->s[0] += a;
+	c->s[1] += b;
+	c->s[2] += cc;
+	c->s[3] += d;
+}
+
+inline void md5c_init(md5c_ctx* c) {
+	c->s[0] = 0x67452301;
+	c->s[1] = 0xefcdab89;
+	c->s[2] = 0x98badcfe;
+	c->s[3] = 0x10325476;
+	c->fill = 0;
+	c->total = 0;
+}
+
+void md5c_add(md5c_ctx* c, const uchar* p, uint n) {
+	c->total += n;
+	for (uint k = 0; k < n; ++k) {
+		c->buf[c->fill++] = p[k];
+		if (c->fill == 64) {
+			md5c_block(c);
+			c->fill = 0;
+		}
+	}
+}
+
+void md5c_add_global(md5c_ctx* c, __global const uchar* p, uint n) {
+	uchar b[CRYPT_MAX_SALT];
+	for (uint k = 0; k < n; ++k)
+		b[k] = p[k];
+	md5c_add(c, b, n);
+}
+
+void md5c_finish(md5c_ctx* c, uchar* out) {
+	const uint bits = c->total * 8;
+	c->buf[c->fill++] = 0x80;
+	if (c->fill > 56) {
+		while (c->fill < 64)
+			c->buf[c->fill++] = 0;
+		md5c_block(c);
+		c->fill = 0;
+	}
+	while (c->fill < 56)
+		c->buf[c->fill++] = 0;
+	for (uint k = 0; k < 8; ++k)
+		c->buf[56 + k] = (k < 4) ? (uchar)(bits >> (k * 8)) : 0;
+	md5c_block(c);
+
+	for (uint k = 0; k < 16; ++k)
+		out[k] = (uchar)(c->s[k / 4] >> ((k % 4) * 8));
+}
+
+/*Streaming SHA-512, same shape.*/
+typedef struct {
+	ulong s[8];
+	uchar buf[128];
+	uint fill;
+	uint total;
+} sha512c_ctx;
+
+#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+void sha512c_block(sha512c_ctx* c) {
+	ulong w[16], x[8];
+	for (uint k = 0; k < 16; ++k) {
+		ulong v = 0;
+		for (uint b = 0; b < 8; ++b)
+			v = v << 8 | c->buf[k * 8 + b];
+		w[k] = v;
+	}
+	for (uint k = 0; k < 8; ++k)
+		x[k] = c->s[k];
+
+	for (uint t = 0; t < 80; ++t) {
+		if (t >= 16) {
+			const ulong a = w[(t + 1) & 15], b = w[(t + 14) & 15];
+			w[t & 15] += (ROTR64(a, 1) ^ ROTR64(a, 8) ^ (a >> 7)) + w[(t + 9) & 15] + (ROTR64(b, 19) ^ ROTR64(b, 61) ^ (b >> 6));
+		}
+
+		const ulong t1 = x[7] + (ROTR64(x[4], 14) ^ ROTR64(x[4], 18) ^ ROTR64(x[4], 41)) +
+			(x[6] ^ (x[4] & (x[5] ^ x[6]))) + sha512c_k[t] + w[t & 15];
+		const ulong t2 = (ROTR64(x[0], 28) ^ ROTR64(x[0], 34) ^ ROTR64(x[0], 39)) +
+			((x[0] & x[1]) | (x[2] & (x[0] | x[1])));
+
+		for (uint k = 7; k > 0; --k)
+			x[k] = x[k - 1];
+		x[4] += t1;
+		x[0] = t1 + t2;
+	}
+
+	for (uint k = 0; k < 8; ++k)
+		c->s[k] += x[k];
+}
+
+inline void sha512c_init(sha512c_ctx* c) {
+	for (uint k = 0; k < 8; ++k)
+		c->s[k] = sha512c_iv[k];
+	c->fill = 0;
+	c->total = 0;
+}
+
+void sha512c_add(sha512c_ctx* c, const uchar* p, uint n) {
+	c->total += n;
+	for (uint k = 0; k < n; ++k) {
+		c->buf[c->fill++] = p[k];
+		if (c->fill == 128) {
+			sha512c_block(c);
+			c->fill = 0;
+		}
+	}
+}
+
+void sha512c_finish(sha512c_ctx* c, uchar* out) {
+	const uint bits = c->total * 8;
+	c->buf[c->fill++] = 0x80;
+	if (c->fill > 112) {
+		while (c->fill < 128)
+			c->buf[c->fill++] = 0;
+		sha512c_block(c);
+		c->fill = 0;
+	}
+	while (c->fill < 128)
+		c->buf[c->fill++] = 0;
+	for (uint k = 0; k < 4; ++k)
+		c->buf[127 - k] = (uchar)(bits >> (k * 8));
+	sha512c_block(c);
+
+	for (uint k = 0; k < 64; ++k)
+		out[k] = (uchar)(c->s[k / 8] >> ((7 - k % 8) * 8));
+}
+
+inline int crypt_compare(__global const uchar* t, const uchar* digest, const uint size) {
+	int c = 0;
+	for (uint k = 0; k < size && !c; ++k)
+		c = (int)t[k] - (int)digest[k];
+	return c;
+}
+
+/*Appends every match against the group's sorted digests to 'hits', in
+the layout of check_targets(). Users who share a salt and a password
+share the digest, each of them gets a hit.*/
+void crypt_check(__global volatile uint* hits, const uchar* digest, const uint size, const uint index,
+	__global const uchar* digests, const uint targets, const uint capacity) {
+	uint lo = 0, hi = targets;
+	while (lo < hi) {
+		const uint mid = (lo + hi) / 2;
+		if (crypt_compare(digests + mid * size, digest, size) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < targets && !crypt_compare(digests + lo * size, digest, size); ++lo) {
+		const uint slot = atomic_inc(&hits[0]);
+		if (slot < capacity) {
+			hits[1 + slot * 2] = index;
+			hits[2 + slot * 2] = lo;
+		}
+	}
+}
+
+__kernel void smash_md5crypt(__global volatile uint* hits, __global const uchar* data, __global const uint* words, uint count,
+	__global const uchar* salt_data, uint salt_length, uint rounds, __global const uchar* digests, uint targets, uint capacity) {
+	const uint id = get_global_id(0);
+	if (id >= count)
+		return;
+
+	uchar key[MAX_KEY_LEN], salt[CRYPT_MAX_SALT], alt[16];
+	const uint length = load_word((char*)key, data, words[id]);
+	for (uint k = 0; k < salt_length; ++k)
+		salt[k] = salt_data[k];
+
+	md5c_ctx c;
+	md5c_init(&c);
+	md5c_add(&c, key, length);
+	md5c_add(&c, salt, salt_length);
+	md5c_add(&c, key, length);
+	md5c_finish(&c, alt);
+
+	const uchar prefix[3] = { '$', '1', '$' };
+	md5c_init(&c);
+	md5c_add(&c, key, length);
+	md5c_add(&c, prefix, 3);
+	md5c_add(&c, salt, salt_length);
+	for (uint n = length; n; n -= (n > 16) ? 16 : n)
+		md5c_add(&c, alt, (n > 16) ? 16 : n);
+
+	const uchar zero = 0;
+	for (uint n = length; n; n >>= 1)
+		md5c_add(&c, (n & 1) ? &zero : key, 1);
+	md5c_finish(&c, alt);
+
+	for (uint i = 0; i < rounds; ++i) {
+		md5c_init(&c);
+		if (i & 1) md5c_add(&c, key, length);
+		else md5c_add(&c, alt, 16);
+		if (i % 3) md5c_add(&c, salt, salt_length);
+		if (i % 7) md5c_add(&c, key, length);
+		if (i & 1) md5c_add(&c, alt, 16);
+		else md5c_add(&c, key, length);
+		md5c_finish(&c, alt);
+	}
+
+	crypt_check(hits, alt, 16, id, digests, targets, capacity);
+}
+
+__kernel void smash_sha512crypt(__global volatile uint* hits, __global const uchar* data, __global const uint* words, uint count,
+	__global const uchar* salt_data, uint salt_length, uint rounds, __global const uchar* digests, uint targets, uint capacity) {
+	const uint id = get_global_id(0);
+	if (id >= count)
+		return;
+
+	uchar key[MAX_KEY_LEN], salt[CRYPT_MAX_SALT], alt[64], p[MAX_KEY_LEN], s[CRYPT_MAX_SALT];
+	const uint length = load_word((char*)key, data, words[id]);
+	for (uint k = 0; k < salt_length; ++k)
+		salt[k] = salt_data[k];
+
+	sha512c_ctx c;
+	sha512c_init(&c);
+	sha512c_add(&c, key, length);
+	sha512c_add(&c, salt, salt_length);
+	sha512c_add(&c, key, length);
+	sha512c_finish(&c, alt);
+
+	sha512c_init(&c);
+	sha512c_add(&c, key, length);
+	sha512c_add(&c, salt, salt_length);
+	sha512c_add(&c, alt, length); // keys are shorter than a digest
+	for (uint n = length; n; n >>= 1) {
+		if (n & 1) sha512c_add(&c, alt, 64);
+		else sha512c_add(&c, key, length);
+	}
+	sha512c_finish(&c, alt);
+
+	// P and S sequences, as long as key and salt
+	uchar d[64];
+	sha512c_init(&c);
+	for (uint n = 0; n < length; ++n)
+		sha512c_add(&c, key, length);
+	sha512c_finish(&c, d);
+	for (uint n = 0; n < length; ++n)
+		p[n] = d[n];
+
+	sha512c_init(&c);
+	for (uint n = 0; n < 16u + alt[0]; ++n)
+		sha512c_add(&c, salt, salt_length);
+	sha512c_finish(&c, d);
+	for (uint n = 0; n < salt_length; ++n)
+		s[n] = d[n];
+
+	for (uint i = 0; i < rounds; ++i) {
+		sha512c_init(&c);
+		if (i & 1) sha512c_add(&c, p, length);
+		else sha512c_add(&c, alt, 64);
+		if (i % 3) sha512c_add(&c, s, salt_length);
+		if (i % 7) sha512c_add(&c, p, length);
+		if (i & 1) sha512c_add(&c, alt, 64);
+		else sha512c_add(&c, p, length);
+		sha512c_finish(&c, alt);
+	}
+
+	crypt_check(hits, alt, 64, id, digests, targets, capacity);
+}
@@ -0,0 +1,546 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "crypt.h"
+#include "hash_cpu.h"
+#include "mask.h"
+#include "log.h"
+
+#define MD5CRYPT_ROUNDS 1000
+#define SHA512CRYPT_ROUNDS 5000 // without rounds=
+#define SHA512CRYPT_MIN_ROUNDS 1000
+#define SHA512CRYPT_MAX_ROUNDS 999999999
+
+static const char* b64 = "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+/*Streaming MD5 and SHA-512 over the scalar lane cores, for the setup
+steps before the rounds and for the reference.*/
+struct md5_stream {
+	uint s[4];
+	uchar buf[64];
+	uint fill;
+	uint64 total;
+
+	md5_stream() : fill(0), total(0) { memcpy(s, MD5_IV, sizeof(s)); }
+
+	void block() {
+		uint m[16];
+		for (uint w = 0; w < 16; ++w)
+			m[w] = buf[w * 4] | (buf[w * 4 + 1] << 8) | (buf[w * 4 + 2] << 16) | ((uint)buf[w * 4 + 3] << 24);
+		md5_lanes_update<lanes_scalar>(m, s);
+	}
+
+	void add(const uchar* p, uint n) {
+		total += n;
+		while (n) {
+			uint take = (64 - fill < n) ? 64 - fill : n;
+			memcpy(buf + fill, p, take);
+			fill += take;
+			p += take;
+			n -= take;
+			if (fill == 64) {
+				block();
+				fill = 0;
+			}
+		}
+	}
+
+	void finish(uchar* out) {
+		uint64 bits = total * 8;
+		buf[fill++] = 0x80;
+		if (fill > 56) {
+			memset(buf + fill, 0, 64 - fill);
+			block();
+			fill = 0;
+		}
+		memset(buf + fill, 0, 56 - fill);
+		for (uint k = 0; k < 8; ++k)
+			buf[56 + k] = (uchar)(bits >> (k * 8));
+		block();
+
+		for (uint k = 0; k < 16; ++k)
+			out[k] = (uchar)(s[k / 4] >> ((k % 4) * 8));
+	}
+};
+
+struct sha512_stream {
+	uint64 s[8];
+	uchar buf[128];
+	uint fill;
+	uint64 total;
+
+	sha512_stream() : fill(0), total(0) { memcpy(s, SHA512_IV, sizeof(s)); }
+
+	void block() {
+		uint64 m[16];
+		for (uint w = 0; w < 16; ++w) {
+			m[w] = 0;
+			for (uint k = 0; k < 8; ++k)
+				m[w] = m[w] << 8 | buf[w * 8 + k];
+		}
+		sha512_lanes_update<lanes64_scalar>(m, s);
+	}
+
+	void add(const uchar* p, uint n) {
+		total += n;
+		while (n) {
+			uint take = (128 - fill < n) ? 128 - fill : n;
+			memcpy(buf + fill, p, take);
+			fill += take;
+			p += take;
+			n -= take;
+			if (fill == 128) {
+				block();
+				fill = 0;
+			}
+		}
+	}
+
+	void finish(uchar* out) {
+		uint64 bits = total * 8;
+		buf[fill++] = 0x80;
+		if (fill > 112) {
+			memset(buf + fill, 0, 128 - fill);
+			block();
+			fill = 0;
+		}
+		memset(buf + fill, 0, 120 - fill);
+		for (uint k = 0; k < 8; ++k)
+			buf[127 - k] = (uchar)(bits >> (k * 8));
+		block();
+
+		for (uint k = 0; k < 64; ++k)
+			out[k] = (uchar)(s[k / 8] >> ((7 - k % 8) * 8));
+	}
+};
+
+/*Everything before the rounds. md5crypt: the digest the rounds start
+from, the key and salt are used as they are. sha512crypt: the digest
+and the derived P and S sequences, as long as key and salt.*/
+static void md5crypt_setup(const uchar* key, uint length, const string& salt, uchar* digest) {
+	const uchar* s = (const uchar*)salt.data();
+	const uint slen = (uint)salt.size();
+	uchar alt[16];
+
+	md5_stream b;
+	b.add(key, length);
+	b.add(s, slen);
+	b.add(key, length);
+	b.finish(alt);
+
+	md5_stream a;
+	a.add(key, length);
+	a.add((const uchar*)"$1$", 3);
+	a.add(s, slen);
+	for (uint n = length; n; n -= (n > 16) ? 16 : n)
+		a.add(alt, (n > 16) ? 16 : n);
+
+	// odd as it is, the bits of the length pick a zero byte or the first key char
+	const uchar zero = 0;
+	for (uint n = length; n; n >>= 1)
+		a.add((n & 1) ? &zero : key, 1);
+	a.finish(digest);
+}
+
+static void sha512crypt_setup(const uchar* key, uint length, const string& salt, uchar* digest, uchar* p, uchar* s) {
+	const uchar* sp = (const uchar*)salt.data();
+	const uint slen = (uint)salt.size();
+	uchar alt[64], dp[64], ds[64];
+
+	sha512_stream b;
+	b.add(key, length);
+	b.add(sp, slen);
+	b.add(key, length);
+	b.finish(alt);
+
+	sha512_stream a;
+	a.add(key, length);
+	a.add(sp, slen);
+	for (uint n = length; n; n -= (n > 64) ? 64 : n)
+		a.add(alt, (n > 64) ? 64 : n);
+	for (uint n = length; n; n >>= 1) {
+		if (n & 1)
+			a.add(alt, 64);
+		else
+			a.add(key, length);
+	}
+	a.finish(digest);
+
+	sha512_stream kp;
+	for (uint n = 0; n < length; ++n)
+		kp.add(key, length);
+	kp.finish(dp);
+	for (uint n = 0; n < length; ++n)
+		p[n] = dp[n % 64];
+
+	sha512_stream ks;
+	for (uint n = 0; n < 16u + digest[0]; ++n)
+		ks.add(sp, slen);
+	ks.finish(ds);
+	for (uint n = 0; n < slen; ++n)
+		s[n] = ds[n % 64];
+}
+
+void crypt_digest(const crypt_group& group, const uchar* key, uint length, uchar* digest) {
+	const uchar* s = (const uchar*)group.salt.data();
+	const uint slen = (uint)group.salt.size();
+
+	if (group.type == CRYPT_MD5) {
+		md5crypt_setup(key, length, group.salt, digest);
+		for (uint i = 0; i < MD5CRYPT_ROUNDS; ++i) {
+			md5_stream r;
+			r.add((i & 1) ? key : digest, (i & 1) ? length : 16);
+			if (i % 3)
+				r.add(s, slen);
+			if (i % 7)
+				r.add(key, length);
+			r.add((i & 1) ? digest : key, (i & 1) ? 16 : length);
+			r.finish(digest);
+		}
+		return;
+	}
+
+	uchar p[MAX_KEY_LEN], ss[CRYPT_MAX_SALT];
+	sha512crypt_setup(key, length, group.salt, digest, p, ss);
+	for (uint i = 0; i < group.rounds; ++i) {
+		sha512_stream r;
+		r.add((i & 1) ? p : digest, (i & 1) ? length : 64);
+		if (i % 3)
+			r.add(ss, slen);
+		if (i % 7)
+			r.add(p, length);
+		r.add((i & 1) ? digest : p, (i & 1) ? 64 : length);
+		r.finish(digest);
+	}
+}
+
+/*Fills the CRYPT_PATTERNS round messages of 'width' lanes. 'p' and 's'
+hold the lanes' key and salt sequences back to back. Words are
+little-endian for MD5 (W = uint), big-endian for SHA-512 (W = uint64).*/
+template<class W>
+static void build_layout(uint width, uint dsize, const uchar* p, uint plen, const uchar* s, uint slen,
+	vector<W>& words, crypt_layout<W>& layout) {
+	const uint bytes = sizeof(W) * 16; // block size
+	const uint tail = sizeof(W) * 2; // length field
+	const bool big = sizeof(W) == 8;
+
+	layout.stride = CRYPT_MAX_BLOCKS * 16 * width;
+	words.assign(CRYPT_PATTERNS * layout.stride, 0);
+	layout.words = words.data();
+
+	for (uint i = 0; i < CRYPT_PATTERNS; ++i) {
+		const uint length = dsize + plen + ((i % 3) ? slen : 0) + ((i % 7) ? plen : 0);
+		layout.at[i] = (uchar)((i & 1) ? length - dsize : 0);
+		layout.blocks[i] = (uchar)((length + 1 + tail + bytes - 1) / bytes);
+
+		for (uint l = 0; l < width; ++l) {
+			uchar msg[CRYPT_MAX_BLOCKS * 128];
+			uint at = 0;
+			memset(msg, 0, sizeof(msg));
+
+			// same order as crypt_digest(), the digest stays zero
+			if (i & 1) { memcpy(msg, p + l * plen, plen); at += plen; }
+			else at += dsize;
+			if (i % 3) { memcpy(msg + at, s + l * slen, slen); at += slen; }
+			if (i % 7) { memcpy(msg + at, p + l * plen, plen); at += plen; }
+			if (!(i & 1)) memcpy(msg + at, p + l * plen, plen);
+
+			const uint end = layout.blocks[i] * bytes;
+			const uint64 bits = (uint64)length * 8;
+			msg[length] = 0x80;
+			for (uint k = 0; k < 8; ++k)
+				msg[big ? end - 1 - k : end - 8 + k] = (uchar)(bits >> (k * 8));
+
+			for (uint w = 0; w < end / sizeof(W); ++w) {
+				W x = 0;
+				for (uint k = 0; k < sizeof(W); ++k)
+					x |= (W)msg[w * sizeof(W) + k] << (big ? (sizeof(W) - 1 - k) * 8 : k * 8);
+				words[i * layout.stride + w * width + l] = x;
+			}
+		}
+	}
+}
+
+void crypt_hash(const crypt_group& group, const uchar* const* keys, const uint* lengths, uint count, uchar* digests) {
+	const crypt_core& core = crypt_select();
+	const bool md5 = group.type == CRYPT_MD5;
+	const uint width = md5 ? core.width : core.width64;
+	const uint slen = (uint)group.salt.size();
+
+	vector<uchar> p, s, start;
+	vector<uint> words32, state32;
+	vector<uint64> words64, state64;
+	crypt_layout<uint> layout32;
+	crypt_layout<uint64> layout64;
+
+	for (uint first = 0; first < count;) {
+		// a run of keys of one length, the lanes past its end repeat its last key
+		const uint plen = lengths[first];
+		uint n = 1;
+		while (n < width && first + n < count && lengths[first + n] == plen)
+			++n;
+
+		p.resize(width * plen + 1);
+		s.resize(width * slen + 1);
+		start.resize(width * group.digest_size);
+		for (uint l = 0; l < width; ++l) {
+			const uint k = first + (l < n ? l : n - 1);
+			memcpy(&p[l * plen], keys[k], plen);
+			if (md5) {
+				memcpy(&s[l * slen], group.salt.data(), slen);
+				md5crypt_setup(keys[k], plen, group.salt, &start[l * 16]);
+			}
+			else
+				sha512crypt_setup(keys[k], plen, group.salt, &start[l * 64], &p[l * plen], &s[l * slen]);
+		}
+
+		// rounds in the lanes, digests as state words
+		if (md5) {
+			build_layout(width, 16, p.data(), plen, s.data(), slen, words32, layout32);
+			state32.resize(4 * width);
+			for (uint j = 0; j < 4; ++j)
+				for (uint l = 0; l < width; ++l) {
+					const uchar* d = &start[l * 16 + j * 4];
+					state32[j * width + l] = d[0] | (d[1] << 8) | (d[2] << 16) | ((uint)d[3] << 24);
+				}
+
+			core.md5(layout32, state32.data(), MD5CRYPT_ROUNDS);
+
+			for (uint l = 0; l < n; ++l)
+				for (uint k = 0; k < 16; ++k)
+					digests[(first + l) * 16 + k] = (uchar)(state32[(k / 4) * width + l] >> ((k % 4) * 8));
+		}
+		else {
+			build_layout(width, 64, p.data(), plen, s.data(), slen, words64, layout64);
+			state64.resize(8 * width);
+			for (uint j = 0; j < 8; ++j)
+				for (uint l = 0; l < width; ++l) {
+					uint64 x = 0;
+					for (uint k = 0; k < 8; ++k)
+						x = x << 8 | start[l * 64 + j * 8 + k];
+					state64[j * width + l] = x;
+				}
+
+			core.sha512(layout64, state64.data(), group.rounds);
+
+			for (uint l = 0; l < n; ++l)
+				for (uint k = 0; k < 64; ++k)
+					digests[(first + l) * 64 + k] = (uchar)(state64[(k / 8) * width + l] >> ((7 - k % 8) * 8));
+		}
+
+		first += n;
+	}
+}
+
+void md5crypt_scalar(const crypt_layout<uint>& layout, uint* s, uint rounds) {
+	md5crypt_lanes<lanes_scalar>(layout, s, rounds);
+}
+
+void sha512crypt_scalar(const crypt_layout<uint64>& layout, uint64* s, uint rounds) {
+	sha512crypt_lanes<lanes64_scalar>(layout, s, rounds);
+}
+
+const crypt_core& crypt_select() {
+	static const crypt_core cores[] = {
+		{ "scalar", 1, md5crypt_scalar, 1, sha512crypt_scalar },
+		{ "sse2", 4, md5crypt_sse2, 2, sha512crypt_sse2 },
+		{ "avx2", 8, md5crypt_avx2, 4, sha512crypt_avx2 },
+		{ "avx512", 16, md5crypt_avx512, 8, sha512crypt_avx512 }
+	};
+
+	const uint width = hash_select(hash_get(HASH_MD5)).width;
+	for (uint k = 0; k < 4; ++k)
+		if (cores[k].width == width)
+			return cores[k];
+	return cores[0];
+}
+
+
+uint crypt_group::find(const uchar* digest, uint& first) const {
+	// lower bound over the sorted digests, then the run of equal ones
+	uint lo = 0, hi = (uint)entries.size();
+	while (lo < hi) {
+		uint mid = (lo + hi) / 2;
+		if (memcmp(&digests[mid * digest_size], digest, digest_size) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	first = lo;
+	while (hi < entries.size() && !memcmp(&digests[hi * digest_size], digest, digest_size))
+		++hi;
+	return hi - lo;
+}
+
+/*Crypt base64 stores the digest in 3-byte groups, permuted. 'order'
+lists the bytes of each group, high byte first, as the formats
+write them; one byte is left over and takes two chars.*/
+static bool decode(const string& text, uint size, uchar* digest) {
+	uint order[22 * 3];
+	uint groups, alone;
+	if (size == 16) {
+		const uint md5[] = { 0, 6, 12, 1, 7, 13, 2, 8, 14, 3, 9, 15, 4, 10, 5 };
+		memcpy(order, md5, sizeof(md5));
+		groups = 5;
+		alone = 11;
+	}
+	else {
+		for (uint k = 0; k < 21; ++k) {
+			const uint a = k, b = k + 21, c = k + 42;
+			const uint rot[3][3] = { { a, b, c }, { b, c, a }, { c, a, b } };
+			memcpy(&order[k * 3], rot[k % 3], sizeof(rot[0]));
+		}
+		groups = 21;
+		alone = 63;
+	}
+
+	if (text.size() != groups * 4 + 2)
+		return false;
+
+	uint value[22 * 4];
+	for (uint k = 0; k < text.size(); ++k) {
+		const char* c = strchr(b64, text[k]);
+		if (!c || !*c)
+			return false;
+		value[k] = (uint)(c - b64);
+	}
+
+	for (uint g = 0; g < groups; ++g) {
+		const uint* v = &value[g * 4];
+		uint w = v[0] | (v[1] << 6) | (v[2] << 12) | (v[3] << 18);
+		digest[order[g * 3]] = (uchar)(w >> 16);
+		digest[order[g * 3 + 1]] = (uchar)(w >> 8);
+		digest[order[g * 3 + 2]] = (uchar)w;
+	}
+
+	uint w = value[groups * 4] | (value[groups * 4 + 1] << 6);
+	if (w > 0xff)
+		return false;
+	digest[alone] = (uchar)w;
+	return true;
+}
+
+bool crypt_set::add(const string& hash, const string& user) {
+	uint type, rounds, size, max_salt;
+	size_t at;
+
+	if (!hash.compare(0, 3, "$1$")) {
+		type = CRYPT_MD5;
+		rounds = MD5CRYPT_ROUNDS;
+		size = 16;
+		max_salt = 8;
+		at = 3;
+	}
+	else if (!hash.compare(0, 3, "$6$")) {
+		type = CRYPT_SHA512;
+		rounds = SHA512CRYPT_ROUNDS;
+		size = 64;
+		max_salt = CRYPT_MAX_SALT;
+		at = 3;
+
+		if (!hash.compare(at, 7, "rounds=")) {
+			size_t end = hash.find('$', at);
+			if (end == string::npos)
+				return false;
+
+			uint64 n = strtoull(hash.c_str() + at + 7, NULL, 10);
+			rounds = (uint)((n < SHA512CRYPT_MIN_ROUNDS) ? SHA512CRYPT_MIN_ROUNDS : (n > SHA512CRYPT_MAX_ROUNDS ? SHA512CRYPT_MAX_ROUNDS : n));
+			at = end + 1;
+		}
+	}
+	else
+		return false;
+
+	size_t end = hash.find('$', at);
+	if (end == string::npos)
+		return false;
+
+	// longer salts are cut, as crypt() does
+	string salt = hash.substr(at, end - at);
+	if (salt.size() > max_salt)
+		salt.resize(max_salt);
+
+	uchar digest[CRYPT_MAX_DIGEST];
+	if (!decode(hash.substr(end + 1), size, digest))
+		return false;
+
+	uint k = 0;
+	while (k < groups.size() && (groups[k].type != type || groups[k].salt != salt || groups[k].rounds != rounds))
+		++k;
+
+	if (k == groups.size()) {
+		crypt_group group;
+		group.type = type;
+		group.salt = salt;
+		group.rounds = rounds;
+		group.digest_size = size;
+		groups.push_back(group);
+	}
+
+	groups[k].digests.insert(groups[k].digests.end(), digest, digest + size);
+	groups[k].entries.push_back((uint)hashes.size());
+	hashes.push_back(hash);
+	users.push_back(user);
+	return true;
+}
+
+bool crypt_set::load(const string& path) {
+	ifstream file(path.c_str());
+	if (!file)
+		return false;
+
+	string line;
+	while (getline(file, line)) {
+		if (!line.empty() && line[line.size() - 1] == '\r')
+			line.resize(line.size() - 1);
+
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		// shadow lines carry the hash in the second field
+		string user, hash = line;
+		size_t colon = line.find(':');
+		if (colon != string::npos) {
+			user = line.substr(0, colon);
+			size_t end = line.find(':', colon + 1);
+			hash = line.substr(colon + 1, end == string::npos ? string::npos : end - colon - 1);
+		}
+
+		if (!add(hash, user))
+			++skipped;
+	}
+
+	LOG_LINE("Loaded crypt hashes from " << path << ". COUNT = " << get_entries() << ". SALTS = " << size() << ". SKIPPED = " << skipped);
+
+	return true;
+}
+
+void crypt_set::build() {
+	for (uint g = 0; g < groups.size(); ++g) {
+		crypt_group& group = groups[g];
+		const uint size = group.digest_size;
+
+		vector<uint> order(group.entries.size());
+		for (uint k = 0; k < order.size(); ++k)
+			order[k] = k;
+		sort(order.begin(), order.end(), [&](uint a, uint b) {
+			return memcmp(&group.digests[a * size], &group.digests[b * size], size) < 0;
+		});
+
+		vector<uchar> digests(group.digests.size());
+		vector<uint> entries(order.size());
+		for (uint k = 0; k < order.size(); ++k) {
+			memcpy(&digests[k * size], &group.digests[order[k] * size], size);
+			entries[k] = group.entries[order[k]];
+		}
+		group.digests.swap(digests);
+		group.entries.swap(entries);
+	}
+}
+
+crypt_set::crypt_set() {
+	skipped = 0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "crypt_lanes.h"
+#include "types.h"
+
+using namespace std;
+
+#define CRYPT_MD5 1 // $1$, md5crypt
+#define CRYPT_SHA512 6 // $6$, sha512crypt
+#define CRYPT_MAX_SALT 16
+#define CRYPT_MAX_DIGEST 64
+#define CRYPT_GRAIN 64 // words per stolen chunk, each one costs thousands of hashes
+
+/*The targets sharing one format, salt and round count. Their keys go
+through exactly the same rounds, so one pass over the candidates
+checks all of them.*/
+struct crypt_group {
+	uint type;
+	string salt;
+	uint rounds;
+	uint digest_size;
+	vector<uchar> digests; // digest_size bytes each, sorted by build()
+	vector<uint> entries; // crypt_set entry of each digest
+
+	/*Digests [first, first + count) are 'digest', returns the count.
+	Users who share a salt and a password share the digest.*/
+	uint find(const uchar* digest, uint& first) const;
+};
+
+/*Crypt strings ($1$ and $6$, with or without rounds=) read from a
+shadow file or one per line, grouped by salt. Entries keep the user
+and the original string for reporting.*/
+class crypt_set {
+public:
+	/*Adds one crypt string, returns false if the format is not
+	supported or it is malformed.*/
+	bool add(const string& hash, const string& user = string());
+
+	/*Adds every entry of a shadow file ("user:hash:..."), or of a
+	plain list of hashes. Locked and empty passwords are skipped.
+	Returns false if the file can not be read.*/
+	bool load(const string& path);
+
+	// sorts the digests of every group, call once after the last add()
+	void build();
+
+	uint size() const { return (uint)groups.size(); }
+	const crypt_group& group(uint k) const { return groups[k]; }
+
+	uint get_entries() const { return (uint)hashes.size(); }
+	uint get_skipped() const { return skipped; }
+	const string& get_user(uint k) const { return users[k]; }
+	const string& get_hash(uint k) const { return hashes[k]; }
+
+	crypt_set();
+private:
+	vector<crypt_group> groups;
+	vector<string> hashes;
+	vector<string> users;
+	uint skipped;
+};
+
+// scalar reference, used to confirm device hits
+void crypt_digest(const crypt_group& group, const uchar* key, uint length, uchar* digest);
+
+/*Hashes 'count' keys for 'group', digest k to digests + k * digest_size.
+Keys of equal length share the SIMD lanes of the widest core the CPU
+has, so callers should pass them sorted by length.*/
+void crypt_hash(const crypt_group& group, const uchar* const* keys, const uint* lengths, uint count, uchar* digests);
+
+// round loops per instruction set, see crypt_lanes.h
+struct crypt_core {
+	const char* name;
+	uint width; // md5crypt lanes
+	void (*md5)(const crypt_layout<uint>& layout, uint* s, uint rounds);
+	uint width64; // sha512crypt lanes
+	void (*sha512)(const crypt_layout<uint64>& layout, uint64* s, uint rounds);
+};
+
+void md5crypt_scalar(const crypt_layout<uint>& layout, uint* s, uint rounds);
+void md5crypt_sse2(const crypt_layout<uint>& layout, uint* s, uint rounds);
+void md5crypt_avx2(const crypt_layout<uint>& layout, uint* s, uint rounds);
+void md5crypt_avx512(const crypt_layout<uint>& layout, uint* s, uint rounds);
+
+void sha512crypt_scalar(const crypt_layout<uint64>& layout, uint64* s, uint rounds);
+void sha512crypt_sse2(const crypt_layout<uint64>& layout, uint64* s, uint rounds);
+void sha512crypt_avx2(const crypt_layout<uint64>& layout, uint64* s, uint rounds);
+void sha512crypt_avx512(const crypt_layout<uint64>& layout, uint64* s, uint rounds);
+
+// same instruction set as hash_select()
+const crypt_core& crypt_select();
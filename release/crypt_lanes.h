@@ -0,0 +1,152 @@
+#pragma once
+
+#include "hash_lanes.h"
+
+/*Round loops of the iterated crypt formats over the lane types of
+simd.h. Same rule as hash_lanes.h: included by the ISA specific units,
+so no standard C++ headers here.*/
+
+#define CRYPT_PATTERNS 42 // round i hashes the same message shape as round i % lcm(2, 3, 7)
+#define CRYPT_MAX_BLOCKS 3 // of the longest round message, 55 char keys
+
+/*Message shapes of one batch of lanes. The lanes share key and salt
+length, so every round lays out its message the same way in all of
+them: pattern p holds the blocks of rounds i % CRYPT_PATTERNS == p
+with key, salt and padding in place and the previous digest left zero,
+to be filled in at byte 'at'. Words are in the hash's own byte order.*/
+template<class W>
+struct crypt_layout {
+	const W* words; // CRYPT_PATTERNS * stride
+	uint stride; // CRYPT_MAX_BLOCKS * 16 * width
+	uchar blocks[CRYPT_PATTERNS];
+	uchar at[CRYPT_PATTERNS];
+};
+
+static const uint MD5_IV[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+
+/*md5crypt rounds: 's' holds the digest of every lane as little-endian
+state words, 4 * width, and is replaced by the digest after 'rounds'.*/
+template<class V>
+SIMD_INLINE void md5crypt_lanes(const crypt_layout<uint>& layout, uint* s, uint rounds) {
+	const uint width = V::width;
+	uint m[CRYPT_MAX_BLOCKS * 16 * V::width];
+
+	for (uint i = 0; i < rounds; ++i) {
+		const uint p = i % CRYPT_PATTERNS;
+		const uint* t = &layout.words[p * layout.stride];
+		for (uint w = 0; w < layout.blocks[p] * 16 * width; ++w)
+			m[w] = t[w];
+
+		// the digest goes in at the same byte in every lane, whole words are shifted into place
+		const uint first = layout.at[p] / 4, shift = (layout.at[p] % 4) * 8;
+		for (uint j = 0; j < 4; ++j)
+			for (uint l = 0; l < width; ++l) {
+				const uint x = s[j * width + l];
+				m[(first + j) * width + l] |= x << shift;
+				if (shift)
+					m[(first + j + 1) * width + l] |= x >> (32 - shift);
+			}
+
+		for (uint j = 0; j < 4; ++j)
+			V::store(&s[j * width], V::set1(MD5_IV[j]));
+		for (uint b = 0; b < layout.blocks[p]; ++b)
+			md5_lanes_update<V>(&m[b * 16 * width], s);
+	}
+}
+
+static const uint64 SHA512_K[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+static const uint64 SHA512_IV[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+/*Adds one 128-byte block per lane to the running SHA-512 states 's'
+(8 * width). Unlike the cores of hash_lanes.h the message words are
+taken as they are: big-endian values, nothing is swapped.*/
+template<class V>
+SIMD_INLINE void sha512_lanes_update(const uint64* m, uint64* s) {
+	typedef typename V::vec vec;
+	vec w[16], x[8];
+
+	for (uint k = 0; k < 16; ++k)
+		w[k] = V::load(&m[k * V::width]);
+	for (uint k = 0; k < 8; ++k)
+		x[k] = V::load(&s[k * V::width]);
+
+	for (uint t = 0; t < 80; ++t) {
+		if (t >= 16) {
+			vec a = w[(t + 1) & 15], b = w[(t + 14) & 15];
+			vec s0 = V::xor_(V::xor_(V::template rotr<1>(a), V::template rotr<8>(a)), V::template shr<7>(a));
+			vec s1 = V::xor_(V::xor_(V::template rotr<19>(b), V::template rotr<61>(b)), V::template shr<6>(b));
+			w[t & 15] = V::add(V::add(w[t & 15], s0), V::add(w[(t + 9) & 15], s1));
+		}
+
+		vec S1 = V::xor_(V::xor_(V::template rotr<14>(x[4]), V::template rotr<18>(x[4])), V::template rotr<41>(x[4]));
+		vec S0 = V::xor_(V::xor_(V::template rotr<28>(x[0]), V::template rotr<34>(x[0])), V::template rotr<39>(x[0]));
+		vec t1 = V::add(V::add(x[7], S1), V::add(V::ch(x[4], x[5], x[6]), V::add(V::set1(SHA512_K[t]), w[t & 15])));
+		vec t2 = V::add(S0, V::maj(x[0], x[1], x[2]));
+
+		x[7] = x[6];
+		x[6] = x[5];
+		x[5] = x[4];
+		x[4] = V::add(x[3], t1);
+		x[3] = x[2];
+		x[2] = x[1];
+		x[1] = x[0];
+		x[0] = V::add(t1, t2);
+	}
+
+	for (uint k = 0; k < 8; ++k)
+		V::store(&s[k * V::width], V::add(x[k], V::load(&s[k * V::width])));
+}
+
+/*sha512crypt rounds, same as md5crypt_lanes: 's' holds the digest of
+every lane as big-endian state words, 8 * width.*/
+template<class V>
+SIMD_INLINE void sha512crypt_lanes(const crypt_layout<uint64>& layout, uint64* s, uint rounds) {
+	const uint width = V::width;
+	uint64 m[CRYPT_MAX_BLOCKS * 16 * V::width];
+
+	for (uint i = 0; i < rounds; ++i) {
+		const uint p = i % CRYPT_PATTERNS;
+		const uint64* t = &layout.words[p * layout.stride];
+		for (uint w = 0; w < layout.blocks[p] * 16 * width; ++w)
+			m[w] = t[w];
+
+		const uint first = layout.at[p] / 8, shift = (layout.at[p] % 8) * 8;
+		for (uint j = 0; j < 8; ++j)
+			for (uint l = 0; l < width; ++l) {
+				const uint64 x = s[j * width + l];
+				m[(first + j) * width + l] |= x >> shift;
+				if (shift)
+					m[(first + j + 1) * width + l] |= x << (64 - shift);
+			}
+
+		for (uint j = 0; j < 8; ++j)
+			V::store(&s[j * width], V::set1(SHA512_IV[j]));
+		for (uint b = 0; b < layout.blocks[p]; ++b)
+			sha512_lanes_update<V>(&m[b * 16 * width], s);
+	}
+}
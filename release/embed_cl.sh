@@ -0,0 +1,28 @@
+#!/bin/sh
+
+# Embeds the CL sources into cl_source.cpp, so the binary does not need
+# them next to it at run time. Run from release/ after editing a .cl file.
+
+out=cl_source.cpp
+
+{
+	echo "// generated by embed_cl.sh from the .cl files, do not edit"
+	echo
+	echo "#include <cstring>"
+	echo "#include \"cl_source.h\""
+	echo
+	echo "static const struct { const char* name; const char* code; } sources[] = {"
+	for f in *.cl; do
+		echo "	{ \"$f\","
+		sed -e 's/\\/\\\\/g' -e 's/"/\\"/g' -e 's/^/		"/' -e 's/$/\\n"/' "$f"
+		echo "	},"
+	done
+	echo "};"
+	echo
+	echo "const char* cl_source(const char* name) {"
+	echo "	for (unsigned k = 0; k < sizeof(sources) / sizeof(sources[0]); ++k)"
+	echo "		if (!strcmp(name, sources[k].name))"
+	echo "			return sources[k].code;"
+	echo "	return NULL;"
+	echo "}"
+} > $out
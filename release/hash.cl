@@ -0,0 +1,49 @@
+/*Definitions shared by every hash file and smash.cl, built first.
+KEY_SIZE, MAX_KEY_LEN and KEYS_PER_ITEM come from the host
+as -D options (smasher::build_options()), so types.h is the only
+place they are set.*/
+
+#pragma OPENCL EXTENSION cl_khr_byte_addressable_store : enable
+
+// byte swap, for the big-endian hashes
+#define swap_bytes(x) ((rotate((uint)(x), 8u) & 0x00ff00ffu) | (rotate((uint)(x), 24u) & 0xff00ff00u))
+
+/*Counter keys are hashed as uintv, VECTOR_WIDTH lanes of one key
+each. The host builds a vector program with -D VECTOR_WIDTH=n on
+devices that prefer uintn (CPU runtimes mostly), where explicit vectors
+beat the implicit vectorizer; everywhere else a uintv is a uint.*/
+#ifndef VECTOR_WIDTH
+#define VECTOR_WIDTH 1
+#endif
+
+#if VECTOR_WIDTH > 1
+#define VECTOR_(name, n) name##n
+#define VECTOR__(name, n) VECTOR_(name, n)
+#define VECTOR(name) VECTOR__(name, VECTOR_WIDTH)
+typedef VECTOR(uint) uintv;
+typedef VECTOR(int) intv; // comparisons of uintv, -1 in matching lanes
+#define any_lane(m) any(m)
+#define store_lanes(v, p) VECTOR(vstore)((v), 0, (p))
+#define load_lanes(p) VECTOR(vload)(0, (p))
+#else
+typedef uint uintv;
+typedef int intv;
+#define any_lane(m) (m)
+#define store_lanes(v, p) (*(p) = (v))
+#define load_lanes(p) (*(p))
+#endif
+
+// swap_bytes() for uintv, rotate() takes no scalar count with vectors
+#define swap_bytesv(x) ((rotate((x), (uintv)8) & 0x00ff00ffu) | (rotate((x), (uintv)24) & 0xff00ff00u))
+
+/*Packs a message of at most MAX_KEY_LEN bytes into one block of
+little-endian words: the message, 0x80, then zeros. The caller adds
+the bit length where its hash expects it.*/
+inline void pack_block(uint* m, const char* msg, const uint len) {
+	for (uint w = 0; w < 16; ++w)
+		m[w] = 0;
+
+	for (uint k = 0; k < len; ++k)
+		m[k >> 2] |= (uint)(uchar)msg[k] << ((k & 3) * 8);
+	m[len >> 2] |= 0x80u << ((len & 3) * 8);
+}
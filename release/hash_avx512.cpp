@@ -0,0 +1,49 @@
+// compiled for AVX512 regardless of the global flags, see simd.h
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512f")
+#endif
+
+#define SIMD_AVX512
+#include "crypt_lanes.h"
+
+void md5_avx512(const uint* m, uint* h, uint batches) {
+#ifdef SIMD_X86
+	md5_lanes_run<lanes_avx512>(m, h, batches);
+#endif
+}
+
+void md4_avx512(const uint* m, uint* h, uint batches) {
+#ifdef SIMD_X86
+	md4_lanes_run<lanes_avx512>(m, h, batches);
+#endif
+}
+
+void sha1_avx512(const uint* m, uint* h, uint batches) {
+#ifdef SIMD_X86
+	sha1_lanes_run<lanes_avx512>(m, h, batches);
+#endif
+}
+
+void sha256_avx512(const uint* m, uint* h, uint batches) {
+#ifdef SIMD_X86
+	sha256_lanes_run<lanes_avx512>(m, h, batches);
+#endif
+}
+
+void md5crypt_avx512(const crypt_layout<uint>& layout, uint* s, uint rounds) {
+#ifdef SIMD_X86
+	md5crypt_lanes<lanes_avx512>(layout, s, rounds);
+#endif
+}
+
+void sha512crypt_avx512(const crypt_layout<uint64>& layout, uint64* s, uint rounds) {
+#ifdef SIMD_X86
+	sha512crypt_lanes<lanes64_avx512>(layout, s, rounds);
+#endif
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
@@ -0,0 +1,181 @@
+#include <cstring>
+#include "hash_lanes.h"
+#include "hash_cpu.h"
+#include "mask.h"
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static const hash_algo algos[] = {
+	{ HASH_MD5, "md5", "md5.cl", "", 16, false, false, md5_reverse },
+	{ HASH_MD4, "md4", "md4.cl", "", 16, false, false, NULL },
+	{ HASH_NTLM, "ntlm", "md4.cl", "-D UTF16", 16, false, true, NULL },
+	{ HASH_SHA1, "sha1", "sha1.cl", "", 20, true, false, NULL },
+	{ HASH_SHA256, "sha256", "sha256.cl", "", 32, true, false, NULL }
+};
+
+const hash_algo& hash_get(hash_type type) {
+	return algos[type];
+}
+
+const hash_algo* hash_find(const string& name) {
+	for (uint k = 0; k < sizeof(algos) / sizeof(algos[0]); ++k)
+		if (name == algos[k].name)
+			return &algos[k];
+	return NULL;
+}
+
+static inline uint rotr(uint x, uint s) {
+	return (x >> s) | (x << (32 - s));
+}
+
+void md5_reverse(const uchar* digest, uint* target) {
+	uint t[4];
+	for (uint w = 0; w < 4; ++w)
+		t[w] = digest[w * 4] | (digest[w * 4 + 1] << 8) | (digest[w * 4 + 2] << 16) | ((uint)digest[w * 4 + 3] << 24);
+
+	// state after step 63 without the final additions
+	const uint a = t[0] - 0x67452301, b = t[1] - 0xefcdab89, c = t[2] - 0x98badcfe, d = t[3] - 0x10325476;
+
+	// step 63, b = c + rotl(b + I(c, d, a) + m[9] + K, 21), and m[9] is zero for counter keys
+	const uint b59 = rotr(b - c, 21) - (d ^ (c | ~a)) - 0xeb86d391;
+
+	// step 62 adds m[2], which varies, so the kernel adds it to its own c
+	const uint c58 = rotr(c - d, 15) - (a ^ (d | ~b59)) - 0x2ad7d2bb;
+
+	target[0] = a;
+	target[1] = b59;
+	target[2] = c58;
+	target[3] = d;
+}
+
+void md5_scalar(const uint* m, uint* h, uint batches) {
+	md5_lanes_run<lanes_scalar>(m, h, batches);
+}
+
+void md4_scalar(const uint* m, uint* h, uint batches) {
+	md4_lanes_run<lanes_scalar>(m, h, batches);
+}
+
+void sha1_scalar(const uint* m, uint* h, uint batches) {
+	sha1_lanes_run<lanes_scalar>(m, h, batches);
+}
+
+void sha256_scalar(const uint* m, uint* h, uint batches) {
+	sha256_lanes_run<lanes_scalar>(m, h, batches);
+}
+
+/*CPU feature detection*/
+
+#ifdef SIMD_X86
+enum cpu_level { LEVEL_SSE2, LEVEL_AVX2, LEVEL_AVX512 };
+
+static cpu_level detect_level() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx)
+		return LEVEL_SSE2;
+
+	unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+
+	// the OS has to save the wider registers, not just the CPU support them
+	if ((info[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6)
+		return LEVEL_AVX512;
+	if ((info[1] & (1 << 5)) && (xcr0 & 0x6) == 0x6)
+		return LEVEL_AVX2;
+	return LEVEL_SSE2;
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return LEVEL_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return LEVEL_AVX2;
+	return LEVEL_SSE2;
+#endif
+}
+#endif
+
+// the cores of every hash, scalar first, then by instruction set
+#define HASH_CORES(a) { \
+	{ "scalar", 1, a##_scalar }, { "sse2", 4, a##_sse2 }, { "avx2", 8, a##_avx2 }, { "avx512", 16, a##_avx512 } }
+
+const hash_core& hash_select(const hash_algo& algo) {
+	static const hash_core cores[][4] = { HASH_CORES(md5), HASH_CORES(md4), HASH_CORES(sha1), HASH_CORES(sha256) };
+
+	// NTLM is MD4 of the widened key
+	const hash_core* row;
+	switch (algo.type) {
+	case HASH_MD4: case HASH_NTLM: row = cores[1]; break;
+	case HASH_SHA1: row = cores[2]; break;
+	case HASH_SHA256: row = cores[3]; break;
+	default: row = cores[0];
+	}
+
+#ifdef SIMD_X86
+	switch (detect_level()) {
+	case LEVEL_AVX512: return row[3];
+	case LEVEL_AVX2: return row[2];
+	default: return row[1];
+	}
+#else
+	return row[0];
+#endif
+}
+
+void hash_length(const hash_algo& algo, uint bytes, uint* m, uint width, uint lane) {
+	uint bits = bytes * 8;
+
+	// a 64-bit length; short keys only ever fill its low word
+	if (algo.big_endian) {
+		m[14 * width + lane] = 0;
+		m[15 * width + lane] = (bits >> 24) | ((bits >> 8) & 0xff00) | ((bits << 8) & 0xff0000) | (bits << 24);
+	}
+	else {
+		m[14 * width + lane] = bits;
+		m[15 * width + lane] = 0;
+	}
+}
+
+bool hash_digest(const hash_algo& algo, const uchar* msg, uint len, uchar* digest) {
+	uchar block[64];
+	uint m[16], h[8];
+
+	// like widen() in cpu_smasher.cpp, the key and its 0x80 have to fit before the length
+	if ((algo.utf16 ? len * 2 : len) > MAX_KEY_LEN) {
+		memset(digest, 0, algo.digest_size);
+		return false;
+	}
+
+	// pad the same way the kernel does: 0x80, zeros, then the bit length
+	memset(block, 0, sizeof(block));
+	if (algo.utf16) {
+		for (uint k = 0; k < len; ++k)
+			block[k * 2] = msg[k];
+		len *= 2;
+	}
+	else
+		memcpy(block, msg, len);
+	block[len] = 0x80;
+
+	for (uint w = 0; w < 16; ++w)
+		m[w] = block[w * 4] | (block[w * 4 + 1] << 8) | (block[w * 4 + 2] << 16) | ((uint)block[w * 4 + 3] << 24);
+	hash_length(algo, len, m, 1, 0);
+
+	switch (algo.type) {
+	case HASH_MD4: case HASH_NTLM: md4_scalar(m, h, 1); break;
+	case HASH_SHA1: sha1_scalar(m, h, 1); break;
+	case HASH_SHA256: sha256_scalar(m, h, 1); break;
+	default: md5_scalar(m, h, 1);
+	}
+
+	// the cores already return digest byte order as little-endian words
+	for (uint w = 0; w < algo.digest_size / 4; ++w)
+		for (uint k = 0; k < 4; ++k)
+			digest[w * 4 + k] = (uchar)(h[w] >> (k * 8));
+	return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include "types.h"
+
+using namespace std;
+
+enum hash_type { HASH_MD5, HASH_MD4, HASH_NTLM, HASH_SHA1, HASH_SHA256 };
+
+/*A hash the engines can search. The device side is 'source', a CL file
+defining hash() that is built between hash.cl and smash.cl with
+'options'; the CPU side is a set of lane cores from hash_lanes.h.*/
+struct hash_algo {
+	hash_type type;
+	const char* name;
+	const char* source;
+	const char* options;
+	uint digest_size; // bytes
+	bool big_endian; // bit length goes in the last block word, big-endian
+	bool utf16; // keys are widened to UTF-16LE before hashing
+
+	/*Turns a single target into what the hash file's COUNTER_SINGLE
+	kernel compares against, NULL if it has none.*/
+	void (*reverse)(const uchar* digest, uint* target);
+};
+
+const hash_algo& hash_get(hash_type type);
+
+// by name ("md5", "md4", "ntlm", "sha1", "sha256"), NULL if unknown
+const hash_algo* hash_find(const string& name);
+
+/*Native cores of one hash. Each one hashes 'batches' groups of 'width'
+padded blocks laid out as in hash_lanes.h, writing digest_size / 4
+words per lane in digest byte order.*/
+struct hash_core {
+	const char* name; // instruction set
+	uint width;
+	void (*run)(const uint* m, uint* h, uint batches);
+};
+
+void md5_scalar(const uint* m, uint* h, uint batches);
+void md5_sse2(const uint* m, uint* h, uint batches);
+void md5_avx2(const uint* m, uint* h, uint batches);
+void md5_avx512(const uint* m, uint* h, uint batches);
+
+void md4_scalar(const uint* m, uint* h, uint batches);
+void md4_sse2(const uint* m, uint* h, uint batches);
+void md4_avx2(const uint* m, uint* h, uint batches);
+void md4_avx512(const uint* m, uint* h, uint batches);
+
+void sha1_scalar(const uint* m, uint* h, uint batches);
+void sha1_sse2(const uint* m, uint* h, uint batches);
+void sha1_avx2(const uint* m, uint* h, uint batches);
+void sha1_avx512(const uint* m, uint* h, uint batches);
+
+void sha256_scalar(const uint* m, uint* h, uint batches);
+void sha256_sse2(const uint* m, uint* h, uint batches);
+void sha256_avx2(const uint* m, uint* h, uint batches);
+void sha256_avx512(const uint* m, uint* h, uint batches);
+
+/*MD5 digest with steps 62 and 63 undone, for the counter keys of the
+single-target kernel: the state after step 61 with m[2] left out of c.*/
+void md5_reverse(const uchar* digest, uint* target);
+
+// widest core of 'algo' the running CPU supports
+const hash_core& hash_select(const hash_algo& algo);
+
+/*Sets the bit length of a 'bytes' long message in lane 'lane' of a
+block, where 'algo' expects it.*/
+void hash_length(const hash_algo& algo, uint bytes, uint* m, uint width, uint lane);
+
+/*Scalar hash of a short key, used to confirm hits on the host. False,
+with a zeroed digest, if the key is over MAX_KEY_LEN bytes once
+widened and does not fit a block.*/
+bool hash_digest(const hash_algo& algo, const uchar* msg, uint len, uchar* digest);
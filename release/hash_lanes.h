@@ -0,0 +1,281 @@
+#pragma once
+
+#include "simd.h"
+
+/*The compression functions written once over a lane type from simd.h,
+so the same code hashes 1, 4, 8 or 16 keys per instruction. Blocks are kept
+"structure of arrays": word w of lane l is at m[w * V::width + l]. Blocks
+hold the message bytes as little-endian words; the big-endian hashes swap
+them as they load and swap their state back when they store, so digests
+always come out in byte order.*/
+
+#define MD5_LANE_STEP(f, a, b, c, d, w, t, s) \
+	(a) = V::add((a), V::add(V::f((b), (c), (d)), V::add(V::load(&m[(w) * V::width]), V::set1(t)))); \
+	(a) = V::add(V::template rotl<s>(a), (b));
+
+// the 64 MD5 steps over one padded 64-byte block per lane
+template<class V>
+SIMD_INLINE void md5_lanes_block(const uint* m, typename V::vec& a, typename V::vec& b, typename V::vec& c, typename V::vec& d) {
+	/* Round 1 */
+	MD5_LANE_STEP(f, a, b, c, d, 0, 0xd76aa478, 7)
+	MD5_LANE_STEP(f, d, a, b, c, 1, 0xe8c7b756, 12)
+	MD5_LANE_STEP(f, c, d, a, b, 2, 0x242070db, 17)
+	MD5_LANE_STEP(f, b, c, d, a, 3, 0xc1bdceee, 22)
+	MD5_LANE_STEP(f, a, b, c, d, 4, 0xf57c0faf, 7)
+	MD5_LANE_STEP(f, d, a, b, c, 5, 0x4787c62a, 12)
+	MD5_LANE_STEP(f, c, d, a, b, 6, 0xa8304613, 17)
+	MD5_LANE_STEP(f, b, c, d, a, 7, 0xfd469501, 22)
+	MD5_LANE_STEP(f, a, b, c, d, 8, 0x698098d8, 7)
+	MD5_LANE_STEP(f, d, a, b, c, 9, 0x8b44f7af, 12)
+	MD5_LANE_STEP(f, c, d, a, b, 10, 0xffff5bb1, 17)
+	MD5_LANE_STEP(f, b, c, d, a, 11, 0x895cd7be, 22)
+	MD5_LANE_STEP(f, a, b, c, d, 12, 0x6b901122, 7)
+	MD5_LANE_STEP(f, d, a, b, c, 13, 0xfd987193, 12)
+	MD5_LANE_STEP(f, c, d, a, b, 14, 0xa679438e, 17)
+	MD5_LANE_STEP(f, b, c, d, a, 15, 0x49b40821, 22)
+
+	/* Round 2 */
+	MD5_LANE_STEP(g, a, b, c, d, 1, 0xf61e2562, 5)
+	MD5_LANE_STEP(g, d, a, b, c, 6, 0xc040b340, 9)
+	MD5_LANE_STEP(g, c, d, a, b, 11, 0x265e5a51, 14)
+	MD5_LANE_STEP(g, b, c, d, a, 0, 0xe9b6c7aa, 20)
+	MD5_LANE_STEP(g, a, b, c, d, 5, 0xd62f105d, 5)
+	MD5_LANE_STEP(g, d, a, b, c, 10, 0x02441453, 9)
+	MD5_LANE_STEP(g, c, d, a, b, 15, 0xd8a1e681, 14)
+	MD5_LANE_STEP(g, b, c, d, a, 4, 0xe7d3fbc8, 20)
+	MD5_LANE_STEP(g, a, b, c, d, 9, 0x21e1cde6, 5)
+	MD5_LANE_STEP(g, d, a, b, c, 14, 0xc33707d6, 9)
+	MD5_LANE_STEP(g, c, d, a, b, 3, 0xf4d50d87, 14)
+	MD5_LANE_STEP(g, b, c, d, a, 8, 0x455a14ed, 20)
+	MD5_LANE_STEP(g, a, b, c, d, 13, 0xa9e3e905, 5)
+	MD5_LANE_STEP(g, d, a, b, c, 2, 0xfcefa3f8, 9)
+	MD5_LANE_STEP(g, c, d, a, b, 7, 0x676f02d9, 14)
+	MD5_LANE_STEP(g, b, c, d, a, 12, 0x8d2a4c8a, 20)
+
+	/* Round 3 */
+	MD5_LANE_STEP(h, a, b, c, d, 5, 0xfffa3942, 4)
+	MD5_LANE_STEP(h, d, a, b, c, 8, 0x8771f681, 11)
+	MD5_LANE_STEP(h, c, d, a, b, 11, 0x6d9d6122, 16)
+	MD5_LANE_STEP(h, b, c, d, a, 14, 0xfde5380c, 23)
+	MD5_LANE_STEP(h, a, b, c, d, 1, 0xa4beea44, 4)
+	MD5_LANE_STEP(h, d, a, b, c, 4, 0x4bdecfa9, 11)
+	MD5_LANE_STEP(h, c, d, a, b, 7, 0xf6bb4b60, 16)
+	MD5_LANE_STEP(h, b, c, d, a, 10, 0xbebfbc70, 23)
+	MD5_LANE_STEP(h, a, b, c, d, 13, 0x289b7ec6, 4)
+	MD5_LANE_STEP(h, d, a, b, c, 0, 0xeaa127fa, 11)
+	MD5_LANE_STEP(h, c, d, a, b, 3, 0xd4ef3085, 16)
+	MD5_LANE_STEP(h, b, c, d, a, 6, 0x04881d05, 23)
+	MD5_LANE_STEP(h, a, b, c, d, 9, 0xd9d4d039, 4)
+	MD5_LANE_STEP(h, d, a, b, c, 12, 0xe6db99e5, 11)
+	MD5_LANE_STEP(h, c, d, a, b, 15, 0x1fa27cf8, 16)
+	MD5_LANE_STEP(h, b, c, d, a, 2, 0xc4ac5665, 23)
+
+	/* Round 4 */
+	MD5_LANE_STEP(i, a, b, c, d, 0, 0xf4292244, 6)
+	MD5_LANE_STEP(i, d, a, b, c, 7, 0x432aff97, 10)
+	MD5_LANE_STEP(i, c, d, a, b, 14, 0xab9423a7, 15)
+	MD5_LANE_STEP(i, b, c, d, a, 5, 0xfc93a039, 21)
+	MD5_LANE_STEP(i, a, b, c, d, 12, 0x655b59c3, 6)
+	MD5_LANE_STEP(i, d, a, b, c, 3, 0x8f0ccc92, 10)
+	MD5_LANE_STEP(i, c, d, a, b, 10, 0xffeff47d, 15)
+	MD5_LANE_STEP(i, b, c, d, a, 1, 0x85845dd1, 21)
+	MD5_LANE_STEP(i, a, b, c, d, 8, 0x6fa87e4f, 6)
+	MD5_LANE_STEP(i, d, a, b, c, 15, 0xfe2ce6e0, 10)
+	MD5_LANE_STEP(i, c, d, a, b, 6, 0xa3014314, 15)
+	MD5_LANE_STEP(i, b, c, d, a, 13, 0x4e0811a1, 21)
+	MD5_LANE_STEP(i, a, b, c, d, 4, 0xf7537e82, 6)
+	MD5_LANE_STEP(i, d, a, b, c, 11, 0xbd3af235, 10)
+	MD5_LANE_STEP(i, c, d, a, b, 2, 0x2ad7d2bb, 15)
+	MD5_LANE_STEP(i, b, c, d, a, 9, 0xeb86d391, 21)
+}
+
+// hashes one padded 64-byte block per lane, starting from the MD5 IV
+template<class V>
+SIMD_INLINE void md5_lanes(const uint* m, uint* h) {
+	typename V::vec a = V::set1(0x67452301);
+	typename V::vec b = V::set1(0xefcdab89);
+	typename V::vec c = V::set1(0x98badcfe);
+	typename V::vec d = V::set1(0x10325476);
+
+	md5_lanes_block<V>(m, a, b, c, d);
+
+	V::store(&h[0 * V::width], V::add(a, V::set1(0x67452301)));
+	V::store(&h[1 * V::width], V::add(b, V::set1(0xefcdab89)));
+	V::store(&h[2 * V::width], V::add(c, V::set1(0x98badcfe)));
+	V::store(&h[3 * V::width], V::add(d, V::set1(0x10325476)));
+}
+
+// adds one more block per lane to the running states 's', for messages longer than a block
+template<class V>
+SIMD_INLINE void md5_lanes_update(const uint* m, uint* s) {
+	typename V::vec a = V::load(&s[0 * V::width]);
+	typename V::vec b = V::load(&s[1 * V::width]);
+	typename V::vec c = V::load(&s[2 * V::width]);
+	typename V::vec d = V::load(&s[3 * V::width]);
+
+	md5_lanes_block<V>(m, a, b, c, d);
+
+	V::store(&s[0 * V::width], V::add(a, V::load(&s[0 * V::width])));
+	V::store(&s[1 * V::width], V::add(b, V::load(&s[1 * V::width])));
+	V::store(&s[2 * V::width], V::add(c, V::load(&s[2 * V::width])));
+	V::store(&s[3 * V::width], V::add(d, V::load(&s[3 * V::width])));
+}
+
+// runs md5_lanes over 'batches' consecutive lane blocks
+template<class V>
+SIMD_INLINE void md5_lanes_run(const uint* m, uint* h, uint batches) {
+	for (uint b = 0; b < batches; ++b)
+		md5_lanes<V>(&m[b * 16 * V::width], &h[b * 4 * V::width]);
+}
+
+// byte order swap of every lane
+template<class V>
+SIMD_INLINE typename V::vec swap_lanes(typename V::vec x) {
+	return V::or_(V::and_(V::template rotl<8>(x), V::set1(0x00ff00ff)), V::and_(V::template rotl<24>(x), V::set1(0xff00ff00)));
+}
+
+#define MD4_LANE_STEP(f, a, b, c, d, w, t, s) \
+	(a) = V::template rotl<s>(V::add((a), V::add(V::f((b), (c), (d)), V::add(V::load(&m[(w) * V::width]), V::set1(t)))));
+
+// MD4 (and NTLM, once the key is widened), same IV as MD5
+template<class V>
+SIMD_INLINE void md4_lanes(const uint* m, uint* h) {
+	typename V::vec a = V::set1(0x67452301);
+	typename V::vec b = V::set1(0xefcdab89);
+	typename V::vec c = V::set1(0x98badcfe);
+	typename V::vec d = V::set1(0x10325476);
+
+	/* Round 1 */
+	for (uint k = 0; k < 16; k += 4) {
+		MD4_LANE_STEP(f, a, b, c, d, k, 0, 3)
+		MD4_LANE_STEP(f, d, a, b, c, k + 1, 0, 7)
+		MD4_LANE_STEP(f, c, d, a, b, k + 2, 0, 11)
+		MD4_LANE_STEP(f, b, c, d, a, k + 3, 0, 19)
+	}
+
+	/* Round 2 */
+	for (uint k = 0; k < 4; ++k) {
+		MD4_LANE_STEP(maj, a, b, c, d, k, 0x5a827999, 3)
+		MD4_LANE_STEP(maj, d, a, b, c, k + 4, 0x5a827999, 5)
+		MD4_LANE_STEP(maj, c, d, a, b, k + 8, 0x5a827999, 9)
+		MD4_LANE_STEP(maj, b, c, d, a, k + 12, 0x5a827999, 13)
+	}
+
+	/* Round 3 */
+	static const uint order[4] = { 0, 2, 1, 3 };
+	for (uint k = 0; k < 4; ++k) {
+		MD4_LANE_STEP(h, a, b, c, d, order[k], 0x6ed9eba1, 3)
+		MD4_LANE_STEP(h, d, a, b, c, order[k] + 8, 0x6ed9eba1, 9)
+		MD4_LANE_STEP(h, c, d, a, b, order[k] + 4, 0x6ed9eba1, 11)
+		MD4_LANE_STEP(h, b, c, d, a, order[k] + 12, 0x6ed9eba1, 15)
+	}
+
+	V::store(&h[0 * V::width], V::add(a, V::set1(0x67452301)));
+	V::store(&h[1 * V::width], V::add(b, V::set1(0xefcdab89)));
+	V::store(&h[2 * V::width], V::add(c, V::set1(0x98badcfe)));
+	V::store(&h[3 * V::width], V::add(d, V::set1(0x10325476)));
+}
+
+template<class V>
+SIMD_INLINE void md4_lanes_run(const uint* m, uint* h, uint batches) {
+	for (uint b = 0; b < batches; ++b)
+		md4_lanes<V>(&m[b * 16 * V::width], &h[b * 4 * V::width]);
+}
+
+// SHA-1, the schedule kept in a 16 word ring
+template<class V>
+SIMD_INLINE void sha1_lanes(const uint* m, uint* h) {
+	static const uint iv[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+	typename V::vec w[16];
+	typename V::vec a = V::set1(iv[0]), b = V::set1(iv[1]), c = V::set1(iv[2]), d = V::set1(iv[3]), e = V::set1(iv[4]);
+
+	for (uint k = 0; k < 16; ++k)
+		w[k] = swap_lanes<V>(V::load(&m[k * V::width]));
+
+	for (uint t = 0; t < 80; ++t) {
+		if (t >= 16)
+			w[t & 15] = V::template rotl<1>(V::xor_(V::xor_(w[(t - 3) & 15], w[(t - 8) & 15]), V::xor_(w[(t - 14) & 15], w[t & 15])));
+
+		typename V::vec f;
+		uint k;
+		if (t < 20) { f = V::f(b, c, d); k = 0x5a827999; }
+		else if (t < 40) { f = V::h(b, c, d); k = 0x6ed9eba1; }
+		else if (t < 60) { f = V::maj(b, c, d); k = 0x8f1bbcdc; }
+		else { f = V::h(b, c, d); k = 0xca62c1d6; }
+
+		typename V::vec next = V::add(V::add(V::template rotl<5>(a), f), V::add(V::add(e, V::set1(k)), w[t & 15]));
+		e = d;
+		d = c;
+		c = V::template rotl<30>(b);
+		b = a;
+		a = next;
+	}
+
+	V::store(&h[0 * V::width], swap_lanes<V>(V::add(a, V::set1(iv[0]))));
+	V::store(&h[1 * V::width], swap_lanes<V>(V::add(b, V::set1(iv[1]))));
+	V::store(&h[2 * V::width], swap_lanes<V>(V::add(c, V::set1(iv[2]))));
+	V::store(&h[3 * V::width], swap_lanes<V>(V::add(d, V::set1(iv[3]))));
+	V::store(&h[4 * V::width], swap_lanes<V>(V::add(e, V::set1(iv[4]))));
+}
+
+template<class V>
+SIMD_INLINE void sha1_lanes_run(const uint* m, uint* h, uint batches) {
+	for (uint b = 0; b < batches; ++b)
+		sha1_lanes<V>(&m[b * 16 * V::width], &h[b * 5 * V::width]);
+}
+
+static const uint SHA256_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+// SHA-256, rotations to the right written as rotl by 32 - n
+template<class V>
+SIMD_INLINE void sha256_lanes(const uint* m, uint* h) {
+	static const uint iv[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+	typename V::vec w[16], s[8];
+
+	for (uint k = 0; k < 16; ++k)
+		w[k] = swap_lanes<V>(V::load(&m[k * V::width]));
+	for (uint k = 0; k < 8; ++k)
+		s[k] = V::set1(iv[k]);
+
+	for (uint t = 0; t < 64; ++t) {
+		if (t >= 16) {
+			typename V::vec w15 = w[(t - 15) & 15], w2 = w[(t - 2) & 15];
+			typename V::vec s0 = V::xor_(V::xor_(V::template rotl<25>(w15), V::template rotl<14>(w15)), V::template shr<3>(w15));
+			typename V::vec s1 = V::xor_(V::xor_(V::template rotl<15>(w2), V::template rotl<13>(w2)), V::template shr<10>(w2));
+			w[t & 15] = V::add(V::add(w[t & 15], s0), V::add(w[(t - 7) & 15], s1));
+		}
+
+		typename V::vec e = s[4], a = s[0];
+		typename V::vec sum1 = V::xor_(V::xor_(V::template rotl<26>(e), V::template rotl<21>(e)), V::template rotl<7>(e));
+		typename V::vec sum0 = V::xor_(V::xor_(V::template rotl<30>(a), V::template rotl<19>(a)), V::template rotl<10>(a));
+		typename V::vec t1 = V::add(V::add(s[7], sum1), V::add(V::f(e, s[5], s[6]), V::add(V::set1(SHA256_K[t]), w[t & 15])));
+		typename V::vec t2 = V::add(sum0, V::maj(a, s[1], s[2]));
+
+		s[7] = s[6];
+		s[6] = s[5];
+		s[5] = s[4];
+		s[4] = V::add(s[3], t1);
+		s[3] = s[2];
+		s[2] = s[1];
+		s[1] = s[0];
+		s[0] = V::add(t1, t2);
+	}
+
+	for (uint k = 0; k < 8; ++k)
+		V::store(&h[k * V::width], swap_lanes<V>(V::add(s[k], V::set1(iv[k]))));
+}
+
+template<class V>
+SIMD_INLINE void sha256_lanes_run(const uint* m, uint* h, uint batches) {
+	for (uint b = 0; b < batches; ++b)
+		sha256_lanes<V>(&m[b * 16 * V::width], &h[b * 8 * V::width]);
+}
@@ -0,0 +1,49 @@
+// compiled for SSE2 regardless of the global flags, see simd.h
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("sse2")
+#endif
+
+#define SIMD_SSE2
+#include "crypt_lanes.h"
+
+void md5_sse2(const uint* m, uint* h, uint batches) {
+#ifdef SIMD_X86
+	md5_lanes_run<lanes_sse2>(m, h, batches);
+#endif
+}
+
+void md4_sse2(const uint* m, uint* h, uint batches) {
+#ifdef SIMD_X86
+	md4_lanes_run<lanes_sse2>(m, h, batches);
+#endif
+}
+
+void sha1_sse2(const uint* m, uint* h, uint batches) {
+#ifdef SIMD_X86
+	sha1_lanes_run<lanes_sse2>(m, h, batches);
+#endif
+}
+
+void sha256_sse2(const uint* m, uint* h, uint batches) {
+#ifdef SIMD_X86
+	sha256_lanes_run<lanes_sse2>(m, h, batches);
+#endif
+}
+
+void md5crypt_sse2(const crypt_layout<uint>& layout, uint* s, uint rounds) {
+#ifdef SIMD_X86
+	md5crypt_lanes<lanes_sse2>(layout, s, rounds);
+#endif
+}
+
+void sha512crypt_sse2(const crypt_layout<uint64>& layout, uint64* s, uint rounds) {
+#ifdef SIMD_X86
+	sha512crypt_lanes<lanes64_sse2>(layout, s, rounds);
+#endif
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <sstream>
+#include <string>
+
 using namespace std;
 
 
@@ -12,4 +15,13 @@ void _log(const string &msg);
 inline void _log(const string &msg) {}
 #endif
 
+/*Formats a message with << and logs it. Without LOG the arguments are
+not even evaluated, so a disabled log line costs nothing:
+LOG_LINE("Created context. Return code = " << getErrorString(ret));*/
+#ifdef LOG
+#define LOG_LINE(message) do { stringstream _line; _line << message; _log(_line.str()); } while (0)
+#else
+#define LOG_LINE(message) do {} while (0)
+#endif
+
 const char *getErrorString(int error);
@@ -0,0 +1,183 @@
+#include <cstring>
+#include <sstream>
+#include "mask.h"
+#include "wordlist.h"
+#include "log.h"
+
+static const char* LOWER = "abcdefghijklmnopqrstuvwxyz";
+static const char* UPPER = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+static const char* DIGITS = "0123456789";
+static const char* SYMBOLS = " !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+
+bool key_mask::expand(const string& spec, string& out, bool allow_custom) const {
+	out.clear();
+
+	for (size_t k = 0; k < spec.size(); ++k) {
+		if (spec[k] != '?') {
+			out += spec[k];
+			continue;
+		}
+
+		if (++k == spec.size())
+			return false; // a lone '?' at the end
+
+		switch (spec[k]) {
+		case 'l': out += LOWER; break;
+		case 'u': out += UPPER; break;
+		case 'd': out += DIGITS; break;
+		case 's': out += SYMBOLS; break;
+		case 'a': out += string(LOWER) + UPPER + DIGITS + SYMBOLS; break;
+		case 'h': out += "0123456789abcdef"; break;
+		case 'H': out += "0123456789ABCDEF"; break;
+		case '?': out += '?'; break;
+		case 'b':
+			for (uint c = 0; c < 256; ++c)
+				out += (char)c;
+			break;
+		default:
+			if (!allow_custom || spec[k] < '1' || spec[k] >= '1' + MASK_CUSTOM || custom[spec[k] - '1'].empty())
+				return false;
+			out += custom[spec[k] - '1'];
+		}
+	}
+
+	// drop repeated chars, they would only produce duplicate keys
+	string unique;
+	bool seen[256] = { false };
+	for (size_t k = 0; k < out.size(); ++k)
+		if (!seen[(uchar)out[k]]) {
+			seen[(uchar)out[k]] = true;
+			unique += out[k];
+		}
+	out = unique;
+
+	return true;
+}
+
+bool key_mask::set_custom(uint k, const string& spec) {
+	if (k < 1 || k > MASK_CUSTOM)
+		return false;
+	return expand(spec, custom[k - 1], false) && !custom[k - 1].empty();
+}
+
+bool key_mask::parse(const string& mask) {
+	chars.clear();
+	radix.clear();
+
+	for (size_t k = 0; k < mask.size(); ++k) {
+		// one position is either "?x" or a literal char
+		string spec = mask.substr(k, mask[k] == '?' ? 2 : 1);
+		if (mask[k] == '?')
+			++k;
+
+		string set;
+		if (!expand(spec, set, true) || set.empty() || radix.size() == MAX_KEY_LEN)
+			return false;
+
+		radix.push_back((uint)set.size());
+		set.resize(256, 0);
+		chars.insert(chars.end(), set.begin(), set.end());
+	}
+
+	min_length = max_length = (uint)radix.size();
+
+	LOG_LINE("Parsed mask " << mask << ". POSITIONS = " << radix.size());
+
+	return !radix.empty();
+}
+
+void key_mask::set_lengths(uint min, uint max) {
+	max_length = (max && max < radix.size()) ? max : (uint)radix.size();
+	min_length = (min && min < max_length) ? min : max_length;
+}
+
+uint64 key_mask::keyspace(uint length) const {
+	uint64 space = 1;
+	for (uint p = 0; p < length && p < radix.size(); ++p) {
+		if (space > ~0ULL / radix[p])
+			return 0;
+		space *= radix[p];
+	}
+	return space;
+}
+
+uint128 key_mask::wide_keyspace(uint length) const {
+	uint128 space = { 1, 0 };
+	for (uint p = 0; p < length && p < radix.size(); ++p) {
+		// radix is at most 256, so each 32-bit half carries at most 8 bits
+		const uint64 low = (space.lo & 0xffffffff) * radix[p];
+		const uint64 mid = (space.lo >> 32) * radix[p] + (low >> 32);
+		if (space.hi > (~0ULL - (mid >> 32)) / radix[p]) {
+			uint128 all = { ~0ULL, ~0ULL };
+			return all;
+		}
+		space.hi = space.hi * radix[p] + (mid >> 32);
+		space.lo = (mid << 32) | (low & 0xffffffff);
+	}
+	return space;
+}
+
+uint64 key_mask::keys_after(const uint128& index, uint length, uint64 most) const {
+	const uint128 space = wide_keyspace(length);
+	if (index.hi > space.hi || (index.hi == space.hi && index.lo >= space.lo))
+		return 0;
+
+	// 2 ** 64 or more left while the high halves differ after the borrow
+	if (space.hi - index.hi - (space.lo < index.lo))
+		return most;
+	const uint64 left = space.lo - index.lo;
+	return (left < most) ? left : most;
+}
+
+// divides 'index' by 'divisor' in place and returns the remainder
+static inline uint divide(uint128& index, uint divisor) {
+	if (!index.hi) {
+		const uint rest = (uint)(index.lo % divisor);
+		index.lo /= divisor;
+		return rest;
+	}
+
+	// long division in 32-bit steps, every partial dividend fits 64 bits
+	const uint64 mid = (index.hi % divisor) << 32 | (index.lo >> 32);
+	const uint64 low = (mid % divisor) << 32 | (index.lo & 0xffffffff);
+	index.hi /= divisor;
+	index.lo = (mid / divisor) << 32 | (low / divisor);
+	return (uint)(low % divisor);
+}
+
+void key_mask::candidate(uint64 index, uint length, uchar* key) const {
+	for (uint p = 0; p < length; ++p) {
+		key[p] = chars[p * 256 + index % radix[p]];
+		index /= radix[p];
+	}
+}
+
+void key_mask::candidate(uint128 index, uint length, uchar* key) const {
+	for (uint p = 0; p < length; ++p)
+		key[p] = chars[p * 256 + divide(index, radix[p])];
+}
+
+void key_mask::digits(uint128 index, uint length, uint* digit) const {
+	for (uint p = 0; p < length; ++p)
+		digit[p] = divide(index, radix[p]);
+}
+
+uint key_mask::combine(const uchar* word, uint size, uint64 index, uint length, bool prefix, uchar* key) const {
+	if (size + length > MAX_KEY_LEN)
+		return 0;
+
+	memcpy(key + (prefix ? length : 0), word, size);
+	candidate(index, length, key + (prefix ? 0 : size));
+	return size + length;
+}
+
+uint key_mask::get_batch_words(uint length) const {
+	uint64 space = keyspace(length);
+	uint64 words = (space && space < HYBRID_CANDIDATES) ? HYBRID_CANDIDATES / space : 1;
+	return (words < WORD_MAX_COUNT) ? (uint)words : WORD_MAX_COUNT;
+}
+
+key_mask::key_mask() {
+	min_length = 0;
+	max_length = 0;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+#define MAX_KEY_LEN 55 // longest key that still fits a single MD5 block
+#define MASK_CUSTOM 4 // custom charsets ?1 to ?4
+#define HYBRID_CANDIDATES (1 << 26) // candidates per launch in hybrid mode
+#define HYBRID_MAX_SPACE (1ULL << 30) // mask keys per word in hybrid mode, the keys of a launch
+
+
+/*A mask describes a keyspace position by position: every position
+has its own charset (?l lower, ?u upper, ?d digits, ?s symbols, ?a all
+printable, ?h/?H hex, ?b any byte, ?1-?4 custom, anything else is a
+literal). A key is the mixed-radix decoding of its index, with the
+first position changing fastest. Lengths from min to max use the first
+positions of the mask. Key indices are 128-bit like counter ones;
+block searches count 64-bit blocks, so a length fits() with fewer
+than 2 ** 74 keys.*/
+class key_mask {
+public:
+	/*Sets custom charset 'k' (1-4), which may itself use ?l etc.
+	Call before parse().*/
+	bool set_custom(uint k, const string& chars);
+
+	bool parse(const string& mask);
+
+	void set_lengths(uint min, uint max);
+
+	uint get_positions() const { return (uint)radix.size(); }
+	uint get_min() const { return min_length; }
+	uint get_max() const { return max_length; }
+
+	/*Number of keys of 'length', 0 if it does not fit 64 bits. Hybrid
+	masks and rainbow tables need that; block searches take
+	wide_keyspace().*/
+	uint64 keyspace(uint length) const;
+
+	// number of keys of 'length', all bits set if it does not fit 128 bits
+	uint128 wide_keyspace(uint length) const;
+
+	// keys of 'length' from 'index' to the end of the keyspace, at most 'most'
+	uint64 keys_after(const uint128& index, uint length, uint64 most) const;
+
+	/*The keys of 'length' can be block searched: 1 to get_positions()
+	positions and fewer than 2 ** 74 of them, so their blocks fit the
+	64-bit block cursors.*/
+	bool fits(uint length) const { return length && length <= radix.size() && wide_keyspace(length).hi < (1ULL << BLOCK_BITS); }
+
+	void candidate(uint64 index, uint length, uchar* key) const;
+	void candidate(uint128 index, uint length, uchar* key) const;
+
+	// the mixed-radix digits of key 'index', which pick each position's char
+	void digits(uint128 index, uint length, uint* digit) const;
+
+	/*Key 'index' of a hybrid search: the 'length' keys of the mask
+	appended to 'word', or prepended with 'prefix'. Returns the key's
+	length, 0 if it is longer than MAX_KEY_LEN.*/
+	uint combine(const uchar* word, uint size, uint64 index, uint length, bool prefix, uchar* key) const;
+
+	// words per hybrid batch, so a batch is one launch of about HYBRID_CANDIDATES keys
+	uint get_batch_words(uint length) const;
+
+	// 256 chars per position, padded
+	const uchar* get_chars() const { return chars.data(); }
+	const uint* get_radix() const { return radix.data(); }
+
+	key_mask();
+private:
+	vector<uchar> chars;
+	vector<uint> radix;
+	string custom[MASK_CUSTOM];
+	uint min_length;
+	uint max_length;
+
+	bool expand(const string& spec, string& out, bool allow_custom) const;
+};
@@ -0,0 +1,59 @@
+/*MD4, single block. With -D UTF16 smash.cl widens keys first, which
+makes it NTLM.*/
+
+#define DIGEST_WORDS 4
+
+#define MD4_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD4_G(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+#define MD4_H(x, y, z) ((x) ^ (y) ^ (z))
+
+#define MD4_STEP(f, a, b, c, d, x, s) \
+	(a) += f((b), (c), (d)) + (x); \
+	(a) = rotate((a), (uintv)(s));
+
+/*'m' is the message packed like pack_block() does, the bit length is
+added here. Hashes VECTOR_WIDTH messages at once.*/
+inline void hash_words(uintv* m, const uint len, uintv* out) {
+	m[14] = len * 8;
+
+	uintv a = 0x67452301, b = 0xefcdab89, c = 0x98badcfe, d = 0x10325476;
+
+	/* Round 1 */
+	for (uint k = 0; k < 16; k += 4) {
+		MD4_STEP(MD4_F, a, b, c, d, m[k], 3)
+		MD4_STEP(MD4_F, d, a, b, c, m[k + 1], 7)
+		MD4_STEP(MD4_F, c, d, a, b, m[k + 2], 11)
+		MD4_STEP(MD4_F, b, c, d, a, m[k + 3], 19)
+	}
+
+	/* Round 2 */
+	for (uint k = 0; k < 4; ++k) {
+		MD4_STEP(MD4_G, a, b, c, d, m[k] + 0x5a827999, 3)
+		MD4_STEP(MD4_G, d, a, b, c, m[k + 4] + 0x5a827999, 5)
+		MD4_STEP(MD4_G, c, d, a, b, m[k + 8] + 0x5a827999, 9)
+		MD4_STEP(MD4_G, b, c, d, a, m[k + 12] + 0x5a827999, 13)
+	}
+
+	/* Round 3, words in bit-reversed order */
+	const uint order[4] = { 0, 2, 1, 3 };
+	for (uint k = 0; k < 4; ++k) {
+		const uint o = order[k];
+		MD4_STEP(MD4_H, a, b, c, d, m[o] + 0x6ed9eba1, 3)
+		MD4_STEP(MD4_H, d, a, b, c, m[o + 8] + 0x6ed9eba1, 9)
+		MD4_STEP(MD4_H, c, d, a, b, m[o + 4] + 0x6ed9eba1, 11)
+		MD4_STEP(MD4_H, b, c, d, a, m[o + 12] + 0x6ed9eba1, 15)
+	}
+
+	out[0] = a + 0x67452301;
+	out[1] = b + 0xefcdab89;
+	out[2] = c + 0x98badcfe;
+	out[3] = d + 0x10325476;
+}
+
+#if VECTOR_WIDTH == 1
+inline void hash(char* msg, const uint len, uint* out) {
+	uint m[16];
+	pack_block(m, msg, len);
+	hash_words(m, len, out);
+}
+#endif
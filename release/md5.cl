@@ -1,10 +1,6 @@
 // MD5 function taken from: https://github.com/awreece/pdfcrack-opencl/blob/master/md5.cl
 
-
-#pragma OPENCL EXTENSION cl_khr_byte_addressable_store : enable
-
-#define MD5_SIZE 16
-#define KEY_SIZE 16
+#define DIGEST_WORDS 4
 
 /* The basic MD5 functions */
 #define F(x, y, z)			((z) ^ ((x) & ((y) ^ (z))))
@@ -20,8 +16,8 @@
 
 #define GET(i) (key[(i)])
 
-static void md5_round(__global uint* internal_state, const uint* key) {
-  uint a, b, c, d;
+static void md5_round(uintv* internal_state, const uintv* key) {
+  uintv a, b, c, d;
   a = internal_state[0];
   b = internal_state[1];
   c = internal_state[2];
@@ -105,7 +101,20 @@ static void md5_round(__global uint* internal_state, const uint* key) {
   internal_state[3] = d + internal_state[3];
 }
 
-void md5(char* msg, __global uint* out) {
+/*'m' is the message packed like pack_block() does, the bit length is
+added here. Hashes VECTOR_WIDTH messages at once.*/
+inline void hash_words(uintv* m, const uint len, uintv* out) {
+  out[0] = 0x67452301;
+  out[1] = 0xefcdab89;
+  out[2] = 0x98badcfe;
+  out[3] = 0x10325476;
+
+  m[14] = len * 8;
+  md5_round(out, m);
+}
+
+#if VECTOR_WIDTH == 1
+void md5(char* msg, const uint len, uint* out) {
   uint i;
   uint bytes_left;
   char key[64];
@@ -115,7 +124,7 @@ void md5(char* msg, __global uint* out) {
   out[2] = 0x98badcfe;
   out[3] = 0x10325476;
 
-  for (bytes_left = KEY_SIZE;  bytes_left >= 64;
+  for (bytes_left = len;  bytes_left >= 64;
        bytes_left -= 64, msg = &msg[64]) {
     md5_round(out, (const uint*) msg);
   }
@@ -135,50 +144,109 @@ void md5(char* msg, __global uint* out) {
   }
 
   ulong* len_ptr = (ulong*) &key[56];
-  *len_ptr = KEY_SIZE * 8;
+  *len_ptr = len * 8;
   md5_round(out, (const uint*) key);
 }
 
-// TODO: if KEY_SIZE or block # > 2 ** 32, will result in infinite loop
-
-inline void increment(char* current) { 
-	for (uint a = 0; a < KEY_SIZE; ++a) { 
-		uchar *curr = &current[KEY_SIZE - a - 1]; // hold onto address for performance boost
-
-		++(*curr); // increment
-
-		// stop while loop if no
-		// overflow has occured
-		a += (*curr) * KEY_SIZE; // not using 'if' for performance reasons
-	}
+inline void hash(char* msg, const uint len, uint* out) {
+  md5(msg, len, out);
 }
+#endif
+
+/*Single-target fast path for the counter keyspace. Its keys are 16
+bytes with the high half zero, so only words 2 and 3 of the padded
+block vary; the others are folded into the step constants below.
+'target' is the digest with steps 62 and 63 undone on the host
+(hash_algo::reverse): (a60, b59, c58 + m[2], d61). Step 58 yields c, so
+nearly every key is rejected there, and a survivor is a match exactly
+when steps 59 to 61 land on the rest; steps 62 and 63 and the final
+additions are never computed. Word 2 is the same in every lane, word 3
+differs; the result is non-zero in the lanes that match.*/
+#define COUNTER_SINGLE
+
+#define STEP0(f, a, b, c, d, t, s) \
+    (a) += f((b), (c), (d)) + (t); \
+    (a) = rotate((a), (uintv)(s)); \
+    (a) += (b);
 
-void generate_key(char* output, const uint block, const uint id) { 
-	// key = block * KEY_SIZE + id
-
-	// zero out output before incrementing
-	for (uint k = 0; k < KEY_SIZE; ++k)
-		output[k] = 0;
+inline intv hash_counter(const uint x2, const uintv x3, const uint4 target) {
+  uintv a = 0x67452301, b = 0xefcdab89, c = 0x98badcfe, d = 0x10325476;
 
-	// cannot use regular multiplication, 
-	// number can be too big
+  /* Round 1 */
+  STEP0(F, a, b, c, d, 0xd76aa478, 7)
+  STEP0(F, d, a, b, c, 0xe8c7b756, 12)
+  STEP(F, c, d, a, b, x2, 0x242070db, 17)
+  STEP(F, b, c, d, a, x3, 0xc1bdceee, 22)
+  STEP0(F, a, b, c, d, 0xf57c102f, 7) // + 0x80 pad
+  STEP0(F, d, a, b, c, 0x4787c62a, 12)
+  STEP0(F, c, d, a, b, 0xa8304613, 17)
+  STEP0(F, b, c, d, a, 0xfd469501, 22)
+  STEP0(F, a, b, c, d, 0x698098d8, 7)
+  STEP0(F, d, a, b, c, 0x8b44f7af, 12)
+  STEP0(F, c, d, a, b, 0xffff5bb1, 17)
+  STEP0(F, b, c, d, a, 0x895cd7be, 22)
+  STEP0(F, a, b, c, d, 0x6b901122, 7)
+  STEP0(F, d, a, b, c, 0xfd987193, 12)
+  STEP0(F, c, d, a, b, 0xa679440e, 17) // + 128 bit length
+  STEP0(F, b, c, d, a, 0x49b40821, 22)
 
-	// block * KEYSIZE
-	for (uint a = 0; a < block; ++a)
-		for (uint b = 0; b < KEY_SIZE; ++b)
-			increment(output);
+  /* Round 2 */
+  STEP0(G, a, b, c, d, 0xf61e2562, 5)
+  STEP0(G, d, a, b, c, 0xc040b340, 9)
+  STEP0(G, c, d, a, b, 0x265e5a51, 14)
+  STEP0(G, b, c, d, a, 0xe9b6c7aa, 20)
+  STEP0(G, a, b, c, d, 0xd62f105d, 5)
+  STEP0(G, d, a, b, c, 0x02441453, 9)
+  STEP0(G, c, d, a, b, 0xd8a1e681, 14)
+  STEP0(G, b, c, d, a, 0xe7d3fc48, 20) // + 0x80 pad
+  STEP0(G, a, b, c, d, 0x21e1cde6, 5)
+  STEP0(G, d, a, b, c, 0xc3370856, 9) // + 128 bit length
+  STEP(G, c, d, a, b, x3, 0xf4d50d87, 14)
+  STEP0(G, b, c, d, a, 0x455a14ed, 20)
+  STEP0(G, a, b, c, d, 0xa9e3e905, 5)
+  STEP(G, d, a, b, c, x2, 0xfcefa3f8, 9)
+  STEP0(G, c, d, a, b, 0x676f02d9, 14)
+  STEP0(G, b, c, d, a, 0x8d2a4c8a, 20)
 
-	// + id
-	for (uint k = 0; k < id; ++k)
-			increment(output);
+  /* Round 3 */
+  STEP0(H, a, b, c, d, 0xfffa3942, 4)
+  STEP0(H, d, a, b, c, 0x8771f681, 11)
+  STEP0(H, c, d, a, b, 0x6d9d6122, 16)
+  STEP0(H, b, c, d, a, 0xfde5388c, 23) // + 128 bit length
+  STEP0(H, a, b, c, d, 0xa4beea44, 4)
+  STEP0(H, d, a, b, c, 0x4bded029, 11) // + 0x80 pad
+  STEP0(H, c, d, a, b, 0xf6bb4b60, 16)
+  STEP0(H, b, c, d, a, 0xbebfbc70, 23)
+  STEP0(H, a, b, c, d, 0x289b7ec6, 4)
+  STEP0(H, d, a, b, c, 0xeaa127fa, 11)
+  STEP(H, c, d, a, b, x3, 0xd4ef3085, 16)
+  STEP0(H, b, c, d, a, 0x04881d05, 23)
+  STEP0(H, a, b, c, d, 0xd9d4d039, 4)
+  STEP0(H, d, a, b, c, 0xe6db99e5, 11)
+  STEP0(H, c, d, a, b, 0x1fa27cf8, 16)
+  STEP(H, b, c, d, a, x2, 0xc4ac5665, 23)
+
+  /* Round 4, up to step 58 */
+  STEP0(I, a, b, c, d, 0xf4292244, 6)
+  STEP0(I, d, a, b, c, 0x432aff97, 10)
+  STEP0(I, c, d, a, b, 0xab942427, 15) // + 128 bit length
+  STEP0(I, b, c, d, a, 0xfc93a039, 21)
+  STEP0(I, a, b, c, d, 0x655b59c3, 6)
+  STEP(I, d, a, b, c, x3, 0x8f0ccc92, 10)
+  STEP0(I, c, d, a, b, 0xffeff47d, 15)
+  STEP0(I, b, c, d, a, 0x85845dd1, 21)
+  STEP0(I, a, b, c, d, 0x6fa87e4f, 6)
+  STEP0(I, d, a, b, c, 0xfe2ce6e0, 10)
+  STEP0(I, c, d, a, b, 0xa3014314, 15)
+
+  // early reject, one word in
+  const intv early = (c + x2 == target.z);
+  if (!any_lane(early))
+    return 0;
+
+  STEP0(I, b, c, d, a, 0x4e0811a1, 21)
+  STEP0(I, a, b, c, d, 0xf7537f02, 6) // + 0x80 pad
+  STEP0(I, d, a, b, c, 0xbd3af235, 10)
+
+  return early & (a == target.x) & (b == target.y) & (d == target.w);
 }
-
-__kernel void smash(__global char* output, uint block) {
-	char key[KEY_SIZE];
-	const uint id = get_global_id(0); // get my unique id
-
-	generate_key(key, block, id); // generate current key to hash
-	__global uint* out = (__global uint*)&output[id * MD5_SIZE]; // location for my result
-
-	md5(key, out); // compute MD5 hash
-}
\ No newline at end of file
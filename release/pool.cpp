@@ -0,0 +1,144 @@
+#include "pool.h"
+
+bool work_pool::take(uint id, uint64& first, uint64& last) {
+	uint64 size = (*grain)(id) ? (*grain)(id) : 1;
+	slice& own = slices[id];
+	lock_guard<mutex> guard(own.lock);
+
+	if (own.first >= own.last)
+		return false;
+
+	first = own.first;
+	last = (own.last - own.first > size) ? own.first + size : own.last;
+	own.first = last;
+	return true;
+}
+
+bool work_pool::steal(uint id) {
+	// pick the victim with the most work left
+	uint victim = id;
+	uint64 most = 0;
+	for (uint k = 0; k < slices.size(); ++k) {
+		if (k == id)
+			continue;
+
+		lock_guard<mutex> guard(slices[k].lock);
+		uint64 left = slices[k].last - slices[k].first;
+		if (slices[k].first < slices[k].last && left > most) {
+			most = left;
+			victim = k;
+		}
+	}
+
+	if (victim == id)
+		return false;
+
+	// move the back half of the victim's slice (at least one chunk) to us
+	uint64 size = (*grain)(id) ? (*grain)(id) : 1;
+	uint64 first, last;
+	{
+		lock_guard<mutex> guard(slices[victim].lock);
+		slice& v = slices[victim];
+		if (v.first >= v.last)
+			return true; // drained meanwhile, look again
+
+		uint64 half = (v.last - v.first) / 2;
+		if (half < size)
+			half = (v.last - v.first < size) ? v.last - v.first : size;
+
+		first = v.last - half;
+		last = v.last;
+		v.last = first;
+	}
+
+	lock_guard<mutex> guard(slices[id].lock);
+	slices[id].first = first;
+	slices[id].last = last;
+	return true;
+}
+
+void work_pool::work(uint id) {
+	uint seen = 0;
+
+	for (;;) {
+		{
+			unique_lock<mutex> guard(lock);
+			wake.wait(guard, [&] { return quit || generation != seen; });
+			if (quit)
+				return;
+			seen = generation;
+		}
+
+		uint64 first, last;
+		for (;;) {
+			if (stop.load(memory_order_relaxed))
+				break;
+
+			if (take(id, first, last)) {
+				if ((*current)(id, first, last))
+					stop = true;
+			}
+			else if (!steal(id))
+				break;
+		}
+
+		lock_guard<mutex> guard(lock);
+		if (--busy == 0)
+			done.notify_all();
+	}
+}
+
+bool work_pool::run(uint64 begin, uint64 end, uint64 chunk, const task& fn) {
+	sizer fixed = [=](uint) { return chunk ? chunk : 1; };
+	return run(begin, end, fixed, fn);
+}
+
+bool work_pool::run(uint64 begin, uint64 end, const sizer& chunk, const task& fn) {
+	if (begin >= end)
+		return false;
+
+	uint count = (uint)slices.size();
+	uint64 share = (end - begin + count - 1) / count;
+
+	unique_lock<mutex> guard(lock);
+
+	// hand every worker an even, contiguous slice to start from
+	for (uint k = 0; k < count; ++k) {
+		lock_guard<mutex> slice_guard(slices[k].lock);
+		uint64 first = begin + share * k;
+		slices[k].first = (first < end) ? first : end;
+		slices[k].last = (first + share < end) ? first + share : end;
+	}
+
+	current = &fn;
+	grain = &chunk;
+	busy = count;
+	stop = false;
+	++generation;
+	wake.notify_all();
+
+	done.wait(guard, [&] { return busy == 0; });
+	return stop;
+}
+
+work_pool::work_pool(uint threads) : slices(threads ? threads : (thread::hardware_concurrency() ? thread::hardware_concurrency() : 1)) {
+	current = NULL;
+	grain = NULL;
+	generation = 0;
+	busy = 0;
+	quit = false;
+	stop = false;
+
+	for (uint k = 0; k < slices.size(); ++k)
+		workers.push_back(thread(&work_pool::work, this, k));
+}
+work_pool::~work_pool() {
+	{
+		lock_guard<mutex> guard(lock);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for (uint k = 0; k < workers.size(); ++k)
+		workers[k].join();
+}
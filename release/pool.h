@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+/*A fixed set of worker threads that splits a range of work between them.
+Every worker starts on its own slice and takes fixed size chunks from the
+front of it; a worker that runs dry steals the back half of the largest
+slice left, so uneven chunks still keep all cores busy.*/
+class work_pool {
+public:
+	// called with the worker index and a chunk [first, last); returning true stops the run
+	typedef function<bool(uint worker, uint64 first, uint64 last)> task;
+
+	// chunk size for a worker, for workers of different speed
+	typedef function<uint64(uint worker)> sizer;
+
+	/*Runs 'fn' over [begin, end). Returns true if a chunk asked to stop.*/
+	bool run(uint64 begin, uint64 end, uint64 chunk, const task& fn);
+
+	bool run(uint64 begin, uint64 end, const sizer& chunk, const task& fn);
+
+	uint size() { return (uint)workers.size(); }
+
+	work_pool(uint threads = 0);
+	~work_pool();
+private:
+	struct slice {
+		mutex lock;
+		uint64 first;
+		uint64 last;
+	};
+
+	vector<thread> workers;
+	vector<slice> slices;
+
+	mutex lock;
+	condition_variable wake;
+	condition_variable done;
+
+	const task* current;
+	const sizer* grain;
+	uint generation;
+	uint busy;
+	bool quit;
+	atomic<bool> stop;
+
+	void work(uint id);
+
+	bool take(uint id, uint64& first, uint64& last);
+
+	bool steal(uint id);
+};
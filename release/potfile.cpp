@@ -0,0 +1,427 @@
+#include <cstring>
+#include <sstream>
+#include "potfile.h"
+#include "log.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+static int sync_file(FILE* f) { return _commit(_fileno(f)); }
+static bool cut_file(const string& path, uint64 size) {
+	FILE* f = fopen(path.c_str(), "r+b");
+	if (!f)
+		return false;
+	bool cut = !_chsize_s(_fileno(f), (long long)size);
+	fclose(f);
+	return cut;
+}
+#define seek_file _fseeki64
+#define tell_file _ftelli64
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+static int sync_file(FILE* f) { return fsync(fileno(f)); }
+static bool cut_file(const string& path, uint64 size) { return !truncate(path.c_str(), (off_t)size); }
+#define seek_file fseeko
+#define tell_file ftello
+#endif
+
+static const char hex_chars[] = "0123456789abcdef";
+
+static inline int nibble(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+// decodes 'length' hex chars (an even number) into 'out', false on anything else
+static bool parse_hex(const char* text, size_t length, uchar* out) {
+	if (length % 2)
+		return false;
+	for (size_t k = 0; k < length / 2; ++k) {
+		int hi = nibble(text[k * 2]), lo = nibble(text[k * 2 + 1]);
+		if (hi < 0 || lo < 0)
+			return false;
+		out[k] = (uchar)(hi << 4 | lo);
+	}
+	return true;
+}
+
+// the digest's first 8 bytes, little-endian; digests are random enough to hash on
+static inline uint64 tag_of(const uchar* digest) {
+	uint64 tag = 0;
+	for (uint k = 8; k-- > 0;)
+		tag = (tag << 8) | digest[k];
+	return tag;
+}
+
+// the key as is if it is printable, $HEX[...] otherwise
+static string encode_key(const uchar* key, uint length) {
+	bool printable = length < 5 || memcmp(key, "$HEX[", 5);
+	for (uint k = 0; k < length && printable; ++k)
+		printable = key[k] >= 0x20 && key[k] < 0x7f;
+	if (printable)
+		return string((const char*)key, length);
+
+	string text = "$HEX[";
+	for (uint k = 0; k < length; ++k) {
+		text += hex_chars[key[k] >> 4];
+		text += hex_chars[key[k] & 15];
+	}
+	return text + "]";
+}
+
+static string decode_key(const string& text) {
+	uchar key[POT_MAX_LINE];
+	if (text.size() >= 6 && !text.compare(0, 5, "$HEX[") && text[text.size() - 1] == ']' &&
+		parse_hex(text.data() + 5, text.size() - 6, key))
+		return string((const char*)key, (text.size() - 6) / 2);
+	return text;
+}
+
+/*Splits a record into its digest and key, false if it is not one.
+'line' holds the record without its newline.*/
+static bool parse_record(const char* line, size_t length, uchar* digest, uint& size, string* key) {
+	const char* colon = (const char*)memchr(line, ':', length);
+	if (!colon || colon - line < 16 || colon - line > MAX_DIGEST_SIZE * 2 || !parse_hex(line, colon - line, digest))
+		return false;
+
+	size = (uint)(colon - line) / 2;
+	if (key)
+		*key = decode_key(string(colon + 1, line + length));
+	return true;
+}
+
+bool potfile::open(const string& path) {
+	close();
+	this->path = path;
+
+	// only whole lines count, cut a record torn by a crash
+	FILE* in = fopen(path.c_str(), "rb");
+	if (in) {
+		seek_file(in, 0, SEEK_END);
+		uint64 size = (uint64)tell_file(in), whole = size;
+		char buffer[POT_MAX_LINE];
+		while (whole) {
+			size_t step = (whole < sizeof(buffer)) ? (size_t)whole : sizeof(buffer);
+			seek_file(in, whole - step, SEEK_SET);
+			if (fread(buffer, 1, step, in) != step)
+				break;
+
+			size_t k = step;
+			while (k && buffer[k - 1] != '\n')
+				--k;
+			whole -= step - k;
+			if (k)
+				break;
+		}
+		fclose(in);
+
+		if (whole < size) {
+			LOG_LINE("Cutting a torn record off potfile " << path << ". SIZE = " << size << " -> " << whole);
+			cut_file(path, whole);
+		}
+	}
+
+	file = fopen(path.c_str(), "ab");
+	if (!file)
+		return false;
+	seek_file(file, 0, SEEK_END);
+	end = (uint64)tell_file(file);
+	reader = fopen(path.c_str(), "rb");
+
+	// an index of a longer potfile belongs to another one, index it all again
+	if (map_index() && header->covered <= end)
+		scan(header->covered);
+	else {
+		unmap_index();
+		scan(0);
+	}
+
+	LOG_LINE("Opened potfile " << path << ". INDEXED = " << count << ". UNINDEXED = " << recent.size());
+
+	return reader != NULL;
+}
+
+bool potfile::map_index() {
+	const string name = path + ".index";
+
+#ifdef _WIN32
+	index_file = CreateFileA(name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (index_file == INVALID_HANDLE_VALUE) {
+		index_file = NULL;
+		return false;
+	}
+
+	LARGE_INTEGER length;
+	GetFileSizeEx(index_file, &length);
+	data_size = (uint64)length.QuadPart;
+
+	if (data_size) {
+		mapping = CreateFileMappingA(index_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		data = mapping ? (const uchar*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	}
+#else
+	index_file = ::open(name.c_str(), O_RDONLY);
+	if (index_file < 0)
+		return false;
+
+	struct stat info;
+	fstat(index_file, &info);
+	data_size = (uint64)info.st_size;
+
+	if (data_size) {
+		void* view = mmap(NULL, (size_t)data_size, PROT_READ, MAP_PRIVATE, index_file, 0);
+		data = (view == MAP_FAILED) ? NULL : (const uchar*)view;
+		if (data)
+			madvise(view, (size_t)data_size, MADV_RANDOM); // every probe lands somewhere else
+	}
+#endif
+
+	header = (const pot_index_header*)data;
+	if (!data || data_size < sizeof(pot_index_header) || memcmp(header->magic, POT_INDEX_MAGIC, sizeof(header->magic)) ||
+		!header->slots || (header->slots & (header->slots - 1)) || (data_size - sizeof(pot_index_header)) / sizeof(pot_slot) < header->slots) {
+		unmap_index();
+		return false;
+	}
+
+	slots = (const pot_slot*)(data + sizeof(pot_index_header));
+	count = header->count;
+	return true;
+}
+
+void potfile::unmap_index() {
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (index_file)
+		CloseHandle(index_file);
+	index_file = NULL;
+	mapping = NULL;
+#else
+	if (data)
+		munmap((void*)data, (size_t)data_size);
+	if (index_file >= 0)
+		::close(index_file);
+	index_file = -1;
+#endif
+
+	data = NULL;
+	data_size = 0;
+	header = NULL;
+	slots = NULL;
+	count = 0;
+}
+
+void potfile::scan(uint64 from) {
+	if (!reader || from >= end)
+		return;
+
+	seek_file(reader, from, SEEK_SET);
+	char line[POT_MAX_LINE];
+	uint64 at = from;
+	while (at < end && fgets(line, sizeof(line), reader)) {
+		size_t length = strlen(line);
+		uint64 next = at + length;
+
+		// longer than any record, skip the rest of it
+		if (length && line[length - 1] != '\n') {
+			int c;
+			while ((c = fgetc(reader)) != EOF && c != '\n')
+				++next;
+			++next;
+		}
+
+		uchar digest[MAX_DIGEST_SIZE];
+		uint size;
+		if (parse_record(line, length - (line[length - 1] == '\n'), digest, size, NULL))
+			recent.insert(make_pair(tag_of(digest), at));
+		at = next;
+	}
+}
+
+bool potfile::match(uint64 at, const char* digest, uint size, string* key) {
+	char line[POT_MAX_LINE];
+	seek_file(reader, at, SEEK_SET);
+	size_t length = fread(line, 1, sizeof(line), reader);
+	const char* newline = (const char*)memchr(line, '\n', length);
+	if (!newline)
+		return false;
+
+	uchar stored[MAX_DIGEST_SIZE];
+	uint stored_size;
+	string text;
+	if (!parse_record(line, newline - line, stored, stored_size, key ? &text : NULL) ||
+		stored_size < size || memcmp(stored, digest, size))
+		return false;
+
+	if (key)
+		*key = text;
+	return true;
+}
+
+bool potfile::find_locked(const char* digest, uint size, string* key) {
+	if (size < 8 || !reader)
+		return false;
+	const uint64 tag = tag_of((const uchar*)digest);
+
+	if (slots) {
+		const uint64 mask = header->slots - 1;
+		for (uint64 k = tag & mask; slots[k].at; k = (k + 1) & mask)
+			if (slots[k].tag == tag && match(slots[k].at - 1, digest, size, key))
+				return true;
+	}
+
+	pair<unordered_multimap<uint64, uint64>::iterator, unordered_multimap<uint64, uint64>::iterator> same = recent.equal_range(tag);
+	for (unordered_multimap<uint64, uint64>::iterator r = same.first; r != same.second; ++r)
+		if (match(r->second, digest, size, key))
+			return true;
+
+	return false;
+}
+
+bool potfile::find(const char* digest, uint size, string& key) {
+	lock_guard<mutex> guard(lock);
+	return find_locked(digest, size, &key);
+}
+
+bool potfile::add(const char* digest, uint size, const uchar* key, uint length) {
+	lock_guard<mutex> guard(lock);
+	if (!file || size < 8 || size > MAX_DIGEST_SIZE)
+		return false;
+	if (find_locked(digest, size, NULL))
+		return true;
+
+	string line;
+	for (uint k = 0; k < size; ++k) {
+		line += hex_chars[(uchar)digest[k] >> 4];
+		line += hex_chars[(uchar)digest[k] & 15];
+	}
+	line += ':' + encode_key(key, length) + '\n';
+
+	// flushed, so the reader sees it, but only sync() waits for the disk
+	if (fwrite(line.data(), 1, line.size(), file) != line.size() || fflush(file))
+		return false;
+
+	recent.insert(make_pair(tag_of((const uchar*)digest), end));
+	end += line.size();
+	return true;
+}
+
+void potfile::sync() {
+	lock_guard<mutex> guard(lock);
+	if (file) {
+		fflush(file);
+		sync_file(file);
+	}
+}
+
+uint potfile::filter(const target_set& targets, target_set& out, vector<uint>* positions) {
+	vector<char> drop(targets.size(), 0);
+	uint dropped = 0;
+	{
+		lock_guard<mutex> guard(lock);
+		for (uint k = 0; k < targets.size(); ++k) {
+			drop[k] = find_locked(targets.digest(k), targets.get_digest_size(), NULL);
+			dropped += drop[k];
+		}
+	}
+
+	targets.subset(drop, out, positions);
+
+	LOG_LINE("Filtered targets through potfile " << path << ". CRACKED = " << dropped << ". LEFT = " << out.size());
+
+	return dropped;
+}
+
+bool potfile::write_index() {
+	uint64 total = count + recent.size(), size = POT_MIN_SLOTS;
+	while (size < total * 2)
+		size <<= 1;
+
+	vector<pot_slot> table((size_t)size);
+	memset(&table[0], 0, (size_t)size * sizeof(pot_slot));
+	auto insert = [&](uint64 tag, uint64 at) {
+		uint64 k = tag & (size - 1);
+		while (table[(size_t)k].at)
+			k = (k + 1) & (size - 1);
+		table[(size_t)k].tag = tag;
+		table[(size_t)k].at = at + 1;
+	};
+
+	for (uint64 k = 0; slots && k < header->slots; ++k)
+		if (slots[k].at)
+			insert(slots[k].tag, slots[k].at - 1);
+	for (unordered_multimap<uint64, uint64>::iterator r = recent.begin(); r != recent.end(); ++r)
+		insert(r->first, r->second);
+
+	pot_index_header next;
+	memcpy(next.magic, POT_INDEX_MAGIC, sizeof(next.magic));
+	next.covered = end;
+	next.slots = size;
+	next.count = total;
+
+	// a new index replaces the old one whole, a crash leaves one of them
+	const string name = path + ".index", temp = name + ".tmp";
+	FILE* out = fopen(temp.c_str(), "wb");
+	if (!out)
+		return false;
+	bool written = fwrite(&next, sizeof(next), 1, out) == 1 &&
+		fwrite(&table[0], sizeof(pot_slot), table.size(), out) == table.size() && !fflush(out) && !sync_file(out);
+	written = !fclose(out) && written;
+
+	unmap_index();
+#ifdef _WIN32
+	if (written)
+		remove(name.c_str()); // rename does not replace there
+#endif
+	written = written && rename(temp.c_str(), name.c_str()) == 0;
+
+	LOG_LINE("Wrote potfile index " << name << ". RECORDS = " << total << ". SLOTS = " << size << (written ? "" : " (failed)"));
+
+	return written;
+}
+
+void potfile::close() {
+	lock_guard<mutex> guard(lock);
+	if (file) {
+		fflush(file);
+		sync_file(file);
+		fclose(file);
+	}
+	if (!recent.empty())
+		write_index();
+	if (reader)
+		fclose(reader);
+
+	unmap_index();
+	recent.clear();
+	file = NULL;
+	reader = NULL;
+	end = 0;
+}
+
+potfile::potfile() {
+	file = NULL;
+	reader = NULL;
+	end = 0;
+	count = 0;
+	data = NULL;
+	data_size = 0;
+	header = NULL;
+	slots = NULL;
+#ifdef _WIN32
+	index_file = NULL;
+	mapping = NULL;
+#else
+	index_file = -1;
+#endif
+}
+potfile::~potfile() {
+	close();
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "targets.h"
+#include "types.h"
+
+using namespace std;
+
+#define POT_INDEX_MAGIC "SMPOTIX1" // first 8 bytes of an index file
+#define POT_MIN_SLOTS 1024
+#define POT_MAX_LINE 256 // longest record: a digest, ':' and a $HEX[] key
+
+
+// fixed part of an index file, followed by 'slots' pot_slot entries
+struct pot_index_header {
+	char magic[8];
+	uint64 covered; // potfile bytes the slots cover
+	uint64 slots; // a power of two
+	uint64 count;
+};
+
+// first 8 digest bytes and the record's offset + 1, 0 for an empty slot
+struct pot_slot {
+	uint64 tag;
+	uint64 at;
+};
+
+/*Every key cracked so far, one "digest:key" line per hit, the key as
+$HEX[...] unless it is printable. The file is only ever appended to;
+a record counts once its newline is on the disk, a torn last line is
+cut off on the next open.
+Next to it, path + ".index" is an open addressing table of record
+offsets keyed on the digest's first 8 bytes, mapped and probed in
+place, so finding a digest costs a probe or two however big the
+potfile gets. Records the index does not cover yet (appended since
+it was written, or after a crash) are kept in memory and written into
+a new index by close(). All members are thread-safe.*/
+class potfile {
+public:
+	/*Opens or creates 'path' and its index, indexing whatever records
+	the index is missing. Returns false if the potfile can not be
+	written.*/
+	bool open(const string& path);
+
+	// writes the index again if it is missing records
+	void close();
+
+	/*Key of the first 'size' bytes of a digest, false if it is not
+	cracked. Records of longer digests match on their prefix.*/
+	bool find(const char* digest, uint size, string& key);
+
+	/*Appends a cracked key unless its digest is known. Records reach
+	the disk with sync().*/
+	bool add(const char* digest, uint size, const uchar* key, uint length);
+
+	// flushes and fsyncs what add() wrote
+	void sync();
+
+	/*Copies the targets not cracked yet into 'out', one probe each;
+	returns how many were dropped. Target k of 'out' was target
+	positions[k] of 'targets'.*/
+	uint filter(const target_set& targets, target_set& out, vector<uint>* positions = NULL);
+
+	uint64 size() { return count + (uint64)recent.size(); }
+
+	potfile();
+	~potfile();
+private:
+	string path;
+	FILE* file; // appends
+	FILE* reader; // reads records back
+	uint64 end; // size of the potfile
+
+	mutex lock;
+	uint64 count; // records in the mapped index
+	unordered_multimap<uint64, uint64> recent; // tag -> offset of records past the index
+
+	// mapped index, NULL if there is none
+	const uchar* data;
+	uint64 data_size;
+	const pot_index_header* header;
+	const pot_slot* slots;
+
+#ifdef _WIN32
+	void* index_file;
+	void* mapping;
+#else
+	int index_file;
+#endif
+
+	bool map_index();
+	void unmap_index();
+
+	// adds the records in [from, end) to 'recent'
+	void scan(uint64 from);
+
+	// the record at 'at' matches 'digest', its key goes to 'key'
+	bool match(uint64 at, const char* digest, uint size, string* key);
+
+	bool find_locked(const char* digest, uint size, string* key);
+
+	bool write_index();
+};
@@ -0,0 +1,57 @@
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include "program_cache.h"
+#include "log.h"
+
+uint64 program_cache::hash(const string& text) {
+	uint64 h = 0xcbf29ce484222325ULL;
+	for (size_t k = 0; k < text.size(); ++k) {
+		h ^= (uchar)text[k];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+void program_cache::init(const string& device, const string& driver, const string& options, const string& source) {
+	stringstream k;
+	k << device << " | " << driver << " | " << options << " | " << hex << setw(16) << setfill('0') << hash(source);
+	key = k.str();
+
+	stringstream p;
+	p << CACHE_PREFIX << hex << setw(16) << setfill('0') << hash(key) << CACHE_SUFFIX;
+	path = p.str();
+}
+
+bool program_cache::load(vector<uchar>& binary) {
+	ifstream file(path.c_str(), ios::binary);
+	string stored;
+	if (!file || !getline(file, stored) || stored != key)
+		return false;
+
+	binary.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+
+	LOG_LINE("Loaded program binary from " << path << ". SIZE = " << binary.size());
+
+	return !binary.empty();
+}
+
+void program_cache::save(const vector<uchar>& binary) {
+	if (binary.empty())
+		return;
+
+	// write aside and rename, a concurrent start never reads half a file
+	string temp = path + ".tmp";
+	{
+		ofstream file(temp.c_str(), ios::binary | ios::trunc);
+		file << key << '\n';
+		file.write((const char*)&binary[0], binary.size());
+		if (!file)
+			return;
+	}
+	remove(path.c_str());
+	rename(temp.c_str(), path.c_str());
+
+	LOG_LINE("Saved program binary to " << path << ". SIZE = " << binary.size());
+}
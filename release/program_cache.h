@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+#define CACHE_PREFIX "smasher-" // cache files go next to TUNE_FILE, one per build key
+#define CACHE_SUFFIX ".clbin"
+
+
+/*Compiled program binaries (CL_PROGRAM_BINARIES) stored on disk, so a
+warm start skips the build. The key names everything the binary
+depends on: device, driver version, build options and a hash of the
+source. A file holds its full key in front of the binary and is only
+used if that key matches.*/
+class program_cache {
+public:
+	// 64-bit FNV-1a, for source hashes and file names
+	static uint64 hash(const string& text);
+
+	void init(const string& device, const string& driver, const string& options, const string& source);
+
+	// false if there is no binary for the key
+	bool load(vector<uchar>& binary);
+
+	void save(const vector<uchar>& binary);
+
+	const string& get_key() { return key; }
+private:
+	string key;
+	string path;
+};
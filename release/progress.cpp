@@ -0,0 +1,286 @@
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include "progress.h"
+#include "log.h"
+
+#ifdef _WIN32
+#include <io.h>
+static int sync_file(FILE* f) { return _commit(_fileno(f)); }
+#else
+#include <unistd.h>
+static int sync_file(FILE* f) { return fsync(fileno(f)); }
+#endif
+
+static bool parse_number(const char* text, uint64& value) {
+	// strtoull would take a sign or leading spaces, "-1" becomes 2 ** 64 - 1
+	if (*text < '0' || *text > '9')
+		return false;
+
+	char* end;
+	errno = 0;
+	value = strtoull(text, &end, 10);
+	return !*end && errno != ERANGE;
+}
+
+bool keyspace_slice::parse(int argc, char** argv) {
+	const string names[] = { "--skip", "--limit" };
+	uint64* values[] = { &skip, &limit };
+
+	for (int a = 1; a < argc; ++a) {
+		string arg = argv[a];
+		for (uint k = 0; k < 2; ++k) {
+			const char* text = NULL;
+			if (arg == names[k]) {
+				if (a + 1 >= argc)
+					return false;
+				text = argv[++a];
+			}
+			else if (!arg.compare(0, names[k].size() + 1, names[k] + "="))
+				text = argv[a] + names[k].size() + 1;
+			else
+				continue;
+
+			if (!parse_number(text, *values[k]))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+keyspace_slice keyspace_slice::part(uint64 total, uint k, uint n) {
+	keyspace_slice slice;
+	if (!n || k >= n)
+		return slice;
+
+	uint64 size = total / n;
+	slice.skip = size * k;
+	slice.limit = (k + 1 == n) ? total - slice.skip : size;
+	return slice;
+}
+
+block_range keyspace_slice::resolve(uint64 total) const {
+	block_range range = { skip, 0 };
+	if (skip < total)
+		range.count = (limit && limit < total - skip) ? limit : total - skip;
+	return range;
+}
+
+// 32-bit FNV-1a, guards each record against torn writes
+static uint checksum(const string& text) {
+	uint h = 0x811c9dc5;
+	for (size_t k = 0; k < text.size(); ++k) {
+		h ^= (uchar)text[k];
+		h *= 0x01000193;
+	}
+	return h;
+}
+
+static string record(const string& body) {
+	stringstream s;
+	s << body << ' ' << hex << checksum(body) << '\n';
+	return s.str();
+}
+
+// "index target rule", then the high index bits if there are any
+static string hit_fields(const target_hit& found) {
+	stringstream s;
+	s << found.index << ' ' << found.target << ' ' << found.rule;
+	if (found.index_hi)
+		s << ' ' << found.index_hi;
+	return s.str();
+}
+
+bool progress_journal::open(const string& path, const string& job) {
+	lock_guard<mutex> guard(lock);
+	const string header = string(JOURNAL_MAGIC) + '\t' + job;
+
+	// load what an earlier run finished, stop at the first damaged record
+	{
+		ifstream in(path.c_str());
+		string line;
+		if (getline(in, line) && line != header) {
+			LOG_LINE("Journal " << path << " belongs to another job");
+			return false;
+		}
+
+		while (getline(in, line)) {
+			size_t space = line.rfind(' ');
+			if (space == string::npos)
+				break;
+
+			uint sum = (uint)strtoul(line.c_str() + space + 1, NULL, 16);
+			string body = line.substr(0, space);
+			if (sum != checksum(body))
+				break;
+
+			stringstream fields(body);
+			char kind;
+			fields >> kind;
+			if (kind == 'D') {
+				uint64 first, count;
+				if (fields >> first >> count)
+					insert(first, first + count);
+			}
+			else if (kind == 'H') {
+				target_hit found;
+				if (fields >> found.index >> found.target >> found.rule) {
+					// high index bits only follow past block 2 ** 54
+					if (!(fields >> found.index_hi))
+						found.index_hi = 0;
+					hits.push_back(found);
+				}
+			}
+		}
+	}
+
+	// rewrite it compacted, then append to the new copy
+	string temp = path + ".tmp";
+	file = fopen(temp.c_str(), "wb");
+	if (!file)
+		return false;
+
+	fputs((header + '\n').c_str(), file);
+	for (size_t k = 0; k < hits.size(); ++k) {
+		stringstream s;
+		s << "H " << hit_fields(hits[k]);
+		fputs(record(s.str()).c_str(), file);
+	}
+	for (map<uint64, uint64>::iterator r = ranges.begin(); r != ranges.end(); ++r) {
+		stringstream s;
+		s << "D " << r->first << ' ' << r->second - r->first;
+		fputs(record(s.str()).c_str(), file);
+	}
+	fflush(file);
+	sync_file(file);
+	fclose(file);
+
+#ifdef _WIN32
+	remove(path.c_str()); // rename does not replace there
+#endif
+	file = (rename(temp.c_str(), path.c_str()) == 0) ? fopen(path.c_str(), "ab") : NULL;
+	last_sync = chrono::steady_clock::now();
+
+	uint64 finished = 0;
+	for (map<uint64, uint64>::iterator r = ranges.begin(); r != ranges.end(); ++r)
+		finished += r->second - r->first;
+
+	LOG_LINE("Opened journal " << path << ". DONE = " << finished << " blocks in " << ranges.size() << " ranges. HITS = " << hits.size());
+
+	return file != NULL;
+}
+
+void progress_journal::insert(uint64 first, uint64 end) {
+	if (first >= end)
+		return;
+
+	// merge with every range it touches
+	map<uint64, uint64>::iterator r = ranges.upper_bound(first);
+	if (r != ranges.begin() && prev(r)->second >= first)
+		--r;
+
+	while (r != ranges.end() && r->first <= end) {
+		if (r->first < first)
+			first = r->first;
+		if (r->second > end)
+			end = r->second;
+		r = ranges.erase(r);
+	}
+
+	ranges[first] = end;
+}
+
+void progress_journal::write(const string& text) {
+	if (file)
+		fputs(text.c_str(), file);
+}
+
+void progress_journal::flush() {
+	if (!file)
+		return;
+
+	fflush(file);
+	sync_file(file);
+	last_sync = chrono::steady_clock::now();
+}
+
+void progress_journal::hit(const target_hit& found) {
+	lock_guard<mutex> guard(lock);
+
+	stringstream s;
+	s << "H " << hit_fields(found);
+	write(record(s.str()));
+	hits.push_back(found);
+}
+
+void progress_journal::done(uint64 first, uint64 count) {
+	lock_guard<mutex> guard(lock);
+
+	stringstream s;
+	s << "D " << first << ' ' << count;
+	write(record(s.str()));
+	insert(first, first + count);
+
+	// a crash costs at most the ranges since the last sync
+	if (chrono::steady_clock::now() - last_sync >= chrono::milliseconds(JOURNAL_SYNC_MS))
+		flush();
+}
+
+void progress_journal::sync() {
+	lock_guard<mutex> guard(lock);
+	flush();
+}
+
+vector<block_range> progress_journal::pending(uint64 first, uint64 count) {
+	lock_guard<mutex> guard(lock);
+	vector<block_range> gaps;
+	const uint64 end = first + count;
+
+	map<uint64, uint64>::iterator r = ranges.upper_bound(first);
+	if (r != ranges.begin())
+		--r;
+
+	uint64 cursor = first;
+	for (; r != ranges.end() && r->first < end; ++r) {
+		if (r->second <= cursor)
+			continue;
+		if (r->first > cursor) {
+			block_range gap = { cursor, r->first - cursor };
+			gaps.push_back(gap);
+		}
+		cursor = r->second;
+	}
+
+	if (cursor < end) {
+		block_range gap = { cursor, end - cursor };
+		gaps.push_back(gap);
+	}
+
+	return gaps;
+}
+
+uint64 progress_journal::get_done() {
+	lock_guard<mutex> guard(lock);
+	uint64 finished = 0;
+	for (map<uint64, uint64>::iterator r = ranges.begin(); r != ranges.end(); ++r)
+		finished += r->second - r->first;
+	return finished;
+}
+
+vector<target_hit> progress_journal::get_hits() {
+	lock_guard<mutex> guard(lock);
+	return hits;
+}
+
+progress_journal::progress_journal() {
+	file = NULL;
+}
+progress_journal::~progress_journal() {
+	if (file) {
+		flush();
+		fclose(file);
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "targets.h"
+#include "types.h"
+
+using namespace std;
+
+#define JOURNAL_MAGIC "smasher-journal 1"
+#define JOURNAL_SYNC_MS 10000 // completed ranges reach the disk at most this often
+
+
+// blocks [first, first + count)
+struct block_range {
+	uint64 first;
+	uint64 count;
+};
+
+/*A fixed part of a keyspace, so a search can be split across machines
+without talking to each other: blocks [skip, skip + limit), limit 0 for
+the rest of the keyspace. scheduler::set_slice() applies it to block
+searches; anything else has to resolve() it itself.*/
+struct keyspace_slice {
+	uint64 skip;
+	uint64 limit;
+
+	/*Reads "--skip N" / "--skip=N" and "--limit N" / "--limit=N" from
+	the command line, other arguments are ignored. Returns false on a
+	missing or malformed number; only plain decimal digits are taken.*/
+	bool parse(int argc, char** argv);
+
+	// part k of n equal parts of 'total' blocks, the last one takes the rest
+	static keyspace_slice part(uint64 total, uint k, uint n);
+
+	// the slice within a keyspace of 'total' blocks, count 0 if it lies past the end
+	block_range resolve(uint64 total) const;
+
+	keyspace_slice() : skip(0), limit(0) {}
+};
+
+/*Append-only record of the block ranges a search has finished, and of
+the hits found in them, so a restarted search never hashes them again.
+Records carry a checksum and a torn last line is ignored, so a crash
+at any point loses at most the ranges since the last sync. Syncs
+(flush and fsync) are batched to once every JOURNAL_SYNC_MS. The job
+string (hash, targets, mode) is stored in the header; a journal of
+another job is not resumed. All members are thread-safe.*/
+class progress_journal {
+public:
+	/*Opens or creates the journal at 'path' and loads what is done.
+	The file is compacted to one record per merged range. Returns
+	false if it can not be written or belongs to another job.*/
+	bool open(const string& path, const string& job);
+
+	// records a finished range, hits of it first
+	void done(uint64 first, uint64 count);
+	void hit(const target_hit& found);
+
+	// forces everything recorded so far to the disk
+	void sync();
+
+	// the parts of [first, first + count) not done yet, in order
+	vector<block_range> pending(uint64 first, uint64 count);
+
+	uint64 get_done();
+
+	// hits of the finished ranges, including earlier runs
+	vector<target_hit> get_hits();
+
+	progress_journal();
+	~progress_journal();
+private:
+	FILE* file;
+	mutex lock;
+	map<uint64, uint64> ranges; // first -> end of merged finished ranges
+	vector<target_hit> hits;
+	chrono::steady_clock::time_point last_sync;
+
+	void insert(uint64 first, uint64 end);
+	void write(const string& record);
+	void flush();
+};
@@ -0,0 +1,473 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include "rainbow.h"
+#include "pool.h"
+#include "scheduler.h"
+#include "log.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+typedef pair<uint64, uint64> chain_end; // end, start
+
+uint rainbow_key(const key_mask* mask, uint length, uint64 index, uchar* key) {
+	if (mask) {
+		mask->candidate(index, length, key);
+		return length;
+	}
+
+	// big-endian counter, like smasher::confirm()
+	for (uint k = 0; k < KEY_SIZE; ++k) {
+		uint shift = (KEY_SIZE - k - 1) * 8;
+		key[k] = (uchar)((shift < 64) ? index >> shift : 0);
+	}
+	return KEY_SIZE;
+}
+
+uint64 rainbow_walk(const hash_algo& algo, const key_mask* mask, uint length, uint64 index, uint from, uint to, uint64 space) {
+	uchar key[MAX_KEY_LEN];
+	uchar digest[MAX_DIGEST_SIZE];
+	for (uint c = from; c < to; ++c) {
+		hash_digest(algo, key, rainbow_key(mask, length, index, key), digest);
+		index = rainbow_reduce(digest, c, space);
+	}
+	return index;
+}
+
+static void put_varint(vector<uchar>& out, uint64 x) {
+	while (x >= 0x80) {
+		out.push_back((uchar)(x | 0x80));
+		x >>= 7;
+	}
+	out.push_back((uchar)x);
+}
+
+// false if the varint runs into 'end' or past 64 bits
+static bool get_varint(const uchar*& p, const uchar* end, uint64& x) {
+	x = 0;
+	for (uint shift = 0; p < end && shift < 64; shift += 7) {
+		uchar b = *p++;
+		x |= (uint64)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+// sorts 'run' and writes it to a new run file next to 'path'
+static bool spill(const string& path, vector<string>& runs, vector<chain_end>& run) {
+	sort(run.begin(), run.end());
+
+	stringstream name;
+	name << path << ".run" << runs.size();
+	runs.push_back(name.str());
+
+	FILE* out = fopen(runs.back().c_str(), "wb");
+	if (!out)
+		return false;
+
+	bool written = fwrite(&run[0], sizeof(chain_end), run.size(), out) == run.size();
+	written = !fclose(out) && written;
+	LOG_LINE("Spilled rainbow run " << runs.back() << ". CHAINS = " << run.size());
+
+	run.clear();
+	return written;
+}
+
+/*Streams the groups and the index of a table into 'out', which
+already holds the header and the mask. 'next' yields the chains
+sorted by end, false at the end.*/
+static bool write_groups(FILE* out, rainbow_header& header, const function<bool(chain_end&)>& next) {
+	vector<uint64> index;
+	vector<uchar> group;
+	uint64 at = (uint64)ftell(out), last = 0;
+	header.chains = 0;
+
+	chain_end chain;
+	while (next(chain)) {
+		// merged with the chain before, same end from here on
+		if (header.chains && chain.first == last)
+			continue;
+
+		if (header.chains % RAINBOW_GROUP == 0) {
+			if (!group.empty() && fwrite(&group[0], 1, group.size(), out) != group.size())
+				return false;
+			at += group.size();
+			group.clear();
+
+			index.push_back(chain.first);
+			index.push_back(at);
+			last = chain.first;
+		}
+
+		put_varint(group, chain.first - last);
+		put_varint(group, chain.second);
+		last = chain.first;
+		++header.chains;
+	}
+
+	// the index is read in place, keep it aligned
+	group.resize(group.size() + (8 - (at + group.size()) % 8) % 8, 0);
+	if (!group.empty() && fwrite(&group[0], 1, group.size(), out) != group.size())
+		return false;
+	header.index_at = at + group.size();
+
+	if (!index.empty() && fwrite(&index[0], sizeof(uint64), index.size(), out) != index.size())
+		return false;
+
+	return !fseek(out, 0, SEEK_SET) && fwrite(&header, sizeof(header), 1, out) == 1;
+}
+
+bool rainbow_build(scheduler& s, const string& path, const key_mask* mask, uint length, uint64 chains, uint columns, uint64 space) {
+	const hash_algo& algo = s.get_algo();
+	if (mask)
+		space = (length && length <= mask->get_positions()) ? mask->keyspace(length) : 0;
+	else
+		length = 0;
+
+	// the kernel hashes keys that fit one block, and starts are key indices
+	uint bytes = mask ? length : KEY_SIZE;
+	if (!space || !chains || chains > space || !columns || (algo.utf16 ? bytes * 2 : bytes) > MAX_KEY_LEN)
+		return false;
+
+	LOG_LINE("Building rainbow table " << path << ". CHAINS = " << chains << ". COLUMNS = " << columns << ". KEYSPACE = " << space);
+
+	mutex lock;
+	vector<chain_end> run;
+	run.reserve((size_t)min<uint64>(chains, RAINBOW_RUN));
+	vector<string> runs;
+	bool spilled = true;
+
+	s.set_mask(mask, length);
+	bool walked = s.make_chains(0, chains, columns, space,
+		[&](uint64 first, const vector<uint64>& ends) {
+			lock_guard<mutex> guard(lock);
+			for (size_t k = 0; k < ends.size(); ++k)
+				run.push_back(chain_end(ends[k], first + k));
+			if (run.size() >= RAINBOW_RUN)
+				spilled = spill(path, runs, run) && spilled;
+		});
+	s.set_mask(NULL, 0);
+
+	// the last run never leaves memory
+	sort(run.begin(), run.end());
+
+	vector<FILE*> readers;
+	for (size_t r = 0; r < runs.size(); ++r) {
+		readers.push_back(fopen(runs[r].c_str(), "rb"));
+		spilled = readers.back() && spilled;
+	}
+
+	/*K-way merge of the run files and the last run, smallest end
+	first; source readers.size() is the last run.*/
+	typedef pair<chain_end, size_t> head;
+	priority_queue<head, vector<head>, greater<head> > heads;
+	size_t in_memory = 0;
+	auto refill = [&](size_t source) {
+		chain_end chain;
+		if (source == readers.size()) {
+			if (in_memory < run.size())
+				heads.push(head(run[in_memory++], source));
+		}
+		else if (readers[source] && fread(&chain, sizeof(chain), 1, readers[source]) == 1)
+			heads.push(head(chain, source));
+	};
+	for (size_t r = 0; r <= readers.size(); ++r)
+		refill(r);
+
+	rainbow_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, RAINBOW_MAGIC, sizeof(header.magic));
+	header.hash = algo.type;
+	header.columns = columns;
+	header.space = space;
+	header.length = length;
+	header.group = RAINBOW_GROUP;
+
+	string temp = path + ".tmp";
+	FILE* out = (walked && spilled) ? fopen(temp.c_str(), "wb") : NULL;
+	bool written = out && fwrite(&header, sizeof(header), 1, out) == 1;
+	if (written && mask)
+		written = fwrite(mask->get_chars(), 256, length, out) == length &&
+			fwrite(mask->get_radix(), sizeof(uint), length, out) == length;
+
+	written = written && write_groups(out, header,
+		[&](chain_end& chain) {
+			if (heads.empty())
+				return false;
+			chain = heads.top().first;
+			size_t source = heads.top().second;
+			heads.pop();
+			refill(source);
+			return true;
+		});
+
+	if (out)
+		written = !fclose(out) && written;
+
+	for (size_t r = 0; r < runs.size(); ++r) {
+		if (readers[r])
+			fclose(readers[r]);
+		remove(runs[r].c_str());
+	}
+
+	LOG_LINE("Built rainbow table " << path << ". CHAINS = " << header.chains << (written ? "" : " (failed)"));
+
+	if (!written) {
+		remove(temp.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	remove(path.c_str()); // rename does not replace there
+#endif
+	return rename(temp.c_str(), path.c_str()) == 0;
+}
+
+bool rainbow_table::open(const string& path, const hash_algo& algo, const key_mask* mask) {
+	close();
+
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = NULL;
+		return false;
+	}
+
+	LARGE_INTEGER length;
+	GetFileSizeEx(file, &length);
+	size = (uint64)length.QuadPart;
+
+	if (size) {
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		data = mapping ? (const uchar*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	}
+#else
+	file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info;
+	fstat(file, &info);
+	size = (uint64)info.st_size;
+
+	if (size) {
+		void* view = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, file, 0);
+		data = (view == MAP_FAILED) ? NULL : (const uchar*)view;
+		if (data)
+			madvise(view, (size_t)size, MADV_RANDOM); // lookups touch a group here and there
+	}
+#endif
+
+	if (!data || size < sizeof(header)) {
+		close();
+		return false;
+	}
+
+	memcpy(&header, data, sizeof(header));
+	groups = header.group ? (header.chains + header.group - 1) / header.group : 0;
+	const uint64 positions = sizeof(header) + (uint64)header.length * (256 + sizeof(uint));
+
+	bool valid = !memcmp(header.magic, RAINBOW_MAGIC, sizeof(header.magic)) && header.hash == (uint)algo.type &&
+		header.group && header.space && header.columns && header.index_at % 8 == 0 &&
+		header.index_at >= positions && header.index_at <= size && (size - header.index_at) / 16 >= groups;
+
+	// the keyspace must be the one of the table, position by position
+	if (valid && header.length)
+		valid = mask && mask->get_positions() >= header.length &&
+			!memcmp(data + sizeof(header), mask->get_chars(), header.length * 256) &&
+			!memcmp(data + sizeof(header) + header.length * 256, mask->get_radix(), header.length * sizeof(uint));
+	else if (valid)
+		valid = !mask;
+
+	if (!valid) {
+		LOG_LINE("Not a rainbow table of " << algo.name << " for this keyspace: " << path);
+		close();
+		return false;
+	}
+
+	/*Group offsets come from the file too: each one must lie in the
+	group area, past the one before, and groups must be sorted by
+	their first end, or find() would read outside the mapping.*/
+	index = (const uint64*)(data + header.index_at);
+	for (uint64 g = 0; g < groups && valid; ++g)
+		valid = index[g * 2 + 1] >= (g ? index[g * 2 - 1] + 1 : positions) && index[g * 2 + 1] < header.index_at &&
+			(!g || index[g * 2] >= index[g * 2 - 2]);
+
+	if (!valid) {
+		LOG_LINE("Rainbow table group index is damaged: " << path);
+		close();
+		return false;
+	}
+
+	this->algo = &algo;
+	this->mask = header.length ? mask : NULL;
+
+	LOG_LINE("Mapped rainbow table " << path << ". CHAINS = " << header.chains << ". COLUMNS = " << header.columns << ". KEYSPACE = " << header.space);
+
+	return true;
+}
+
+void rainbow_table::close() {
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	file = NULL;
+	mapping = NULL;
+#else
+	if (data)
+		munmap((void*)data, (size_t)size);
+	if (file >= 0)
+		::close(file);
+	file = -1;
+#endif
+
+	data = NULL;
+	size = 0;
+	index = NULL;
+	groups = 0;
+	memset(&header, 0, sizeof(header));
+}
+
+bool rainbow_table::find(uint64 end, uint64& start) const {
+	// the last group whose first end is not past 'end'
+	uint64 low = 0, high = groups;
+	while (low < high) {
+		uint64 middle = low + (high - low) / 2;
+		if (index[middle * 2] <= end)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if (!low)
+		return false;
+
+	// a group ends where the next one, or the index, begins
+	const uint64 g = low - 1;
+	const uchar* p = data + index[g * 2 + 1];
+	const uchar* stop = data + ((g + 1 < groups) ? index[g * 2 + 3] : header.index_at);
+	const uint64 count = (g + 1 < groups) ? header.group : header.chains - g * header.group;
+	uint64 at = index[g * 2];
+	for (uint64 k = 0; k < count; ++k) {
+		uint64 delta, first;
+		if (!get_varint(p, stop, delta) || !get_varint(p, stop, first))
+			return false;
+		at += delta;
+		if (at == end) {
+			start = first;
+			return true;
+		}
+		if (at > end)
+			return false;
+	}
+	return false;
+}
+
+int rainbow_table::lookup(scheduler& s, const target_set& targets, vector<target_hit>& hits) {
+	if (!data || targets.get_digest_size() < 8)
+		return 0;
+
+	// a target and the column it is assumed in, and the chain that reached a stored end from there
+	struct candidate {
+		uint target;
+		uint column;
+		uint64 start;
+	};
+
+	const uint columns = header.columns;
+	const uint pass = (columns < RAINBOW_LOOKUP) ? RAINBOW_LOOKUP / columns : 1;
+	work_pool verify;
+	mutex lock;
+	int found = 0;
+
+	if (!s.set_mask(mask, header.length))
+		return 0;
+	for (uint first = 0; first < targets.size(); first += pass) {
+		const uint count = (targets.size() - first < pass) ? targets.size() - first : pass;
+
+		vector<uint64> chains((size_t)count * columns);
+		for (uint t = 0; t < count; ++t)
+			for (uint c = 0; c < columns; ++c)
+				chains[(size_t)t * columns + c] = rainbow_reduce((const uchar*)targets.digest(first + t), c, header.space);
+
+		if (!s.walk_chains(chains, columns, header.space))
+			break;
+
+		vector<candidate> candidates;
+		for (size_t k = 0; k < chains.size(); ++k) {
+			candidate next = { first + (uint)(k / columns), (uint)(k % columns), 0 };
+			if (find(chains[k], next.start))
+				candidates.push_back(next);
+		}
+
+		// most candidates are false alarms, rebuilding them is the host's share of the work
+		vector<char> solved(count, 0);
+		verify.run(0, candidates.size(), 1,
+			[&](uint, uint64 a, uint64 b) {
+				for (uint64 k = a; k < b; ++k) {
+					const candidate& c = candidates[k];
+					{
+						lock_guard<mutex> guard(lock);
+						if (solved[c.target - first])
+							continue;
+					}
+
+					uchar key[MAX_KEY_LEN];
+					uchar digest[MAX_DIGEST_SIZE];
+					uint64 at = rainbow_walk(*algo, mask, header.length, c.start, 0, c.column, header.space);
+					if (!hash_digest(*algo, key, rainbow_key(mask, header.length, at, key), digest) ||
+						memcmp(digest, targets.digest(c.target), targets.get_digest_size()))
+						continue;
+
+					lock_guard<mutex> guard(lock);
+					if (!solved[c.target - first]) {
+						solved[c.target - first] = 1;
+						target_hit hit = { at, c.target, 0, 0 };
+						hits.push_back(hit);
+						++found;
+					}
+				}
+				return false;
+			});
+
+		LOG_LINE("Looked up " << count << " targets. CANDIDATES = " << candidates.size());
+	}
+	s.set_mask(NULL, 0);
+
+	return found;
+}
+
+rainbow_table::rainbow_table() {
+	data = NULL;
+	size = 0;
+	index = NULL;
+	groups = 0;
+	algo = NULL;
+	mask = NULL;
+	memset(&header, 0, sizeof(header));
+#ifdef _WIN32
+	file = NULL;
+	mapping = NULL;
+#else
+	file = -1;
+#endif
+}
+
+rainbow_table::~rainbow_table() {
+	close();
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "hash_cpu.h"
+#include "mask.h"
+#include "targets.h"
+#include "types.h"
+
+using namespace std;
+
+#define RAINBOW_MAGIC "SMRAIN01" // first 8 bytes of a table file
+#define RAINBOW_COLUMNS 4096 // default chain length
+#define RAINBOW_RUN (1 << 22) // chains sorted in memory before they go to a run file
+#define RAINBOW_GROUP 256 // chains per compressed group, one index entry each
+#define RAINBOW_LOOKUP (1 << 24) // lookup walks per pass, targets times columns
+
+class scheduler;
+
+/*Time-memory tradeoff tables over a fixed-length keyspace of 'space'
+keys: the keys of one length of a mask, or the first 'space' counter
+keys without one. A chain starts at a key index; each of its columns
+hashes the key there and reduces the digest to the next index, with a
+reduction that depends on the column, so chains that collide in
+different columns do not merge. Only the start and the end of every
+chain are stored, sorted by end. A lookup walks a target from every
+column to the end and rebuilds the chains whose end it reaches.*/
+
+// key 'index' of a table's keyspace, counter keys for a NULL mask; returns its length
+uint rainbow_key(const key_mask* mask, uint length, uint64 index, uchar* key);
+
+// key index of column 'column' + 1 from the digest of column 'column', as in smash_chains
+inline uint64 rainbow_reduce(const uchar* digest, uint column, uint64 space) {
+	uint64 low = 0;
+	for (uint k = 8; k-- > 0;)
+		low = (low << 8) | digest[k];
+	return (low + column) % space;
+}
+
+// chain index 'index' after columns [from, to), on the host
+uint64 rainbow_walk(const hash_algo& algo, const key_mask* mask, uint length, uint64 index, uint from, uint to, uint64 space);
+
+// fixed part of a table file, in host byte order
+struct rainbow_header {
+	char magic[8];
+	uint hash; // hash_type
+	uint columns;
+	uint64 space;
+	uint64 chains; // stored, merged ones dropped
+	uint length; // mask length, 0 for counter keys
+	uint group; // chains per group
+	uint64 index_at; // file offset of the group index
+};
+
+/*Builds a table of 'chains' chains starting at key indices 0 to
+chains - 1 on every device of 's', leaving it on the counter keyspace.
+Chain ends are sorted RAINBOW_RUN at a time and spilled to run files
+next to 'path', then merged into it, so memory stays bounded however
+big the table gets. Chains with the same end merged on the way, only
+one of them is kept. 'space' is for counter keys, a mask has its own.*/
+bool rainbow_build(scheduler& s, const string& path, const key_mask* mask, uint length,
+	uint64 chains, uint columns = RAINBOW_COLUMNS, uint64 space = 0);
+
+/*A table file mapped into memory: the header, the chars and radix of
+the mask's positions (256 + 4 bytes each), the groups, then the group
+index of (first end, file offset) pairs. A group holds RAINBOW_GROUP
+chains as varints, the end as its delta from the end before (the
+group's first end for the first chain) and the start.*/
+class rainbow_table {
+public:
+	/*Maps 'path', false if it is no table of 'algo' or if it was
+	built for another mask; 'mask' is NULL for counter keys.*/
+	bool open(const string& path, const hash_algo& algo, const key_mask* mask);
+	void close();
+
+	// start of the chain that ends at 'end', false if there is none
+	bool find(uint64 end, uint64& start) const;
+
+	/*Looks every target up on the devices of 's', which must run
+	the table's hash, leaving them on the counter keyspace. Hits
+	hold the key index in the table's keyspace.*/
+	int lookup(scheduler& s, const target_set& targets, vector<target_hit>& hits);
+
+	const rainbow_header& get_header() const { return header; }
+
+	rainbow_table();
+	~rainbow_table();
+private:
+	const uchar* data;
+	uint64 size;
+	rainbow_header header;
+	const uint64* index; // first end and file offset of every group
+	uint64 groups;
+
+	const hash_algo* algo;
+	const key_mask* mask;
+
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+};
@@ -0,0 +1,214 @@
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "mask.h"
+#include "rules.h"
+#include "wordlist.h"
+#include "log.h"
+
+// 0-9 then A-Z, -1 if 'c' is no position
+static int position(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+	return -1;
+}
+
+bool rule_set::add(const string& rule) {
+	vector<uchar> compiled;
+
+	for (size_t k = 0; k < rule.size(); ++k) {
+		uchar op, a = 0, b = 0;
+		uint args = 0; // chars following the rule letter
+		bool numeric = false; // first argument is a position
+
+		switch (rule[k]) {
+		case ' ': case ':': continue;
+		case 'l': op = RULE_LOWER; break;
+		case 'u': op = RULE_UPPER; break;
+		case 'c': op = RULE_CAPITALIZE; break;
+		case 'C': op = RULE_INVERT; break;
+		case 't': op = RULE_TOGGLE_ALL; break;
+		case 'T': op = RULE_TOGGLE; args = 1; numeric = true; break;
+		case 'r': op = RULE_REVERSE; break;
+		case 'd': op = RULE_DUPLICATE; break;
+		case 'f': op = RULE_REFLECT; break;
+		case '$': op = RULE_APPEND; args = 1; break;
+		case '^': op = RULE_PREPEND; args = 1; break;
+		case '[': op = RULE_DELETE_FIRST; break;
+		case ']': op = RULE_DELETE_LAST; break;
+		case 'D': op = RULE_DELETE; args = 1; numeric = true; break;
+		case '\'': op = RULE_TRUNCATE; args = 1; numeric = true; break;
+		case 's': op = RULE_REPLACE; args = 2; break;
+		case '@': op = RULE_PURGE; args = 1; break;
+		case 'p': op = RULE_REPEAT; args = 1; numeric = true; break;
+		case '{': op = RULE_ROTATE_LEFT; break;
+		case '}': op = RULE_ROTATE_RIGHT; break;
+		default: return false;
+		}
+
+		// missing arguments or too long
+		if ((args && k + args >= rule.size()) || compiled.size() / 3 == RULE_MAX_OPS)
+			return false;
+
+		if (args) {
+			int p = numeric ? position(rule[k + 1]) : (uchar)rule[k + 1];
+			if (p < 0)
+				return false;
+			a = (uchar)p;
+		}
+		if (args == 2)
+			b = (uchar)rule[k + 2];
+		k += args;
+
+		compiled.push_back(op);
+		compiled.push_back(a);
+		compiled.push_back(b);
+	}
+
+	offsets.push_back((uint)(code.size() / 3));
+	code.insert(code.end(), compiled.begin(), compiled.end());
+	code.push_back(RULE_END);
+	code.push_back(0);
+	code.push_back(0);
+	return true;
+}
+
+bool rule_set::load(const string& path) {
+	ifstream file(path.c_str());
+	if (!file)
+		return false;
+
+	string line;
+	while (getline(file, line)) {
+		if (!line.empty() && line[line.size() - 1] == '\r')
+			line.resize(line.size() - 1);
+
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		if (!add(line))
+			++skipped;
+	}
+
+	LOG_LINE("Loaded rules from " << path << ". COUNT = " << size() << ". SKIPPED = " << skipped);
+
+	return true;
+}
+
+static inline uchar flip(uchar c) {
+	if (c >= 'a' && c <= 'z') return c - 32;
+	if (c >= 'A' && c <= 'Z') return c + 32;
+	return c;
+}
+
+static inline uchar lower(uchar c) { return (c >= 'A' && c <= 'Z') ? c + 32 : c; }
+static inline uchar upper(uchar c) { return (c >= 'a' && c <= 'z') ? c - 32 : c; }
+
+uint rule_set::apply(uint k, uchar* key, uint length) const {
+	// same semantics as apply_rule() in the kernel
+	for (const uchar* ins = &code[offsets[k] * 3];; ins += 3) {
+		const uchar a = ins[1], b = ins[2];
+		uint p, n;
+		uchar c;
+
+		switch (ins[0]) {
+		case RULE_END:
+			return length;
+		case RULE_LOWER:
+			for (p = 0; p < length; ++p) key[p] = lower(key[p]);
+			break;
+		case RULE_UPPER:
+			for (p = 0; p < length; ++p) key[p] = upper(key[p]);
+			break;
+		case RULE_CAPITALIZE:
+		case RULE_INVERT:
+			for (p = 0; p < length; ++p)
+				key[p] = ((p == 0) == (ins[0] == RULE_CAPITALIZE)) ? upper(key[p]) : lower(key[p]);
+			break;
+		case RULE_TOGGLE_ALL:
+			for (p = 0; p < length; ++p) key[p] = flip(key[p]);
+			break;
+		case RULE_TOGGLE:
+			if (a < length) key[a] = flip(key[a]);
+			break;
+		case RULE_REVERSE:
+			for (p = 0; p < length / 2; ++p) {
+				c = key[p];
+				key[p] = key[length - p - 1];
+				key[length - p - 1] = c;
+			}
+			break;
+		case RULE_DUPLICATE:
+			if (length * 2 > MAX_KEY_LEN) return 0;
+			for (p = 0; p < length; ++p) key[length + p] = key[p];
+			length *= 2;
+			break;
+		case RULE_REFLECT:
+			if (length * 2 > MAX_KEY_LEN) return 0;
+			for (p = 0; p < length; ++p) key[length + p] = key[length - p - 1];
+			length *= 2;
+			break;
+		case RULE_APPEND:
+			if (length == MAX_KEY_LEN) return 0;
+			key[length++] = a;
+			break;
+		case RULE_PREPEND:
+			if (length == MAX_KEY_LEN) return 0;
+			for (p = length; p > 0; --p) key[p] = key[p - 1];
+			key[0] = a;
+			++length;
+			break;
+		case RULE_DELETE_FIRST:
+			if (!length) break;
+			for (p = 1; p < length; ++p) key[p - 1] = key[p];
+			--length;
+			break;
+		case RULE_DELETE_LAST:
+			if (length) --length;
+			break;
+		case RULE_DELETE:
+			if (a >= length) break;
+			for (p = a + 1; p < length; ++p) key[p - 1] = key[p];
+			--length;
+			break;
+		case RULE_TRUNCATE:
+			if (a < length) length = a;
+			break;
+		case RULE_REPLACE:
+			for (p = 0; p < length; ++p) if (key[p] == a) key[p] = b;
+			break;
+		case RULE_PURGE:
+			for (p = 0, n = 0; p < length; ++p) if (key[p] != a) key[n++] = key[p];
+			length = n;
+			break;
+		case RULE_REPEAT:
+			if (length * (a + 1) > MAX_KEY_LEN) return 0;
+			for (p = length; p < length * (a + 1); ++p) key[p] = key[p - length];
+			length *= a + 1;
+			break;
+		case RULE_ROTATE_LEFT:
+			if (!length) break;
+			c = key[0];
+			for (p = 1; p < length; ++p) key[p - 1] = key[p];
+			key[length - 1] = c;
+			break;
+		case RULE_ROTATE_RIGHT:
+			if (!length) break;
+			c = key[length - 1];
+			for (p = length - 1; p > 0; --p) key[p] = key[p - 1];
+			key[0] = c;
+			break;
+		}
+	}
+}
+
+uint rule_set::get_batch_words() const {
+	uint words = size() ? RULE_CANDIDATES / size() : WORD_MAX_COUNT;
+	if (words > WORD_MAX_COUNT)
+		words = WORD_MAX_COUNT;
+	return words ? words : 1;
+}
+
+rule_set::rule_set() {
+	skipped = 0;
+}
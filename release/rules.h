@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+#define RULE_MAX_OPS 31 // instructions per rule, not counting the end
+#define RULE_CANDIDATES (1 << 26) // candidates per launch in rule mode
+
+// opcodes, mirrored in the kernel; every instruction is (op, a, b)
+#define RULE_END 0
+#define RULE_LOWER 1 // l
+#define RULE_UPPER 2 // u
+#define RULE_CAPITALIZE 3 // c
+#define RULE_INVERT 4 // C, lower first, upper rest
+#define RULE_TOGGLE_ALL 5 // t
+#define RULE_TOGGLE 6 // TN
+#define RULE_REVERSE 7 // r
+#define RULE_DUPLICATE 8 // d
+#define RULE_REFLECT 9 // f
+#define RULE_APPEND 10 // $X
+#define RULE_PREPEND 11 // ^X
+#define RULE_DELETE_FIRST 12 // [
+#define RULE_DELETE_LAST 13 // ]
+#define RULE_DELETE 14 // DN
+#define RULE_TRUNCATE 15 // 'N
+#define RULE_REPLACE 16 // sXY, e.g. sa4 se3 so0 for leetspeak
+#define RULE_PURGE 17 // @X
+#define RULE_REPEAT 18 // pN, word N more times
+#define RULE_ROTATE_LEFT 19 // {
+#define RULE_ROTATE_RIGHT 20 // }
+
+
+/*Mangling rules in the usual one-rule-per-line syntax (':' is the
+identity, positions are 0-9 then A-Z), compiled once into fixed size
+(op, a, b) instructions. The kernel interprets the same code, so one
+uploaded word turns into size() candidates on the device. A rule that
+would make a key longer than MAX_KEY_LEN, or empty, rejects it.*/
+class rule_set {
+public:
+	/*Compiles one rule, returns false if it is malformed.*/
+	bool add(const string& rule);
+
+	/*Adds one rule per line, skipping blank lines and '#'
+	comments. Returns false if the file can not be read.*/
+	bool load(const string& path);
+
+	/*Applies rule 'k' to the 'length' chars in 'key' (MAX_KEY_LEN
+	bytes). Returns the new length, 0 if the rule rejects the word.*/
+	uint apply(uint k, uchar* key, uint length) const;
+
+	uint size() const { return (uint)offsets.size(); }
+	uint get_skipped() const { return skipped; }
+
+	// instruction index of the first instruction of every rule
+	const uint* get_offsets() const { return offsets.data(); }
+	const uchar* get_code() const { return code.data(); }
+	uint get_code_size() const { return (uint)code.size(); }
+
+	// words per batch, so a batch is one launch of about RULE_CANDIDATES keys
+	uint get_batch_words() const;
+
+	rule_set();
+private:
+	vector<uchar> code;
+	vector<uint> offsets;
+	uint skipped;
+};
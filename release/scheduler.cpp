@@ -0,0 +1,436 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include "scheduler.h"
+#include "log.h"
+
+void scheduler::enumerate() {
+	cl_platform_id platforms[MAX_PLATFORMS];
+	cl_uint num_platforms = 0;
+
+	if (clGetPlatformIDs(MAX_PLATFORMS, platforms, &num_platforms) != CL_SUCCESS)
+		num_platforms = 0;
+
+	for (cl_uint p = 0; p < num_platforms && p < MAX_PLATFORMS; ++p) {
+		cl_device_id devices[MAX_DEVICES];
+		cl_uint num_devices = 0;
+
+		if (clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, MAX_DEVICES, devices, &num_devices) != CL_SUCCESS)
+			continue;
+
+		for (cl_uint d = 0; d < num_devices && d < MAX_DEVICES; ++d) {
+			smasher* engine = new smasher(platforms[p], devices[d], algo);
+
+			LOG_LINE("Platform " << p << " device " << d << ": " << engine->get_name() << (engine->get_ready() ? "" : " (unusable)"));
+
+			// a device that failed to set up is skipped, not fatal
+			if (engine->get_ready())
+				engines.push_back(engine);
+			else
+				delete engine;
+		}
+	}
+
+	// nothing usable, the default smasher falls back to the CPU
+	if (engines.empty()) {
+		smasher* engine = new smasher(algo);
+		if (engine->get_ready())
+			engines.push_back(engine);
+		else
+			delete engine;
+	}
+}
+
+vector<block_range> scheduler::begin(const uint64 first, const uint64 count) {
+	// only this machine's part of the range
+	block_range range = { first, count };
+	if (slice) {
+		range = slice->resolve(count);
+		range.first += first;
+	}
+
+	vector<block_range> pending;
+	if (journal)
+		pending = journal->pending(range.first, range.count);
+	else if (range.count)
+		pending.push_back(range);
+
+	uint64 left = 0;
+	for (size_t r = 0; r < pending.size(); ++r)
+		left += pending[r].count;
+
+	stats.begin(range.count, range.count - left);
+	for (uint k = 0; k < engines.size(); ++k)
+		device_done[k] = 0;
+
+	return pending;
+}
+
+uint scheduler::block_key(uint128 index, uchar* key) {
+	if (mask) {
+		mask->candidate(index, mask_length, key);
+		return mask_length;
+	}
+
+	// big-endian counter, like smasher::confirm()
+	for (uint k = 0; k < KEY_SIZE; ++k) {
+		uint shift = (KEY_SIZE - k - 1) * 8;
+		key[k] = (uchar)((shift < 64) ? index.lo >> shift : index.hi >> (shift - 64));
+	}
+	return KEY_SIZE;
+}
+
+uint scheduler::word_key(word_feed& feed, uint64 offset, uint rule, uchar* key) {
+	string word = feed.get_words().word(offset);
+	uint length = (uint)min(word.size(), (size_t)MAX_KEY_LEN);
+	if (hybrid)
+		return hybrid->combine((const uchar*)word.data(), length, rule, hybrid_length, hybrid_prefix, key);
+
+	memcpy(key, word.data(), length);
+	return rules ? rules->apply(rule, key, length) : length;
+}
+
+void scheduler::record(const uchar* key, uint length) {
+	uchar digest[MAX_DIGEST_SIZE];
+	if (!hash_digest(algo, key, length, digest))
+		return;
+	pot->add((const char*)digest, algo.digest_size, key, length);
+}
+
+int scheduler::smash_range(const uint64 first, const uint64 count, char* cmpto, uint64& found) {
+	mutex lock;
+	int match = -1;
+
+	// ranges are searched in order, the first one with a match is the last
+	vector<block_range> pending = begin(first, count);
+	for (size_t r = 0; r < pending.size() && match < 0; ++r)
+		pool->run(pending[r].first, pending[r].first + pending[r].count,
+			[&](uint worker) { return (uint64)engines[worker]->get_chunk(); },
+			[&](uint worker, uint64 a, uint64 b) {
+				uint64 block;
+				int k = engines[worker]->smash_range(a, b - a, cmpto, block);
+
+				stats.add_blocks(b - a);
+				device_done[worker] += b - a;
+				if (k < 0) {
+					if (journal)
+						journal->done(a, b - a);
+					return false;
+				}
+
+				// keep the lowest hit if two devices find one
+				lock_guard<mutex> guard(lock);
+				if (match < 0 || block < found || (block == found && k < match)) {
+					match = k;
+					found = block;
+				}
+				return true;
+			});
+
+	if (match >= 0 && pot) {
+		uchar key[MAX_KEY_LEN];
+		record(key, block_key(key_index(found, match), key));
+		pot->sync();
+	}
+
+	if (journal)
+		journal->sync();
+	return match;
+}
+
+int scheduler::smash_range(const uint64 first, const uint64 count, const target_set& targets, vector<target_hit>& hits) {
+	mutex lock;
+	int confirmed = 0;
+
+	// the devices search 'live'; target k of it is targets[positions[k]] once it is reduced
+	const target_set* live = &targets;
+	target_set* reduced = NULL;
+	vector<uint> positions;
+	vector<char> cracked(pot ? targets.size() : 0, 0);
+	uint left = targets.size(), dropped = 0; // dropped from 'live' since it was built
+
+	uint64 segment = ~0ULL;
+	if (pot) {
+		segment = 0;
+		for (uint k = 0; k < engines.size(); ++k)
+			segment += engines[k]->get_chunk();
+		segment *= LIVE_SEGMENT;
+	}
+
+	vector<block_range> pending = begin(first, count);
+	for (size_t r = 0; r < pending.size() && left; ++r)
+		for (uint64 a = pending[r].first, end = a + pending[r].count; a < end && left;) {
+			uint64 b = (end - a > segment) ? a + segment : end;
+			pool->run(a, b,
+				[&](uint worker) { return (uint64)engines[worker]->get_chunk(); },
+				[&](uint worker, uint64 a, uint64 b) {
+					vector<target_hit> found;
+					int n = engines[worker]->smash_range(a, b - a, *live, found);
+
+					stats.add_blocks(b - a);
+					device_done[worker] += b - a;
+
+					if (!positions.empty())
+						for (size_t k = 0; k < found.size(); ++k)
+							found[k].target = positions[found[k].target];
+
+					// keys reach the potfile before the journal marks their range done
+					if (pot && !found.empty()) {
+						for (size_t k = 0; k < found.size(); ++k) {
+							uchar key[MAX_KEY_LEN];
+							uint128 index = { found[k].index, found[k].index_hi };
+							record(key, block_key(index, key));
+						}
+						pot->sync();
+					}
+
+					// hits go in before the range, a crash between them only repeats the chunk
+					if (journal) {
+						for (size_t k = 0; k < found.size(); ++k)
+							journal->hit(found[k]);
+						journal->done(a, b - a);
+					}
+
+					if (n > 0) {
+						lock_guard<mutex> guard(lock);
+						hits.insert(hits.end(), found.begin(), found.end());
+						confirmed += n;
+
+						for (size_t k = 0; pot && k < found.size(); ++k)
+							if (!cracked[found[k].target]) {
+								cracked[found[k].target] = 1;
+								--left;
+								++dropped;
+							}
+						return pot && !left;
+					}
+					return false;
+				});
+			a = b;
+
+			// a smaller table once enough of this one is cracked, the old one is freed first
+			if (pot && left && dropped * LIVE_REDUCE >= live->size()) {
+				target_set* next = new target_set();
+				targets.subset(cracked, *next, &positions);
+
+				if (reduced) {
+					for (uint k = 0; k < engines.size(); ++k)
+						engines[k]->forget_targets(*reduced);
+					delete reduced;
+				}
+				live = reduced = next;
+				dropped = 0;
+
+				LOG_LINE("Dropped cracked targets from the device tables. LEFT = " << left);
+			}
+		}
+
+	if (reduced) {
+		for (uint k = 0; k < engines.size(); ++k)
+			engines[k]->forget_targets(*reduced);
+		delete reduced;
+	}
+
+	if (journal)
+		journal->sync();
+	return confirmed;
+}
+
+bool scheduler::set_mask(const key_mask* mask, uint length) {
+	bool fits = true;
+	for (uint k = 0; k < engines.size(); ++k)
+		fits = engines[k]->set_mask(mask, length) && fits;
+
+	this->mask = fits ? mask : NULL;
+	mask_length = fits ? length : 0;
+	return fits;
+}
+
+bool scheduler::set_rules(const rule_set* rules) {
+	bool loaded = true;
+	for (uint k = 0; k < engines.size(); ++k)
+		loaded = engines[k]->set_rules(rules) && loaded;
+
+	// devices without the rules would search plain words only
+	if (!loaded)
+		for (uint k = 0; k < engines.size(); ++k)
+			engines[k]->set_rules(NULL);
+
+	this->rules = (loaded && rules && rules->size()) ? rules : NULL;
+	return loaded;
+}
+
+bool scheduler::set_hybrid(const key_mask* mask, uint length, bool prefix) {
+	bool fits = true;
+	for (uint k = 0; k < engines.size(); ++k)
+		fits = engines[k]->set_hybrid(mask, length, prefix) && fits;
+
+	// every device searches the same candidates or none goes hybrid
+	if (!fits)
+		for (uint k = 0; k < engines.size(); ++k)
+			engines[k]->set_hybrid(NULL, 0, false);
+
+	hybrid = fits ? mask : NULL;
+	hybrid_length = length;
+	hybrid_prefix = prefix;
+	return fits;
+}
+
+bool scheduler::smash_words(word_feed& feed, char* cmpto, uint64& found, uint& rule) {
+	mutex lock;
+	stats.begin(0); // the feed's size is not known
+	bool match = false;
+
+	/*One index per device, the work itself comes from the feed. A
+	worker may steal another's index, so the chunk picks the engine.*/
+	pool->run(0, engines.size(), 1,
+		[&](uint, uint64 a, uint64 b) {
+			bool hit = false;
+			for (uint64 k = a; k < b; ++k) {
+				uint64 offset;
+				uint applied;
+				if (!engines[k]->smash_words(feed, cmpto, offset, applied))
+					continue;
+
+				// the others stop after their batches in flight
+				feed.stop();
+
+				lock_guard<mutex> guard(lock);
+				if (!match || offset < found) {
+					found = offset;
+					rule = applied;
+				}
+				match = hit = true;
+			}
+			return hit;
+		});
+
+	if (match && pot) {
+		uchar key[MAX_KEY_LEN];
+		uint length = word_key(feed, found, rule, key);
+		if (length) {
+			record(key, length);
+			pot->sync();
+		}
+	}
+
+	return match;
+}
+
+int scheduler::smash_words(word_feed& feed, const target_set& targets, vector<target_hit>& hits) {
+	mutex lock;
+	stats.begin(0);
+	int confirmed = 0;
+
+	pool->run(0, engines.size(), 1,
+		[&](uint, uint64 a, uint64 b) {
+			for (uint64 e = a; e < b; ++e) {
+				vector<target_hit> found;
+				int n = engines[e]->smash_words(feed, targets, found);
+
+				for (size_t k = 0; pot && k < found.size(); ++k) {
+					uchar key[MAX_KEY_LEN];
+					uint length = word_key(feed, found[k].index, found[k].rule, key);
+					if (length)
+						record(key, length);
+				}
+				if (pot && !found.empty())
+					pot->sync();
+
+				if (n > 0) {
+					lock_guard<mutex> guard(lock);
+					hits.insert(hits.end(), found.begin(), found.end());
+					confirmed += n;
+				}
+			}
+			return false;
+		});
+
+	return confirmed;
+}
+
+int scheduler::smash_crypt(word_feed& feed, const crypt_set& targets, vector<target_hit>& hits) {
+	mutex lock;
+	stats.begin(0);
+	int confirmed = 0;
+
+	pool->run(0, engines.size(), 1,
+		[&](uint, uint64 a, uint64 b) {
+			for (uint64 e = a; e < b; ++e) {
+				vector<target_hit> found;
+				int n = engines[e]->smash_crypt(feed, targets, found);
+
+				if (n > 0) {
+					lock_guard<mutex> guard(lock);
+					hits.insert(hits.end(), found.begin(), found.end());
+					confirmed += n;
+				}
+			}
+			return false;
+		});
+
+	return confirmed;
+}
+
+bool scheduler::make_chains(const uint64 first, const uint64 count, uint columns, uint64 space, const chain_sink& sink) {
+	atomic<bool> failed(false);
+	stats.begin(0);
+
+	pool->run(first, first + count, CHAIN_CHUNK,
+		[&](uint worker, uint64 a, uint64 b) {
+			vector<uint64> chains((size_t)(b - a));
+			for (uint64 k = a; k < b; ++k)
+				chains[k - a] = k;
+
+			if (!engines[worker]->walk_chains(&chains[0], (uint)(b - a), a, columns, space, false)) {
+				failed = true;
+				return true;
+			}
+
+			sink(a, chains);
+			return false;
+		});
+
+	return !failed;
+}
+
+bool scheduler::walk_chains(vector<uint64>& chains, uint columns, uint64 space) {
+	atomic<bool> failed(false);
+	stats.begin(0);
+
+	pool->run(0, chains.size(), CHAIN_CHUNK,
+		[&](uint worker, uint64 a, uint64 b) {
+			if (!engines[worker]->walk_chains(&chains[a], (uint)(b - a), a, columns, space, true)) {
+				failed = true;
+				return true;
+			}
+			return false;
+		});
+
+	return !failed;
+}
+
+scheduler::scheduler(const hash_algo& algo) : algo(algo) {
+	journal = NULL;
+	slice = NULL;
+	pot = NULL;
+	mask = NULL;
+	mask_length = 0;
+	rules = NULL;
+	hybrid = NULL;
+	hybrid_length = 0;
+	hybrid_prefix = false;
+	enumerate();
+	for (uint k = 0; k < engines.size(); ++k)
+		engines[k]->set_stats(&stats);
+
+	device_done = vector<atomic<uint64> >(engines.size());
+	pool = new work_pool(engines.empty() ? 1 : (uint)engines.size());
+
+	LOG_LINE("Scheduler ready. DEVICES = " << engines.size());
+}
+scheduler::~scheduler() {
+	delete pool;
+	for (uint k = 0; k < engines.size(); ++k)
+		delete engines[k];
+}
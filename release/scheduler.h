@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "CL.h"
+#include "mask.h"
+#include "pool.h"
+#include "potfile.h"
+#include "progress.h"
+#include "rules.h"
+#include "smasher.h"
+#include "stats.h"
+#include "targets.h"
+#include "types.h"
+#include "wordlist.h"
+
+using namespace std;
+
+#define MAX_PLATFORMS 16
+#define MAX_DEVICES 64
+#define CHAIN_CHUNK 65536 // rainbow chains handed to a device at once
+#define LIVE_SEGMENT 64 // device chunks searched between target table rebuilds
+#define LIVE_REDUCE 16 // the table is rebuilt once 1 / LIVE_REDUCE of it is cracked
+
+
+/*Runs one search over every usable OpenCL device. Each device gets
+its own smasher (context, queue and kernels) and a host thread; the
+keyspace is split between them by work stealing, in chunks sized to
+keep each device's pipeline full, so faster devices end up taking
+more. Falls back to the native CPU engine if there is no device.*/
+class scheduler {
+public:
+	int smash_range(const uint64 first, const uint64 count, char* cmpto, uint64& found);
+
+	int smash_range(const uint64 first, const uint64 count, const target_set& targets, vector<target_hit>& hits);
+
+	/*Searches a mask on every device, NULL goes back to the counter
+	keyspace. False if the mask does not fit(length), the devices stay
+	on the counter keyspace then.*/
+	bool set_mask(const key_mask* mask, uint length);
+
+	/*Every device pulls chunks from the same feed until it runs dry,
+	so faster devices hash more of the wordlist. Hits are file offsets.*/
+	bool smash_words(word_feed& feed, char* cmpto, uint64& found, uint& rule);
+
+	int smash_words(word_feed& feed, const target_set& targets, vector<target_hit>& hits);
+
+	// salted crypt hashes, hits carry the crypt_set entry
+	int smash_crypt(word_feed& feed, const crypt_set& targets, vector<target_hit>& hits);
+
+	// false if a device could not take the rules, none are applied then
+	bool set_rules(const rule_set* rules);
+
+	/*Hybrid wordlist searches: every word gets the 'length' keys of
+	a mask appended, or prepended with 'prefix', on every device. NULL
+	goes back to plain or rule words. Feeds should be limited to
+	mask->get_batch_words(length) words per batch; hits hold the mask
+	key index as their rule. False if a word has too many such keys
+	or a device could not take the mask, none goes hybrid then.*/
+	bool set_hybrid(const key_mask* mask, uint length, bool prefix);
+
+	// gets the ends of chains [first, first + count), called from the device threads
+	typedef function<void(uint64 first, const vector<uint64>& ends)> chain_sink;
+
+	/*Walks the rainbow chains that start at key indices [first,
+	first + count) through 'columns' columns of the current mask's
+	'space' keys, CHAIN_CHUNK chains at a time on every device.*/
+	bool make_chains(const uint64 first, const uint64 count, uint columns, uint64 space, const chain_sink& sink);
+
+	/*Lookup walks, in place and on every device: entry k holds a
+	digest reduced in column k % columns.*/
+	bool walk_chains(vector<uint64>& chains, uint columns, uint64 space);
+
+	/*Block searches skip what 'journal' has done and record every
+	finished chunk (and its hits) in it, NULL to stop. Chunks with a
+	single-target match are not recorded, so a resumed run finds it
+	again. Wordlist searches are not journaled.*/
+	void set_journal(progress_journal* journal) { this->journal = journal; }
+
+	/*Block searches cover only 'slice' of the blocks they are given,
+	NULL for all of them. Journals and hits keep absolute blocks, so
+	a resumed slice picks up where it stopped.*/
+	void set_slice(const keyspace_slice* slice) { this->slice = slice; }
+
+	/*Every key found from now on goes into 'pot', NULL to stop. Block
+	searches then run in segments of LIVE_SEGMENT chunks per device;
+	between them, once enough targets are cracked, the devices get a
+	table without them, and the search ends when none is left. Crypt
+	searches are not recorded.*/
+	void set_potfile(potfile* pot) { this->pot = pot; }
+
+	uint get_devices() { return (uint)engines.size(); }
+	const string& get_name(uint k) { return engines[k]->get_name(); }
+
+	// blocks searched so far, overall and per device; safe to poll from other threads
+	uint64 get_done() { return stats.get_blocks(); }
+	uint64 get_done(uint k) { return device_done[k]; }
+
+	/*Rate, stage times, coverage and ETA of the current search, summed
+	over every device; poll get_stats().get() from any thread.*/
+	const smash_stats& get_stats() { return stats; }
+
+	bool get_ready() { return !engines.empty(); }
+	const hash_algo& get_algo() { return algo; }
+
+	scheduler(const hash_algo& algo = hash_get(HASH_MD5));
+	~scheduler();
+private:
+	const hash_algo& algo;
+	vector<smasher*> engines;
+	work_pool* pool; // one host thread per device
+	progress_journal* journal;
+	const keyspace_slice* slice;
+	potfile* pot;
+
+	// what the devices search, for turning hits back into keys
+	const key_mask* mask;
+	uint mask_length;
+	const rule_set* rules;
+	const key_mask* hybrid;
+	uint hybrid_length;
+	bool hybrid_prefix;
+
+	smash_stats stats;
+	vector<atomic<uint64> > device_done;
+
+	void enumerate();
+
+	/*What is left of the slice of [first, first + count), all of it
+	without a journal. Starts the stats and the device counters of the
+	search.*/
+	vector<block_range> begin(const uint64 first, const uint64 count);
+
+	// key of a block search hit, returns its length
+	uint block_key(uint128 index, uchar* key);
+
+	// key of a word search hit, 0 if its rule rejects the word or it gets too long
+	uint word_key(word_feed& feed, uint64 offset, uint rule, uchar* key);
+
+	// hashes 'key' again for its full digest and adds it to the potfile
+	void record(const uchar* key, uint length);
+};
@@ -0,0 +1,51 @@
+/*SHA-1, single block. The schedule lives in a 16-word ring.*/
+
+#define DIGEST_WORDS 5
+
+#define SHA1_CH(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define SHA1_PARITY(x, y, z) ((x) ^ (y) ^ (z))
+#define SHA1_MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+
+/*'w' is the message packed like pack_block() does, the bit length is
+added here. Hashes VECTOR_WIDTH messages at once.*/
+inline void hash_words(uintv* w, const uint len, uintv* out) {
+	for (uint k = 0; k < 14; ++k)
+		w[k] = swap_bytesv(w[k]);
+	w[15] = len * 8;
+
+	uintv a = 0x67452301, b = 0xefcdab89, c = 0x98badcfe, d = 0x10325476, e = 0xc3d2e1f0;
+
+	for (uint t = 0; t < 80; ++t) {
+		if (t >= 16)
+			w[t & 15] = rotate(w[(t + 13) & 15] ^ w[(t + 8) & 15] ^ w[(t + 2) & 15] ^ w[t & 15], (uintv)1);
+
+		uintv f;
+		uint k;
+		if (t < 20) { f = SHA1_CH(b, c, d); k = 0x5a827999; }
+		else if (t < 40) { f = SHA1_PARITY(b, c, d); k = 0x6ed9eba1; }
+		else if (t < 60) { f = SHA1_MAJ(b, c, d); k = 0x8f1bbcdc; }
+		else { f = SHA1_PARITY(b, c, d); k = 0xca62c1d6; }
+
+		const uintv temp = rotate(a, (uintv)5) + f + e + k + w[t & 15];
+		e = d;
+		d = c;
+		c = rotate(b, (uintv)30);
+		b = a;
+		a = temp;
+	}
+
+	// digest byte order, as little-endian words like md5
+	out[0] = swap_bytesv(a + 0x67452301);
+	out[1] = swap_bytesv(b + 0xefcdab89);
+	out[2] = swap_bytesv(c + 0x98badcfe);
+	out[3] = swap_bytesv(d + 0x10325476);
+	out[4] = swap_bytesv(e + 0xc3d2e1f0);
+}
+
+#if VECTOR_WIDTH == 1
+inline void hash(char* msg, const uint len, uint* out) {
+	uint w[16];
+	pack_block(w, msg, len);
+	hash_words(w, len, out);
+}
+#endif
@@ -0,0 +1,65 @@
+/*SHA-256, single block. The schedule lives in a 16-word ring.*/
+
+#define DIGEST_WORDS 8
+
+__constant uint sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_CH(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define SHA256_MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
+
+// rotate() turns left, these are the right rotations of the spec
+#define SHA256_S0(x) (rotate((x), (uintv)30) ^ rotate((x), (uintv)19) ^ rotate((x), (uintv)10))
+#define SHA256_S1(x) (rotate((x), (uintv)26) ^ rotate((x), (uintv)21) ^ rotate((x), (uintv)7))
+#define SHA256_s0(x) (rotate((x), (uintv)25) ^ rotate((x), (uintv)14) ^ ((x) >> 3))
+#define SHA256_s1(x) (rotate((x), (uintv)15) ^ rotate((x), (uintv)13) ^ ((x) >> 10))
+
+/*'w' is the message packed like pack_block() does, the bit length is
+added here. Hashes VECTOR_WIDTH messages at once.*/
+inline void hash_words(uintv* w, const uint len, uintv* out) {
+	const uint iv[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+	uintv s[8];
+
+	for (uint k = 0; k < 14; ++k)
+		w[k] = swap_bytesv(w[k]);
+	w[15] = len * 8;
+
+	for (uint k = 0; k < 8; ++k)
+		s[k] = iv[k];
+
+	for (uint t = 0; t < 64; ++t) {
+		if (t >= 16)
+			w[t & 15] += SHA256_s1(w[(t + 14) & 15]) + w[(t + 9) & 15] + SHA256_s0(w[(t + 1) & 15]);
+
+		const uintv t1 = s[7] + SHA256_S1(s[4]) + SHA256_CH(s[4], s[5], s[6]) + sha256_k[t] + w[t & 15];
+		const uintv t2 = SHA256_S0(s[0]) + SHA256_MAJ(s[0], s[1], s[2]);
+		s[7] = s[6];
+		s[6] = s[5];
+		s[5] = s[4];
+		s[4] = s[3] + t1;
+		s[3] = s[2];
+		s[2] = s[1];
+		s[1] = s[0];
+		s[0] = t1 + t2;
+	}
+
+	// digest byte order, as little-endian words like md5
+	for (uint k = 0; k < 8; ++k)
+		out[k] = swap_bytesv(s[k] + iv[k]);
+}
+
+#if VECTOR_WIDTH == 1
+inline void hash(char* msg, const uint len, uint* out) {
+	uint w[16];
+	pack_block(w, msg, len);
+	hash_words(w, len, out);
+}
+#endif
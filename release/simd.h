@@ -0,0 +1,180 @@
+#pragma once
+
+#include "types.h"
+
+/*Lane types for the CPU hash cores. Every ISA specific translation unit
+defines one of SIMD_SSE2, SIMD_AVX2 or SIMD_AVX512 and sets its own target
+before including this file, so the rest of the program keeps the baseline
+instruction set. Those units must not include any standard C++ header:
+inline library code compiled for a wider target would be merged with the
+baseline copies at link time.*/
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86
+#endif
+
+#if defined(_MSC_VER)
+#define SIMD_INLINE __forceinline
+#else
+#define SIMD_INLINE inline __attribute__((always_inline))
+#endif
+
+// one key per "vector", used where no SIMD unit is available
+struct lanes_scalar {
+	typedef uint vec;
+	static const uint width = 1;
+
+	static SIMD_INLINE vec set1(uint x) { return x; }
+	static SIMD_INLINE vec load(const uint* p) { return *p; }
+	static SIMD_INLINE void store(uint* p, vec x) { *p = x; }
+	static SIMD_INLINE vec add(vec a, vec b) { return a + b; }
+	static SIMD_INLINE vec xor_(vec a, vec b) { return a ^ b; }
+	static SIMD_INLINE vec and_(vec a, vec b) { return a & b; }
+	static SIMD_INLINE vec or_(vec a, vec b) { return a | b; }
+	template<int s> static SIMD_INLINE vec rotl(vec a) { return (a << s) | (a >> (32 - s)); }
+	template<int s> static SIMD_INLINE vec shr(vec a) { return a >> s; }
+
+	// MD5 boolean functions, f is also the SHA choice and h the parity
+	static SIMD_INLINE vec f(vec x, vec y, vec z) { return z ^ (x & (y ^ z)); }
+	static SIMD_INLINE vec g(vec x, vec y, vec z) { return y ^ (z & (x ^ y)); }
+	static SIMD_INLINE vec h(vec x, vec y, vec z) { return x ^ y ^ z; }
+	static SIMD_INLINE vec i(vec x, vec y, vec z) { return y ^ (x | ~z); }
+
+	// majority, MD4 round 2 and SHA
+	static SIMD_INLINE vec maj(vec x, vec y, vec z) { return (x & y) | (z & (x | y)); }
+};
+
+// same with 64-bit lanes, for SHA-512
+struct lanes64_scalar {
+	typedef uint64 vec;
+	static const uint width = 1;
+
+	static SIMD_INLINE vec set1(uint64 x) { return x; }
+	static SIMD_INLINE vec load(const uint64* p) { return *p; }
+	static SIMD_INLINE void store(uint64* p, vec x) { *p = x; }
+	static SIMD_INLINE vec add(vec a, vec b) { return a + b; }
+	static SIMD_INLINE vec xor_(vec a, vec b) { return a ^ b; }
+	template<int s> static SIMD_INLINE vec rotr(vec a) { return (a >> s) | (a << (64 - s)); }
+	template<int s> static SIMD_INLINE vec shr(vec a) { return a >> s; }
+	static SIMD_INLINE vec ch(vec x, vec y, vec z) { return z ^ (x & (y ^ z)); }
+	static SIMD_INLINE vec maj(vec x, vec y, vec z) { return (x & y) | (z & (x | y)); }
+};
+
+#if defined(SIMD_X86) && (defined(SIMD_SSE2) || defined(SIMD_AVX2) || defined(SIMD_AVX512))
+#include <immintrin.h>
+#endif
+
+#if defined(SIMD_X86) && defined(SIMD_SSE2)
+struct lanes_sse2 {
+	typedef __m128i vec;
+	static const uint width = 4;
+
+	static SIMD_INLINE vec set1(uint x) { return _mm_set1_epi32((int)x); }
+	static SIMD_INLINE vec load(const uint* p) { return _mm_loadu_si128((const __m128i*)p); }
+	static SIMD_INLINE void store(uint* p, vec x) { _mm_storeu_si128((__m128i*)p, x); }
+	static SIMD_INLINE vec add(vec a, vec b) { return _mm_add_epi32(a, b); }
+	static SIMD_INLINE vec xor_(vec a, vec b) { return _mm_xor_si128(a, b); }
+	static SIMD_INLINE vec and_(vec a, vec b) { return _mm_and_si128(a, b); }
+	static SIMD_INLINE vec or_(vec a, vec b) { return _mm_or_si128(a, b); }
+	template<int s> static SIMD_INLINE vec rotl(vec a) { return _mm_or_si128(_mm_slli_epi32(a, s), _mm_srli_epi32(a, 32 - s)); }
+	template<int s> static SIMD_INLINE vec shr(vec a) { return _mm_srli_epi32(a, s); }
+
+	static SIMD_INLINE vec f(vec x, vec y, vec z) { return xor_(z, and_(x, xor_(y, z))); }
+	static SIMD_INLINE vec g(vec x, vec y, vec z) { return xor_(y, and_(z, xor_(x, y))); }
+	static SIMD_INLINE vec h(vec x, vec y, vec z) { return xor_(xor_(x, y), z); }
+	static SIMD_INLINE vec i(vec x, vec y, vec z) { return xor_(y, or_(x, _mm_xor_si128(z, _mm_set1_epi32(-1)))); }
+	static SIMD_INLINE vec maj(vec x, vec y, vec z) { return or_(and_(x, y), and_(z, or_(x, y))); }
+};
+
+struct lanes64_sse2 {
+	typedef __m128i vec;
+	static const uint width = 2;
+
+	static SIMD_INLINE vec set1(uint64 x) { return _mm_set1_epi64x((long long)x); }
+	static SIMD_INLINE vec load(const uint64* p) { return _mm_loadu_si128((const __m128i*)p); }
+	static SIMD_INLINE void store(uint64* p, vec x) { _mm_storeu_si128((__m128i*)p, x); }
+	static SIMD_INLINE vec add(vec a, vec b) { return _mm_add_epi64(a, b); }
+	static SIMD_INLINE vec xor_(vec a, vec b) { return _mm_xor_si128(a, b); }
+	template<int s> static SIMD_INLINE vec rotr(vec a) { return _mm_or_si128(_mm_srli_epi64(a, s), _mm_slli_epi64(a, 64 - s)); }
+	template<int s> static SIMD_INLINE vec shr(vec a) { return _mm_srli_epi64(a, s); }
+	static SIMD_INLINE vec ch(vec x, vec y, vec z) { return _mm_xor_si128(z, _mm_and_si128(x, _mm_xor_si128(y, z))); }
+	static SIMD_INLINE vec maj(vec x, vec y, vec z) { return _mm_or_si128(_mm_and_si128(x, y), _mm_and_si128(z, _mm_or_si128(x, y))); }
+};
+#endif
+
+#if defined(SIMD_X86) && defined(SIMD_AVX2)
+struct lanes_avx2 {
+	typedef __m256i vec;
+	static const uint width = 8;
+
+	static SIMD_INLINE vec set1(uint x) { return _mm256_set1_epi32((int)x); }
+	static SIMD_INLINE vec load(const uint* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	static SIMD_INLINE void store(uint* p, vec x) { _mm256_storeu_si256((__m256i*)p, x); }
+	static SIMD_INLINE vec add(vec a, vec b) { return _mm256_add_epi32(a, b); }
+	static SIMD_INLINE vec xor_(vec a, vec b) { return _mm256_xor_si256(a, b); }
+	static SIMD_INLINE vec and_(vec a, vec b) { return _mm256_and_si256(a, b); }
+	static SIMD_INLINE vec or_(vec a, vec b) { return _mm256_or_si256(a, b); }
+	template<int s> static SIMD_INLINE vec rotl(vec a) { return _mm256_or_si256(_mm256_slli_epi32(a, s), _mm256_srli_epi32(a, 32 - s)); }
+	template<int s> static SIMD_INLINE vec shr(vec a) { return _mm256_srli_epi32(a, s); }
+
+	static SIMD_INLINE vec f(vec x, vec y, vec z) { return xor_(z, and_(x, xor_(y, z))); }
+	static SIMD_INLINE vec g(vec x, vec y, vec z) { return xor_(y, and_(z, xor_(x, y))); }
+	static SIMD_INLINE vec h(vec x, vec y, vec z) { return xor_(xor_(x, y), z); }
+	static SIMD_INLINE vec i(vec x, vec y, vec z) { return xor_(y, or_(x, _mm256_xor_si256(z, _mm256_set1_epi32(-1)))); }
+	static SIMD_INLINE vec maj(vec x, vec y, vec z) { return or_(and_(x, y), and_(z, or_(x, y))); }
+};
+
+struct lanes64_avx2 {
+	typedef __m256i vec;
+	static const uint width = 4;
+
+	static SIMD_INLINE vec set1(uint64 x) { return _mm256_set1_epi64x((long long)x); }
+	static SIMD_INLINE vec load(const uint64* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	static SIMD_INLINE void store(uint64* p, vec x) { _mm256_storeu_si256((__m256i*)p, x); }
+	static SIMD_INLINE vec add(vec a, vec b) { return _mm256_add_epi64(a, b); }
+	static SIMD_INLINE vec xor_(vec a, vec b) { return _mm256_xor_si256(a, b); }
+	template<int s> static SIMD_INLINE vec rotr(vec a) { return _mm256_or_si256(_mm256_srli_epi64(a, s), _mm256_slli_epi64(a, 64 - s)); }
+	template<int s> static SIMD_INLINE vec shr(vec a) { return _mm256_srli_epi64(a, s); }
+	static SIMD_INLINE vec ch(vec x, vec y, vec z) { return _mm256_xor_si256(z, _mm256_and_si256(x, _mm256_xor_si256(y, z))); }
+	static SIMD_INLINE vec maj(vec x, vec y, vec z) { return _mm256_or_si256(_mm256_and_si256(x, y), _mm256_and_si256(z, _mm256_or_si256(x, y))); }
+};
+#endif
+
+#if defined(SIMD_X86) && defined(SIMD_AVX512)
+struct lanes_avx512 {
+	typedef __m512i vec;
+	static const uint width = 16;
+
+	static SIMD_INLINE vec set1(uint x) { return _mm512_set1_epi32((int)x); }
+	static SIMD_INLINE vec load(const uint* p) { return _mm512_loadu_si512((const void*)p); }
+	static SIMD_INLINE void store(uint* p, vec x) { _mm512_storeu_si512((void*)p, x); }
+	static SIMD_INLINE vec add(vec a, vec b) { return _mm512_add_epi32(a, b); }
+	static SIMD_INLINE vec xor_(vec a, vec b) { return _mm512_xor_si512(a, b); }
+	static SIMD_INLINE vec and_(vec a, vec b) { return _mm512_and_si512(a, b); }
+	static SIMD_INLINE vec or_(vec a, vec b) { return _mm512_or_si512(a, b); }
+	template<int s> static SIMD_INLINE vec rotl(vec a) { return _mm512_rol_epi32(a, s); }
+	template<int s> static SIMD_INLINE vec shr(vec a) { return _mm512_srli_epi32(a, s); }
+
+	// single ternary-logic instruction per boolean function
+	static SIMD_INLINE vec f(vec x, vec y, vec z) { return _mm512_ternarylogic_epi32(x, y, z, 0xca); }
+	static SIMD_INLINE vec g(vec x, vec y, vec z) { return _mm512_ternarylogic_epi32(x, y, z, 0xe4); }
+	static SIMD_INLINE vec h(vec x, vec y, vec z) { return _mm512_ternarylogic_epi32(x, y, z, 0x96); }
+	static SIMD_INLINE vec i(vec x, vec y, vec z) { return _mm512_ternarylogic_epi32(x, y, z, 0x39); }
+	static SIMD_INLINE vec maj(vec x, vec y, vec z) { return _mm512_ternarylogic_epi32(x, y, z, 0xe8); }
+};
+
+struct lanes64_avx512 {
+	typedef __m512i vec;
+	static const uint width = 8;
+
+	static SIMD_INLINE vec set1(uint64 x) { return _mm512_set1_epi64((long long)x); }
+	static SIMD_INLINE vec load(const uint64* p) { return _mm512_loadu_si512((const void*)p); }
+	static SIMD_INLINE void store(uint64* p, vec x) { _mm512_storeu_si512((void*)p, x); }
+	static SIMD_INLINE vec add(vec a, vec b) { return _mm512_add_epi64(a, b); }
+	static SIMD_INLINE vec xor_(vec a, vec b) { return _mm512_xor_si512(a, b); }
+	template<int s> static SIMD_INLINE vec rotr(vec a) { return _mm512_ror_epi64(a, s); }
+	template<int s> static SIMD_INLINE vec shr(vec a) { return _mm512_srli_epi64(a, s); }
+	static SIMD_INLINE vec ch(vec x, vec y, vec z) { return _mm512_ternarylogic_epi64(x, y, z, 0xca); }
+	static SIMD_INLINE vec maj(vec x, vec y, vec z) { return _mm512_ternarylogic_epi64(x, y, z, 0xe8); }
+};
+#endif
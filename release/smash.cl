@@ -0,0 +1,659 @@
+/*Key generation, comparison and the search kernels. Built after hash.cl
+and one hash file (md5.cl, md4.cl, sha1.cl, sha256.cl), which defines
+DIGEST_WORDS, hash_words(m, len, out) and, outside vector builds,
+hash(msg, len, out), with 'out' in digest byte order.*/
+
+/*128-bit index of key 'offset' of a launch that starts at key 'base'.
+Counter keys are 16 bytes, so their indices need both halves (x low,
+y high); the carry costs one compare per work-item.*/
+inline ulong2 key_at(const ulong2 base, const uint offset) {
+	ulong2 index;
+	index.x = base.x + offset;
+	index.y = base.y + (index.x < base.x);
+	return index;
+}
+
+/*Counter keys are built as words: the 16 key bytes are the big-endian
+128-bit index, so little-endian word 3 holds its lowest 32 bits. A
+work-item hashes KEYS_PER_ITEM words of VECTOR_WIDTH consecutive keys.
+Launches start on a block and ITEM_KEYS divides BLOCK_SIZE, so no item
+crosses a multiple of 2 ** 32 and only word 3 differs within one.*/
+#define ITEM_KEYS (KEYS_PER_ITEM * VECTOR_WIDTH)
+
+__constant uint lane_offsets[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+// step 'k' of the item at 'index', lane l holds key k * VECTOR_WIDTH + l
+inline void counter_key(uintv* key, const ulong2 index, const uint k) {
+	key[0] = swap_bytes(index.y >> 32);
+	key[1] = swap_bytes(index.y);
+	key[2] = swap_bytes(index.x >> 32);
+	key[3] = swap_bytesv((uint)index.x + k * VECTOR_WIDTH + load_lanes(lane_offsets));
+}
+
+/*Hashes counter key words as the build selected: as is, or widened to
+UTF-16LE with -D UTF16 (NTLM).*/
+inline void hash_counter_key(const uintv* key, uintv* out) {
+	uintv m[16];
+	for (uint w = 0; w < 16; ++w)
+		m[w] = 0;
+
+#ifdef UTF16
+	for (uint w = 0; w < KEY_SIZE / 4; ++w) {
+		m[w * 2] = (key[w] & 0xff) | ((key[w] & 0xff00) << 8);
+		m[w * 2 + 1] = ((key[w] >> 16) & 0xff) | ((key[w] >> 8) & 0xff0000);
+	}
+	m[KEY_SIZE / 2] = 0x80;
+	hash_words(m, KEY_SIZE * 2, out);
+#else
+	for (uint w = 0; w < KEY_SIZE / 4; ++w)
+		m[w] = key[w];
+	m[KEY_SIZE / 4] = 0x80;
+	hash_words(m, KEY_SIZE, out);
+#endif
+}
+
+/*Mask keys: 'chars' holds 256 chars per position and 'radix' the
+charset sizes. A key is the mixed-radix decoding of its index, with
+the first position changing fastest.*/
+void decode_mask(char* key, uchar* digit, ulong index, const uint length,
+	__constant uchar* chars, __constant uint* radix) {
+	for (uint p = 0; p < length; ++p) {
+		digit[p] = index % radix[p];
+		index /= radix[p];
+		key[p] = chars[p * 256 + digit[p]];
+	}
+}
+
+/*decode_mask() of a 128-bit index: long division in 32-bit steps while
+the high half is set, the plain one after that.*/
+void decode_wide_mask(char* key, uchar* digit, ulong2 index, const uint length,
+	__constant uchar* chars, __constant uint* radix) {
+	uint p = 0;
+	for (; p < length && index.y; ++p) {
+		const ulong mid = (index.y % radix[p]) << 32 | (index.x >> 32);
+		const ulong low = (mid % radix[p]) << 32 | (index.x & 0xffffffff);
+		index.y /= radix[p];
+		index.x = (mid / radix[p]) << 32 | (low / radix[p]);
+		digit[p] = low % radix[p];
+		key[p] = chars[p * 256 + digit[p]];
+	}
+
+	decode_mask(key + p, digit + p, index.x, length - p, chars + p * 256, radix + p);
+}
+
+// keys from 'index' to the end of a 128-bit 'space', capped at 'most'
+inline uint keys_left(const ulong2 index, const ulong2 space, const uint most) {
+	if (index.y > space.y || (index.y == space.y && index.x >= space.x))
+		return 0;
+	if (space.y - index.y - (space.x < index.x))
+		return most;
+	return (space.x - index.x < most) ? (uint)(space.x - index.x) : most;
+}
+
+inline void next_mask(char* key, uchar* digit, const uint length,
+	__constant uchar* chars, __constant uint* radix) {
+	for (uint p = 0; p < length; ++p) {
+		const uint d = digit[p] + 1;
+
+		// no carry, done
+		if (d < radix[p]) {
+			digit[p] = d;
+			key[p] = chars[p * 256 + d];
+			return;
+		}
+
+		digit[p] = 0;
+		key[p] = chars[p * 256];
+	}
+}
+
+inline bool probe(__global const uint* bitmap, const uint mask, const uint word) {
+	return (bitmap[(word & mask) >> 5] >> (word & 31)) & 1;
+}
+
+int find_target(__global const uint4* table, const uint count, const uint* h) {
+	// lower bound on the first word, then check the full digests
+	uint lo = 0, hi = count;
+	while (lo < hi) {
+		const uint mid = (lo + hi) / 2;
+		if (table[mid].x < h[0])
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < count && table[lo].x == h[0]; ++lo)
+		if (table[lo].y == h[1] && table[lo].z == h[2] && table[lo].w == h[3])
+			return lo;
+
+	return -1;
+}
+
+inline void check_target(__global volatile uint* result, const uint* h, const uint4 target, const uint index) {
+	// only a hit touches global memory, keep the lowest index
+	if (h[0] == target.x && h[1] == target.y && h[2] == target.z && h[3] == target.w)
+		atomic_min(result, index);
+}
+
+/*'hits' holds a counter followed by (key index in launch, target index)
+pairs; pairs past 'capacity' are counted but not stored.*/
+inline void check_targets(__global volatile uint* hits, const uint* h, const uint index,
+	__global const uint* bitmap_a, __global const uint* bitmap_b, const uint mask,
+	__global const uint4* table, const uint count, const uint capacity) {
+	// nearly every key stops at the bitmaps
+	if (!probe(bitmap_a, mask, h[0]) || !probe(bitmap_b, mask, h[1]))
+		return;
+
+	const int t = find_target(table, count, h);
+	if (t >= 0) {
+		const uint slot = atomic_inc(&hits[0]);
+		if (slot < capacity) {
+			hits[1 + slot * 2] = index;
+			hits[2 + slot * 2] = t;
+		}
+	}
+}
+
+// keeps the lowest of the keys set in 'hit', key 'first' in lane 0
+inline void report_lanes(__global volatile uint* result, const intv hit, const uint first) {
+	if (!any_lane(hit))
+		return;
+
+	int lanes[VECTOR_WIDTH];
+	store_lanes(hit, lanes);
+	for (uint l = 0; l < VECTOR_WIDTH; ++l)
+		if (lanes[l]) {
+			atomic_min(result, first + l);
+			return;
+		}
+}
+
+// check_target() for a uintv of keys, 'first' in lane 0
+inline void check_target_lanes(__global volatile uint* result, const uintv* h, const uint4 target, const uint first) {
+	report_lanes(result, (h[0] == target.x) & (h[1] == target.y) & (h[2] == target.z) & (h[3] == target.w), first);
+}
+
+// check_targets() for a uintv of keys, 'first' in lane 0
+inline void check_targets_lanes(__global volatile uint* hits, const uintv* h, const uint first,
+	__global const uint* bitmap_a, __global const uint* bitmap_b, const uint mask,
+	__global const uint4* table, const uint count, const uint capacity) {
+	uint lanes[DIGEST_WORDS][VECTOR_WIDTH];
+	for (uint w = 0; w < DIGEST_WORDS; ++w)
+		store_lanes(h[w], lanes[w]);
+
+	for (uint l = 0; l < VECTOR_WIDTH; ++l) {
+		uint out[DIGEST_WORDS];
+		for (uint w = 0; w < DIGEST_WORDS; ++w)
+			out[w] = lanes[w][l];
+		check_targets(hits, out, first + l, bitmap_a, bitmap_b, mask, table, count, capacity);
+	}
+}
+
+#ifdef COUNTER_SINGLE
+/*The hash file has a fast path for counter keys, and the host hands
+over 'target' in the form it expects. The fast path takes the first 8
+key bytes as zero; keys from 2 ** 64 on are hashed in full and compared
+to the plain 'digest'.*/
+__kernel void smash(__global volatile uint* result, ulong2 base, uint4 target, uint4 digest) {
+	const uint first = get_global_id(0) * ITEM_KEYS; // my sub-range of the launch
+	const ulong2 index = key_at(base, first);
+	uintv key[KEY_SIZE / 4], out[DIGEST_WORDS];
+
+	// the same branch for the whole launch, except one crossing 2 ** 64
+	if (!index.y) {
+		const uint x2 = swap_bytes(index.x >> 32);
+		for (uint k = 0; k < KEYS_PER_ITEM; ++k) {
+			counter_key(key, index, k);
+			report_lanes(result, hash_counter(x2, key[3], target), first + k * VECTOR_WIDTH);
+		}
+		return;
+	}
+
+	for (uint k = 0; k < KEYS_PER_ITEM; ++k) {
+		counter_key(key, index, k);
+		hash_counter_key(key, out);
+		check_target_lanes(result, out, digest, first + k * VECTOR_WIDTH);
+	}
+}
+#else
+__kernel void smash(__global volatile uint* result, ulong2 base, uint4 target) {
+	uintv key[KEY_SIZE / 4], out[DIGEST_WORDS];
+	const uint first = get_global_id(0) * ITEM_KEYS; // my sub-range of the launch
+
+	// key = base + first, built directly
+	// instead of counting up to it from zero
+	const ulong2 index = key_at(base, first);
+
+	for (uint k = 0; k < KEYS_PER_ITEM; ++k) {
+		counter_key(key, index, k);
+		hash_counter_key(key, out); // compute the hashes
+		check_target_lanes(result, out, target, first + k * VECTOR_WIDTH);
+	}
+}
+#endif
+
+/*Checks every key against a whole target set.*/
+__kernel void smash_multi(__global volatile uint* hits, ulong2 base,
+	__global const uint* bitmap_a, __global const uint* bitmap_b, uint mask,
+	__global const uint4* table, uint count, uint capacity) {
+	uintv key[KEY_SIZE / 4], out[DIGEST_WORDS];
+	const uint first = get_global_id(0) * ITEM_KEYS; // my sub-range of the launch
+	const ulong2 index = key_at(base, first);
+
+	for (uint k = 0; k < KEYS_PER_ITEM; ++k) {
+		counter_key(key, index, k);
+		hash_counter_key(key, out); // compute the hashes
+		check_targets_lanes(hits, out, first + k * VECTOR_WIDTH, bitmap_a, bitmap_b, mask, table, count, capacity);
+	}
+}
+
+/*Everything below hashes byte keys one at a time and is left out of
+vector builds, which only run the counter kernels above.*/
+#if VECTOR_WIDTH == 1
+/*Hashes a key as the build selected it: as is, or widened to UTF-16LE
+with -D UTF16 (NTLM). Returns false if the message does not fit.*/
+inline bool hash_key(char* key, const uint length, uint* out) {
+#ifdef UTF16
+	char wide[MAX_KEY_LEN];
+	if (length * 2 > MAX_KEY_LEN)
+		return false;
+
+	for (uint p = 0; p < length; ++p) {
+		wide[p * 2] = key[p];
+		wide[p * 2 + 1] = 0;
+	}
+	hash(wide, length * 2, out);
+#else
+	hash(key, length, out);
+#endif
+	return true;
+}
+
+
+/*Mask mode: generates, hashes and compares 'length' byte keys of a
+mask keyspace with 'space' keys in one pass. Indices and the space are
+128-bit like counter ones; a launch with keys past the end of the space
+finds nothing there.*/
+__kernel void smash_mask(__global volatile uint* result, ulong2 base, uint4 target,
+	__constant uchar* chars, __constant uint* radix, uint length, ulong2 space) {
+	char key[MAX_KEY_LEN];
+	uchar digit[MAX_KEY_LEN];
+	uint out[DIGEST_WORDS];
+	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch
+
+#ifdef MASK_LENGTH
+	length = MASK_LENGTH; // variant built for one length, the key loops unroll
+#endif
+
+	const ulong2 index = key_at(base, first);
+	const uint keys = keys_left(index, space, KEYS_PER_ITEM);
+	if (!keys)
+		return;
+
+	decode_wide_mask(key, digit, index, length, chars, radix);
+
+	for (uint k = 0; k < keys; ++k) {
+		if (hash_key(key, length, out))
+			check_target(result, out, target, first + k);
+		next_mask(key, digit, length, chars, radix);
+	}
+}
+
+__kernel void smash_mask_multi(__global volatile uint* hits, ulong2 base,
+	__global const uint* bitmap_a, __global const uint* bitmap_b, uint mask,
+	__global const uint4* table, uint count, uint capacity,
+	__constant uchar* chars, __constant uint* radix, uint length, ulong2 space) {
+	char key[MAX_KEY_LEN];
+	uchar digit[MAX_KEY_LEN];
+	uint out[DIGEST_WORDS];
+	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch
+
+#ifdef MASK_LENGTH
+	length = MASK_LENGTH; // variant built for one length, the key loops unroll
+#endif
+
+	const ulong2 index = key_at(base, first);
+	const uint keys = keys_left(index, space, KEYS_PER_ITEM);
+	if (!keys)
+		return;
+
+	decode_wide_mask(key, digit, index, length, chars, radix);
+
+	for (uint k = 0; k < keys; ++k) {
+		if (hash_key(key, length, out))
+			check_targets(hits, out, first + k, bitmap_a, bitmap_b, mask, table, count, capacity);
+		next_mask(key, digit, length, chars, radix);
+	}
+}
+
+/*Wordlist mode: 'words' holds offset << 8 | length of each of the
+'count' words packed into 'data'. Words are hashed straight from the
+uploaded chunk, nothing is decoded.*/
+inline uint load_word(char* key, __global const uchar* data, const uint word) {
+	const uint length = word & 0xff;
+	__global const uchar* src = data + (word >> 8);
+
+	for (uint p = 0; p < length; ++p)
+		key[p] = src[p];
+
+	return length;
+}
+
+__kernel void smash_words(__global volatile uint* result, ulong base, uint4 target,
+	__global const uchar* data, __global const uint* words, uint count) {
+	char key[MAX_KEY_LEN];
+	uint out[DIGEST_WORDS];
+	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch
+
+	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < count; ++k) {
+		if (hash_key(key, load_word(key, data, words[base + first + k]), out))
+			check_target(result, out, target, first + k);
+	}
+}
+
+__kernel void smash_words_multi(__global volatile uint* hits, ulong base,
+	__global const uint* bitmap_a, __global const uint* bitmap_b, uint mask,
+	__global const uint4* table, uint count, uint capacity,
+	__global const uchar* data, __global const uint* words, uint words_count) {
+	char key[MAX_KEY_LEN];
+	uint out[DIGEST_WORDS];
+	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch
+
+	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < words_count; ++k) {
+		if (hash_key(key, load_word(key, data, words[base + first + k]), out))
+			check_targets(hits, out, first + k, bitmap_a, bitmap_b, mask, table, count, capacity);
+	}
+}
+
+/*Hybrid mode: every word gets each of the 'space' keys of 'length' of a
+mask appended, or prepended with 'prefix'. candidate = word * space +
+mask index, so neighbours share a word and only step the mask part.
+Returns the key's length, 0 if the word is too long for it.*/
+inline uint load_hybrid(char* key, uchar* digit, __global const uchar* data, const uint word, const ulong index,
+	const uint length, __constant uchar* chars, __constant uint* radix, const uint prefix) {
+	const uint size = word & 0xff;
+	if (size + length > MAX_KEY_LEN)
+		return 0;
+
+	load_word(key + (prefix ? length : 0), data, word);
+	decode_mask(key + (prefix ? 0 : size), digit, index, length, chars, radix);
+	return size + length;
+}
+
+__kernel void smash_hybrid(__global volatile uint* result, ulong base, uint4 target,
+	__global const uchar* data, __global const uint* words, uint count,
+	__constant uchar* chars, __constant uint* radix, uint length, ulong space, uint prefix) {
+	char key[MAX_KEY_LEN];
+	uchar digit[MAX_KEY_LEN];
+	uint out[DIGEST_WORDS];
+	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch
+	const ulong candidates = (ulong)count * space;
+
+	if (base + first >= candidates)
+		return;
+
+	uint word = (uint)((base + first) / space);
+	ulong index = (base + first) % space;
+	uint size = load_hybrid(key, digit, data, words[word], index, length, chars, radix, prefix);
+
+	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < candidates; ++k) {
+		// past the word's last mask key, on to the next word
+		if (index == space) {
+			index = 0;
+			size = load_hybrid(key, digit, data, words[++word], 0, length, chars, radix, prefix);
+		}
+
+		if (size && hash_key(key, size, out))
+			check_target(result, out, target, first + k);
+		if (size)
+			next_mask(key + (prefix ? 0 : size - length), digit, length, chars, radix);
+		++index;
+	}
+}
+
+__kernel void smash_hybrid_multi(__global volatile uint* hits, ulong base,
+	__global const uint* bitmap_a, __global const uint* bitmap_b, uint mask,
+	__global const uint4* table, uint count, uint capacity,
+	__global const uchar* data, __global const uint* words, uint words_count,
+	__constant uchar* chars, __constant uint* radix, uint length, ulong space, uint prefix) {
+	char key[MAX_KEY_LEN];
+	uchar digit[MAX_KEY_LEN];
+	uint out[DIGEST_WORDS];
+	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch
+	const ulong candidates = (ulong)words_count * space;
+
+	if (base + first >= candidates)
+		return;
+
+	uint word = (uint)((base + first) / space);
+	ulong index = (base + first) % space;
+	uint size = load_hybrid(key, digit, data, words[word], index, length, chars, radix, prefix);
+
+	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < candidates; ++k) {
+		if (index == space) {
+			index = 0;
+			size = load_hybrid(key, digit, data, words[++word], 0, length, chars, radix, prefix);
+		}
+
+		if (size && hash_key(key, size, out))
+			check_targets(hits, out, first + k, bitmap_a, bitmap_b, mask, table, count, capacity);
+		if (size)
+			next_mask(key + (prefix ? 0 : size - length), digit, length, chars, radix);
+		++index;
+	}
+}
+
+/*Rule mode: every word of a chunk is run through every rule. Rules are
+(op, a, b) instructions as compiled by rule_set on the host, 'rule_at'
+holds the first instruction of each rule. Both are global memory, rule
+files outgrow the constant buffer of most devices.*/
+#define RULE_END 0
+#define RULE_LOWER 1
+#define RULE_UPPER 2
+#define RULE_CAPITALIZE 3
+#define RULE_INVERT 4
+#define RULE_TOGGLE_ALL 5
+#define RULE_TOGGLE 6
+#define RULE_REVERSE 7
+#define RULE_DUPLICATE 8
+#define RULE_REFLECT 9
+#define RULE_APPEND 10
+#define RULE_PREPEND 11
+#define RULE_DELETE_FIRST 12
+#define RULE_DELETE_LAST 13
+#define RULE_DELETE 14
+#define RULE_TRUNCATE 15
+#define RULE_REPLACE 16
+#define RULE_PURGE 17
+#define RULE_REPEAT 18
+#define RULE_ROTATE_LEFT 19
+#define RULE_ROTATE_RIGHT 20
+
+inline uchar flip_case(const uchar c) {
+	return (c >= 'a' && c <= 'z') ? c - 32 : ((c >= 'A' && c <= 'Z') ? c + 32 : c);
+}
+
+inline uchar to_lower(const uchar c) { return (c >= 'A' && c <= 'Z') ? c + 32 : c; }
+inline uchar to_upper(const uchar c) { return (c >= 'a' && c <= 'z') ? c - 32 : c; }
+
+// returns the new length, 0 if the rule rejects the word
+uint apply_rule(uchar* key, uint length, __global const uchar* ins) {
+	for (;; ins += 3) {
+		const uchar a = ins[1], b = ins[2];
+		uint p, n;
+		uchar c;
+
+		switch (ins[0]) {
+		case RULE_END:
+			return length;
+		case RULE_LOWER:
+			for (p = 0; p < length; ++p) key[p] = to_lower(key[p]);
+			break;
+		case RULE_UPPER:
+			for (p = 0; p < length; ++p) key[p] = to_upper(key[p]);
+			break;
+		case RULE_CAPITALIZE:
+		case RULE_INVERT:
+			for (p = 0; p < length; ++p)
+				key[p] = ((p == 0) == (ins[0] == RULE_CAPITALIZE)) ? to_upper(key[p]) : to_lower(key[p]);
+			break;
+		case RULE_TOGGLE_ALL:
+			for (p = 0; p < length; ++p) key[p] = flip_case(key[p]);
+			break;
+		case RULE_TOGGLE:
+			if (a < length) key[a] = flip_case(key[a]);
+			break;
+		case RULE_REVERSE:
+			for (p = 0; p < length / 2; ++p) {
+				c = key[p];
+				key[p] = key[length - p - 1];
+				key[length - p - 1] = c;
+			}
+			break;
+		case RULE_DUPLICATE:
+			if (length * 2 > MAX_KEY_LEN) return 0;
+			for (p = 0; p < length; ++p) key[length + p] = key[p];
+			length *= 2;
+			break;
+		case RULE_REFLECT:
+			if (length * 2 > MAX_KEY_LEN) return 0;
+			for (p = 0; p < length; ++p) key[length + p] = key[length - p - 1];
+			length *= 2;
+			break;
+		case RULE_APPEND:
+			if (length == MAX_KEY_LEN) return 0;
+			key[length++] = a;
+			break;
+		case RULE_PREPEND:
+			if (length == MAX_KEY_LEN) return 0;
+			for (p = length; p > 0; --p) key[p] = key[p - 1];
+			key[0] = a;
+			++length;
+			break;
+		case RULE_DELETE_FIRST:
+			if (!length) break;
+			for (p = 1; p < length; ++p) key[p - 1] = key[p];
+			--length;
+			break;
+		case RULE_DELETE_LAST:
+			if (length) --length;
+			break;
+		case RULE_DELETE:
+			if (a >= length) break;
+			for (p = a + 1; p < length; ++p) key[p - 1] = key[p];
+			--length;
+			break;
+		case RULE_TRUNCATE:
+			if (a < length) length = a;
+			break;
+		case RULE_REPLACE:
+			for (p = 0; p < length; ++p) if (key[p] == a) key[p] = b;
+			break;
+		case RULE_PURGE:
+			for (p = 0, n = 0; p < length; ++p) if (key[p] != a) key[n++] = key[p];
+			length = n;
+			break;
+		case RULE_REPEAT:
+			if (length * (a + 1) > MAX_KEY_LEN) return 0;
+			for (p = length; p < length * (a + 1); ++p) key[p] = key[p - length];
+			length *= a + 1;
+			break;
+		case RULE_ROTATE_LEFT:
+			if (!length) break;
+			c = key[0];
+			for (p = 1; p < length; ++p) key[p - 1] = key[p];
+			key[length - 1] = c;
+			break;
+		case RULE_ROTATE_RIGHT:
+			if (!length) break;
+			c = key[length - 1];
+			for (p = length - 1; p > 0; --p) key[p] = key[p - 1];
+			key[0] = c;
+			break;
+		}
+	}
+}
+
+__kernel void smash_rules(__global volatile uint* result, ulong base, uint4 target,
+	__global const uchar* data, __global const uint* words, uint count,
+	__global const uchar* code, __global const uint* rule_at, uint rules) {
+	uchar key[MAX_KEY_LEN];
+	uint out[DIGEST_WORDS];
+	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch
+
+	// candidate = word * rules + rule, neighbours share a word
+	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < (ulong)count * rules; ++k) {
+		const ulong candidate = base + first + k;
+		uint length = load_word((char*)key, data, words[candidate / rules]);
+
+		length = apply_rule(key, length, code + rule_at[candidate % rules] * 3);
+		if (!length || !hash_key((char*)key, length, out))
+			continue;
+
+		check_target(result, out, target, first + k);
+	}
+}
+
+__kernel void smash_rules_multi(__global volatile uint* hits, ulong base,
+	__global const uint* bitmap_a, __global const uint* bitmap_b, uint mask,
+	__global const uint4* table, uint count, uint capacity,
+	__global const uchar* data, __global const uint* words, uint words_count,
+	__global const uchar* code, __global const uint* rule_at, uint rules) {
+	uchar key[MAX_KEY_LEN];
+	uint out[DIGEST_WORDS];
+	const uint first = get_global_id(0) * KEYS_PER_ITEM; // my sub-range of the launch
+
+	for (uint k = 0; k < KEYS_PER_ITEM && base + first + k < (ulong)words_count * rules; ++k) {
+		const ulong candidate = base + first + k;
+		uint length = load_word((char*)key, data, words[candidate / rules]);
+
+		length = apply_rule(key, length, code + rule_at[candidate % rules] * 3);
+		if (!length || !hash_key((char*)key, length, out))
+			continue;
+
+		check_targets(hits, out, first + k, bitmap_a, bitmap_b, mask, table, count, capacity);
+	}
+}
+
+/*Rainbow chains over 'space' keys: the keys of 'length' of the mask in
+'chars' and 'radix', or counter keys below 2 ** 64 with length 0. Column
+c hashes the key at the chain's index and reduces the digest to the
+index of column c + 1: its first 8 bytes, little-endian, plus c modulo
+'space', as rainbow_reduce() does on the host. Each work-item walks one
+entry of 'chains' through columns [from, to) in place. With 'lookup',
+entry k holds a digest reduced in column (first + k) % columns and
+starts in the column after it.*/
+__kernel void smash_chains(__global ulong* chains, uint count, ulong first,
+	uint columns, uint from, const uint to, uint lookup, ulong space,
+	__constant uchar* chars, __constant uint* radix, uint length) {
+	char key[MAX_KEY_LEN];
+	uchar digit[MAX_KEY_LEN];
+	uint out[DIGEST_WORDS];
+	const uint id = get_global_id(0);
+	if (id >= count)
+		return;
+
+	if (lookup && (first + id) % columns + 1 > from)
+		from = (first + id) % columns + 1;
+
+	ulong index = chains[id];
+	for (uint c = from; c < to; ++c) {
+		uint size = length;
+		if (length)
+			decode_mask(key, digit, index, length, chars, radix);
+		else {
+			// big-endian counter, like counter_key()
+			size = KEY_SIZE;
+			for (uint k = 0; k < 8; ++k) {
+				key[k] = 0;
+				key[KEY_SIZE - 1 - k] = (char)(index >> (k * 8));
+			}
+		}
+
+		if (!hash_key(key, size, out))
+			return;
+		index = ((((ulong)out[1] << 32) | out[0]) + c) % space;
+	}
+	chains[id] = index;
+}
+#endif
@@ -1,12 +1,18 @@
 #pragma once
 
+#include <cstring>
 #include <sstream>
 #include <iostream>
 #include <fstream>
 #include "smasher.h"
+#include "cl_source.h"
+#include "hash_cpu.h"
+#include "program_cache.h"
 #include "log.h"
 
-#define CL_FILE "smashMD5.cl"
+#define CL_COMMON "hash.cl"
+#define CL_FILE "smash.cl"
+#define CL_CRYPT "crypt.cl"
 
 void smasher::set_platform() {
 	cl_uint ret_num_platforms;
@@ -15,30 +21,28 @@ void smasher::set_platform() {
 	set_ready();
 
 	// log data
-	stringstream s;
-	s << "Set platform to ID " << platform << ". NUMBER_OF_PLATFORMS = " << ret_num_platforms << ". Return code = " << getErrorString(ret);
-	_log(s.str());
+	LOG_LINE("Set platform to ID " << platform << ". NUMBER_OF_PLATFORMS = " << ret_num_platforms << ". Return code = " << getErrorString(ret));
 }
 
 void smasher::set_device() {
 	cl_uint ret_num_devices;
 	ret = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, &ret_num_devices);
 
+	// no GPU, take any other device (e.g. an OpenCL CPU runtime)
+	if (ret != CL_SUCCESS)
+		ret = clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 1, &device, &ret_num_devices);
+
 	set_ready();
 
 	// log data
-	stringstream s;
-	s << "Set device to ID " << device << ". NUMBER_OF_DEVICES = " << ret_num_devices << ". Return code = " << getErrorString(ret);
-	_log(s.str());
+	LOG_LINE("Set device to ID " << device << ". NUMBER_OF_DEVICES = " << ret_num_devices << ". Return code = " << getErrorString(ret));
 }
 
 void smasher::create_context() {
 	context = clCreateContext(NULL, 1, &device, NULL, NULL, &ret);
 
 	// log creation
-	stringstream s;
-	s << "Created context. Return code = " << getErrorString(ret);
-	_log(s.str());
+	LOG_LINE("Created context. Return code = " << getErrorString(ret));
 
 	set_ready();
 }
@@ -47,176 +51,1225 @@ void smasher::create_command_queue() {
 	/*NOTE: Even though 'clCreateCommandQueue' is deprecated, 
 	'clCreateCommandQueueWithProperties' causes error when not debugging!!!*/
 
-	command_queue = clCreateCommandQueue(context, device, NULL, &ret);
+	// profiling adds a few timestamps per command, too little to notice
+	command_queue = clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, &ret);
 
 	// log creation
-	stringstream s;
-	s << "Created command queue. Return code = " << getErrorString(ret);
-	_log(s.str());
+	LOG_LINE("Created command queue. Return code = " << getErrorString(ret));
 
 	set_ready();
 }
 
 void smasher::read_cl() {
-	// open file
-	fstream file(CL_FILE);
+	// shared definitions, the hash, then the kernels built on it
+	const char* files[] = { CL_COMMON, algo.source, CL_FILE, CL_CRYPT };
 
-	// get file size
-	int size = file.tellg();
-	file.seekg(ios::beg);
-
-	// read CL code
+	// the sources are compiled in, see embed_cl.sh
 	stringstream buffer;
-	buffer << file.rdbuf();
-	file.close();
+	for (uint k = 0; k < 4; ++k) {
+		const char* text = cl_source(files[k]);
+		if (!text)
+			ret = CL_INVALID_VALUE;
+		else
+			buffer << text << endl;
+	}
 
 	code = buffer.str();
 
-	// log compilation
-	stringstream s;
-	s << "Read and compiled CL-code. Return code = " << getErrorString(ret);
-	_log(s.str());
+	// log loading
+	LOG_LINE("Loaded CL-code. Return code = " << getErrorString(ret));
 
 	set_ready();
 }
 
-void smasher::create_program() {
-	// turn string into char buffer
-	int count = code.size();
-	char *buffer = &code[0];
-
-	// compile code
-	program = clCreateProgramWithSource(context, 1, (const char**)&buffer, (const size_t *)&count, &ret);
-	ret = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
-
-	/*
-	//----------------------------------------------------------------------------------
-	char a[4096];
-	size_t length;
-	clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 4096, &a, &length);
-	cout.write(a, length);
-	//----------------------------------------------------------------------------------
-	*/
+void smasher::build_program(cl_program program, const string& options) {
+	ret = clBuildProgram(program, 1, &device, options.c_str(), NULL, NULL);
+	if (ret == CL_SUCCESS)
+		return;
 
-	// log creation
+	// keep the compiler's output, it is the only way to see what went wrong
+	size_t length = 0;
+	clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &length);
+	build_log.assign(length, 0);
+	if (length)
+		clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, length, &build_log[0], NULL);
+	build_log = build_log.c_str();
+
+	LOG_LINE("Build failed:\n" << build_log);
+}
+
+string smasher::build_options(uint length, uint width) {
+	// the shared sizes come from types.h and mask.h, the device never repeats them
 	stringstream s;
-	s << "Created program. Return code = " << getErrorString(ret);
-	_log(s.str());
+	s << algo.options << " -D KEY_SIZE=" << KEY_SIZE << " -D MAX_KEY_LEN=" << MAX_KEY_LEN << " -D KEYS_PER_ITEM=" << KEYS_PER_ITEM;
+	if (length)
+		s << " -D MASK_LENGTH=" << length;
+	if (width > 1)
+		s << " -D VECTOR_WIDTH=" << width;
+	return s.str();
+}
+
+cl_program smasher::load_program(const string& options) {
+	char device_name[256] = "", driver[256] = "";
+	clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(device_name) - 1, device_name, NULL);
+	clGetDeviceInfo(device, CL_DRIVER_VERSION, sizeof(driver) - 1, driver, NULL);
+
+	program_cache cache;
+	cache.init(device_name, driver, options, code);
+
+	// a cached binary skips compilation, anything wrong with it falls back to the source
+	cl_program built = NULL;
+	vector<uchar> binary;
+	if (cache.load(binary)) {
+		const uchar* data = &binary[0];
+		size_t size = binary.size();
+		cl_int status;
+		built = clCreateProgramWithBinary(context, 1, &device, &size, &data, &status, &ret);
+		if (ret == CL_SUCCESS && status == CL_SUCCESS)
+			build_program(built, options);
+
+		if (ret != CL_SUCCESS || status != CL_SUCCESS) {
+			if (built)
+				clReleaseProgram(built);
+			built = NULL;
+			LOG_LINE("Cached program binary rejected, building from source");
+		}
+	}
+
+	if (!built) {
+		const char* buffer = code.c_str();
+		size_t length = code.size();
+		built = clCreateProgramWithSource(context, 1, &buffer, &length, &ret);
+		if (ret == CL_SUCCESS)
+			build_program(built, options);
+
+		// store what the driver built for the next start
+		if (ret == CL_SUCCESS) {
+			size_t size = 0;
+			clGetProgramInfo(built, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &size, NULL);
+			binary.assign(size, 0);
+			uchar* data = size ? &binary[0] : NULL;
+			if (size && clGetProgramInfo(built, CL_PROGRAM_BINARIES, sizeof(uchar*), &data, NULL) == CL_SUCCESS)
+				cache.save(binary);
+		}
+	}
+
+	// log creation
+	LOG_LINE("Created program. OPTIONS = " << options << ". Return code = " << getErrorString(ret));
+
+	if (ret != CL_SUCCESS && built) {
+		clReleaseProgram(built);
+		built = NULL;
+	}
+	return built;
+}
 
+void smasher::create_program() {
+	program = load_program(build_options(0));
 	set_ready();
+
+	if (is_ready)
+		create_vector_program();
+}
+
+void smasher::create_vector_program() {
+	cl_uint preferred = 1;
+	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT, sizeof(preferred), &preferred, NULL);
+
+	// uintn exists for n = 2, 4, 8 and 16
+	uint width = 1;
+	while (width * 2 <= preferred && width * 2 <= MAX_VECTOR_WIDTH)
+		width *= 2;
+
+	if (width == 1)
+		return;
+
+	// the scalar kernels are still there if the driver can not build it
+	vector_program = load_program(build_options(0, width));
+	if (vector_program)
+		vector_width = width;
+	else
+		ret = CL_SUCCESS;
+
+	LOG_LINE("Built vector counter kernels. WIDTH = " << width << (vector_program ? "" : " (failed, using the scalar kernels)"));
 }
 
 void smasher::create_kernel() {
-	kernel = clCreateKernel(program, FUNC_NAME, &ret);
+	// counter kernels from the vector program if there is one, they take the same arguments
+	cl_program counter = vector_program ? vector_program : program;
+	kernel = clCreateKernel(counter, FUNC_NAME, &ret);
 
 	// log creation
-	stringstream s;
-	s << "Created kernel. Return code = " << getErrorString(ret);
-	_log(s.str());
+	LOG_LINE("Created kernel. Return code = " << getErrorString(ret));
 
 	set_ready();
+
+	kernel_multi = clCreateKernel(counter, FUNC_MULTI, &ret);
+	LOG_LINE("Created multi-target kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+
+	kernel_mask = clCreateKernel(program, FUNC_MASK, &ret);
+	LOG_LINE("Created mask kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+
+	kernel_mask_multi = clCreateKernel(program, FUNC_MASK_MULTI, &ret);
+	LOG_LINE("Created multi-target mask kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+
+	mask_variant generic = { 0, NULL, kernel_mask, kernel_mask_multi };
+	variants.push_back(generic);
+
+	kernel_words = clCreateKernel(program, FUNC_WORDS, &ret);
+	LOG_LINE("Created wordlist kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+
+	kernel_words_multi = clCreateKernel(program, FUNC_WORDS_MULTI, &ret);
+	LOG_LINE("Created multi-target wordlist kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+
+	kernel_rules = clCreateKernel(program, FUNC_RULES, &ret);
+	LOG_LINE("Created rule kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+
+	kernel_rules_multi = clCreateKernel(program, FUNC_RULES_MULTI, &ret);
+	LOG_LINE("Created multi-target rule kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+
+	kernel_hybrid = clCreateKernel(program, FUNC_HYBRID, &ret);
+	LOG_LINE("Created hybrid kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+
+	kernel_hybrid_multi = clCreateKernel(program, FUNC_HYBRID_MULTI, &ret);
+	LOG_LINE("Created multi-target hybrid kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+
+	kernel_md5crypt = clCreateKernel(program, FUNC_MD5CRYPT, &ret);
+	LOG_LINE("Created md5crypt kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+
+	kernel_sha512crypt = clCreateKernel(program, FUNC_SHA512CRYPT, &ret);
+	LOG_LINE("Created sha512crypt kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+
+	kernel_chains = clCreateKernel(program, FUNC_CHAINS, &ret);
+	LOG_LINE("Created rainbow chain kernel. Return code = " << getErrorString(ret));
+
+	set_ready();
+}
+
+void smasher::tune_device() {
+	char name[256] = "", driver[256] = "";
+	size_t group = ~(size_t)0, multiple = 1;
+
+	clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+	clGetDeviceInfo(device, CL_DRIVER_VERSION, sizeof(driver) - 1, driver, NULL);
+
+	// all kernels run with the same work-group size
+	const cl_kernel kernels[] = { kernel, kernel_multi, kernel_mask, kernel_mask_multi, kernel_words, kernel_words_multi,
+		kernel_rules, kernel_rules_multi, kernel_hybrid, kernel_hybrid_multi };
+	for (uint k = 0; k < 10; ++k) {
+		size_t max = 0;
+		clGetKernelWorkGroupInfo(kernels[k], device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &max, NULL);
+		if (max < group)
+			group = max;
+	}
+	clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(size_t), &multiple, NULL);
+
+	// a group must divide a one block launch of the vector kernels too
+	if (BLOCK_SIZE / (KEYS_PER_ITEM * vector_width) < group)
+		group = BLOCK_SIZE / (KEYS_PER_ITEM * vector_width);
+
+	// vector kernels tune differently, they get their own stored values
+	stringstream key;
+	key << name << " | " << driver << " | " << algo.name;
+	if (vector_width > 1)
+		key << " | uint" << vector_width;
+
+	this->name = name;
+	tuner.init(key.str(), MAX_LAUNCH_BLOCKS, group, multiple);
 }
 
 void smasher::init() {
-	_log("Beginning initialization...");
+	LOG_LINE("Beginning initialization...");
 
 	set_platform();
-	set_device();
+	if (is_ready)
+		set_device();
+
+	// nothing OpenCL can run on, search on the CPU instead
+	if (!is_ready) {
+		LOG_LINE("No OpenCL device found, using native CPU engine");
+		native = new cpu_smasher(algo);
+		name = string("native ") + native->get_isa();
+		is_ready = true;
+		return;
+	}
+
+	init_device();
+}
+
+void smasher::init_device() {
 	create_context();
 	create_command_queue();
 	read_cl();
 	create_program();
 	create_kernel();
+	tune_device();
+	create_block_memory();
 
-	_log("Initialization complete");
+	LOG_LINE("Initialization complete");
 }
 
 /*Operation specific functions*/
 
-void smasher::create_block_memory(char* out) {
-	stringstream s_log;
+void smasher::create_block_memory() {
+	// allocated once, every launch reuses its slot's buffers
+	for (uint k = 0; k < PIPELINE_DEPTH; ++k) {
+		launch_slot& slot = slots[k];
 
-	output = clCreateBuffer(context, 
-		CL_MEM_WRITE_ONLY | CL_MEM_COPY_HOST_PTR, 
-		TOTAL_MD5_SIZE,
-		out,
-		&ret);
-	s_log << "Created output memory. count = " << TOTAL_MD5_SIZE << ". Return code = " << getErrorString(ret);
+		// a single word the kernel writes a hit into, no digests come back
+		slot.result = clCreateBuffer(context, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &ret);
+		LOG_LINE("Created result memory for slot " << k << ". Return code = " << getErrorString(ret));
+		set_ready();
 
-	_log(s_log.str());
+		// a counter followed by up to HIT_CAPACITY (key, target) pairs
+		slot.hits = clCreateBuffer(context, CL_MEM_READ_WRITE, (1 + HIT_CAPACITY * 2) * sizeof(cl_uint), NULL, &ret);
+		LOG_LINE("Created hit memory for slot " << k << ". Return code = " << getErrorString(ret));
+		set_ready();
+
+		slot.data = NULL;
+		slot.words = NULL;
+		slot.done = NULL;
+		slot.written = NULL;
+		slot.ran = NULL;
+		slot.uploads[0] = NULL;
+		slot.uploads[1] = NULL;
+	}
 }
 
-void smasher::get_results(char* res) {
-	// read result into out
-	ret = clEnqueueReadBuffer(command_queue, output, CL_TRUE, 0, TOTAL_MD5_SIZE, res, 0, NULL, NULL);
+void smasher::create_word_memory() {
+	if (slots[0].data)
+		return;
 
-	// log reading
-	stringstream s;
-	s << "Read output from GPU memory. Return code = " << getErrorString(ret);
-	_log(s.str());
+	for (uint k = 0; k < PIPELINE_DEPTH; ++k) {
+		launch_slot& slot = slots[k];
+
+		slot.data = clCreateBuffer(context, CL_MEM_READ_ONLY, WORD_CHUNK, NULL, &ret);
+		LOG_LINE("Created wordlist memory for slot " << k << ". Return code = " << getErrorString(ret));
+		set_ready();
+
+		slot.words = clCreateBuffer(context, CL_MEM_READ_ONLY, WORD_MAX_COUNT * sizeof(cl_uint), NULL, &ret);
+		LOG_LINE("Created word memory for slot " << k << ". Return code = " << getErrorString(ret));
+		set_ready();
+	}
 }
 
-void smasher::set_args() {
-	stringstream s;
+void smasher::set_args(launch_slot& slot, cl_mem out, uint128 base) {
+	ret = clSetKernelArg(slot.kernel, 0, sizeof(cl_mem), &out);
 
-	ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), &output);
-	s << "Set argument0 to output memory. Return code = " << getErrorString(ret);
+	// block kernels take the 128-bit key index, wordlist ones a candidate number
+	const bool single = (slot.kernel == kernel_words || slot.kernel == kernel_rules || slot.kernel == kernel_hybrid);
+	if (!single && slot.kernel != kernel_words_multi && slot.kernel != kernel_rules_multi && slot.kernel != kernel_hybrid_multi) {
+		cl_ulong2 index;
+		index.s[0] = base.lo;
+		index.s[1] = base.hi;
+		ret = clSetKernelArg(slot.kernel, 1, sizeof(cl_ulong2), &index);
+		return;
+	}
+	cl_ulong candidate = base.lo;
+	ret = clSetKernelArg(slot.kernel, 1, sizeof(cl_ulong), &candidate);
 
-	ret = clSetKernelArg(kernel, 1, sizeof(cl_int), &block_number);
-	s << endl << "Set argument1 to block number " << block_number << ". Return code = " << getErrorString(ret);
+	// the chunk lives in the slot's own buffers, after the target arguments
+	cl_uint first = single ? 3 : 8;
+	cl_uint count = (cl_uint)slot.batch.words.size();
+	ret = clSetKernelArg(slot.kernel, first, sizeof(cl_mem), &slot.data);
+	ret = clSetKernelArg(slot.kernel, first + 1, sizeof(cl_mem), &slot.words);
+	ret = clSetKernelArg(slot.kernel, first + 2, sizeof(cl_uint), &count);
+}
 
-	_log(s.str());
+void smasher::upload(launch_slot& slot) {
+	// non-blocking, the batch stays in the slot until the launch retires
+	ret = clEnqueueWriteBuffer(command_queue, slot.data, CL_FALSE, 0, slot.batch.size, slot.batch.data, 0, NULL, &slot.uploads[0]);
+	ret = clEnqueueWriteBuffer(command_queue, slot.words, CL_FALSE, 0, slot.batch.words.size() * sizeof(cl_uint), &slot.batch.words[0], 0, NULL, &slot.uploads[1]);
 }
 
-void smasher::run() {
-	stringstream s1, s2;
+void smasher::run(launch_slot& slot, cl_kernel k, uint64 block, uint blocks) {
+	static const cl_uint no_match = NO_MATCH, no_hits = 0;
+
+	const size_t count = (size_t)blocks * (BLOCK_SIZE / item_keys(k));
+	const bool multi = (k == kernel_multi || k == kernel_mask_multi || k == kernel_words_multi || k == kernel_rules_multi || k == kernel_hybrid_multi);
+	cl_mem out = multi ? slot.hits : slot.result;
+
+	slot.kernel = k;
+	slot.block = block;
+	slot.blocks = blocks;
+	slot.local = tuner.get_local();
+	slot.issued = chrono::steady_clock::now();
+
+	// reset, run and read back without blocking, each step waits on the last
+	ret = clEnqueueWriteBuffer(command_queue, out, CL_FALSE, 0, sizeof(cl_uint), multi ? &no_hits : &no_match, 0, NULL, &slot.written);
+	set_args(slot, out, key_index(block));
+	ret = clEnqueueNDRangeKernel(command_queue, k, 1, NULL, &count, slot.local ? &slot.local : NULL, 1, &slot.written, &slot.ran);
+	ret = clEnqueueReadBuffer(command_queue, out, CL_FALSE, 0, (multi ? 1 + HIT_PREFIX * 2 : 1) * sizeof(cl_uint), slot.res, 1, &slot.ran, &slot.done);
+
+	clFlush(command_queue);
+}
 
-	const size_t count = BLOCK_SIZE;
+void smasher::get_results(launch_slot& slot) {
+	// wait for this slot's read, later launches keep running meanwhile
+	ret = clWaitForEvents(1, &slot.done);
+	profile(slot);
+	if (stats)
+		stats->add_launch((uint64)slot.blocks * BLOCK_SIZE);
 
-	_log("Running smasher...");
+	// with the pipeline full, launches retire one kernel time apart
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	chrono::duration<double, milli> took = now - (slot.issued > last_retired ? slot.issued : last_retired);
+	last_retired = now;
 
-	// run sorting
-	ret = clEnqueueNDRangeKernel(command_queue, kernel, 1, NULL, &count, NULL, NULL, NULL, NULL);
-	clFinish(command_queue);
+	// pinned sizes are not what the tuner chose, they would mislead it
+	if (!pinned)
+		tuner.record(slot.blocks, slot.local, took.count());
 }
 
-int smasher::smash(const uint block, char* cmpto) {
-	uchar out[TOTAL_MD5_SIZE];
+// ns the command of 'event' ran for, 0 without profiling
+static uint64 event_ns(cl_event event) {
+	cl_ulong start = 0, end = 0;
+	if (!event || clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL) != CL_SUCCESS ||
+		clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL) != CL_SUCCESS)
+		return 0;
+	return (end > start) ? end - start : 0;
+}
 
-	// setup and run
-	block_number = block;
-	create_block_memory((char*)out);
-	set_args();
-	run();
+void smasher::profile(launch_slot& slot) {
+	// every command before the read has finished once it has
+	if (stats) {
+		stats->add_stage(STAGE_WRITE, event_ns(slot.written) + event_ns(slot.uploads[0]) + event_ns(slot.uploads[1]));
+		stats->add_stage(STAGE_KERNEL, event_ns(slot.ran));
+		stats->add_stage(STAGE_READ, event_ns(slot.done));
+	}
 
-	get_results((char*)out); // read results
-	return find_match((char*)out, cmpto); // look for matching hash
+	cl_event* events[] = { &slot.written, &slot.ran, &slot.done, &slot.uploads[0], &slot.uploads[1] };
+	for (uint k = 0; k < 5; ++k)
+		if (*events[k]) {
+			clReleaseEvent(*events[k]);
+			*events[k] = NULL;
+		}
 }
 
-int smasher::find_match(const char* out, const char* cmpto)  {
-	// return index of key if exists
-	for (uint k = 0; k < BLOCK_SIZE; ++k) {
-		if (!memcmp(&out[k * KEY_SIZE], cmpto, KEY_SIZE)) // compare kth key in out to cmpto
-			return k;
+void smasher::add_native(chrono::steady_clock::time_point start, uint64 blocks) {
+	// the native engine has no stages, its whole search counts as the kernel
+	if (stats) {
+		stats->add_launch(blocks * BLOCK_SIZE);
+		stats->add_stage(STAGE_KERNEL, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
 	}
+}
 
-	return -1; // no matching keys =(
+void smasher::add_match(chrono::steady_clock::time_point start) {
+	if (stats)
+		stats->add_stage(STAGE_MATCH, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
 }
 
-smasher::smasher() {
+int smasher::smash(const uint64 block, char* cmpto) {
+	uint64 found;
+	return smash_range(block, 1, cmpto, found);
+}
+
+int smasher::smash_range(const uint64 first, const uint64 count, char* cmpto, uint64& found) {
+	if (native) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		int match = native->smash_range(first, count, cmpto, found);
+		add_native(start, count);
+		return match;
+	}
+
+	cl_kernel k = get_kernel(false);
+	memcpy(&target, cmpto, MATCH_SIZE); // digest bytes are the little-endian state words
+	if (!mask && algo.reverse) {
+		// the counter kernel takes it half reversed, and plain for keys past 2 ** 64
+		ret = clSetKernelArg(k, 3, sizeof(cl_uint4), &target);
+		algo.reverse((const uchar*)cmpto, (uint*)&target);
+	}
+	ret = clSetKernelArg(k, 2, sizeof(cl_uint4), &target);
+
+	// keep up to PIPELINE_DEPTH launches in flight, retire them in order
+	int match = -1;
+	uint64 done = 0;
+	uint issued = 0, retired = 0;
+	for (;;) {
+		while (done < count && issued - retired < PIPELINE_DEPTH && match < 0) {
+			uint blocks = (count - done < get_blocks()) ? (uint)(count - done) : get_blocks();
+			run(slots[issued++ % PIPELINE_DEPTH], k, first + done, blocks);
+			done += blocks;
+		}
+
+		if (retired == issued)
+			break; // all done or matched, nothing left in flight
+
+		launch_slot& slot = slots[retired++ % PIPELINE_DEPTH];
+		get_results(slot);
+
+		if (match < 0 && slot.res[0] != NO_MATCH) {
+			match = (int)(slot.res[0] % BLOCK_SIZE);
+			found = slot.block + slot.res[0] / BLOCK_SIZE;
+		}
+	}
+
+	return match;
+}
+
+void smasher::set_targets(const target_set& targets) {
+	release_targets();
+
+	bitmap_a = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		targets.get_bitmap_words() * sizeof(cl_uint), (void*)targets.get_bitmap_a(), &ret);
+	LOG_LINE("Created bitmap_a memory. Return code = " << getErrorString(ret));
+
+	bitmap_b = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		targets.get_bitmap_words() * sizeof(cl_uint), (void*)targets.get_bitmap_b(), &ret);
+	LOG_LINE("Created bitmap_b memory. Return code = " << getErrorString(ret));
+
+	table = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		targets.size() * MATCH_SIZE, (void*)targets.get_table(), &ret);
+	LOG_LINE("Created target table memory. count = " << targets.size() << ". Return code = " << getErrorString(ret));
+
+	// everything but the hit buffer and block number stays put
+	cl_uint mask = targets.get_mask();
+	cl_uint count = targets.size();
+	cl_uint capacity = HIT_CAPACITY;
+	const cl_kernel kernels[] = { kernel_multi, kernel_mask_multi, kernel_words_multi, kernel_rules_multi, kernel_hybrid_multi };
+	for (uint k = 0; k < 5; ++k) {
+		ret = clSetKernelArg(kernels[k], 2, sizeof(cl_mem), &bitmap_a);
+		ret = clSetKernelArg(kernels[k], 3, sizeof(cl_mem), &bitmap_b);
+		ret = clSetKernelArg(kernels[k], 4, sizeof(cl_uint), &mask);
+		ret = clSetKernelArg(kernels[k], 5, sizeof(cl_mem), &table);
+		ret = clSetKernelArg(kernels[k], 6, sizeof(cl_uint), &count);
+		ret = clSetKernelArg(kernels[k], 7, sizeof(cl_uint), &capacity);
+	}
+	LOG_LINE("Set multi-target arguments. Return code = " << getErrorString(ret));
+
+	uploaded = &targets;
+}
+
+void smasher::release_targets() {
+	if (!uploaded)
+		return;
+
+	clReleaseMemObject(bitmap_a);
+	clReleaseMemObject(bitmap_b);
+	clReleaseMemObject(table);
+	uploaded = NULL;
+}
+
+void smasher::forget_targets(const target_set& targets) {
+	if (uploaded == &targets)
+		release_targets();
+}
+
+bool smasher::set_mask(const key_mask* mask, uint length) {
+	if (native)
+		return native->set_mask(mask, length);
+
+	release_mask();
+	if (!mask)
+		return true;
+
+	// its blocks would not fit the 64-bit block cursors
+	if (!mask->fits(length)) {
+		LOG_LINE("Mask keyspace too big. length = " << length);
+		return false;
+	}
+
+	select_variant(length);
+
+	// only the positions of this length go to the device
+	mask_chars = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		length * 256, (void*)mask->get_chars(), &ret);
+	LOG_LINE("Created mask charset memory. length = " << length << ". Return code = " << getErrorString(ret));
+
+	mask_radix = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		length * sizeof(cl_uint), (void*)mask->get_radix(), &ret);
+	LOG_LINE("Created mask radix memory. Return code = " << getErrorString(ret));
+
+	// the mask arguments follow the ones of the counter kernels, the space is 128-bit like the base
+	const uint128 wide = mask->wide_keyspace(length);
+	cl_ulong2 space;
+	space.s[0] = wide.lo;
+	space.s[1] = wide.hi;
+	const cl_kernel kernels[] = { kernel_mask, kernel_mask_multi };
+	const cl_uint first[] = { 3, 8 };
+	for (uint k = 0; k < 2; ++k) {
+		ret = clSetKernelArg(kernels[k], first[k], sizeof(cl_mem), &mask_chars);
+		ret = clSetKernelArg(kernels[k], first[k] + 1, sizeof(cl_mem), &mask_radix);
+		ret = clSetKernelArg(kernels[k], first[k] + 2, sizeof(cl_uint), &length);
+		ret = clSetKernelArg(kernels[k], first[k] + 3, sizeof(cl_ulong2), &space);
+	}
+	LOG_LINE("Set mask arguments. KEYSPACE = " << wide.hi << " * 2 ** 64 + " << wide.lo << ". Return code = " << getErrorString(ret));
+
+	this->mask = mask;
+	mask_length = length;
+	return true;
+}
+
+void smasher::select_variant(uint length) {
+	uint k = 0;
+	while (k < variants.size() && variants[k].length != length)
+		++k;
+
+	// first search of this length, build its program
+	if (k == variants.size()) {
+		mask_variant variant = { length, load_program(build_options(length)), NULL, NULL };
+		if (variant.program) {
+			cl_int created;
+			variant.kernel = clCreateKernel(variant.program, FUNC_MASK, &created);
+			if (created == CL_SUCCESS)
+				variant.kernel_multi = clCreateKernel(variant.program, FUNC_MASK_MULTI, &created);
+			if (created != CL_SUCCESS) {
+				if (variant.kernel)
+					clReleaseKernel(variant.kernel);
+				clReleaseProgram(variant.program);
+				variant.program = NULL;
+				variant.kernel = NULL;
+			}
+		}
+
+		LOG_LINE("Built mask variant. LENGTH = " << length << (variant.program ? "" : " (failed, using the generic kernels)"));
+
+		variants.push_back(variant);
+	}
+
+	const mask_variant& chosen = variants[k].program ? variants[k] : variants[0];
+	if (chosen.kernel == kernel_mask)
+		return;
+
+	// the other kernels have none of the target arguments yet, upload again on the next search
+	kernel_mask = chosen.kernel;
+	kernel_mask_multi = chosen.kernel_multi;
+	release_targets();
+}
+
+void smasher::release_mask() {
+	if (!mask)
+		return;
+
+	clReleaseMemObject(mask_chars);
+	clReleaseMemObject(mask_radix);
+	mask = NULL;
+}
+
+bool smasher::set_rules(const rule_set* rules) {
+	if (native) {
+		native->set_rules(rules);
+		return true;
+	}
+
+	release_rules();
+	if (!rules || !rules->size())
+		return true;
+
+	// a failed step leaves the device usable, only rule mode is off
+	cl_int failed = CL_SUCCESS;
+	rule_code = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		rules->get_code_size(), (void*)rules->get_code(), &ret);
+	LOG_LINE("Created rule code memory. RULES = " << rules->size() << ". Return code = " << getErrorString(ret));
+	failed = (ret != CL_SUCCESS) ? ret : failed;
+
+	rule_offsets = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		rules->size() * sizeof(cl_uint), (void*)rules->get_offsets(), &ret);
+	LOG_LINE("Created rule offset memory. Return code = " << getErrorString(ret));
+	failed = (ret != CL_SUCCESS) ? ret : failed;
+
+	// after the wordlist arguments
+	cl_uint count = rules->size();
+	const cl_kernel kernels[] = { kernel_rules, kernel_rules_multi };
+	const cl_uint first[] = { 6, 11 };
+	for (uint k = 0; k < 2 && failed == CL_SUCCESS; ++k) {
+		ret = clSetKernelArg(kernels[k], first[k], sizeof(cl_mem), &rule_code);
+		failed = (ret != CL_SUCCESS) ? ret : failed;
+		ret = clSetKernelArg(kernels[k], first[k] + 1, sizeof(cl_mem), &rule_offsets);
+		failed = (ret != CL_SUCCESS) ? ret : failed;
+		ret = clSetKernelArg(kernels[k], first[k] + 2, sizeof(cl_uint), &count);
+		failed = (ret != CL_SUCCESS) ? ret : failed;
+	}
+	LOG_LINE("Set rule arguments. Return code = " << getErrorString(failed));
+
+	this->rules = rules;
+	if (failed != CL_SUCCESS) {
+		release_rules();
+		return false;
+	}
+	return true;
+}
+
+void smasher::release_rules() {
+	if (!rules)
+		return;
+
+	clReleaseMemObject(rule_code);
+	clReleaseMemObject(rule_offsets);
+	rules = NULL;
+}
+
+bool smasher::set_hybrid(const key_mask* mask, uint length, bool prefix) {
+	if (native)
+		return native->set_hybrid(mask, length, prefix);
+
+	release_hybrid();
+	if (!mask)
+		return true;
+
+	// a word's keys must fit one launch, hits keep the mask index in 32 bits
+	cl_ulong space = mask->keyspace(length);
+	if (!space || space > HYBRID_MAX_SPACE) {
+		LOG_LINE("Hybrid mask too big. length = " << length << ". KEYSPACE = " << space);
+		return false;
+	}
+
+	// like set_rules(), a failed step only turns hybrid mode off
+	cl_int failed = CL_SUCCESS;
+	hybrid_chars = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		length * 256, (void*)mask->get_chars(), &ret);
+	LOG_LINE("Created hybrid charset memory. length = " << length << ". Return code = " << getErrorString(ret));
+	failed = (ret != CL_SUCCESS) ? ret : failed;
+
+	hybrid_radix = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+		length * sizeof(cl_uint), (void*)mask->get_radix(), &ret);
+	LOG_LINE("Created hybrid radix memory. Return code = " << getErrorString(ret));
+	failed = (ret != CL_SUCCESS) ? ret : failed;
+
+	// the mask arguments follow the ones of the wordlist kernels
+	cl_uint before = prefix;
+	const cl_kernel kernels[] = { kernel_hybrid, kernel_hybrid_multi };
+	const cl_uint first[] = { 6, 11 };
+	for (uint k = 0; k < 2 && failed == CL_SUCCESS; ++k) {
+		ret = clSetKernelArg(kernels[k], first[k], sizeof(cl_mem), &hybrid_chars);
+		failed = (ret != CL_SUCCESS) ? ret : failed;
+		ret = clSetKernelArg(kernels[k], first[k] + 1, sizeof(cl_mem), &hybrid_radix);
+		failed = (ret != CL_SUCCESS) ? ret : failed;
+		ret = clSetKernelArg(kernels[k], first[k] + 2, sizeof(cl_uint), &length);
+		failed = (ret != CL_SUCCESS) ? ret : failed;
+		ret = clSetKernelArg(kernels[k], first[k] + 3, sizeof(cl_ulong), &space);
+		failed = (ret != CL_SUCCESS) ? ret : failed;
+		ret = clSetKernelArg(kernels[k], first[k] + 4, sizeof(cl_uint), &before);
+		failed = (ret != CL_SUCCESS) ? ret : failed;
+	}
+	LOG_LINE("Set hybrid arguments. KEYSPACE = " << space << (prefix ? ", prefix" : ", suffix") << ". Return code = " << getErrorString(failed));
+
+	hybrid = mask;
+	hybrid_length = length;
+	hybrid_prefix = prefix;
+	hybrid_space = (uint)space;
+	if (failed != CL_SUCCESS) {
+		release_hybrid();
+		return false;
+	}
+	return true;
+}
+
+void smasher::release_hybrid() {
+	if (!hybrid)
+		return;
+
+	clReleaseMemObject(hybrid_chars);
+	clReleaseMemObject(hybrid_radix);
+	hybrid = NULL;
+}
+
+bool smasher::confirm(uint128 index, const char* digest) {
+	uchar key[MAX_KEY_LEN];
+
+	if (mask) {
+		mask->candidate(index, mask_length, key);
+		return confirm(key, mask_length, digest);
+	}
+
+	// big-endian counter, like counter_key() in the kernel
+	for (uint k = 0; k < KEY_SIZE; ++k) {
+		uint shift = (KEY_SIZE - k - 1) * 8;
+		key[k] = (uchar)((shift < 64) ? index.lo >> shift : index.hi >> (shift - 64));
+	}
+
+	return confirm(key, KEY_SIZE, digest);
+}
+
+bool smasher::confirm(const uchar* key, uint length, const char* digest) {
+	uchar out[MAX_DIGEST_SIZE];
+	return hash_digest(algo, key, length, out) && !memcmp(out, digest, algo.digest_size);
+}
+
+int smasher::collect(launch_slot& slot, const target_set& targets, vector<target_hit>& found) {
+	cl_uint count = slot.res[0];
+	if (!count)
+		return 0;
+
+	// more hits than fit, rerun the launch one block at a time
+	if (count > HIT_CAPACITY) {
+		// run() overwrites the slot's launch, keep the one to split
+		const cl_kernel k = slot.kernel;
+		const uint64 block = slot.block;
+		const uint blocks = slot.blocks;
+
+		int confirmed = 0;
+		for (uint b = 0; b < blocks; ++b) {
+			run(slot, k, block + b, 1);
+			get_results(slot);
+			confirmed += collect(slot, targets, found);
+		}
+		return confirmed;
+	}
+
+	// only the first HIT_PREFIX pairs came back with the counter
+	vector<cl_uint> pairs(slot.res + 1, slot.res + 1 + 2 * (count < HIT_PREFIX ? count : HIT_PREFIX));
+	if (count > HIT_PREFIX) {
+		pairs.resize(count * 2);
+		ret = clEnqueueReadBuffer(command_queue, slot.hits, CL_TRUE, sizeof(cl_uint), pairs.size() * sizeof(cl_uint), &pairs[0], 0, NULL, NULL);
+	}
+
+	// every device hit is recomputed before it is reported
+	int confirmed = 0;
+	for (uint k = 0; k < count; ++k) {
+		uint128 index = key_index(slot.block, pairs[k * 2]);
+		target_hit hit = { index.lo, pairs[k * 2 + 1], 0, index.hi };
+		if (hit.target >= targets.size())
+			continue;
+
+		bool valid;
+		if (slot.kernel == kernel_words_multi || slot.kernel == kernel_rules_multi || slot.kernel == kernel_hybrid_multi) {
+			// candidate number in the chunk, reported by file offset and rule
+			uchar key[MAX_KEY_LEN];
+			uint length = word_key(slot, hit.index, key, hit.rule);
+			hit.index = slot.batch.begin + (slot.batch.words[(size_t)(hit.index / word_candidates())] >> 8);
+			valid = length && confirm(key, length, targets.digest(hit.target));
+		}
+		else
+			valid = confirm(index, targets.digest(hit.target));
+
+		if (valid) {
+			found.push_back(hit);
+			++confirmed;
+		}
+	}
+
+	return confirmed;
+}
+
+int smasher::smash(const uint64 block, const target_set& targets, vector<target_hit>& found) {
+	return smash_range(block, 1, targets, found);
+}
+
+int smasher::smash_range(const uint64 first, const uint64 count, const target_set& targets, vector<target_hit>& found) {
+	// digests of another hash can never match
+	if (!targets.size() || targets.get_digest_size() != algo.digest_size)
+		return 0;
+
+	if (native) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		int confirmed = native->smash_range(first, count, targets, found);
+		add_native(start, count);
+		return confirmed;
+	}
+
+	// targets go to the device once, not per block
+	if (uploaded != &targets)
+		set_targets(targets);
+
+	cl_kernel k = get_kernel(true);
+	int confirmed = 0;
+	uint64 done = 0;
+	uint issued = 0, retired = 0;
+	while (done < count || retired < issued) {
+		while (done < count && issued - retired < PIPELINE_DEPTH) {
+			uint blocks = (count - done < get_blocks()) ? (uint)(count - done) : get_blocks();
+			run(slots[issued++ % PIPELINE_DEPTH], k, first + done, blocks);
+			done += blocks;
+		}
+
+		// confirm the oldest launch's hits while the others run
+		launch_slot& slot = slots[retired++ % PIPELINE_DEPTH];
+		get_results(slot);
+		chrono::steady_clock::time_point matching = chrono::steady_clock::now();
+		confirmed += collect(slot, targets, found);
+		add_match(matching);
+	}
+
+	return confirmed;
+}
+
+uint smasher::word_key(launch_slot& slot, uint64 candidate, uchar* key, uint& rule) {
+	uint per_word = word_candidates();
+	uint word = slot.batch.words[(size_t)(candidate / per_word)];
+	uint length = word & 0xff;
+
+	rule = (uint)(candidate % per_word);
+	if (hybrid)
+		return hybrid->combine((const uchar*)slot.batch.data + (word >> 8), length, rule, hybrid_length, hybrid_prefix, key);
+
+	memcpy(key, slot.batch.data + (word >> 8), length);
+	return rules ? rules->apply(rule, key, length) : length;
+}
+
+bool smasher::run_batch(launch_slot& slot, cl_kernel k, uint64 block) {
+	// words * rules outgrows a launch long before the batch memory fills
+	const uint64 total = (slot.batch.words.size() * (uint64)word_candidates() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if (block >= total)
+		return false;
+
+	run(slot, k, block, (total - block < MAX_LAUNCH_BLOCKS) ? (uint)(total - block) : MAX_LAUNCH_BLOCKS);
+	return true;
+}
+
+bool smasher::smash_words(word_feed& feed, char* cmpto, uint64& found, uint& rule) {
+	if (native)
+		return native->smash_words(feed, cmpto, found, rule);
+
+	cl_kernel k = hybrid ? kernel_hybrid : (rules ? kernel_rules : kernel_words);
+	const uint per_word = word_candidates();
+
+	create_word_memory();
+	memcpy(&target, cmpto, MATCH_SIZE);
+	ret = clSetKernelArg(k, 2, sizeof(cl_uint4), &target);
+
+	// pack, upload and hash overlap: the feed packs ahead, uploads do not block
+	bool match = false, more = true;
+	uint issued = 0, retired = 0;
+	for (;;) {
+		while (more && !match && issued - retired < PIPELINE_DEPTH) {
+			launch_slot& slot = slots[issued % PIPELINE_DEPTH];
+			if (!(more = feed.next(slot.batch)))
+				break;
+
+			upload(slot);
+			if (run_batch(slot, k, 0))
+				++issued;
+		}
+
+		if (retired == issued)
+			break;
+
+		launch_slot& slot = slots[retired % PIPELINE_DEPTH];
+		get_results(slot);
+
+		if (!match && slot.res[0] != NO_MATCH) {
+			// the result is an offset in the launch, not in the batch
+			const uint64 candidate = key_index(slot.block, slot.res[0]).lo;
+			match = true;
+			found = slot.batch.begin + (slot.batch.words[(size_t)(candidate / per_word)] >> 8);
+			rule = (uint)(candidate % per_word);
+		}
+
+		// the rest of a batch bigger than one launch reuses its slot
+		if (match || !run_batch(slot, k, slot.block + slot.blocks))
+			++retired;
+	}
+
+	return match;
+}
+
+int smasher::smash_words(word_feed& feed, const target_set& targets, vector<target_hit>& found) {
+	if (!targets.size() || targets.get_digest_size() != algo.digest_size)
+		return 0;
+
+	if (native)
+		return native->smash_words(feed, targets, found);
+
+	cl_kernel k = hybrid ? kernel_hybrid_multi : (rules ? kernel_rules_multi : kernel_words_multi);
+
+	create_word_memory();
+	if (uploaded != &targets)
+		set_targets(targets);
+
+	int confirmed = 0;
+	bool more = true;
+	uint issued = 0, retired = 0;
+	for (;;) {
+		while (more && issued - retired < PIPELINE_DEPTH) {
+			launch_slot& slot = slots[issued % PIPELINE_DEPTH];
+			if (!(more = feed.next(slot.batch)))
+				break;
+
+			upload(slot);
+			if (run_batch(slot, k, 0))
+				++issued;
+		}
+
+		if (retired == issued)
+			break;
+
+		launch_slot& slot = slots[retired % PIPELINE_DEPTH];
+		get_results(slot);
+		// collect() may rerun the launch block by block
+		const uint64 next = slot.block + slot.blocks;
+		chrono::steady_clock::time_point matching = chrono::steady_clock::now();
+		confirmed += collect(slot, targets, found);
+		add_match(matching);
+
+		if (!run_batch(slot, k, next))
+			++retired;
+	}
+
+	return confirmed;
+}
+
+int smasher::collect_crypt(launch_slot& slot, const crypt_group& group, vector<target_hit>& found) {
+	cl_uint count = slot.res[0];
+	if (!count)
+		return 0;
+
+	vector<cl_uint> pairs(slot.res + 1, slot.res + 1 + 2 * (count < HIT_PREFIX ? count : HIT_PREFIX));
+	if (count > HIT_PREFIX) {
+		pairs.resize((count < HIT_CAPACITY ? count : HIT_CAPACITY) * 2);
+		ret = clEnqueueReadBuffer(command_queue, slot.hits, CL_TRUE, sizeof(cl_uint), pairs.size() * sizeof(cl_uint), &pairs[0], 0, NULL, NULL);
+	}
+
+	// only duplicated words overflow, hash the whole chunk on the host then
+	if (count > HIT_CAPACITY) {
+		int confirmed = 0;
+		uchar digest[CRYPT_MAX_DIGEST];
+		for (uint k = 0; k < slot.batch.words.size(); ++k) {
+			uint word = slot.batch.words[k];
+			crypt_digest(group, (const uchar*)slot.batch.data + (word >> 8), word & 0xff, digest);
+			uint first, count = group.find(digest, first);
+			for (uint e = first; e < first + count; ++e) {
+				target_hit hit = { slot.batch.begin + (word >> 8), group.entries[e], 0, 0 };
+				found.push_back(hit);
+				++confirmed;
+			}
+		}
+		return confirmed;
+	}
+
+	int confirmed = 0;
+	for (uint k = 0; k < pairs.size() / 2; ++k) {
+		if (pairs[k * 2] >= slot.batch.words.size() || pairs[k * 2 + 1] >= group.entries.size())
+			continue;
+
+		uint word = slot.batch.words[pairs[k * 2]];
+		uchar digest[CRYPT_MAX_DIGEST];
+		crypt_digest(group, (const uchar*)slot.batch.data + (word >> 8), word & 0xff, digest);
+		if (memcmp(digest, &group.digests[pairs[k * 2 + 1] * group.digest_size], group.digest_size))
+			continue;
+
+		target_hit hit = { slot.batch.begin + (word >> 8), group.entries[pairs[k * 2 + 1]], 0, 0 };
+		found.push_back(hit);
+		++confirmed;
+	}
+
+	return confirmed;
+}
+
+int smasher::smash_crypt(word_feed& feed, const crypt_set& targets, vector<target_hit>& found) {
+	if (!targets.size())
+		return 0;
+
+	if (native)
+		return native->smash_crypt(feed, targets, found);
+
+	create_word_memory();
+
+	// salts and digests of every group stay on the device for the whole run
+	vector<cl_mem> salts(targets.size()), digests(targets.size());
+	for (uint g = 0; g < targets.size(); ++g) {
+		const crypt_group& group = targets.group(g);
+		char salt[CRYPT_MAX_SALT] = {};
+		memcpy(salt, group.salt.data(), group.salt.size());
+		salts[g] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, CRYPT_MAX_SALT, salt, &ret);
+		set_ready();
+		digests[g] = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			group.digests.size(), (void*)&group.digests[0], &ret);
+		set_ready();
+	}
+
+	// the round loops dwarf launch overhead, so each chunk runs group after group
+	static const cl_uint no_hits = 0;
+	const cl_uint capacity = HIT_CAPACITY;
+	int confirmed = 0;
+	launch_slot& slot = slots[0];
+	while (feed.next(slot.batch)) {
+		upload(slot);
+
+		const cl_uint count = (cl_uint)slot.batch.words.size();
+		for (uint g = 0; g < targets.size() && count; ++g) {
+			const crypt_group& group = targets.group(g);
+			cl_kernel k = (group.type == CRYPT_MD5) ? kernel_md5crypt : kernel_sha512crypt;
+			const cl_uint salt_length = (cl_uint)group.salt.size(), rounds = group.rounds, entries = (cl_uint)group.entries.size();
+
+			ret = clSetKernelArg(k, 0, sizeof(cl_mem), &slot.hits);
+			ret = clSetKernelArg(k, 1, sizeof(cl_mem), &slot.data);
+			ret = clSetKernelArg(k, 2, sizeof(cl_mem), &slot.words);
+			ret = clSetKernelArg(k, 3, sizeof(cl_uint), &count);
+			ret = clSetKernelArg(k, 4, sizeof(cl_mem), &salts[g]);
+			ret = clSetKernelArg(k, 5, sizeof(cl_uint), &salt_length);
+			ret = clSetKernelArg(k, 6, sizeof(cl_uint), &rounds);
+			ret = clSetKernelArg(k, 7, sizeof(cl_mem), &digests[g]);
+			ret = clSetKernelArg(k, 8, sizeof(cl_uint), &entries);
+			ret = clSetKernelArg(k, 9, sizeof(cl_uint), &capacity);
+
+			// one word per work-item, the kernel drops the ones past 'count'
+			size_t local = 0;
+			clGetKernelWorkGroupInfo(k, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &local, NULL);
+			if (tuner.get_local() && tuner.get_local() < local)
+				local = tuner.get_local();
+			size_t global = local ? (count + local - 1) / local * local : count;
+
+			ret = clEnqueueWriteBuffer(command_queue, slot.hits, CL_FALSE, 0, sizeof(cl_uint), &no_hits, 0, NULL, &slot.written);
+			ret = clEnqueueNDRangeKernel(command_queue, k, 1, NULL, &global, local ? &local : NULL, 0, NULL, &slot.ran);
+			ret = clEnqueueReadBuffer(command_queue, slot.hits, CL_TRUE, 0, (1 + HIT_PREFIX * 2) * sizeof(cl_uint), slot.res, 0, NULL, &slot.done);
+
+			// the chunk's upload is counted with the first group
+			profile(slot);
+			if (stats)
+				stats->add_launch(count);
+
+			chrono::steady_clock::time_point matching = chrono::steady_clock::now();
+			confirmed += collect_crypt(slot, group, found);
+			add_match(matching);
+		}
+	}
+
+	for (uint g = 0; g < targets.size(); ++g) {
+		ret = clReleaseMemObject(salts[g]);
+		ret = clReleaseMemObject(digests[g]);
+	}
+
+	return confirmed;
+}
+
+bool smasher::walk_chains(uint64* chains, uint count, uint64 first, uint columns, uint64 space, bool lookup) {
+	if (native)
+		return native->walk_chains(chains, count, first, columns, space, lookup);
+
+	if (!count)
+		return true;
+
+	cl_mem buffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, count * sizeof(cl_ulong), chains, &ret);
+	LOG_LINE("Created chain memory. CHAINS = " << count << ". Return code = " << getErrorString(ret));
+	if (ret != CL_SUCCESS)
+		return false;
+
+	const cl_uint length = mask ? mask_length : 0, flag = lookup;
+	const cl_mem chars = mask ? mask_chars : NULL, radix = mask ? mask_radix : NULL;
+	ret = clSetKernelArg(kernel_chains, 0, sizeof(cl_mem), &buffer);
+	ret = clSetKernelArg(kernel_chains, 1, sizeof(cl_uint), &count);
+	ret = clSetKernelArg(kernel_chains, 2, sizeof(cl_ulong), &first);
+	ret = clSetKernelArg(kernel_chains, 3, sizeof(cl_uint), &columns);
+	ret = clSetKernelArg(kernel_chains, 6, sizeof(cl_uint), &flag);
+	ret = clSetKernelArg(kernel_chains, 7, sizeof(cl_ulong), &space);
+	ret = clSetKernelArg(kernel_chains, 8, sizeof(cl_mem), &chars);
+	ret = clSetKernelArg(kernel_chains, 9, sizeof(cl_mem), &radix);
+	ret = clSetKernelArg(kernel_chains, 10, sizeof(cl_uint), &length);
+
+	// one chain per work-item, the kernel drops the ones past 'count'
+	size_t local = 0;
+	clGetKernelWorkGroupInfo(kernel_chains, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &local, NULL);
+	if (tuner.get_local() && tuner.get_local() < local)
+		local = tuner.get_local();
+	size_t global = local ? (count + local - 1) / local * local : count;
+
+	// a lookup has nothing to hash in column 0, the queue keeps the slices in order
+	for (cl_uint from = lookup ? 1 : 0; from < columns && ret == CL_SUCCESS; from += CHAIN_SLICE) {
+		const cl_uint to = (columns - from > CHAIN_SLICE) ? from + CHAIN_SLICE : columns;
+		ret = clSetKernelArg(kernel_chains, 4, sizeof(cl_uint), &from);
+		ret = clSetKernelArg(kernel_chains, 5, sizeof(cl_uint), &to);
+		ret = clEnqueueNDRangeKernel(command_queue, kernel_chains, 1, NULL, &global, local ? &local : NULL, 0, NULL, NULL);
+		if (stats)
+			stats->add_launch((uint64)count * (to - from));
+	}
+
+	if (ret == CL_SUCCESS)
+		ret = clEnqueueReadBuffer(command_queue, buffer, CL_TRUE, 0, count * sizeof(cl_ulong), chains, 0, NULL, NULL);
+	LOG_LINE("Walked chains. COLUMNS = " << columns << ". Return code = " << getErrorString(ret));
+
+	const bool walked = (ret == CL_SUCCESS);
+	ret = clReleaseMemObject(buffer);
+	return walked;
+}
+
+smasher::smasher(const hash_algo& algo) : algo(algo) {
 	is_ready = true;
+	native = NULL;
+	uploaded = NULL;
+	mask = NULL;
+	rules = NULL;
+	hybrid = NULL;
+	stats = NULL;
+	pinned = 0;
+	vector_program = NULL;
+	vector_width = 1;
 	init();
 }
+smasher::smasher(cl_platform_id platform, cl_device_id device, const hash_algo& algo) : algo(algo) {
+	is_ready = true;
+	native = NULL;
+	uploaded = NULL;
+	mask = NULL;
+	rules = NULL;
+	hybrid = NULL;
+	stats = NULL;
+	pinned = 0;
+	vector_program = NULL;
+	vector_width = 1;
+	this->platform = platform;
+	this->device = device;
+	init_device();
+}
 smasher::~smasher() {
-	_log("Releasing OpenCL objects...");
+	if (native) {
+		delete native;
+		return;
+	}
+
+	tuner.save();
+
+	LOG_LINE("Releasing OpenCL objects...");
 
 	ret = clFlush(command_queue);
 	ret = clFinish(command_queue);
+	release_targets();
+	release_mask();
+	release_rules();
+	release_hybrid();
+	for (uint k = 0; k < PIPELINE_DEPTH; ++k) {
+		ret = clReleaseMemObject(slots[k].result);
+		ret = clReleaseMemObject(slots[k].hits);
+		if (slots[k].data) {
+			ret = clReleaseMemObject(slots[k].data);
+			ret = clReleaseMemObject(slots[k].words);
+		}
+	}
 	ret = clReleaseKernel(kernel);
+	ret = clReleaseKernel(kernel_multi);
+	for (uint k = 0; k < variants.size(); ++k)
+		if (!k || variants[k].program) {
+			ret = clReleaseKernel(variants[k].kernel);
+			ret = clReleaseKernel(variants[k].kernel_multi);
+			if (k)
+				ret = clReleaseProgram(variants[k].program);
+		}
+	ret = clReleaseKernel(kernel_words);
+	ret = clReleaseKernel(kernel_words_multi);
+	ret = clReleaseKernel(kernel_rules);
+	ret = clReleaseKernel(kernel_rules_multi);
+	ret = clReleaseKernel(kernel_hybrid);
+	ret = clReleaseKernel(kernel_hybrid_multi);
+	ret = clReleaseKernel(kernel_md5crypt);
+	ret = clReleaseKernel(kernel_sha512crypt);
+	ret = clReleaseKernel(kernel_chains);
 	ret = clReleaseProgram(program);
-	ret = clReleaseMemObject(output);
+	if (vector_program)
+		ret = clReleaseProgram(vector_program);
 	ret = clReleaseCommandQueue(command_queue);
 	ret = clReleaseContext(context);
 
-	_log("Release complete");
+	LOG_LINE("Release complete");
 }
\ No newline at end of file
@@ -1,37 +1,225 @@
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <vector>
 #include "CL.h"
+#include "crypt.h"
+#include "cpu_smasher.h"
+#include "mask.h"
+#include "rules.h"
+#include "stats.h"
+#include "targets.h"
+#include "tuner.h"
+#include "wordlist.h"
 #include "types.h"
 
 using namespace std;
 
 #define FUNC_NAME "smash"
+#define FUNC_MULTI "smash_multi"
+#define FUNC_MASK "smash_mask"
+#define FUNC_MASK_MULTI "smash_mask_multi"
+#define FUNC_WORDS "smash_words"
+#define FUNC_WORDS_MULTI "smash_words_multi"
+#define FUNC_RULES "smash_rules"
+#define FUNC_RULES_MULTI "smash_rules_multi"
+#define FUNC_HYBRID "smash_hybrid"
+#define FUNC_HYBRID_MULTI "smash_hybrid_multi"
+#define FUNC_MD5CRYPT "smash_md5crypt"
+#define FUNC_SHA512CRYPT "smash_sha512crypt"
+#define FUNC_CHAINS "smash_chains"
 
+#define PIPELINE_DEPTH 3 // blocks in flight at once
+#define HIT_PREFIX 8 // hit pairs read back together with the counter
+#define HIT_CAPACITY 65536 // hit pairs stored per launch
+#define MAX_LAUNCH_BLOCKS (1 << 20) // keeps key offsets in a launch below 2 ** 32
+#define MAX_VECTOR_WIDTH 16 // widest uintn the counter kernels are built for
+#define CHAIN_SLICE 256 // rainbow columns walked per launch, keeps launches short
 
-/*A class to run MD5 in parallel, while
-comparing to a certain value.*/
+// buffers and readback of one in-flight launch
+struct launch_slot {
+	cl_mem result; // hit slot of a single target launch
+	cl_mem hits; // hit counter and pairs of a multi-target launch
+	cl_mem data; // wordlist chunk and packed words, allocated on first use
+	cl_mem words;
+	cl_event done; // completes when 'res' holds the results
+	cl_event written; // the launch's other commands, kept for their profiling times
+	cl_event ran;
+	cl_event uploads[2]; // wordlist chunk and words, NULL for block launches
+	cl_uint res[1 + HIT_PREFIX * 2];
+	cl_kernel kernel;
+	uint64 block; // first block of the launch
+	uint blocks;
+	word_batch batch; // kept until the launch retires, its upload reads from it
+	size_t local;
+	chrono::steady_clock::time_point issued;
+};
+
+// mask kernels of a program built for one key length
+struct mask_variant {
+	uint length; // 0 for the generic kernels of the main program
+	cl_program program; // NULL if it failed to build, the generic kernels run instead
+	cl_kernel kernel;
+	cl_kernel kernel_multi;
+};
+
+
+/*A class to run a hash in parallel, while
+comparing to a certain value. Runs on the
+native CPU engine if there is no OpenCL device.
+Searches compare the first MATCH_SIZE digest
+bytes; multi-target hits are confirmed against
+the full digest on the host.*/
 class smasher {
 public:
-	int smash(const uint block, char* cmpto);
+	int smash(const uint64 block, char* cmpto);
+
+	/*Searches blocks [first, first + count) with several launches
+	in flight. On a hit the block is stored in 'found' and the key's
+	index in it is returned.*/
+	int smash_range(const uint64 first, const uint64 count, char* cmpto, uint64& found);
+
+	/*Checks a block against every target at once. Hits are
+	confirmed on the host, appended to 'hits' and counted.*/
+	int smash(const uint64 block, const target_set& targets, vector<target_hit>& hits);
+
+	int smash_range(const uint64 first, const uint64 count, const target_set& targets, vector<target_hit>& hits);
+
+	/*Searches the 'length' keys of a mask instead of the counter
+	keyspace, until cleared with NULL. Blocks past the end of the
+	mask's keyspace find nothing. False, and back on the counter
+	keyspace, if the mask does not fit(length).*/
+	bool set_mask(const key_mask* mask, uint length);
+
+	/*Hashes every word of the feed. Chunks are uploaded and hashed
+	PIPELINE_DEPTH at a time while the feed packs the next ones. On a
+	hit the word's file offset is stored in 'found' and the rule that
+	made the key in 'rule'.*/
+	bool smash_words(word_feed& feed, char* cmpto, uint64& found, uint& rule);
+
+	// hits hold the words' file offsets
+	int smash_words(word_feed& feed, const target_set& targets, vector<target_hit>& hits);
+
+	/*Runs every word of the feed through each salt group of
+	'targets', one launch per group and chunk. Hits hold the words'
+	file offsets and the crypt_set entry; rules are not applied.*/
+	int smash_crypt(word_feed& feed, const crypt_set& targets, vector<target_hit>& hits);
+
+	/*Runs every word through every rule on the device, until
+	cleared with NULL. Feeds should be limited to
+	rules->get_batch_words() words per batch, bigger batches take
+	several launches. False if the rules could not be uploaded.*/
+	bool set_rules(const rule_set* rules);
+
+	/*Appends (prepends with 'prefix') the 'length' keys of a mask to
+	every word on the device, until cleared with NULL; words are
+	uploaded once per batch and rules are not applied. Hits hold the
+	mask key index as their rule. Feeds should be limited to
+	mask->get_batch_words(length) words per batch. False if a word has
+	more than HYBRID_MAX_SPACE such keys or the mask could not be
+	uploaded.*/
+	bool set_hybrid(const key_mask* mask, uint length, bool prefix);
 
-	smasher();
+	/*Walks 'count' rainbow chains in place through 'columns' columns
+	of the current mask's first 'space' keys, or of the counter keys
+	without a mask; see smash_chains in smash.cl. With 'lookup', chain
+	k holds a digest reduced in column (first + k) % columns.*/
+	bool walk_chains(uint64* chains, uint count, uint64 first, uint columns, uint64 space, bool lookup);
+
+	/*Frees the device table of 'targets' if it is the uploaded one.
+	Call it before the set goes away, a new set at the same address
+	would find the old table.*/
+	void forget_targets(const target_set& targets);
+
+	smasher(const hash_algo& algo = hash_get(HASH_MD5));
+	smasher(cl_platform_id platform, cl_device_id device, const hash_algo& algo = hash_get(HASH_MD5)); // a specific device, no fallback
 	~smasher();
 
 	bool get_ready() { return is_ready; }
+	bool is_native() { return native != NULL; }
+	const string& get_name() { return name; }
+	const hash_algo& get_algo() { return algo; }
+
+	// compiler output of the last failed program build
+	const string& get_build_log() { return build_log; }
+
+	// blocks to hand out at once, enough to keep the pipeline full
+	uint get_chunk() { return native ? CPU_CHUNK : get_blocks() * PIPELINE_DEPTH; }
+
+	// launches, keys and stage times are added to 'stats', NULL to stop
+	void set_stats(smash_stats* stats) { this->stats = stats; }
+
+	// fixes the blocks per launch, as benchmarks need; 0 leaves it to the tuner
+	void set_launch_blocks(uint blocks) { pinned = (blocks < MAX_LAUNCH_BLOCKS) ? blocks : MAX_LAUNCH_BLOCKS; }
 private:
+	const hash_algo& algo;
+
 	// OpenCL data
 	cl_platform_id platform;
 	cl_device_id device;
 	cl_context context;
 	cl_command_queue command_queue;
-	cl_int block_number;
-	cl_mem output;
+	cl_uint4 target;
+	launch_slot slots[PIPELINE_DEPTH];
+
+	// launch geometry, adapted as launches retire
+	launch_tuner tuner;
+	uint pinned; // blocks per launch set from outside, 0 if tuned
+	chrono::steady_clock::time_point last_retired;
 	cl_program program;
+	cl_program vector_program; // counter kernels in uintn, NULL if the device prefers scalars
+	uint vector_width; // keys hashed at once by a counter work-item, 1 without vector_program
 	cl_kernel kernel;
+	cl_kernel kernel_multi;
+	cl_kernel kernel_mask;
+	cl_kernel kernel_mask_multi;
+	cl_kernel kernel_words;
+	cl_kernel kernel_words_multi;
+	cl_kernel kernel_rules;
+	cl_kernel kernel_rules_multi;
+	cl_kernel kernel_hybrid;
+	cl_kernel kernel_hybrid_multi;
+	cl_kernel kernel_md5crypt;
+	cl_kernel kernel_sha512crypt;
+	cl_kernel kernel_chains;
+
+	// target set currently on the device
+	const target_set* uploaded;
+	cl_mem bitmap_a;
+	cl_mem bitmap_b;
+	cl_mem table;
+
+	// mask kernels per key length, built on first use
+	vector<mask_variant> variants;
+
+	// mask currently searched, NULL for the counter keyspace
+	const key_mask* mask;
+	uint mask_length;
+	cl_mem mask_chars;
+	cl_mem mask_radix;
+
+	// compiled rules on the device, NULL for plain words
+	const rule_set* rules;
+	cl_mem rule_code;
+	cl_mem rule_offsets;
+
+	// hybrid mask on the device, NULL for plain or rule words
+	const key_mask* hybrid;
+	uint hybrid_length;
+	bool hybrid_prefix;
+	uint hybrid_space;
+	cl_mem hybrid_chars;
+	cl_mem hybrid_radix;
 
 	string code;
+	string name;
+	string build_log;
+
+	// set when no OpenCL device was found
+	cpu_smasher* native;
+
+	smash_stats* stats;
 
 	cl_int ret;
 	
@@ -52,19 +240,87 @@ private:
 
 	void create_program();
 
+	// builds vector_program at the device's preferred int width, if it has one
+	void create_vector_program();
+
+	/*-D options of the build, 'length' > 0 for a mask variant of that
+	key length, 'width' > 1 for the vector counter kernels.*/
+	string build_options(uint length, uint width = 1);
+
+	// a program built with 'options', from the binary cache if possible; NULL if it fails
+	cl_program load_program(const string& options);
+
+	void build_program(cl_program program, const string& options);
+
 	void create_kernel();
 
+	void tune_device();
+
+	uint get_blocks() { return pinned ? pinned : tuner.get_blocks(); }
+
 	void init();
 
+	void init_device();
+
 	/*Operation specific functions*/
 
-	void create_block_memory(char* out);
+	void create_block_memory();
+
+	void create_word_memory();
+
+	// 'base' is the key index of the launch's first key, or its first wordlist candidate
+	void set_args(launch_slot& slot, cl_mem out, uint128 base);
+
+	void upload(launch_slot& slot);
+
+	cl_kernel get_kernel(bool multi) { return mask ? (multi ? kernel_mask_multi : kernel_mask) : (multi ? kernel_multi : kernel); }
+
+	// keys per work-item of kernel 'k'
+	uint item_keys(cl_kernel k) { return (k == kernel || k == kernel_multi) ? KEYS_PER_ITEM * vector_width : KEYS_PER_ITEM; }
+
+	void run(launch_slot& slot, cl_kernel k, uint64 block, uint blocks);
+
+	void get_results(launch_slot& slot);
+
+	// adds the stage times of the slot's finished commands to 'stats' and releases them
+	void profile(launch_slot& slot);
+
+	// host time since 'start' spent matching hits
+	void add_match(chrono::steady_clock::time_point start);
+
+	// a block search of the native engine that began at 'start'
+	void add_native(chrono::steady_clock::time_point start, uint64 blocks);
+
+	int collect(launch_slot& slot, const target_set& targets, vector<target_hit>& found);
+
+	void set_targets(const target_set& targets);
+
+	void release_targets();
+
+	void release_mask();
+
+	// points kernel_mask and kernel_mask_multi at the variant for 'length'
+	void select_variant(uint length);
+
+	void release_rules();
+
+	void release_hybrid();
+
+	// candidates of every word of a wordlist launch
+	uint word_candidates() { return hybrid ? hybrid_space : (rules ? rules->size() : 1); }
+
+	/*Launches the batch in 'slot' from 'block' on, at most
+	MAX_LAUNCH_BLOCKS of it so candidate offsets stay 32-bit. False
+	once the batch is done.*/
+	bool run_batch(launch_slot& slot, cl_kernel k, uint64 block);
 
-	void get_results(char* res);
+	// key of word 'candidate' of a wordlist launch, its length and rule or mask index
+	uint word_key(launch_slot& slot, uint64 candidate, uchar* key, uint& rule);
 
-	void set_args();
+	bool confirm(uint128 index, const char* digest);
 
-	void run();
+	bool confirm(const uchar* key, uint length, const char* digest);
 
-	int find_match(const char* out, const char* cmpto);
+	// hits of one salt group on the chunk in 'slot', confirmed on the host
+	int collect_crypt(launch_slot& slot, const crypt_group& group, vector<target_hit>& found);
 };
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include "scheduler.h"
+#include "smasher.h"
+
+/*Runs fixed synthetic searches on every backend (each OpenCL device
+and the native CPU engine), for every hash and launch size asked for,
+and prints the results as JSON:
+
+	smasher_bench [--ms N] [--hashes md5,sha1] [--blocks 1,64,1024]
+	              [--out FILE] [--baseline FILE] [--tolerance PERCENT]
+
+Each result holds the hash rate of a pipelined counter search, the
+latency percentiles of single launches, the time to upload a large
+target set and the host overhead per launch (single launch latency
+not spent hashing). With a baseline (an earlier output), every rate
+is compared to the matching one there and the exit code is 2 if any
+dropped by more than the tolerance.*/
+
+#define BENCH_MS 1000 // each measurement runs about this long
+#define BENCH_LAUNCHES 64 // most single launches timed for the percentiles
+#define BENCH_TARGETS 65536 // digests uploaded for the transfer time
+#define BENCH_TOLERANCE 5.0 // percent a rate may drop before it is a regression
+
+struct bench_result {
+	string backend;
+	string hash;
+	uint blocks;
+	double rate; // keys per second
+	double p50, p90, p99, max; // single launch latency, ms
+	double transfer; // target upload, ms
+	double overhead; // per launch, ms
+};
+
+static double elapsed_ms(chrono::steady_clock::time_point start) {
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static double percentile(const vector<double>& sorted, double p) {
+	size_t k = (size_t)(p * (sorted.size() - 1) + 0.5);
+	return sorted[k];
+}
+
+// the native engine has no launches to pin and nothing to upload
+static void pin(smasher& s, uint blocks) { s.set_launch_blocks(blocks); }
+static void pin(cpu_smasher&, uint) {}
+
+static double transfer(smasher& s, const hash_algo& algo) {
+	// arbitrary but fixed digests, none of them is ever hit
+	target_set targets(algo.digest_size);
+	vector<char> digest(algo.digest_size);
+	uint x = 0x9e3779b9;
+	for (uint k = 0; k < BENCH_TARGETS; ++k) {
+		for (uint b = 0; b < algo.digest_size; ++b) {
+			x = x * 1664525 + 1013904223;
+			digest[b] = (char)(x >> 24);
+		}
+		targets.add(&digest[0]);
+	}
+	targets.build();
+
+	// a search of no blocks only uploads the targets
+	vector<target_hit> hits;
+	auto start = chrono::steady_clock::now();
+	s.smash_range(0, 0, targets, hits);
+	return elapsed_ms(start);
+}
+static double transfer(cpu_smasher&, const hash_algo&) { return 0; }
+
+template<class E>
+static bench_result measure(E& engine, uint blocks, uint ms) {
+	char target[MATCH_SIZE];
+	memset(target, 0xff, MATCH_SIZE); // never matches, every launch runs fully
+	uint64 found, cursor = 0;
+
+	bench_result r;
+	r.blocks = blocks;
+	pin(engine, blocks);
+
+	// one launch per search, waited for before the next
+	vector<double> latency;
+	auto start = chrono::steady_clock::now();
+	while (latency.size() < BENCH_LAUNCHES && (latency.empty() || elapsed_ms(start) < ms)) {
+		auto issued = chrono::steady_clock::now();
+		engine.smash_range(cursor, blocks, target, found);
+		latency.push_back(elapsed_ms(issued));
+		cursor += blocks;
+	}
+	sort(latency.begin(), latency.end());
+	r.p50 = percentile(latency, 0.5);
+	r.p90 = percentile(latency, 0.9);
+	r.p99 = percentile(latency, 0.99);
+	r.max = latency.back();
+
+	// long searches keep PIPELINE_DEPTH launches in flight
+	uint64 searched = 0;
+	start = chrono::steady_clock::now();
+	double took;
+	do {
+		const uint64 count = (uint64)blocks * PIPELINE_DEPTH * 8;
+		engine.smash_range(cursor, count, target, found);
+		cursor += count;
+		searched += count;
+	} while ((took = elapsed_ms(start)) < ms);
+	r.rate = searched * BLOCK_SIZE / (took / 1000);
+
+	double hashing = blocks * BLOCK_SIZE / r.rate * 1000;
+	r.overhead = (r.p50 > hashing) ? r.p50 - hashing : 0;
+
+	pin(engine, 0);
+	return r;
+}
+
+template<class E>
+static void run_backend(E& engine, const string& backend, const hash_algo& algo, const vector<uint>& blocks, uint ms, vector<bench_result>& results) {
+	double upload = transfer(engine, algo);
+
+	for (uint k = 0; k < blocks.size(); ++k) {
+		bench_result r = measure(engine, blocks[k], ms);
+		r.backend = backend;
+		r.hash = algo.name;
+		r.transfer = upload;
+		results.push_back(r);
+
+		cerr << backend << " " << algo.name << " x" << blocks[k] << ": " << r.rate / 1e6 << " MH/s, p50 " << r.p50 << " ms" << endl;
+	}
+}
+
+static string quote(const string& text) {
+	string q = "\"";
+	for (size_t k = 0; k < text.size(); ++k) {
+		if (text[k] == '"' || text[k] == '\\')
+			q += '\\';
+		q += text[k];
+	}
+	return q + "\"";
+}
+
+// one result per line, so a baseline can be read back line by line
+static void write_json(ostream& out, const vector<bench_result>& results, uint ms) {
+	out << "{" << endl;
+	out << "\t\"ms\": " << ms << "," << endl;
+	out << "\t\"results\": [" << endl;
+	for (size_t k = 0; k < results.size(); ++k) {
+		const bench_result& r = results[k];
+		out << "\t\t{\"backend\": " << quote(r.backend) << ", \"hash\": " << quote(r.hash) << ", \"blocks\": " << r.blocks
+			<< ", \"hashes_per_s\": " << r.rate
+			<< ", \"latency_ms\": {\"p50\": " << r.p50 << ", \"p90\": " << r.p90 << ", \"p99\": " << r.p99 << ", \"max\": " << r.max << "}"
+			<< ", \"transfer_ms\": " << r.transfer << ", \"overhead_ms\": " << r.overhead << "}"
+			<< (k + 1 < results.size() ? "," : "") << endl;
+	}
+	out << "\t]" << endl;
+	out << "}" << endl;
+}
+
+// value of "name": in a result line, as written by write_json
+static string field(const string& line, const string& name) {
+	size_t at = line.find("\"" + name + "\": ");
+	if (at == string::npos)
+		return "";
+	at += name.size() + 4;
+
+	if (line[at] != '"')
+		return line.substr(at, line.find_first_of(",}", at) - at);
+
+	string value;
+	for (++at; at < line.size() && line[at] != '"'; ++at) {
+		if (line[at] == '\\')
+			++at;
+		value += line[at];
+	}
+	return value;
+}
+
+static string key_of(const string& backend, const string& hash, uint blocks) {
+	stringstream s;
+	s << backend << "|" << hash << "|" << blocks;
+	return s.str();
+}
+
+// rates of an earlier run by backend, hash and blocks; false if unreadable
+static bool read_baseline(const string& path, map<string, double>& rates) {
+	ifstream in(path.c_str());
+	if (!in)
+		return false;
+
+	string line;
+	while (getline(in, line)) {
+		string rate = field(line, "hashes_per_s");
+		if (!rate.empty())
+			rates[key_of(field(line, "backend"), field(line, "hash"), atoi(field(line, "blocks").c_str()))] = atof(rate.c_str());
+	}
+	return true;
+}
+
+static vector<string> split(const string& list) {
+	vector<string> items;
+	stringstream s(list);
+	string item;
+	while (getline(s, item, ','))
+		if (!item.empty())
+			items.push_back(item);
+	return items;
+}
+
+int main(int argc, char** argv) {
+	uint ms = BENCH_MS;
+	string hashes = "md5,md4,ntlm,sha1,sha256";
+	string sizes = "1,64,1024";
+	string out_path, baseline;
+	double tolerance = BENCH_TOLERANCE;
+
+	for (int a = 1; a < argc; a += 2) {
+		string arg = argv[a];
+		if (a + 1 >= argc) {
+			cerr << "missing value for " << arg << endl;
+			return 1;
+		}
+		if (arg == "--ms")
+			ms = atoi(argv[a + 1]);
+		else if (arg == "--hashes")
+			hashes = argv[a + 1];
+		else if (arg == "--blocks")
+			sizes = argv[a + 1];
+		else if (arg == "--out")
+			out_path = argv[a + 1];
+		else if (arg == "--baseline")
+			baseline = argv[a + 1];
+		else if (arg == "--tolerance")
+			tolerance = atof(argv[a + 1]);
+		else {
+			cerr << "unknown option " << arg << endl;
+			return 1;
+		}
+	}
+
+	vector<uint> blocks;
+	vector<string> size_list = split(sizes);
+	for (uint k = 0; k < size_list.size(); ++k)
+		if (atoi(size_list[k].c_str()) > 0)
+			blocks.push_back(atoi(size_list[k].c_str()));
+
+	vector<const hash_algo*> algos;
+	vector<string> names = split(hashes);
+	for (uint k = 0; k < names.size(); ++k) {
+		const hash_algo* algo = hash_find(names[k]);
+		if (!algo) {
+			cerr << "unknown hash " << names[k] << endl;
+			return 1;
+		}
+		algos.push_back(algo);
+	}
+
+	map<string, double> base;
+	if (!baseline.empty() && !read_baseline(baseline, base)) {
+		cerr << "can not read baseline " << baseline << endl;
+		return 1;
+	}
+
+	cl_platform_id platforms[MAX_PLATFORMS];
+	cl_uint num_platforms = 0;
+	if (clGetPlatformIDs(MAX_PLATFORMS, platforms, &num_platforms) != CL_SUCCESS)
+		num_platforms = 0;
+
+	vector<bench_result> results;
+	for (uint h = 0; h < algos.size(); ++h) {
+		for (cl_uint p = 0; p < num_platforms && p < MAX_PLATFORMS; ++p) {
+			cl_device_id devices[MAX_DEVICES];
+			cl_uint num_devices = 0;
+			if (clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, MAX_DEVICES, devices, &num_devices) != CL_SUCCESS)
+				continue;
+
+			for (cl_uint d = 0; d < num_devices && d < MAX_DEVICES; ++d) {
+				smasher s(platforms[p], devices[d], *algos[h]);
+				if (!s.get_ready()) {
+					cerr << "device " << s.get_name() << " failed to initialize" << endl;
+					continue;
+				}
+				run_backend(s, s.get_name(), *algos[h], blocks, ms, results);
+			}
+		}
+
+		cpu_smasher native(*algos[h]);
+		run_backend(native, string("native ") + native.get_isa(), *algos[h], blocks, ms, results);
+	}
+
+	if (out_path.empty())
+		write_json(cout, results, ms);
+	else {
+		ofstream out(out_path.c_str());
+		write_json(out, results, ms);
+	}
+
+	if (baseline.empty())
+		return 0;
+
+	// a result without a counterpart is new, not a regression
+	uint regressions = 0;
+	for (uint k = 0; k < results.size(); ++k) {
+		const bench_result& r = results[k];
+		map<string, double>::iterator b = base.find(key_of(r.backend, r.hash, r.blocks));
+		if (b == base.end() || b->second <= 0)
+			continue;
+
+		double change = (r.rate / b->second - 1) * 100;
+		bool worse = change < -tolerance;
+		regressions += worse;
+
+		cerr << (worse ? "REGRESSION " : "") << r.backend << " " << r.hash << " x" << r.blocks << ": " << (change >= 0 ? "+" : "") << change << "%" << endl;
+	}
+
+	cerr << regressions << " regression(s) beyond " << tolerance << "%" << endl;
+	return regressions ? 2 : 0;
+}
@@ -0,0 +1,458 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "cluster.h"
+#include "progress.h"
+#include "scheduler.h"
+#include "smasher.h"
+
+/*Correctness checks on every backend (each OpenCL device and the
+native CPU engine) for the cases synthetic benchmarks never hit:
+
+	smasher_test [--hashes md5,sha1]
+
+Prints one line per check and exits with 1 if any failed.*/
+
+#define TEST_OVERFLOW_BLOCKS (HIT_CAPACITY / BLOCK_SIZE + 16) // one launch with more hits than fit
+#define TEST_CLUSTER_PORT (CLUSTER_PORT + 100) // first of the ports tried for the loopback cluster
+#define TEST_LEASE_MS 300
+
+static uint failures = 0;
+
+static void report(const string& backend, const string& check, bool passed, const string& detail) {
+	cerr << (passed ? "ok   " : "FAIL ") << backend << " " << check << ": " << detail << endl;
+	failures += !passed;
+}
+
+// the native engine has no launches to pin
+static void pin(smasher& s, uint blocks) { s.set_launch_blocks(blocks); }
+static void pin(cpu_smasher&, uint) {}
+
+/*Every key of a single launch is a target, so the launch overflows
+HIT_CAPACITY and has to be searched again block by block.*/
+template<class E>
+static void check_overflow(E& engine, const string& backend, const hash_algo& algo, const key_mask* mask, uint length) {
+	const uint64 keys = mask ? mask->keyspace(length) : (uint64)TEST_OVERFLOW_BLOCKS * BLOCK_SIZE;
+	const uint blocks = (uint)((keys + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+	target_set targets(algo.digest_size);
+	uchar key[MAX_KEY_LEN], digest[MAX_DIGEST_SIZE];
+	for (uint64 k = 0; k < keys; ++k) {
+		if (mask)
+			mask->candidate(k, length, key);
+		else {
+			// big-endian counter, like smasher::confirm()
+			memset(key, 0, KEY_SIZE);
+			for (uint b = 0; b < 8; ++b)
+				key[KEY_SIZE - 1 - b] = (uchar)(k >> (b * 8));
+		}
+		hash_digest(algo, key, mask ? length : KEY_SIZE, digest);
+		targets.add((const char*)digest);
+	}
+	targets.build();
+
+	engine.set_mask(mask, length);
+	pin(engine, blocks);
+	vector<target_hit> hits;
+	int confirmed = engine.smash_range(0, blocks, targets, hits);
+	pin(engine, 0);
+	engine.set_mask(NULL, 0);
+
+	// every target exactly once
+	vector<char> seen(targets.size(), 0);
+	uint twice = 0;
+	for (size_t k = 0; k < hits.size(); ++k)
+		if (hits[k].target < targets.size())
+			twice += seen[hits[k].target]++ != 0;
+
+	stringstream detail;
+	detail << confirmed << " of " << targets.size() << " confirmed, " << twice << " twice";
+	report(backend, string(algo.name) + (mask ? " mask overflow" : " counter overflow"),
+		confirmed == (int)targets.size() && hits.size() == targets.size() && !twice, detail.str());
+}
+
+/*Masks past 2 ** 64 keys are searched to their last key, only ones
+whose blocks outgrow 64 bits are refused.*/
+template<class E>
+static void check_mask_space(E& engine, const string& backend, const hash_algo& algo) {
+	key_mask all;
+	all.parse("?a?a?a?a?a?a?a?a?a?a?a?a");
+
+	const bool huge = engine.set_mask(&all, 12), wide = engine.set_mask(&all, 10);
+
+	// the last key of 95 ** 10, about 2 ** 65.7
+	uint128 last = all.wide_keyspace(10);
+	last.hi -= !last.lo--;
+	const uint64 block = last.hi << (64 - BLOCK_BITS) | last.lo >> BLOCK_BITS;
+	const uint offset = (uint)(last.lo & (BLOCK_SIZE - 1));
+
+	uchar key[MAX_KEY_LEN], digest[MAX_DIGEST_SIZE];
+	all.candidate(last, 10, key);
+	hash_digest(algo, key, 10, digest);
+
+	uint64 found = 0;
+	const int single = wide ? engine.smash_range(block, 1, (char*)digest, found) : -1;
+
+	target_set targets(algo.digest_size);
+	targets.add((const char*)digest);
+	targets.build();
+	vector<target_hit> hits;
+	if (wide)
+		engine.smash_range(block, 1, targets, hits);
+	engine.set_mask(NULL, 0);
+
+	const bool multi = hits.size() == 1 && hits[0].index == last.lo && hits[0].index_hi == last.hi;
+	stringstream detail;
+	detail << "95 ** 12 " << (huge ? "accepted" : "refused") << ", 95 ** 10 " << (wide ? "accepted" : "refused")
+		<< ", last key " << (single == (int)offset && found == block ? "found" : "missed") << " single, "
+		<< (multi ? "found" : "missed") << " multi";
+	report(backend, string(algo.name) + " mask space", !huge && wide && single == (int)offset && found == block && multi, detail.str());
+}
+
+/*Users sharing a salt and a password share a crypt string, each of
+them is a hit, for md5crypt and sha512crypt with and without rounds=.*/
+template<class E>
+static void check_crypt_shared(E& engine, const string& backend) {
+	const char* path = "smasher_test.words";
+	FILE* out = fopen(path, "wb");
+	if (!out) {
+		report(backend, "crypt shared", false, "can not write the wordlist");
+		return;
+	}
+	fputs("letmein\npassword\n", out);
+	fclose(out);
+
+	crypt_set targets;
+	targets.add("$1$saltsalt$qjXMvbEw8oaL.CzflDtaK/", "alice");
+	targets.add("$1$saltsalt$qjXMvbEw8oaL.CzflDtaK/", "bob");
+	targets.add("$1$other$ccwe2RAD4/76BDLhrMpM9.", "carol");
+	targets.add("$6$saltsalt$qFmFH.bQmmtXzyBY0s9v7Oicd2z4XSIecDzlB5KiA2/jctKu9YterLp8wwnSq.qc.eoxqOmSuNp2xS0ktL3nh/", "dave");
+	targets.add("$6$saltsalt$qFmFH.bQmmtXzyBY0s9v7Oicd2z4XSIecDzlB5KiA2/jctKu9YterLp8wwnSq.qc.eoxqOmSuNp2xS0ktL3nh/", "erin");
+	targets.add("$6$rounds=1000$pepper$Vmt8QDYBfy4xyUJ5ZApk3M1GJddAlInQHMMw/4WerPZMjAIvRPau/Vx6lDtbP5vGlVRbT37DPMPsM0dcUNHvE.", "frank");
+	targets.build();
+
+	wordlist words;
+	words.open(path);
+	vector<target_hit> hits;
+	{
+		word_feed feed(words);
+		engine.smash_crypt(feed, targets, hits);
+	}
+	words.close();
+	remove(path);
+
+	string users;
+	vector<string> found;
+	for (size_t k = 0; k < hits.size(); ++k)
+		found.push_back(targets.get_user(hits[k].target));
+	sort(found.begin(), found.end());
+	for (size_t k = 0; k < found.size(); ++k)
+		users += (k ? " " : "") + found[k];
+	report(backend, "crypt shared", users == "alice bob carol dave erin frank", users.empty() ? string("no hits") : users);
+}
+
+static string ranges_text(const vector<block_range>& ranges) {
+	stringstream s;
+	for (size_t k = 0; k < ranges.size(); ++k)
+		s << (k ? " " : "") << ranges[k].first << "+" << ranges[k].count;
+	return s.str();
+}
+
+static vector<string> read_lines(const string& path) {
+	vector<string> lines;
+	ifstream in(path.c_str());
+	string line;
+	while (getline(in, line))
+		lines.push_back(line);
+	return lines;
+}
+
+/*A journal as a crash leaves it: a record with a bad checksum, with a
+good one after it that must not be trusted either, then a torn last
+line. Reopening keeps what came before the damage, compacts the file
+to one record per range and per hit, and refuses another job.*/
+static void check_journal() {
+	const char* path = "smasher_test.journal";
+	remove(path);
+
+	{
+		progress_journal journal;
+		if (!journal.open(path, "md5 test")) {
+			report("journal", "resume", false, "can not write the journal");
+			return;
+		}
+		target_hit low = { 5 << BLOCK_BITS, 1, 0, 0 };
+		target_hit high = { 7, 2, 3, 1 };
+		journal.hit(low);
+		journal.done(0, 10);
+		journal.done(20, 10);
+		journal.done(10, 5);
+		journal.hit(high);
+		journal.done(30, 5);
+		journal.done(60, 5);
+	}
+
+	// the checksum of "D 60 5" on "D 40 5", then the intact "D 60 5"
+	vector<string> lines = read_lines(path);
+	string last = lines.back();
+	lines.back() = "D 40 5" + last.substr(last.rfind(' '));
+	lines.push_back(last);
+	{
+		ofstream out(path, ios::binary);
+		for (size_t k = 0; k < lines.size(); ++k)
+			out << lines[k] << '\n';
+		out << last.substr(0, 4); // torn
+	}
+
+	bool passed = true;
+	stringstream detail;
+	{
+		progress_journal journal;
+		passed = journal.open(path, "md5 test");
+		vector<target_hit> hits = journal.get_hits();
+		const string pending = ranges_text(journal.pending(0, 100));
+		const string within = ranges_text(journal.pending(12, 20));
+		passed = passed && journal.get_done() == 30 && pending == "15+5 35+65" && within == "15+5" && journal.pending(0, 15).empty();
+		passed = passed && hits.size() == 2 && hits[0].index == 5 << BLOCK_BITS && hits[1].index_hi == 1 && hits[1].rule == 3;
+		detail << journal.get_done() << " blocks done, pending " << pending << ", " << hits.size() << " hits";
+	}
+
+	// header, two hits, [0, 15) and [20, 35)
+	const size_t compacted = read_lines(path).size();
+	passed = passed && compacted == 5;
+	detail << ", " << compacted << " lines compacted";
+
+	{
+		progress_journal journal;
+		const bool other = journal.open(path, "sha1 test");
+		passed = passed && !other;
+		detail << (other ? ", other job resumed" : ", other job refused");
+	}
+
+	remove(path);
+	remove((string(path) + ".tmp").c_str());
+	report("journal", "resume", passed, detail.str());
+}
+
+/*Host digests of keys that do not fit a block are refused instead of
+written past it: over MAX_KEY_LEN bytes, or half that for NTLM.*/
+static void check_digest_length() {
+	uchar key[MAX_KEY_LEN + 1], digest[MAX_DIGEST_SIZE];
+	memset(key, 'a', sizeof(key));
+
+	const hash_algo* md5 = hash_find("md5");
+	const hash_algo* ntlm = hash_find("ntlm");
+	const uint half = MAX_KEY_LEN / 2;
+	const bool passed = hash_digest(*md5, key, MAX_KEY_LEN, digest) && !hash_digest(*md5, key, MAX_KEY_LEN + 1, digest) &&
+		hash_digest(*ntlm, key, half, digest) && !hash_digest(*ntlm, key, half + 1, digest);
+
+	stringstream detail;
+	detail << "md5 up to " << MAX_KEY_LEN << ", ntlm up to " << half << " characters";
+	report("host", "digest length", passed, detail.str());
+}
+
+/*--skip and --limit take plain decimal numbers only, strtoull alone
+would read "-1" as 2 ** 64 - 1.*/
+static void check_slice() {
+	const char* good[] = { "smasher", "--hashes", "md5", "--skip", "12", "--limit=5" };
+	const char* bad[][3] = {
+		{ "smasher", "--skip=-1", NULL }, { "smasher", "--skip", " 3" }, { "smasher", "--limit=+3", NULL },
+		{ "smasher", "--limit", NULL }, { "smasher", "--skip=18446744073709551616", NULL }, { "smasher", "--skip=3x", NULL },
+		{ "smasher", "--limit=", NULL },
+	};
+
+	keyspace_slice slice;
+	bool passed = slice.parse(6, (char**)good) && slice.skip == 12 && slice.limit == 5;
+	string refused;
+	for (size_t k = 0; k < sizeof(bad) / sizeof(bad[0]); ++k) {
+		keyspace_slice s;
+		const int argc = bad[k][2] ? 3 : 2;
+		if (s.parse(argc, (char**)bad[k])) {
+			passed = false;
+			refused += string(refused.empty() ? "" : ", ") + bad[k][1] + (argc == 3 ? string(" ") + bad[k][2] : "");
+		}
+	}
+	report("slice", "parse", passed, refused.empty() ? "malformed numbers refused" : "taken: " + refused);
+}
+
+// sleeps until 'flag' is set, false if it took more than ten seconds
+static bool wait_for(const atomic<bool>& flag) {
+	for (uint k = 0; k < 1000 && !flag; ++k)
+		this_thread::sleep_for(chrono::milliseconds(10));
+	return flag;
+}
+
+/*A loopback coordinator and two workers. The first worker takes the
+first lease and goes quiet until its lease has timed out and been
+leased again to the second one; the hits it then reports under its old
+lease, one of them forged, must be refused. Every block still has to
+be searched once, so each of the expected hits arrives exactly once.*/
+static void check_cluster() {
+	const uint64 blocks = 256;
+	const uint every = 16; // one hit at the first key of every 16th block
+
+	coordinator c;
+	c.set_job("smasher_test");
+	c.set_lease_timeout(TEST_LEASE_MS);
+	uint16_t port = 0;
+	for (uint16_t p = TEST_CLUSTER_PORT; p < TEST_CLUSTER_PORT + 16 && !port; ++p)
+		if (c.listen(p))
+			port = p;
+	if (!port) {
+		report("cluster", "lease expiry", false, "can not listen");
+		return;
+	}
+
+	auto hits_in = [&](uint64 first, uint64 count, vector<target_hit>& hits) {
+		for (uint64 b = first; b < first + count; ++b)
+			if (b % every == 0) {
+				target_hit hit = { b << BLOCK_BITS, 0, 0, 0 };
+				hits.push_back(hit);
+			}
+		return 0;
+	};
+
+	atomic<bool> leased(false), reissued(false), reported(false);
+	vector<target_hit> found;
+	thread serve([&] { c.run(0, blocks, found); });
+
+	thread quiet([&] {
+		cluster_worker w;
+		if (!w.connect("127.0.0.1", port, "smasher_test"))
+			return;
+		w.run([&](uint64 first, uint64 count, vector<target_hit>& hits) {
+			if (leased)
+				return hits_in(first, count, hits);
+			leased = true;
+			wait_for(reissued);
+			hits_in(first, count, hits);
+			target_hit forged = { (blocks + 1) << BLOCK_BITS, 0, 0, 0 };
+			hits.push_back(forged);
+			reported = true;
+			return 0;
+		});
+	});
+
+	bool again = false;
+	thread busy([&] {
+		cluster_worker w;
+		if (!wait_for(leased) || !w.connect("127.0.0.1", port, "smasher_test"))
+			return;
+		w.run([&](uint64 first, uint64 count, vector<target_hit>& hits) {
+			// the first lease comes back here once it times out
+			if (first == 0) {
+				again = true;
+				reissued = true;
+				wait_for(reported);
+				this_thread::sleep_for(chrono::milliseconds(TEST_LEASE_MS / 2)); // the late hits arrive meanwhile
+			}
+			return hits_in(first, count, hits);
+		});
+	});
+
+	serve.join();
+	busy.join();
+	reissued = reported = true; // a quiet worker that never got the range lets go
+	quiet.join();
+
+	vector<uint64> got;
+	for (size_t k = 0; k < found.size(); ++k)
+		got.push_back(found[k].index >> BLOCK_BITS);
+	sort(got.begin(), got.end());
+	vector<uint64> expected;
+	for (uint64 b = 0; b < blocks; b += every)
+		expected.push_back(b);
+
+	stringstream detail;
+	detail << got.size() << " of " << expected.size() << " hits" << (again ? ", first lease re-issued" : ", first lease never re-issued");
+	report("cluster", "lease expiry", again && got == expected, detail.str());
+}
+
+template<class E>
+static void run_backend(E& engine, const string& backend, const hash_algo& algo) {
+	key_mask digits;
+	digits.parse("?d?d?d?d?d");
+
+	check_overflow(engine, backend, algo, NULL, 0);
+	check_overflow(engine, backend, algo, &digits, digits.get_positions());
+	check_mask_space(engine, backend, algo);
+	check_crypt_shared(engine, backend);
+}
+
+static vector<string> split(const string& list) {
+	vector<string> items;
+	stringstream s(list);
+	string item;
+	while (getline(s, item, ','))
+		if (!item.empty())
+			items.push_back(item);
+	return items;
+}
+
+int main(int argc, char** argv) {
+	string hashes = "md5,sha1";
+
+	for (int a = 1; a < argc; a += 2) {
+		string arg = argv[a];
+		if (a + 1 >= argc) {
+			cerr << "missing value for " << arg << endl;
+			return 1;
+		}
+		if (arg == "--hashes")
+			hashes = argv[a + 1];
+		else {
+			cerr << "unknown option " << arg << endl;
+			return 1;
+		}
+	}
+
+	vector<const hash_algo*> algos;
+	vector<string> names = split(hashes);
+	for (uint k = 0; k < names.size(); ++k) {
+		const hash_algo* algo = hash_find(names[k]);
+		if (!algo) {
+			cerr << "unknown hash " << names[k] << endl;
+			return 1;
+		}
+		algos.push_back(algo);
+	}
+
+	cl_platform_id platforms[MAX_PLATFORMS];
+	cl_uint num_platforms = 0;
+	if (clGetPlatformIDs(MAX_PLATFORMS, platforms, &num_platforms) != CL_SUCCESS)
+		num_platforms = 0;
+
+	for (uint h = 0; h < algos.size(); ++h) {
+		for (cl_uint p = 0; p < num_platforms && p < MAX_PLATFORMS; ++p) {
+			cl_device_id devices[MAX_DEVICES];
+			cl_uint num_devices = 0;
+			if (clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, MAX_DEVICES, devices, &num_devices) != CL_SUCCESS)
+				continue;
+
+			for (cl_uint d = 0; d < num_devices && d < MAX_DEVICES; ++d) {
+				smasher s(platforms[p], devices[d], *algos[h]);
+				if (!s.get_ready()) {
+					report(s.get_name(), "init", false, "failed to initialize");
+					continue;
+				}
+				run_backend(s, s.get_name(), *algos[h]);
+			}
+		}
+
+		cpu_smasher native(*algos[h]);
+		run_backend(native, string("native ") + native.get_isa(), *algos[h]);
+	}
+
+	check_journal();
+	check_slice();
+	check_digest_length();
+	check_cluster();
+
+	cerr << failures << " failure(s)" << endl;
+	return failures ? 1 : 0;
+}
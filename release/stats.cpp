@@ -0,0 +1,69 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "stats.h"
+
+static const char* const stage_names[STAGE_COUNT] = { "write", "kernel", "read", "match" };
+
+double stats_snapshot::eta() const {
+	if (!total || !blocks || seconds <= 0)
+		return -1;
+
+	uint64 left = (skipped + blocks < total) ? total - skipped - blocks : 0;
+	return left / (blocks / seconds);
+}
+
+string stats_snapshot::to_json() const {
+	stringstream s;
+	s << "{\"seconds\": " << seconds << ", \"launches\": " << launches << ", \"keys\": " << keys
+		<< ", \"hashes_per_s\": " << rate() << ", \"blocks\": " << blocks << ", \"skipped\": " << skipped
+		<< ", \"total\": " << total << ", \"coverage\": " << coverage() << ", \"eta_s\": " << eta() << ", \"stages_ms\": {";
+	for (uint k = 0; k < STAGE_COUNT; ++k)
+		s << (k ? ", " : "") << "\"" << stage_names[k] << "\": " << stage_ms[k];
+	s << "}}";
+	return s.str();
+}
+
+void smash_stats::begin(uint64 total, uint64 skipped) {
+	launches = 0;
+	keys = 0;
+	blocks = 0;
+	this->skipped = skipped;
+	this->total = total;
+	for (uint k = 0; k < STAGE_COUNT; ++k)
+		stage_ns[k] = 0;
+	started = chrono::steady_clock::now().time_since_epoch().count();
+}
+
+stats_snapshot smash_stats::get() const {
+	stats_snapshot snap;
+	chrono::steady_clock::duration since(chrono::steady_clock::now().time_since_epoch().count() - started);
+	snap.seconds = chrono::duration<double>(since).count();
+	snap.launches = launches;
+	snap.keys = keys;
+	snap.blocks = blocks;
+	snap.skipped = skipped;
+	snap.total = total;
+	for (uint k = 0; k < STAGE_COUNT; ++k)
+		snap.stage_ms[k] = stage_ns[k] / 1e6;
+	return snap;
+}
+
+bool smash_stats::write(const string& path) const {
+	string temp = path + ".tmp";
+	{
+		ofstream file(temp.c_str(), ios::trunc);
+		file << get().to_json() << endl;
+		if (!file)
+			return false;
+	}
+
+#ifdef _WIN32
+	remove(path.c_str()); // rename does not replace there
+#endif
+	return rename(temp.c_str(), path.c_str()) == 0;
+}
+
+smash_stats::smash_stats() {
+	begin(0);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include "types.h"
+
+using namespace std;
+
+// stages of a launch, all but STAGE_MATCH timed by the device's queue profiling
+enum smash_stage {
+	STAGE_WRITE, // hit counter reset and wordlist uploads
+	STAGE_KERNEL,
+	STAGE_READ, // hit counter and first pairs
+	STAGE_MATCH, // confirming hits on the host
+	STAGE_COUNT
+};
+
+// a consistent enough copy of smash_stats, times in ms
+struct stats_snapshot {
+	double seconds; // since the search began
+	uint64 launches;
+	uint64 keys;
+	uint64 blocks; // searched in this run
+	uint64 skipped; // done by an earlier run, from the journal
+	uint64 total; // blocks of the search, 0 for wordlists
+	double stage_ms[STAGE_COUNT];
+
+	double rate() const { return seconds > 0 ? keys / seconds : 0; }
+
+	// done share of the keyspace, 0 if the size is not known
+	double coverage() const { return total ? (double)(skipped + blocks) / total : 0; }
+
+	// seconds left at the block rate so far, -1 if not known yet
+	double eta() const;
+
+	string to_json() const;
+};
+
+/*Live counters of the search in progress. Engines add to them once
+per retired launch with relaxed atomics, so the hot loop pays a few
+uncontended adds; any thread (a status socket, a file writer) can take
+a snapshot at any time without stopping anything.*/
+class smash_stats {
+public:
+	// starts a search of 'total' blocks, 'skipped' of them done before
+	void begin(uint64 total, uint64 skipped = 0);
+
+	void add_launch(uint64 keys) { launches.fetch_add(1, memory_order_relaxed); add_keys(keys); }
+	void add_keys(uint64 keys) { this->keys.fetch_add(keys, memory_order_relaxed); }
+	void add_blocks(uint64 blocks) { this->blocks.fetch_add(blocks, memory_order_relaxed); }
+	void add_stage(smash_stage stage, uint64 ns) { stage_ns[stage].fetch_add(ns, memory_order_relaxed); }
+
+	uint64 get_blocks() const { return blocks; }
+
+	stats_snapshot get() const;
+
+	// replaces 'path' with the snapshot as JSON, readers never see half of it
+	bool write(const string& path) const;
+
+	smash_stats();
+private:
+	atomic<uint64> launches;
+	atomic<uint64> keys;
+	atomic<uint64> blocks;
+	atomic<uint64> skipped;
+	atomic<uint64> total;
+	atomic<uint64> stage_ns[STAGE_COUNT];
+	atomic<long long> started; // steady clock ticks
+};
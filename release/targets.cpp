@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include "targets.h"
+#include "pool.h"
+#include "wordlist.h"
+#include "log.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TARGETS_SSE2
+#include <emmintrin.h>
+#endif
+
+struct digest_words {
+	uint w[4];
+
+	bool operator<(const digest_words& o) const {
+		for (uint k = 0; k < 4; ++k)
+			if (w[k] != o.w[k])
+				return w[k] < o.w[k];
+		return false;
+	}
+	bool operator==(const digest_words& o) const { return !memcmp(w, o.w, sizeof(w)); }
+};
+
+// table words of a target and where its full digest is
+struct keyed_words {
+	digest_words words;
+	uint at;
+};
+
+// value of every char as a hex digit, 0xff for anything else
+static const struct hex_table {
+	uchar value[256];
+
+	hex_table() {
+		memset(value, 0xff, sizeof(value));
+		for (uint k = 0; k < 10; ++k)
+			value['0' + k] = (uchar)k;
+		for (uint k = 0; k < 6; ++k)
+			value['a' + k] = value['A' + k] = (uchar)(10 + k);
+	}
+} hex_digits;
+
+/*Decodes 'bytes' bytes from twice as many hex chars, false if one
+of them is no hex digit. With SSE2, 16 chars go at once: digits and
+letters are told apart with compares, their values come from one
+subtraction each and the nibble pairs are joined with shifts, so
+nothing branches on the data; the rest goes through the table.*/
+static bool decode_hex(const char* text, uint bytes, uchar* out) {
+	uint k = 0;
+#ifdef TARGETS_SSE2
+	const __m128i zero = _mm_setzero_si128(), low = _mm_set1_epi16(0xff);
+	for (; (k + 8) <= bytes; k += 8) {
+		const __m128i c = _mm_loadu_si128((const __m128i*)(text + k * 2));
+		const __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+		const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+		const __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+		if (_mm_movemask_epi8(_mm_or_si128(digit, letter)) != 0xffff)
+			return false;
+
+		const __m128i value = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+			_mm_and_si128(letter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+
+		// the first char of a pair is the low byte of its 16-bit lane and the high nibble
+		const __m128i pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(value, low), 4), _mm_srli_epi16(value, 8));
+		_mm_storel_epi64((__m128i*)(out + k), _mm_packus_epi16(pairs, zero));
+	}
+#endif
+
+	uchar invalid = 0;
+	for (; k < bytes; ++k) {
+		const uchar hi = hex_digits.value[(uchar)text[k * 2]], lo = hex_digits.value[(uchar)text[k * 2 + 1]];
+		invalid |= (hi | lo) & 0xf0;
+		out[k] = (uchar)(hi << 4 | lo);
+	}
+	return !invalid;
+}
+
+/*Sorts 'items' on every core: equal slices are sorted on their own,
+then merged pairwise, one round per doubling.*/
+template<class T, class F>
+static void parallel_sort(vector<T>& items, F less) {
+	const uint64 count = items.size();
+	if (count < TARGET_SORT_MIN) {
+		sort(items.begin(), items.end(), less);
+		return;
+	}
+
+	work_pool pool;
+	const uint64 slice = (count + pool.size() - 1) / pool.size();
+	pool.run(0, (count + slice - 1) / slice, 1,
+		[&](uint, uint64 a, uint64 b) {
+			for (uint64 k = a; k < b; ++k)
+				sort(items.begin() + k * slice, items.begin() + min(count, (k + 1) * slice), less);
+			return false;
+		});
+
+	for (uint64 width = slice; width < count; width *= 2)
+		pool.run(0, (count + width * 2 - 1) / (width * 2), 1,
+			[&](uint, uint64 a, uint64 b) {
+				for (uint64 k = a; k < b; ++k) {
+					const uint64 first = k * width * 2;
+					if (first + width < count)
+						inplace_merge(items.begin() + first, items.begin() + first + width, items.begin() + min(count, first + width * 2), less);
+				}
+				return false;
+			});
+}
+
+void target_set::add(const char* digest) {
+	uint w[4];
+	memcpy(w, digest, MATCH_SIZE); // digest bytes are the little-endian state words
+	table.insert(table.end(), w, w + 4);
+	digests.insert(digests.end(), digest, digest + digest_size);
+}
+
+bool target_set::load(const string& path) {
+	wordlist list;
+	if (!list.open(path))
+		return false;
+
+	// digests and skipped lines of a chunk, line numbers counted from the chunk's start
+	struct part {
+		vector<char> digests;
+		uint64 lines;
+		uint skipped;
+		vector<uint64> malformed;
+	};
+
+	vector<part> parts(list.get_chunks());
+	work_pool pool;
+	pool.run(0, parts.size(), 1,
+		[&](uint, uint64 a, uint64 b) {
+			for (uint64 c = a; c < b; ++c) {
+				part& p = parts[(size_t)c];
+				p.lines = 0;
+				p.skipped = 0;
+
+				uint size;
+				const char* text = list.chunk((uint)c, size);
+				const char* end = text + size;
+				char digest[MAX_DIGEST_SIZE];
+				for (const char* line = text; line < end; ++p.lines) {
+					const char* next = (const char*)memchr(line, '\n', end - line);
+					if (!next)
+						next = end;
+
+					// allow a trailing '\r' from files written on Windows
+					uint length = (uint)(next - line);
+					if (length && line[length - 1] == '\r')
+						--length;
+
+					if (length == digest_size * 2 && decode_hex(line, digest_size, (uchar*)digest))
+						p.digests.insert(p.digests.end(), digest, digest + digest_size);
+					else if (++p.skipped <= TARGET_REPORT)
+						p.malformed.push_back(p.lines + 1);
+
+					line = next + 1;
+				}
+			}
+			return false;
+		});
+
+	// chunks go in in file order, each one copied to its place on its own core
+	vector<uint64> at(parts.size() + 1, size());
+	uint64 lines = 0;
+	for (size_t c = 0; c < parts.size(); ++c) {
+		at[c + 1] = at[c] + parts[c].digests.size() / digest_size;
+		skipped += parts[c].skipped;
+		for (size_t k = 0; k < parts[c].malformed.size() && malformed.size() < TARGET_REPORT; ++k) {
+			malformed.push_back(lines + parts[c].malformed[k]);
+			LOG_LINE("Malformed target at " << path << ":" << malformed.back());
+		}
+		lines += parts[c].lines;
+	}
+
+	table.resize((size_t)at.back() * 4);
+	digests.resize((size_t)at.back() * digest_size);
+	pool.run(0, parts.size(), 1,
+		[&](uint, uint64 a, uint64 b) {
+			for (uint64 c = a; c < b; ++c) {
+				const vector<char>& d = parts[(size_t)c].digests;
+				if (d.empty())
+					continue;
+				memcpy(&digests[(size_t)at[c] * digest_size], &d[0], d.size());
+
+				// digest bytes are the little-endian state words, as in add()
+				for (uint64 k = 0; k < d.size() / digest_size; ++k)
+					memcpy(&table[(size_t)(at[c] + k) * 4], &d[(size_t)k * digest_size], MATCH_SIZE);
+			}
+			return false;
+		});
+
+	LOG_LINE("Loaded targets from " << path << ". COUNT = " << size() << ". SKIPPED = " << skipped);
+
+	return true;
+}
+
+void target_set::build() {
+	/*Sort and drop duplicates, moving the full digests along. The
+	words are sorted together with their position, so comparisons
+	rarely leave the array being sorted.*/
+	vector<keyed_words> order(size());
+	for (uint k = 0; k < size(); ++k) {
+		memcpy(order[k].words.w, &table[(size_t)k * 4], sizeof(order[k].words.w));
+		order[k].at = k;
+	}
+	parallel_sort(order, [&](const keyed_words& a, const keyed_words& b) {
+		if (a.words == b.words)
+			return memcmp(&digests[(size_t)a.at * digest_size], &digests[(size_t)b.at * digest_size], digest_size) < 0;
+		return a.words < b.words;
+	});
+
+	vector<uint> sorted_table;
+	vector<char> sorted_digests;
+	sorted_table.reserve(table.size());
+	sorted_digests.reserve(digests.size());
+	for (uint k = 0; k < order.size(); ++k) {
+		const char* d = &digests[(size_t)order[k].at * digest_size];
+		if (k && order[k].words == order[k - 1].words && !memcmp(d, &digests[(size_t)order[k - 1].at * digest_size], digest_size))
+			continue;
+		sorted_table.insert(sorted_table.end(), order[k].words.w, order[k].words.w + 4);
+		sorted_digests.insert(sorted_digests.end(), d, d + digest_size);
+	}
+	table.swap(sorted_table);
+	digests.swap(sorted_digests);
+
+	fill_bitmaps();
+}
+
+void target_set::fill_bitmaps() {
+	// bitmaps get a power of two number of bits, TARGET_BITS per target
+	uint64 bits = 1 << 16;
+	while (bits < (uint64)size() * TARGET_BITS && bits < (1ULL << 32))
+		bits <<= 1;
+	mask = (uint)(bits - 1);
+
+	bitmap_a.assign((size_t)(bits / 32), 0);
+	bitmap_b.assign((size_t)(bits / 32), 0);
+	for (uint k = 0; k < size(); ++k) {
+		const uint* h = &table[k * 4];
+		bitmap_a[(h[0] & mask) >> 5] |= 1u << (h[0] & 31);
+		bitmap_b[(h[1] & mask) >> 5] |= 1u << (h[1] & 31);
+	}
+
+	LOG_LINE("Built target set. COUNT = " << size() << ". BITMAP_BITS = " << bits);
+}
+
+void target_set::subset(const vector<char>& drop, target_set& out, vector<uint>* positions) const {
+	out.digest_size = digest_size;
+	out.table.clear();
+	out.digests.clear();
+	if (positions)
+		positions->clear();
+
+	for (uint k = 0; k < size(); ++k) {
+		if (drop[k])
+			continue;
+		out.table.insert(out.table.end(), &table[(size_t)k * 4], &table[(size_t)k * 4] + 4);
+		out.digests.insert(out.digests.end(), digest(k), digest(k) + digest_size);
+		if (positions)
+			positions->push_back(k);
+	}
+
+	// still sorted and unique, only the bitmaps are new
+	out.fill_bitmaps();
+}
+
+int target_set::find(const uint* h, uint stride) const {
+	// lower bound on the first word, then check the full digests
+	uint lo = 0, hi = size();
+	while (lo < hi) {
+		uint mid = (lo + hi) / 2;
+		if (table[mid * 4] < h[0])
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < size() && table[lo * 4] == h[0]; ++lo) {
+		const uint* t = &table[lo * 4];
+		if (t[1] == h[stride] && t[2] == h[2 * stride] && t[3] == h[3 * stride])
+			return (int)lo;
+	}
+
+	return -1;
+}
+
+target_set::target_set(uint digest_size) {
+	this->digest_size = digest_size;
+	mask = 0;
+	skipped = 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "types.h"
+
+using namespace std;
+
+#define TARGET_BITS 16 // bitmap bits per target, sets the false positive rate
+#define TARGET_REPORT 16 // malformed lines load() keeps the line numbers of
+#define TARGET_SORT_MIN 65536 // fewer targets than this are sorted on one thread
+
+struct target_hit {
+	uint64 index; // key index in the keyspace
+	uint target; // position in the target_set
+	uint rule; // rule applied to the word in rule mode, mask key index in hybrid mode, 0 otherwise
+	uint64 index_hi; // bits 64 to 127 of a counter key index, 0 below block 2 ** 54
+};
+
+/*A list of target digests prepared for matching them all at once.
+Two bitmaps, indexed by the low bits of the first and second digest
+word, reject almost every candidate with two loads; survivors are
+looked up in the sorted digest table. The cost per candidate barely
+depends on how many targets there are.
+The table holds the first MATCH_SIZE bytes of every digest, which is
+all the searches compare; longer digests are kept whole for confirming
+hits on the host.*/
+class target_set {
+public:
+	void add(const char* digest); // get_digest_size() bytes
+
+	/*Adds one hex digest per line, returns false if the file
+	can not be read. The file is mapped and its chunks decoded on
+	every core, 16 hex chars at a time where SSE2 is there. Malformed
+	lines are skipped and counted, the first TARGET_REPORT of them
+	are kept for get_malformed().*/
+	bool load(const string& path);
+
+	/*Sorts and deduplicates the targets and fills the bitmaps.
+	Slices are sorted on every core, then merged. Call once after
+	the last add().*/
+	void build();
+
+	/*Copies the targets whose 'drop' entry is 0 into 'out', ready to
+	search. A built set stays sorted, so this is O(n) where build()
+	would sort again. Target k of 'out' was target positions[k] here.*/
+	void subset(const vector<char>& drop, target_set& out, vector<uint>* positions = NULL) const;
+
+	// true if the state words 'h' (spaced 'stride' apart) might be a target
+	bool probe(const uint* h, uint stride = 1) const {
+		return (bitmap_a[(h[0] & mask) >> 5] >> (h[0] & 31) & 1) &&
+			(bitmap_b[(h[stride] & mask) >> 5] >> (h[stride] & 31) & 1);
+	}
+
+	// position of 'h' in the table, or -1
+	int find(const uint* h, uint stride = 1) const;
+
+	uint size() const { return (uint)(table.size() / 4); }
+	uint get_mask() const { return mask; }
+	uint get_skipped() const { return skipped; }
+
+	// line numbers (from 1) of the first lines load() skipped, in file order
+	const vector<uint64>& get_malformed() const { return malformed; }
+	uint get_digest_size() const { return digest_size; }
+
+	const uint* get_table() const { return table.data(); }
+	const uint* get_bitmap_a() const { return bitmap_a.data(); }
+	const uint* get_bitmap_b() const { return bitmap_b.data(); }
+	uint get_bitmap_words() const { return (uint)bitmap_a.size(); }
+
+	// the full digest of target 'k'
+	const char* digest(uint k) const { return &digests[k * digest_size]; }
+
+	target_set(uint digest_size = MATCH_SIZE);
+private:
+	uint digest_size;
+	vector<uint> table; // first four digest words per target
+	vector<char> digests;
+	vector<uint> bitmap_a;
+	vector<uint> bitmap_b;
+	uint mask;
+	uint skipped;
+	vector<uint64> malformed;
+
+	void fill_bitmaps();
+};
@@ -0,0 +1,118 @@
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "tuner.h"
+#include "log.h"
+
+void launch_tuner::record(uint launched, size_t used_local, double ms) {
+	if (!launched || ms <= 0)
+		return;
+
+	// try each work-group size once, comparing time per block
+	if (sweeping && used_local == local) {
+		double per_block = ms / launched;
+		if (best_per_block == 0 || per_block < best_per_block) {
+			best_per_block = per_block;
+			best_local = local;
+		}
+
+		if (local * 2 <= max_local)
+			local *= 2;
+		else {
+			local = best_local;
+			sweeping = false;
+		}
+		changed = true;
+	}
+
+	// a short tail launch says nothing about the full size
+	if (launched != blocks)
+		return;
+
+	if (ms < TUNE_MIN_MS && blocks < max_blocks) {
+		blocks = (blocks * 2 < max_blocks) ? blocks * 2 : max_blocks;
+		changed = true;
+	}
+	else if (ms > TUNE_MAX_MS && blocks > 1) {
+		blocks /= 2;
+		changed = true;
+	}
+	else
+		return;
+
+	LOG_LINE("Tuned launch size. BLOCKS = " << blocks << ". LOCAL = " << local << ". LAST_MS = " << ms);
+}
+
+void launch_tuner::init(const string& name, uint max, size_t local_max, size_t multiple) {
+	device = name;
+	max_blocks = max ? max : 1;
+	blocks = (TUNE_START_BLOCKS < max_blocks) ? TUNE_START_BLOCKS : max_blocks;
+
+	// work-group sizes are powers of two from the preferred multiple up,
+	// so they always divide a launch of whole blocks
+	size_t group = BLOCK_SIZE / KEYS_PER_ITEM;
+	max_local = 1;
+	while (max_local * 2 <= local_max && max_local * 2 <= group)
+		max_local *= 2;
+	local = 1;
+	while (local < multiple && local < max_local)
+		local *= 2;
+	sweeping = true;
+
+	// restore stored values for this device, if any
+	ifstream file(TUNE_FILE);
+	string line;
+	while (getline(file, line)) {
+		size_t tab = line.rfind('\t');
+		size_t tab2 = (tab == string::npos || !tab) ? string::npos : line.rfind('\t', tab - 1);
+		if (tab2 == string::npos || line.substr(0, tab2) != device)
+			continue;
+
+		uint stored_blocks = 0;
+		size_t stored_local = 0;
+		stringstream(line.substr(tab2 + 1)) >> stored_blocks >> stored_local;
+		if (stored_blocks && stored_blocks <= max_blocks && stored_local <= max_local) {
+			blocks = stored_blocks;
+			local = stored_local;
+			sweeping = false;
+		}
+	}
+
+	LOG_LINE("Launch tuner for " << device << ". BLOCKS = " << blocks << ". LOCAL = " << local << (sweeping ? " (sweeping)" : " (stored)"));
+}
+
+void launch_tuner::save() {
+	if (!changed || sweeping || device.empty())
+		return;
+
+	// rewrite the file with this device's line replaced
+	vector<string> lines;
+	{
+		ifstream file(TUNE_FILE);
+		string line;
+		while (getline(file, line))
+			if (line.compare(0, device.size() + 1, device + "\t"))
+				lines.push_back(line);
+	}
+
+	stringstream entry;
+	entry << device << '\t' << blocks << '\t' << local;
+	lines.push_back(entry.str());
+
+	ofstream file(TUNE_FILE, ios::trunc);
+	for (size_t k = 0; k < lines.size(); ++k)
+		file << lines[k] << endl;
+
+	changed = false;
+}
+
+launch_tuner::launch_tuner() {
+	blocks = TUNE_START_BLOCKS;
+	max_blocks = TUNE_START_BLOCKS;
+	local = 0;
+	max_local = 0;
+	sweeping = false;
+	best_local = 0;
+	best_per_block = 0;
+	changed = false;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include "types.h"
+
+using namespace std;
+
+#define TUNE_FILE "smasher.tune"
+#define TUNE_MIN_MS 50.0 // launches shorter than this grow
+#define TUNE_MAX_MS 100.0 // launches longer than this shrink
+#define TUNE_START_BLOCKS 16
+
+
+/*Picks the launch geometry for one device: how many blocks a launch
+covers and the work-group size. Launches are timed as they retire; the
+block count is doubled or halved until a launch takes between TUNE_MIN_MS
+and TUNE_MAX_MS, and every work-group size is tried once, keeping the one
+with the lowest time per key. Settled values are stored per device in
+TUNE_FILE so the next start does not have to search again.*/
+class launch_tuner {
+public:
+	uint get_blocks() { return blocks; }
+	size_t get_local() { return local; }
+
+	/*Feeds back how long a launch of 'launched' blocks
+	with work-group size 'used_local' took.*/
+	void record(uint launched, size_t used_local, double ms);
+
+	/*Sets the limits for this device and restores its stored values.*/
+	void init(const string& device, uint max_blocks, size_t max_local, size_t multiple);
+
+	/*Stores the current values if they changed.*/
+	void save();
+
+	launch_tuner();
+private:
+	string device;
+	uint blocks;
+	uint max_blocks;
+	size_t local;
+	size_t max_local;
+
+	// work-group sweep state
+	bool sweeping;
+	size_t best_local;
+	double best_per_block;
+
+	bool changed;
+};
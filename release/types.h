@@ -1,11 +1,29 @@
 #pragma once
 
-#define MD5_SIZE 16
-#define BLOCK_SIZE 1024
+#define MATCH_SIZE 16 // leading digest bytes the searches compare
+#define MAX_DIGEST_SIZE 32
+#define BLOCK_SIZE 1024 // keys per block, launches cover a tuned number of blocks
+#define BLOCK_BITS 10 // BLOCK_SIZE == 1 << BLOCK_BITS
 #define KEY_SIZE 16
-#define TOTAL_KEY_SIZE 16 * 1024
-#define TOTAL_MD5_SIZE 16 * 1024
+#define KEYS_PER_ITEM 4 // consecutive keys hashed by each work-item
+#define NO_MATCH 0xffffffff // result slot value when no key matched
 
 typedef unsigned int uint;
 typedef unsigned short ushort;
 typedef unsigned char uchar;
+typedef unsigned long long uint64;
+
+/*Counter keys are 16 bytes, so key indices take 128 bits. Halves as in
+the kernels' ulong2 base: x the low, y the high one.*/
+struct uint128 {
+	uint64 lo;
+	uint64 hi;
+};
+
+// index of key 'offset' counted from the first key of 'block'
+inline uint128 key_index(uint64 block, uint64 offset = 0) {
+	uint128 index;
+	index.lo = (block << BLOCK_BITS) + offset;
+	index.hi = (block >> (64 - BLOCK_BITS)) + (index.lo < offset);
+	return index;
+}
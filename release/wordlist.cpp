@@ -0,0 +1,246 @@
+#include <cstring>
+#include <sstream>
+#include "wordlist.h"
+#include "log.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool wordlist::open(const string& path) {
+	close();
+
+#ifdef _WIN32
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = NULL;
+		return false;
+	}
+
+	LARGE_INTEGER length;
+	GetFileSizeEx(file, &length);
+	size = (uint64)length.QuadPart;
+
+	if (size) {
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		data = mapping ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	}
+#else
+	file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat info;
+	fstat(file, &info);
+	size = (uint64)info.st_size;
+
+	if (size) {
+		void* view = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, file, 0);
+		data = (view == MAP_FAILED) ? NULL : (const char*)view;
+		if (data)
+			madvise(view, (size_t)size, MADV_SEQUENTIAL); // read once, front to back
+	}
+#endif
+
+	if (size && !data) {
+		close();
+		return false;
+	}
+
+	// end each chunk after the last newline in its WORD_CHUNK bytes
+	bounds.assign(1, 0);
+	while (bounds.back() < size) {
+		uint64 first = bounds.back();
+		uint64 last = first + WORD_CHUNK;
+		if (last >= size) {
+			bounds.push_back(size);
+			break;
+		}
+
+		uint64 cut = last;
+		while (cut > first && data[cut - 1] != '\n')
+			--cut;
+
+		// a single line longer than a chunk, it is no key anyway
+		if (cut == first) {
+			const char* end = (const char*)memchr(data + last, '\n', (size_t)(size - last));
+			cut = end ? (uint64)(end - data) + 1 : size;
+		}
+
+		bounds.push_back(cut);
+	}
+
+	LOG_LINE("Mapped wordlist " << path << ". SIZE = " << size << ". CHUNKS = " << get_chunks());
+
+	return true;
+}
+
+void wordlist::close() {
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	file = NULL;
+	mapping = NULL;
+#else
+	if (data)
+		munmap((void*)data, (size_t)size);
+	if (file >= 0)
+		::close(file);
+	file = -1;
+#endif
+
+	data = NULL;
+	size = 0;
+	bounds.assign(1, 0);
+}
+
+void wordlist::pack(uint k, word_batch& batch) const {
+	batch.begin = bounds[k];
+	batch.data = data + bounds[k];
+	batch.size = (uint)(bounds[k + 1] - bounds[k]);
+	batch.words.clear();
+	batch.skipped = 0;
+
+	const char* end = batch.data + batch.size;
+	for (const char* line = batch.data; line < end;) {
+		const char* next = (const char*)memchr(line, '\n', end - line);
+		if (!next)
+			next = end;
+
+		uint length = (uint)(next - line);
+		if (length && line[length - 1] == '\r')
+			--length;
+
+		if (length > MAX_KEY_LEN)
+			++batch.skipped;
+		else if (length)
+			batch.words.push_back((uint)(line - batch.data) << 8 | length);
+
+		line = next + 1;
+	}
+}
+
+string wordlist::word(uint64 offset) const {
+	uint64 end = offset;
+	while (end < size && data[end] != '\n' && data[end] != '\r')
+		++end;
+	return string(data + offset, (size_t)(end - offset));
+}
+
+wordlist::wordlist() {
+	data = NULL;
+	size = 0;
+#ifdef _WIN32
+	file = NULL;
+	mapping = NULL;
+#else
+	file = -1;
+#endif
+	bounds.assign(1, 0);
+}
+wordlist::~wordlist() {
+	close();
+}
+
+
+bool word_feed::push(word_batch& batch) {
+	unique_lock<mutex> guard(lock);
+	space.wait(guard, [&] { return quit || queue.size() < WORD_AHEAD; });
+	if (quit)
+		return false;
+
+	queue.push_back(move(batch));
+	ready.notify_one();
+	return true;
+}
+
+void word_feed::scan() {
+	for (;;) {
+		uint k = chunk++;
+		if (k >= words.get_chunks())
+			break;
+
+		word_batch batch;
+		words.pack(k, batch);
+		read += batch.size;
+		skipped += batch.skipped;
+
+		if (batch.words.size() <= limit) {
+			if (!batch.words.empty() && !push(batch))
+				break;
+			continue;
+		}
+
+		// split, each piece starting at its first word
+		bool stopped = false;
+		for (size_t first = 0; first < batch.words.size() && !stopped; first += limit) {
+			size_t last = (batch.words.size() - first < limit) ? batch.words.size() : first + limit;
+			uint from = batch.words[first] >> 8;
+			uint to = (last < batch.words.size()) ? batch.words[last] >> 8 : batch.size;
+
+			word_batch piece;
+			piece.begin = batch.begin + from;
+			piece.data = batch.data + from;
+			piece.size = to - from;
+			piece.skipped = 0;
+			for (size_t w = first; w < last; ++w)
+				piece.words.push_back(batch.words[w] - (from << 8));
+
+			stopped = !push(piece);
+		}
+
+		if (stopped)
+			break;
+	}
+
+	lock_guard<mutex> guard(lock);
+	if (--running == 0)
+		ready.notify_all();
+}
+
+bool word_feed::next(word_batch& batch) {
+	unique_lock<mutex> guard(lock);
+	ready.wait(guard, [&] { return quit || !queue.empty() || running == 0; });
+	if (quit || queue.empty())
+		return false;
+
+	batch = move(queue.front());
+	queue.pop_front();
+	space.notify_one();
+	return true;
+}
+
+void word_feed::stop() {
+	lock_guard<mutex> guard(lock);
+	quit = true;
+	queue.clear();
+	ready.notify_all();
+	space.notify_all();
+}
+
+word_feed::word_feed(const wordlist& words, uint threads, uint limit) : words(words) {
+	this->limit = limit ? limit : 1;
+	threads = threads ? threads : 1;
+	running = threads;
+	quit = false;
+	chunk = 0;
+	read = 0;
+	skipped = 0;
+
+	for (uint k = 0; k < threads; ++k)
+		scanners.push_back(thread(&word_feed::scan, this));
+}
+word_feed::~word_feed() {
+	stop();
+	for (uint k = 0; k < scanners.size(); ++k)
+		scanners[k].join();
+}
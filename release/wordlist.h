@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mask.h"
+#include "types.h"
+
+using namespace std;
+
+#define WORD_CHUNK (1 << 20) // bytes of wordlist packed per batch, keeps offsets below 2 ** 24
+#define WORD_MAX_COUNT (WORD_CHUNK / 2 + 1) // a word takes at least one char and a newline
+#define WORD_SCANNERS 4 // threads packing chunks
+#define WORD_AHEAD 8 // packed batches waiting for the devices
+
+/*One newline-aligned chunk of a wordlist, packed for upload. 'data'
+points into the mapped file; 'words' holds offset << 8 | length of
+every usable word, offsets relative to 'data'.*/
+struct word_batch {
+	uint64 begin; // file offset of the chunk
+	const char* data;
+	uint size;
+	vector<uint> words;
+	uint skipped; // lines too long for a key
+};
+
+/*A wordlist mapped into memory instead of read line by line. open()
+splits it into chunks of at most WORD_CHUNK bytes that end on a
+newline, so chunks can be packed independently and in any order.
+Hits are reported as the file offset of the word.*/
+class wordlist {
+public:
+	bool open(const string& path);
+	void close();
+
+	uint64 get_size() const { return size; }
+	uint get_chunks() const { return (uint)(bounds.size() - 1); }
+
+	/*Packs chunk 'k': one entry per non-empty line of at most
+	MAX_KEY_LEN chars, a trailing '\r' stripped.*/
+	void pack(uint k, word_batch& batch) const;
+
+	// raw bytes of chunk 'k', for files that are not wordlists
+	const char* chunk(uint k, uint& size) const { size = (uint)(bounds[k + 1] - bounds[k]); return data + bounds[k]; }
+
+	// the word at file offset 'offset'
+	string word(uint64 offset) const;
+
+	wordlist();
+	~wordlist();
+private:
+	const char* data;
+	uint64 size;
+	vector<uint64> bounds; // chunk k is [bounds[k], bounds[k + 1])
+
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+};
+
+
+/*Packs the chunks of a wordlist on WORD_SCANNERS threads and queues
+up to WORD_AHEAD batches, so the devices never wait on the file.
+Chunks with more than 'limit' words are split into several batches.
+Batches come out in no particular order; next() may be called from
+several threads.*/
+class word_feed {
+public:
+	/*Takes the next packed batch, false once the wordlist
+	is exhausted or stop() was called.*/
+	bool next(word_batch& batch);
+
+	// drops everything not yet taken, e.g. after a hit
+	void stop();
+
+	uint64 get_read() { return read; } // bytes packed so far
+	uint64 get_skipped() { return skipped; }
+
+	// the wordlist, to read hit words back
+	const wordlist& get_words() const { return words; }
+
+	word_feed(const wordlist& words, uint threads = WORD_SCANNERS, uint limit = WORD_MAX_COUNT);
+	~word_feed();
+private:
+	const wordlist& words;
+	vector<thread> scanners;
+	uint limit; // words per batch
+
+	mutex lock;
+	condition_variable ready; // a batch was queued or the scanners finished
+	condition_variable space; // a batch was taken
+	deque<word_batch> queue;
+	uint running;
+	bool quit;
+
+	atomic<uint> chunk; // next chunk to pack
+	atomic<uint64> read;
+	atomic<uint64> skipped;
+
+	void scan();
+
+	bool push(word_batch& batch);
+};
@@ -9,6 +9,10 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "utils.h"
 
 int
@@ -172,33 +176,76 @@ bin2hex(const char * src, size_t srclen, char * dst, size_t dstlen)
 	return 0;
 }
 
+/* nibble value of every char, 0xff for anything that is no hex digit */
+static const unsigned char hexval[256] = {
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0,1,2,3,4,5,6,7,8,9,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,10,11,12,13,14,15,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,10,11,12,13,14,15,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+	0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff
+};
+
 int
 hex2bin(const char * src, size_t srclen, char * dst, size_t dstlen)
 {
-	int i;
-	const char * p;
-	char ch, ch2;
+	size_t i, bytes;
+	unsigned char hi, lo, invalid;
 
 	if (!src || !srclen || !dst) return -1;
 	if (srclen%2 || (srclen>>1 > dstlen)) return -1;
 
-	p = src;
-	do {
-		ch2 = 0;
-		for (i=4;i>=0;i-=4) {
-			if (*p >= '0' && *p <= '9') ch = *p - '0';
-			else if (*p >= 'a' && *p <= 'f') ch = *p - 'a' + 10; 
-			else if (*p >= 'A' && *p <= 'F') ch = *p - 'A' + 10;
-			else return -1;
-			ch2 |= (ch << i);
-			p++;
+	/*
+	 * nothing branches on the data: 16 chars at a time with SSE2, the
+	 * rest through the table. dst may be src, each store lands behind
+	 * everything read so far.
+	 */
+	bytes = srclen >> 1;
+	i = 0;
+#ifdef __SSE2__
+	{
+		const __m128i zero = _mm_setzero_si128(), low = _mm_set1_epi16(0xff);
+		__m128i c, lower, digit, letter, value, pairs;
+
+		for (; i + 8 <= bytes; i += 8) {
+			c = _mm_loadu_si128((const __m128i *)(src + i * 2));
+			lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+			digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+			    _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+			letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+			    _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+			if (_mm_movemask_epi8(_mm_or_si128(digit, letter)) != 0xffff)
+				return -1;
+
+			value = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+			    _mm_and_si128(letter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+			/* first char of a pair: low byte of its 16-bit lane, high nibble */
+			pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(value, low), 4),
+			    _mm_srli_epi16(value, 8));
+			_mm_storel_epi64((__m128i *)(dst + i), _mm_packus_epi16(pairs, zero));
 		}
-		*dst = ch2;
-		dst++;
-		srclen -= 2;
-	} while (srclen);
+	}
+#endif
 
-	return 0;
+	invalid = 0;
+	for (; i < bytes; i++) {
+		hi = hexval[(unsigned char)src[i * 2]];
+		lo = hexval[(unsigned char)src[i * 2 + 1]];
+		invalid |= (hi | lo) & 0xf0;
+		dst[i] = (char)(hi << 4 | lo);
+	}
+
+	return invalid ? -1 : 0;
 }
 
 int